@@ -76,6 +76,12 @@
              ARG_STRING,                                \
              NULL,                                      \
              "Directory to log senone score files to"   \
+             },                                         \
+    { "-senlogfmt",                                     \
+             ARG_STRING,                                \
+             "legacy",                                  \
+             "Format of senone score files: legacy, indexed, " \
+             "or indexed with delta or int8 compression" \
              }
 
 /** Options defining beam width parameters for tuning the search. */
@@ -155,6 +161,26 @@
       ARG_INT32,                                                                                \
       "5000",                                                                                   \
       "Initial backpointer table size" },                                                       \
+{ "-bptbl_gc",                                                                                  \
+      ARG_INT32,                                                                                \
+      "0",                                                                                      \
+      "Frames between backpointer table garbage collections (or 0 for none)" },                 \
+{ "-lmcache",                                                                                   \
+      ARG_INT32,                                                                                \
+      "65536",                                                                                  \
+      "Number of language model scores to cache during search (or 0 for no caching)" },         \
+{ "-lmlookahead",                                                                               \
+      ARG_BOOLEAN,                                                                              \
+      "no",                                                                                     \
+      "Apply unigram LM lookahead in lexicon tree search (allows tighter beams)" },             \
+{ "-nthreads_search",                                                                           \
+      ARG_INT32,                                                                                \
+      "1",                                                                                      \
+      "Number of threads to use for evaluating HMMs in lexicon tree search" },                  \
+{ "-lextreeimg",                                                                                \
+      ARG_STRING,                                                                               \
+      NULL,                                                                                     \
+      "Lexicon tree image file, loaded if up to date or else rebuilt and written at startup" }, \
 { "-maxwpf",                                                                                    \
       ARG_INT32,                                                                                \
       "-1",                                                                                     \
@@ -220,7 +246,11 @@
 { "-fsgusefiller",                                              \
         ARG_BOOLEAN,                                            \
         "yes",                                                  \
-        "Insert filler words at each state."}
+        "Insert filler words at each state."},                  \
+{ "-wfst",                                                      \
+        ARG_STRING,                                             \
+        NULL,                                                   \
+        "Precompiled decoding graph file" }
 
 /** Command-line options for statistical language models. */
 #define POCKETSPHINX_NGRAM_OPTIONS \
@@ -354,6 +384,10 @@
       ARG_STRING,                                                               \
       NULL,                                                                     \
       "Senone dump (compressed mixture weights) input file" },                  \
+{ "-kdtree",                                                                    \
+      ARG_STRING,                                                               \
+      NULL,                                                                     \
+      "kd-tree (Gaussian selection) input file for semi-continuous and PTM models" },\
 { "-mllr",                                                                      \
       ARG_STRING,                                                               \
       NULL,                                                                     \
@@ -374,6 +408,30 @@
       ARG_STRING,                                                               \
       "0",                                                                     \
       "Beam width used to determine top-N Gaussians (or a list, per-feature)" },\
+{ "-cb_beam",                                                                   \
+      ARG_FLOAT64,                                                              \
+      "0",                                                                      \
+      "Beam width used to prune codebooks from previous frame's top-N Gaussians in PTM models (0 to disable)" },\
+{ "-fastlogadd",                                                                \
+      ARG_BOOLEAN,                                                              \
+      "no",                                                                     \
+      "Use 8-bit fast log-addition for senone scores in continuous models" },   \
+{ "-gmm_simd",                                                                  \
+      ARG_STRING,                                                               \
+      "auto",                                                                   \
+      "SIMD instruction set for Gaussian computation (auto, none, sse4, avx2, avx512, neon)" },\
+{ "-nthreads_score",                                                            \
+      ARG_INT32,                                                                \
+      "1",                                                                      \
+      "Number of threads to use for computing acoustic scores" },               \
+{ "-score_batch",                                                               \
+      ARG_INT32,                                                                \
+      "1",                                                                      \
+      "Number of frames to score at once (only with -compallsen)" },            \
+{ "-pipeline",                                                                  \
+      ARG_BOOLEAN,                                                              \
+      "no",                                                                     \
+      "Run live front end, search and (with -compallsen) scoring in threads" }, \
 { "-logbase",                                                                   \
       ARG_FLOAT32,                                                              \
       "1.0001",                                                                 \
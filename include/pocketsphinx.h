@@ -299,6 +299,34 @@ POCKETSPHINX_EXPORT
 long ps_decode_raw(ps_decoder_t *ps, FILE *rawfh,
                    long maxsamps);
 
+/**
+ * Decode a raw audio stream against several searches at once.
+ *
+ * This is meant for choosing among a set of grammars (added with
+ * ps_set_fsg() or ps_set_jsgf_file()), but any searches will do.
+ * They are run frame by frame over the same audio, and senone scores
+ * are computed once per frame for all of them (see
+ * ps_activate_search()).  The search selected with ps_set_search()
+ * is left as it was.
+ *
+ * @param ps Decoder.
+ * @param rawfh Previously opened file stream, read until end-of-file.
+ * @param names Names of the searches to run.
+ * @param n_names Number of entries in names.
+ * @param out_hyps Output: hypothesis from each search, or NULL if it
+ *                 has none.  These strings are owned by the searches
+ *                 and are valid until their next utterance.  May be
+ *                 NULL.
+ * @param out_scores Output: path score of each hypothesis.  May be
+ *                   NULL.
+ * @return Index in names of the search with the best scoring
+ *         hypothesis, or -1 if none of them has one or on error.
+ */
+POCKETSPHINX_EXPORT
+int ps_decode_multi(ps_decoder_t *ps, FILE *rawfh,
+                    char const * const *names, int n_names,
+                    char const **out_hyps, int32 *out_scores);
+
 /**
  * Decode a senone score dump file.
  *
@@ -309,6 +337,20 @@ long ps_decode_raw(ps_decoder_t *ps, FILE *rawfh,
 POCKETSPHINX_EXPORT
 int ps_decode_senscr(ps_decoder_t *ps, FILE *senfh);
 
+/**
+ * Decode a senone score dump file, given its name.
+ *
+ * Files written with -senlogfmt other than "legacy" are
+ * memory-mapped if -mmap is enabled, so that the search can be rerun
+ * many times over the same scores without any I/O.
+ *
+ * @param ps Decoder
+ * @param file Name of senone score dump file.
+ * @return Number of frames read, or <0 on error.
+ */
+POCKETSPHINX_EXPORT
+int ps_decode_senscr_file(ps_decoder_t *ps, char const *file);
+
 /**
  * Start processing of the stream of speech. Channel parameters like
  * noise-level are maintained for the stream and reused among utterances.
@@ -343,7 +385,8 @@ int ps_start_utt(ps_decoder_t *ps);
  * @param full_utt If non-zero, this block of data is a full utterance
  *                 worth of data.  This may allow the recognizer to
  *                 produce more accurate results.
- * @return Number of frames of data searched, or <0 for error.
+ * @return Number of frames of data searched (or, with -pipeline,
+ *         queued to be searched), or <0 for error.
  */
 POCKETSPHINX_EXPORT
 int ps_process_raw(ps_decoder_t *ps,
@@ -372,6 +415,23 @@ int ps_process_cep(ps_decoder_t *ps,
                    int no_search,
                    int full_utt);
 
+/**
+ * Wait for all data passed to the decoder to be searched.
+ *
+ * With -pipeline, ps_process_raw() and ps_process_cep() only run the
+ * front end and leave the search to a separate thread.  This waits
+ * for that thread to catch up.  It is done automatically by
+ * ps_end_utt() and by anything else that needs the whole search, such
+ * as ps_seg_iter() or ps_get_lattice(), while ps_get_hyp() only
+ * reflects the frames searched so far.  Without -pipeline, this does
+ * nothing.
+ *
+ * @param ps Decoder.
+ * @return 0 for success, <0 if there was an error in the search.
+ */
+POCKETSPHINX_EXPORT
+int ps_wait_frames(ps_decoder_t *ps);
+
 /**
  * Get the number of frames of data searched.
  *
@@ -408,6 +468,29 @@ int ps_end_utt(ps_decoder_t *ps);
 POCKETSPHINX_EXPORT
 char const *ps_get_hyp(ps_decoder_t *ps, int32 *out_best_score);
 
+/**
+ * Get words that have become final since the last call.
+ *
+ * With -bptbl_gc, the N-Gram search periodically forgets the parts of
+ * the search history that no active path can reach, so that an
+ * utterance can go on forever.  Words that all active paths share can
+ * no longer change, and are returned by this function, once each.
+ *
+ * Words become final whether or not this function is called.  Those
+ * not returned yet come first in ps_get_hyp(), but ps_seg_iter()
+ * never includes any final words, since their segmentation is
+ * forgotten along with the rest of their history.  Until they are
+ * returned, final words are kept as text, so in a long utterance the
+ * application has to call this function regularly (e.g. after each
+ * call to ps_process_raw()) for memory use to stay bounded.
+ *
+ * @param ps Decoder.
+ * @return String containing the newly final words, or NULL if there
+ *         are none (or the current search does not do this).
+ */
+POCKETSPHINX_EXPORT
+char const *ps_get_stable_hyp(ps_decoder_t *ps);
+
 /**
  * Get posterior probability.
  *
@@ -443,6 +526,9 @@ ps_lattice_t *ps_get_lattice(ps_decoder_t *ps);
 /**
  * Get an iterator over the word segmentation for the best hypothesis.
  *
+ * With -bptbl_gc, this leaves out the words that have become final,
+ * even if ps_get_hyp() still includes them (see ps_get_stable_hyp()).
+ *
  * @param ps Decoder.
  * @return Iterator over the best hypothesis at this point in
  *         decoding.  NULL if no hypothesis is available.
@@ -450,6 +536,41 @@ ps_lattice_t *ps_get_lattice(ps_decoder_t *ps);
 POCKETSPHINX_EXPORT
 ps_seg_t *ps_seg_iter(ps_decoder_t *ps);
 
+/**
+ * Get hypothesis string and path score from a named search.
+ *
+ * This works like ps_get_hyp(), but for any search, including those
+ * run alongside the current one with ps_activate_search().
+ *
+ * @param ps Decoder.
+ * @param name Name of the search.
+ * @param out_best_score Output: path score corresponding to returned string.
+ * @return String containing best hypothesis at this point in
+ *         decoding.  NULL if no hypothesis is available or there is
+ *         no search with this name.
+ */
+POCKETSPHINX_EXPORT
+char const *ps_get_search_hyp(ps_decoder_t *ps, const char *name,
+                              int32 *out_best_score);
+
+/**
+ * Get posterior probability from a named search.
+ *
+ * @see ps_get_prob
+ * @see ps_activate_search
+ */
+POCKETSPHINX_EXPORT
+int32 ps_get_search_prob(ps_decoder_t *ps, const char *name);
+
+/**
+ * Get an iterator over the word segmentation from a named search.
+ *
+ * @see ps_seg_iter
+ * @see ps_activate_search
+ */
+POCKETSPHINX_EXPORT
+ps_seg_t *ps_get_search_seg_iter(ps_decoder_t *ps, const char *name);
+
 /**
  * Get the next segment in a word segmentation.
  *
@@ -602,8 +723,10 @@ uint8 ps_get_in_speech(ps_decoder_t *ps);
  * Sets the limit of the raw audio data to store in decoder
  * to retrieve it later on ps_get_rawdata.
  *
+ * The most recent audio of the utterance is kept, up to this limit.
+ *
  * @param ps Decoder
- * @param size bytes of the utterance to store
+ * @param size samples of the utterance to store
  */
 POCKETSPHINX_EXPORT
 void ps_set_rawdata_size(ps_decoder_t *ps, int32 size);
@@ -613,8 +736,9 @@ void ps_set_rawdata_size(ps_decoder_t *ps, int32 size);
  * Retrieves the raw data collected during utterance decoding.
  * 
  * @param ps Decoder
- * @param buffer preallocated buffer to store the data, must be within the limit
- * set before
+ * @param buffer Output: pointer to the data, which belongs to the
+ * decoder and is valid until more audio is processed or a new
+ * utterance is started.
  * @param size size of the data collected in samples (not bytes).
  */
 POCKETSPHINX_EXPORT
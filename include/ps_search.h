@@ -43,12 +43,16 @@
  * <li>grammar - recognizes speech according to JSGF grammar. Unlike keyphrase grammar search doesn't ignore words which are not in grammar but tries to recognize them.</li>
  * <li>ngram/lm - recognizes natural speech with a language model.</li>
  * <li>allphone - recognizes phonemes with a phonetic language model.</li>
+ * <li>wfst - recognizes speech with a precompiled decoding graph, built
+ * from a grammar or a language model, which is faster for small and
+ * medium vocabularies.</li>
  * </ul>
  * 
  * Each search has a name and can be referenced by a name, names are
  * application-specific. The function ps_set_search allows to activate
  * the search previously added by a name. Only single search can be
- * activated at time.
+ * activated at time, but ps_activate_search() can run others alongside
+ * it on the same audio.
  *
  * To add the search one needs to point to the grammar/language model
  * describing the search. The location of the grammar is specific to the
@@ -116,6 +120,34 @@ const char* ps_get_search(ps_decoder_t *ps);
 POCKETSPHINX_EXPORT
 int ps_unset_search(ps_decoder_t *ps, const char *name);
 
+/**
+ * Run a search alongside the current one.
+ *
+ * From the next utterance on, the named search is decoded on the same
+ * audio as the search selected with ps_set_search().  Senone scores
+ * are computed only once per frame, for all the senones that the
+ * running searches need, so this is cheaper than running a second
+ * decoder.  Use ps_get_search_hyp(), ps_get_search_prob() and
+ * ps_get_search_seg_iter() to get its results.
+ *
+ * Phoneme lookahead (-pl_window) follows the current search, and
+ * other searches are stepped on the same frames as it.
+ *
+ * @return 0 on success, -1 if there is no such search or an utterance
+ *         is in progress.
+ */
+POCKETSPHINX_EXPORT
+int ps_activate_search(ps_decoder_t *ps, const char *name);
+
+/**
+ * Stop running a search alongside the current one.
+ *
+ * @see ps_activate_search
+ * @return 0 on success, -1 if the search was not running.
+ */
+POCKETSPHINX_EXPORT
+int ps_deactivate_search(ps_decoder_t *ps, const char *name);
+
 /**
  * Returns iterator over current searches 
  *
@@ -293,6 +325,45 @@ int ps_set_allphone(ps_decoder_t *ps, const char *name, ngram_model_t *lm);
 POCKETSPHINX_EXPORT
 int ps_set_allphone_file(ps_decoder_t *ps, const char *name, const char *path);
 
+/**
+ * Adds new search based on a precompiled decoding graph.
+ *
+ * The graph must have been built for the acoustic model in use, with
+ * ps_build_wfst_fsg() or ps_build_wfst_lm().  It is memory-mapped if
+ * -mmap is enabled.
+ *
+ * @see ps_set_search
+ */
+POCKETSPHINX_EXPORT
+int ps_set_wfst_file(ps_decoder_t *ps, const char *name, const char *path);
+
+/**
+ * Build a decoding graph from a finite state grammar.
+ *
+ * The graph uses the current dictionary and acoustic model, as well
+ * as -wip, -pip, -silprob and -fillprob.  Context-dependent phones
+ * are not expanded across words: silence is assumed at word
+ * boundaries.
+ *
+ * @param path File to write the graph to.
+ * @return 0 for success, <0 on failure.
+ */
+POCKETSPHINX_EXPORT
+int ps_build_wfst_fsg(ps_decoder_t *ps, fsg_model_t *fsg, const char *path);
+
+/**
+ * Build a decoding graph from an N-gram language model.
+ *
+ * As ps_build_wfst_fsg(), but only the unigrams and bigrams of the
+ * model are used.  Building takes time quadratic in the size of the
+ * vocabulary, so this is meant for medium-vocabulary tasks.
+ *
+ * @param path File to write the graph to.
+ * @return 0 for success, <0 on failure.
+ */
+POCKETSPHINX_EXPORT
+int ps_build_wfst_lm(ps_decoder_t *ps, ngram_model_t *lm, const char *path);
+
 #ifdef __cplusplus
 }
 #endif
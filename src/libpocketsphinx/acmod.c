@@ -62,7 +62,13 @@
 #include "ptm_mgau.h"
 #include "ms_mgau.h"
 
+/* Seconds of data that can be waiting to be written to each log file
+ * before the decoder has to wait for the disk. */
+#define ACMOD_LOG_SECS 4
+
 static int32 acmod_process_mfcbuf(acmod_t *acmod);
+static int acmod_score_batch_wait(acmod_t *acmod);
+static void acmod_score_batch_reset(acmod_t *acmod);
 
 static int
 acmod_init_am(acmod_t *acmod)
@@ -288,6 +294,40 @@ acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
                                                      sizeof(*acmod->senone_active));
     acmod->log_zero = logmath_get_zero(acmod->lmath);
     acmod->compallsen = cmd_ln_boolean_r(config, "-compallsen");
+    acmod->rawring = ps_rawring_init(0);
+
+    /* Batched scoring, if the model supports it.  In a pipeline, all
+     * senones are scored on a separate thread, one batch ahead of the
+     * search, and scores are kept for the frames it may look back
+     * at. */
+    acmod->n_batch_alloc = cmd_ln_int32_r(config, "-score_batch");
+    if (acmod->n_batch_alloc > 1 && !acmod->compallsen) {
+        /* The active senones for future frames aren't known until
+         * the search gets there, so there is nothing to batch. */
+        E_WARN("-score_batch requires -compallsen, scoring one frame at a time\n");
+        acmod->n_batch_alloc = 1;
+    }
+    acmod->n_batch_ring = acmod->n_batch_alloc;
+    if (cmd_ln_boolean_r(config, "-pipeline") && acmod->compallsen
+        && acmod->mgau->vt->frame_eval_batch) {
+        if (acmod->n_batch_alloc < 1)
+            acmod->n_batch_alloc = 1;
+        acmod->n_batch_ring = acmod->n_batch_alloc * 2
+            + cmd_ln_int32_r(config, "-pl_window") + 1;
+        acmod->score_pool = ps_workpool_init(2);
+    }
+    if ((acmod->n_batch_alloc > 1 || acmod->score_pool)
+        && acmod->mgau->vt->frame_eval_batch) {
+        acmod->senscr_batch = (int16 **)
+            ckd_calloc_2d(acmod->n_batch_ring, bin_mdef_n_sen(acmod->mdef),
+                          sizeof(**acmod->senscr_batch));
+        acmod->senscr_eval = ckd_calloc(acmod->n_batch_alloc,
+                                        sizeof(*acmod->senscr_eval));
+        acmod->feat_batch = ckd_calloc(acmod->n_batch_alloc,
+                                       sizeof(*acmod->feat_batch));
+    }
+    else
+        acmod->n_batch_alloc = acmod->n_batch_ring = 1;
     return acmod;
 
 error_out:
@@ -301,6 +341,8 @@ acmod_free(acmod_t *acmod)
     if (acmod == NULL)
         return;
 
+    acmod_score_batch_reset(acmod);
+    ps_workpool_free(acmod->score_pool);
     feat_free(acmod->fcb);
     fe_free(acmod->fe);
     cmd_ln_free_r(acmod->config);
@@ -310,18 +352,22 @@ acmod_free(acmod_t *acmod)
     if (acmod->feat_buf)
         feat_array_free(acmod->feat_buf);
 
-    if (acmod->mfcfh)
-        fclose(acmod->mfcfh);
-    if (acmod->rawfh)
-        fclose(acmod->rawfh);
-    if (acmod->senfh)
-        fclose(acmod->senfh);
+    acmod_set_rawfh(acmod, NULL);
+    acmod_set_mfcfh(acmod, NULL);
+    acmod_set_senfh(acmod, NULL);
+    ps_logwriter_free(acmod->logwriter);
+    ps_rawring_free(acmod->rawring);
+    senfile_free(acmod->insenfile);
 
     ckd_free(acmod->framepos);
     ckd_free(acmod->senone_scores);
     ckd_free(acmod->senone_active_vec);
+    ckd_free(acmod->senlog_buf);
     ckd_free(acmod->senone_active);
-    ckd_free(acmod->rawdata);
+    if (acmod->senscr_batch)
+        ckd_free_2d((void **)acmod->senscr_batch);
+    ckd_free(acmod->senscr_eval);
+    ckd_free(acmod->feat_batch);
 
     if (acmod->mdef)
         bin_mdef_free(acmod->mdef);
@@ -338,6 +384,7 @@ acmod_free(acmod_t *acmod)
 ps_mllr_t *
 acmod_update_mllr(acmod_t *acmod, ps_mllr_t *mllr)
 {
+    acmod_score_batch_reset(acmod);
     if (acmod->mllr)
         ps_mllr_free(acmod->mllr);
     acmod->mllr = mllr;
@@ -360,41 +407,112 @@ acmod_write_senfh_header(acmod_t *acmod, FILE *logfh)
                         "logbase", logbasestr, NULL);
 }
 
+/**
+ * Queue a log file for writing by the log writer thread.
+ */
+static ps_logfile_t *
+acmod_open_log(acmod_t *acmod, FILE *logfh, size_t bytes_per_sec)
+{
+    if (acmod->logwriter == NULL)
+        acmod->logwriter = ps_logwriter_init();
+    return ps_logfile_open(acmod->logwriter, logfh,
+                           bytes_per_sec * ACMOD_LOG_SECS);
+}
+
 int
 acmod_set_senfh(acmod_t *acmod, FILE *logfh)
 {
-    if (acmod->senfh)
-        fclose(acmod->senfh);
-    acmod->senfh = logfh;
+    char const *fmt;
+    int32 n_sen;
+    int compress, rv = 0;
+
+    if (acmod->senwriter) {
+        rv = senfile_writer_close(acmod->senwriter);
+        acmod->senwriter = NULL;
+    }
+    if (ps_logfile_close(acmod->senlog) < 0)
+        rv = -1;
+    acmod->senlog = NULL;
     if (logfh == NULL)
-        return 0;
-    return acmod_write_senfh_header(acmod, logfh);
+        return rv;
+
+    fmt = cmd_ln_str_r(acmod->config, "-senlogfmt");
+    if (fmt == NULL || 0 == strcmp(fmt, "legacy"))
+        compress = -1;
+    else if (0 == strcmp(fmt, "indexed"))
+        compress = SENFILE_COMPRESS_NONE;
+    else if ((compress = senfile_compress_type(fmt)) < 0) {
+        E_ERROR("Unknown senone score file format %s\n", fmt);
+        return -1;
+    }
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    if (compress >= 0)
+        rv = senfile_write_header(logfh, compress, n_sen,
+                                  cmd_ln_str_r(acmod->config, "_mdef"),
+                                  logmath_get_base(acmod->lmath));
+    else
+        rv = acmod_write_senfh_header(acmod, logfh);
+    if (rv < 0) {
+        fclose(logfh);
+        return -1;
+    }
+
+    /* The header is buffered in logfh, which the log writer takes
+     * over from here. */
+    if (acmod->senlog_buf == NULL)
+        acmod->senlog_buf = ckd_calloc(2 + 3 * n_sen, 1);
+    acmod->senlog = acmod_open_log(acmod, logfh,
+                                   cmd_ln_int32_r(acmod->config, "-frate")
+                                   * (2 + 3 * n_sen));
+    if (compress >= 0)
+        acmod->senwriter = senfile_writer_init(acmod->senlog, compress, n_sen);
+    return 0;
 }
 
 int
 acmod_set_mfcfh(acmod_t *acmod, FILE *logfh)
 {
+    int32 outlen;
     int rv = 0;
 
-    if (acmod->mfcfh)
-        fclose(acmod->mfcfh);
-    acmod->mfcfh = logfh;
-    fwrite(&rv, 4, 1, acmod->mfcfh);
-    return rv;
+    if (acmod->mfclog) {
+        /* Fill in the number of values in the header. */
+        outlen = (int32)((ps_logfile_tell(acmod->mfclog) - 4) / 4);
+        ps_logfile_patch(acmod->mfclog, 0, &outlen, 4);
+        rv = ps_logfile_close(acmod->mfclog);
+        acmod->mfclog = NULL;
+    }
+    if (logfh == NULL)
+        return rv;
+    acmod->mfclog = acmod_open_log(acmod, logfh,
+                                   cmd_ln_int32_r(acmod->config, "-frate")
+                                   * feat_cepsize(acmod->fcb)
+                                   * sizeof(mfcc_t));
+    outlen = 0;
+    return ps_logfile_write(acmod->mfclog, &outlen, 4);
 }
 
 int
 acmod_set_rawfh(acmod_t *acmod, FILE *logfh)
 {
-    if (acmod->rawfh)
-        fclose(acmod->rawfh);
-    acmod->rawfh = logfh;
+    int rv;
+
+    rv = ps_logfile_close(acmod->rawlog);
+    acmod->rawlog = NULL;
+    if (logfh == NULL)
+        return rv;
+    acmod->rawlog = acmod_open_log(acmod, logfh,
+                                   (size_t)cmd_ln_float32_r(acmod->config,
+                                                            "-samprate")
+                                   * sizeof(int16));
     return 0;
 }
 
 void
 acmod_grow_feat_buf(acmod_t *acmod, int nfr)
 {
+    /* Frames being scored ahead would be pulled out from under it. */
+    acmod_score_batch_wait(acmod);
     if (nfr > MAX_N_FRAMES)
         E_FATAL("Decoder can not process more than %d frames at once, "
                 "requested %d\n", MAX_N_FRAMES, nfr);
@@ -431,8 +549,10 @@ acmod_start_utt(acmod_t *acmod)
     acmod->output_frame = 0;
     acmod->senscr_frame = -1;
     acmod->n_senone_active = 0;
+    acmod->hold_active = FALSE;
+    acmod_score_batch_reset(acmod);
     acmod->mgau->frame_idx = 0;
-    acmod->rawdata_pos = 0;
+    ps_rawring_reset(acmod->rawring);
 
     return 0;
 }
@@ -457,26 +577,11 @@ acmod_end_utt(acmod_t *acmod)
         else
             feat_update_stats(acmod->fcb);
     }
-    if (acmod->mfcfh) {
-        long outlen;
-        int32 rv;
-        outlen = (ftell(acmod->mfcfh) - 4) / 4;
-        /* Try to seek and write */
-        if ((rv = fseek(acmod->mfcfh, 0, SEEK_SET)) == 0) {
-            fwrite(&outlen, 4, 1, acmod->mfcfh);
-        }
-        fclose(acmod->mfcfh);
-        acmod->mfcfh = NULL;
-    }
-    if (acmod->rawfh) {
-        fclose(acmod->rawfh);
-        acmod->rawfh = NULL;
-    }
-
-    if (acmod->senfh) {
-        fclose(acmod->senfh);
-        acmod->senfh = NULL;
-    }
+    /* This waits for the log files to be finished, but not for
+     * anything else. */
+    acmod_set_mfcfh(acmod, NULL);
+    acmod_set_rawfh(acmod, NULL);
+    acmod_set_senfh(acmod, NULL);
 
     return nfr;
 }
@@ -486,11 +591,8 @@ acmod_log_mfc(acmod_t *acmod,
               mfcc_t **cep, int n_frames)
 {
     int n = n_frames * feat_cepsize(acmod->fcb);
-    /* Write features. */
-    if (fwrite(cep[0], sizeof(mfcc_t), n, acmod->mfcfh) != n) {
-        E_ERROR_SYSTEM("Failed to write %d values to file", n);
-    }
-    return 0;
+    /* Queue features for writing. */
+    return ps_logfile_write(acmod->mfclog, cep[0], n * sizeof(mfcc_t));
 }
 
 static int
@@ -501,7 +603,7 @@ acmod_process_full_cep(acmod_t *acmod,
     int32 nfr;
 
     /* Write to file. */
-    if (acmod->mfcfh)
+    if (acmod->mfclog)
         acmod_log_mfc(acmod, *inout_cep, *inout_n_frames);
 
     /* Resize feat_buf to fit. */
@@ -536,13 +638,12 @@ acmod_process_full_raw(acmod_t *acmod,
     int32 nfr, ntail;
     mfcc_t **cepptr;
 
-    /* Write to logging file if any. */
-    if (*inout_n_samps + acmod->rawdata_pos < acmod->rawdata_size) {
-	memcpy(acmod->rawdata + acmod->rawdata_pos, *inout_raw, *inout_n_samps * sizeof(int16));
-	acmod->rawdata_pos += *inout_n_samps;
-    }
-    if (acmod->rawfh)
-        fwrite(*inout_raw, sizeof(int16), *inout_n_samps, acmod->rawfh);
+    /* Keep it and write to logging file if any. */
+    if (acmod->rawdata_size > 0)
+        ps_rawring_write(acmod->rawring, *inout_raw, *inout_n_samps);
+    if (acmod->rawlog)
+        ps_logfile_write(acmod->rawlog, *inout_raw,
+                         *inout_n_samps * sizeof(int16));
     /* Resize mfc_buf to fit. */
     if (fe_process_frames(acmod->fe, NULL, inout_n_samps, NULL, &nfr, NULL) < 0)
         return -1;
@@ -603,6 +704,55 @@ acmod_process_mfcbuf(acmod_t *acmod)
     return ncep;
 }
 
+int
+acmod_process_raw_cep(acmod_t *acmod,
+                      int16 const **inout_raw,
+                      size_t *inout_n_samps,
+                      mfcc_t **cep,
+                      int32 *inout_n_frames,
+                      int32 *out_frameidx)
+{
+    if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
+                          cep, inout_n_frames, out_frameidx) < 0)
+        return -1;
+    return 0;
+}
+
+void
+acmod_keep_raw(acmod_t *acmod,
+               int16 const *raw,
+               size_t n_samps,
+               int32 frameidx)
+{
+    if (frameidx > 0)
+        acmod->utt_start_frame = frameidx;
+
+    /* Keep it and write to logging file if any. */
+    if (acmod->rawdata_size > 0)
+        ps_rawring_write(acmod->rawring, raw, n_samps);
+    if (acmod->rawlog)
+        ps_logfile_write(acmod->rawlog, raw, n_samps * sizeof(int16));
+}
+
+/* Run the front end and keep the raw audio it used. */
+static int
+acmod_process_raw_block(acmod_t *acmod,
+                        int16 const **inout_raw,
+                        size_t *inout_n_samps,
+                        mfcc_t **cep,
+                        int32 *inout_n_frames)
+{
+    int16 const *prev_audio_inptr = *inout_raw;
+    int32 out_frameidx;
+
+    if (acmod_process_raw_cep(acmod, inout_raw, inout_n_samps,
+                              cep, inout_n_frames, &out_frameidx) < 0)
+        return -1;
+    acmod_keep_raw(acmod, prev_audio_inptr, *inout_raw - prev_audio_inptr,
+                   out_frameidx);
+    return 0;
+}
+
 int
 acmod_process_raw(acmod_t *acmod,
                   int16 const **inout_raw,
@@ -610,8 +760,6 @@ acmod_process_raw(acmod_t *acmod,
                   int full_utt)
 {
     int32 ncep;
-    int32 out_frameidx;
-    int16 const *prev_audio_inptr;
     
     /* If this is a full utterance, process it all at once. */
     if (full_utt)
@@ -621,9 +769,7 @@ acmod_process_raw(acmod_t *acmod,
      * (in practice, there will probably be none) */
     if (inout_n_samps && *inout_n_samps) {
         int inptr;
-        int32 processed_samples;
 
-        prev_audio_inptr = *inout_raw;
         /* Total number of frames available. */
         ncep = acmod->n_mfc_alloc - acmod->n_mfc_frame;
         /* Where to start writing them (circular buffer) */
@@ -632,25 +778,9 @@ acmod_process_raw(acmod_t *acmod,
         /* Write them in two (or more) parts if there is wraparound. */
         while (inptr + ncep > acmod->n_mfc_alloc) {
             int32 ncep1 = acmod->n_mfc_alloc - inptr;
-            if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
-                                  acmod->mfc_buf + inptr, &ncep1, &out_frameidx) < 0)
+            if (acmod_process_raw_block(acmod, inout_raw, inout_n_samps,
+                                        acmod->mfc_buf + inptr, &ncep1) < 0)
                 return -1;
-	    
-	    if (out_frameidx > 0)
-		acmod->utt_start_frame = out_frameidx;
-
-    	    processed_samples = *inout_raw - prev_audio_inptr;
-	    if (processed_samples + acmod->rawdata_pos < acmod->rawdata_size) {
-		memcpy(acmod->rawdata + acmod->rawdata_pos, prev_audio_inptr, processed_samples * sizeof(int16));
-		acmod->rawdata_pos += processed_samples;
-	    }
-            /* Write to logging file if any. */
-            if (acmod->rawfh) {
-                fwrite(prev_audio_inptr, sizeof(int16),
-                       processed_samples,
-                       acmod->rawfh);
-            }
-            prev_audio_inptr = *inout_raw;
             
             /* ncep1 now contains the number of frames actually
              * processed.  This is a good thing, but it means we
@@ -668,24 +798,9 @@ acmod_process_raw(acmod_t *acmod,
         }
 
         assert(inptr + ncep <= acmod->n_mfc_alloc);        
-        if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
-                              acmod->mfc_buf + inptr, &ncep, &out_frameidx) < 0)
+        if (acmod_process_raw_block(acmod, inout_raw, inout_n_samps,
+                                    acmod->mfc_buf + inptr, &ncep) < 0)
             return -1;
-
-	if (out_frameidx > 0)
-	    acmod->utt_start_frame = out_frameidx;
-
-	
-	processed_samples = *inout_raw - prev_audio_inptr;
-	if (processed_samples + acmod->rawdata_pos < acmod->rawdata_size) {
-	    memcpy(acmod->rawdata + acmod->rawdata_pos, prev_audio_inptr, processed_samples * sizeof(int16));
-	    acmod->rawdata_pos += processed_samples;
-	}
-        if (acmod->rawfh) {
-            fwrite(prev_audio_inptr, sizeof(int16),
-                   processed_samples, acmod->rawfh);
-        }
-        prev_audio_inptr = *inout_raw;
         acmod->n_mfc_frame += ncep;
     alldone:
         ;
@@ -709,7 +824,7 @@ acmod_process_cep(acmod_t *acmod,
         return acmod_process_full_cep(acmod, inout_cep, inout_n_frames);
 
     /* Write to file. */
-    if (acmod->mfcfh)
+    if (acmod->mfclog)
         acmod_log_mfc(acmod, *inout_cep, *inout_n_frames);
 
     /* Maximum number of frames we're going to generate. */
@@ -863,14 +978,41 @@ error_out:
 int
 acmod_set_insenfh(acmod_t *acmod, FILE *senfh)
 {
+    return acmod_set_insenfile(acmod, senfh, NULL);
+}
+
+int
+acmod_set_insenfile(acmod_t *acmod, FILE *senfh, char const *file)
+{
+    senfile_free(acmod->insenfile);
+    acmod->insenfile = NULL;
     acmod->insenfh = senfh;
+    acmod_score_batch_reset(acmod);
     if (senfh == NULL) {
         acmod->n_feat_frame = 0;
         acmod->compallsen = cmd_ln_boolean_r(acmod->config, "-compallsen");
         return 0;
     }
     acmod->compallsen = TRUE;
-    return acmod_read_senfh_header(acmod);
+    if (senfile_read(acmod->config, file, senfh, &acmod->insenfile) < 0)
+        return -1;
+    if (acmod->insenfile == NULL)
+        return acmod_read_senfh_header(acmod);
+
+    if (acmod->insenfile->n_sen != bin_mdef_n_sen(acmod->mdef)) {
+        E_ERROR("Number of senones in senone file (%d) does not "
+                "match mdef (%d)\n", acmod->insenfile->n_sen,
+                bin_mdef_n_sen(acmod->mdef));
+        return -1;
+    }
+    if (fabs(acmod->insenfile->logbase - logmath_get_base(acmod->lmath)) > 0.001) {
+        E_ERROR("Logbase in senone file (%f) does not match acmod "
+                "(%f)\n", acmod->insenfile->logbase,
+                logmath_get_base(acmod->lmath));
+        return -1;
+    }
+    acmod->insen_frame = 0;
+    return 0;
 }
 
 int
@@ -890,6 +1032,7 @@ acmod_rewind(acmod_t *acmod)
     acmod->feat_outidx = 0;
     acmod->output_frame = 0;
     acmod->senscr_frame = -1;
+    acmod_score_batch_reset(acmod);
     acmod->mgau->frame_idx = 0;
 
     return 0;
@@ -909,8 +1052,9 @@ acmod_advance(acmod_t *acmod)
 
 int
 acmod_write_scores(acmod_t *acmod, int n_active, uint8 const *active,
-                   int16 const *senscr, FILE *senfh)
+                   int16 const *senscr, ps_logfile_t *senlog)
 {
+    uint8 *ptr = acmod->senlog_buf;
     int16 n_active2;
 
     /* Uncompressed frame format:
@@ -923,28 +1067,42 @@ acmod_write_scores(acmod_t *acmod, int n_active, uint8 const *active,
      * (2 bytes) n_active: Number of active senones
      * (n_active bytes) deltas to active senones
      * (n_active * 2 bytes) scores of active senones
+     *
+     * The frame is put together in senlog_buf and queued all at once.
      */
     n_active2 = n_active;
-    if (fwrite(&n_active2, 2, 1, senfh) != 1)
-        goto error_out;
+    memcpy(ptr, &n_active2, 2);
+    ptr += 2;
     if (n_active == bin_mdef_n_sen(acmod->mdef)) {
-        if (fwrite(senscr, 2, n_active, senfh) != n_active)
-            goto error_out;
+        memcpy(ptr, senscr, n_active * 2);
+        ptr += n_active * 2;
     }
     else {
         int i, n;
-        if (fwrite(active, 1, n_active, senfh) != n_active)
-            goto error_out;
+        memcpy(ptr, active, n_active);
+        ptr += n_active;
         for (i = n = 0; i < n_active; ++i) {
             n += active[i];
-            if (fwrite(senscr + n, 2, 1, senfh) != 1)
-                goto error_out;
+            memcpy(ptr, senscr + n, 2);
+            ptr += 2;
         }
     }
-    return 0;
-error_out:
-    E_ERROR_SYSTEM("Failed to write frame to senone file");
-    return -1;
+    return ps_logfile_write(senlog, acmod->senlog_buf,
+                            ptr - acmod->senlog_buf);
+}
+
+/**
+ * Get a frame from an indexed senone score file.
+ */
+static int
+acmod_read_senfile_frame(acmod_t *acmod, int32 frame)
+{
+    if (frame >= senfile_n_frame(acmod->insenfile))
+        return 0;
+    if (senfile_frame(acmod->insenfile, frame, acmod->senone_scores,
+                      acmod->senone_active, &acmod->n_senone_active) < 0)
+        return -1;
+    return 1;
 }
 
 /**
@@ -966,6 +1124,12 @@ acmod_read_scores_internal(acmod_t *acmod)
 
     if (senfh == NULL)
         return -1;
+    if (acmod->insenfile) {
+        int frv;
+        if ((frv = acmod_read_senfile_frame(acmod, acmod->insen_frame)) == 1)
+            ++acmod->insen_frame;
+        return frv;
+    }
     
     if ((rv = fread(&n_active, 2, 1, senfh)) != 1)
         goto error_out;
@@ -1040,7 +1204,10 @@ acmod_read_scores(acmod_t *acmod)
      * position for the relevant frame in the (possibly circular)
      * buffer. */
     ++acmod->n_feat_frame;
-    acmod->framepos[inptr] = ftell(acmod->insenfh);
+    if (acmod->insenfile)
+        acmod->framepos[inptr] = acmod->insen_frame - 1;
+    else
+        acmod->framepos[inptr] = ftell(acmod->insenfh);
 
     return 1;
 }
@@ -1102,6 +1269,153 @@ acmod_get_frame(acmod_t *acmod, int *inout_frame_idx)
     return acmod->feat_buf[feat_idx];
 }
 
+/* Score the pending frames (on the scoring thread, if there is one). */
+static void
+acmod_score_batch_work(void *arg, int idx, int n_threads)
+{
+    acmod_t *acmod = (acmod_t *)arg;
+
+    acmod->batch_rv = ps_mgau_frame_eval_batch(acmod->mgau,
+                                               acmod->senscr_eval,
+                                               acmod->feat_batch,
+                                               acmod->batch_start
+                                               + acmod->n_batch_frame,
+                                               acmod->n_batch_pending);
+}
+
+/* Start scoring n_frames frames following the ones already scored. */
+static void
+acmod_score_batch_start(acmod_t *acmod, int n_frames)
+{
+    int i, frame_idx;
+
+    /* Drop the oldest frames to make room for them. */
+    if (acmod->n_batch_frame + n_frames > acmod->n_batch_ring) {
+        int n_drop = acmod->n_batch_frame + n_frames - acmod->n_batch_ring;
+        acmod->batch_start += n_drop;
+        acmod->n_batch_frame -= n_drop;
+    }
+    frame_idx = acmod->batch_start + acmod->n_batch_frame;
+    for (i = 0; i < n_frames; ++i) {
+        acmod->feat_batch[i] =
+            acmod->feat_buf[calc_feat_idx(acmod, frame_idx + i)];
+        acmod->senscr_eval[i] =
+            acmod->senscr_batch[(frame_idx + i) % acmod->n_batch_ring];
+    }
+    acmod->n_batch_pending = n_frames;
+    ps_workpool_start(acmod->score_pool, acmod_score_batch_work, acmod);
+}
+
+/* Wait for the pending frames to be scored. */
+static int
+acmod_score_batch_wait(acmod_t *acmod)
+{
+    if (acmod->n_batch_pending == 0)
+        return 0;
+    ps_workpool_wait(acmod->score_pool);
+    if (acmod->batch_rv < 0) {
+        acmod->n_batch_pending = 0;
+        return -1;
+    }
+    acmod->n_batch_frame += acmod->n_batch_pending;
+    acmod->n_batch_pending = 0;
+    return 0;
+}
+
+/* Forget all batched scores. */
+static void
+acmod_score_batch_reset(acmod_t *acmod)
+{
+    acmod_score_batch_wait(acmod);
+    acmod->batch_start = 0;
+    acmod->n_batch_frame = 0;
+}
+
+/**
+ * Get scores for a frame from the batched scores, scoring a new batch
+ * of upcoming frames if necessary.  With a scoring thread, the batch
+ * after that is then started in the background.
+ *
+ * @return 0 if scores were found, <0 if batched scoring is not
+ *         possible for this frame.
+ */
+static int
+acmod_score_batch(acmod_t *acmod, int frame_idx)
+{
+    int n_frames, end;
+
+    /* Batching only works if we know which senones to score in
+     * future frames, i.e. all of them. */
+    if (acmod->senscr_batch == NULL)
+        return -1;
+    if (!acmod->compallsen) {
+        /* The model will be needed for the active senones. */
+        acmod_score_batch_wait(acmod);
+        return -1;
+    }
+    if (frame_idx < acmod->batch_start) {
+        /* Too old, score it by itself. */
+        acmod_score_batch_wait(acmod);
+        return -1;
+    }
+    end = acmod->batch_start + acmod->n_batch_frame;
+    if (frame_idx >= end) {
+        /* It may be among the ones being scored. */
+        if (acmod_score_batch_wait(acmod) < 0)
+            return -1;
+        end = acmod->batch_start + acmod->n_batch_frame;
+    }
+    if (frame_idx >= end) {
+        /* Only score frames that have already been computed. */
+        if (frame_idx < acmod->output_frame)
+            return -1;
+        n_frames = acmod->output_frame + acmod->n_feat_frame - frame_idx;
+        if (n_frames <= 0)
+            return -1;
+        if (n_frames > acmod->n_batch_alloc)
+            n_frames = acmod->n_batch_alloc;
+        if (frame_idx > end) {
+            /* Not contiguous with the ones we have. */
+            acmod->batch_start = frame_idx;
+            acmod->n_batch_frame = 0;
+        }
+        acmod_score_batch_start(acmod, n_frames);
+        if (acmod_score_batch_wait(acmod) < 0)
+            return -1;
+    }
+    memcpy(acmod->senone_scores,
+           acmod->senscr_batch[frame_idx % acmod->n_batch_ring],
+           bin_mdef_n_sen(acmod->mdef) * sizeof(*acmod->senone_scores));
+    acmod->n_senone_active = bin_mdef_n_sen(acmod->mdef);
+
+    /* Score the next batch while this frame is being searched,
+     * keeping enough of the ring free for the frames behind it. */
+    if (acmod->score_pool && acmod->n_batch_pending == 0) {
+        end = acmod->batch_start + acmod->n_batch_frame;
+        n_frames = acmod->output_frame + acmod->n_feat_frame - end;
+        if (n_frames > acmod->n_batch_alloc)
+            n_frames = acmod->n_batch_alloc;
+        if (n_frames > acmod->output_frame + 2 * acmod->n_batch_alloc - end)
+            n_frames = acmod->output_frame + 2 * acmod->n_batch_alloc - end;
+        if (n_frames > 0)
+            acmod_score_batch_start(acmod, n_frames);
+    }
+    return 0;
+}
+
+/* Count active senones without building the delta list. */
+static int32
+acmod_count_active(acmod_t *acmod)
+{
+    int32 w, n, total_words;
+
+    total_words = bitvec_size(bin_mdef_n_sen(acmod->mdef));
+    for (w = n = 0; w < total_words; ++w)
+        n += acmod_bitvec_popcount(acmod->senone_active_vec[w]);
+    acmod->n_senone_active = n;
+    return n;
+}
+
 int16 const *
 acmod_score(acmod_t *acmod, int *inout_frame_idx)
 {
@@ -1112,7 +1426,7 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
 
     /* If all senones are being computed, or we are using a senone file,
        then we can reuse existing scores. */
-    if ((acmod->compallsen || acmod->insenfh)
+    if ((acmod->compallsen || acmod->insenfh || acmod->hold_active)
         && frame_idx == acmod->senscr_frame) {
         if (inout_frame_idx)
             *inout_frame_idx = frame_idx;
@@ -1127,11 +1441,28 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
      * If there is an input senone file locate the appropriate frame and read
      * it.
      */
-    if (acmod->insenfh) {
+    if (acmod->insenfile) {
+        if (acmod_read_senfile_frame(acmod, acmod->framepos[feat_idx]) < 0)
+            return NULL;
+    }
+    else if (acmod->insenfh) {
         fseek(acmod->insenfh, acmod->framepos[feat_idx], SEEK_SET);
         if (acmod_read_scores_internal(acmod) < 0)
             return NULL;
     }
+    else if (acmod_score_batch(acmod, frame_idx) == 0) {
+        /* Scores were already computed in a batch. */
+    }
+    else if (!acmod->compallsen && acmod->senlog == NULL
+             && acmod->mgau->vt->frame_eval_active) {
+        /* Score straight from the active senone bitvector. */
+        acmod_count_active(acmod);
+        ps_mgau_frame_eval_active(acmod->mgau,
+                                  acmod->senone_scores,
+                                  acmod->senone_active_vec,
+                                  acmod->feat_buf[feat_idx],
+                                  frame_idx);
+    }
     else {
         /* Build active senone list. */
         acmod_flags2list(acmod);
@@ -1151,11 +1482,19 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
     acmod->senscr_frame = frame_idx;
 
     /* Dump scores to the senone dump file if one exists. */
-    if (acmod->senfh) {
+    if (acmod->senwriter) {
+        if (senfile_write_frame(acmod->senwriter, acmod->n_senone_active,
+                                acmod->senone_active,
+                                acmod->senone_scores) < 0)
+            return NULL;
+        E_DEBUG("Frame %d has %d active states\n", frame_idx,
+                acmod->n_senone_active);
+    }
+    else if (acmod->senlog) {
         if (acmod_write_scores(acmod, acmod->n_senone_active,
                                acmod->senone_active,
                                acmod->senone_scores,
-                               acmod->senfh) < 0)
+                               acmod->senlog) < 0)
             return NULL;
         E_DEBUG("Frame %d has %d active states\n", frame_idx,
                 acmod->n_senone_active);
@@ -1178,7 +1517,7 @@ acmod_best_score(acmod_t *acmod, int *out_best_senid)
             }
         }
     }
-    else {
+    else if (acmod->insenfh) {
         int16 *senscr;
         senscr = acmod->senone_scores;
         for (i = 0; i < acmod->n_senone_active; ++i) {
@@ -1189,6 +1528,24 @@ acmod_best_score(acmod_t *acmod, int *out_best_senid)
             }
         }
     }
+    else {
+        /* The delta list may not have been built, so use the
+         * bitvector. */
+        int w, n_words;
+
+        n_words = bitvec_size(bin_mdef_n_sen(acmod->mdef));
+        for (w = 0; w < n_words; ++w) {
+            bitvec_t bits = acmod->senone_active_vec[w];
+            while (bits) {
+                int sen = w * BITVEC_BITS + acmod_bitvec_ctz(bits);
+                bits &= bits - 1;
+                if (acmod->senone_scores[sen] < best) {
+                    best = acmod->senone_scores[sen];
+                    *out_best_senid = sen;
+                }
+            }
+        }
+    }
     return best;
 }
 
@@ -1196,12 +1553,18 @@ acmod_best_score(acmod_t *acmod, int *out_best_senid)
 void
 acmod_clear_active(acmod_t *acmod)
 {
-    if (acmod->compallsen)
+    if (acmod->compallsen || acmod->hold_active)
         return;
     bitvec_clear_all(acmod->senone_active_vec, bin_mdef_n_sen(acmod->mdef));
     acmod->n_senone_active = 0;
 }
 
+void
+acmod_hold_active(acmod_t *acmod, int hold)
+{
+    acmod->hold_active = hold;
+}
+
 #define MPX_BITVEC_SET(a,h,i)                                   \
     if (hmm_mpx_ssid(h,i) != BAD_SSID)                          \
         bitvec_set((a)->senone_active_vec, hmm_mpx_senid(h,i))
@@ -1250,10 +1613,24 @@ acmod_activate_hmm(acmod_t *acmod, hmm_t *hmm)
     }
 }
 
+void
+acmod_activate_hmm_compact(acmod_t *acmod, hmm_context_t *ctx,
+                           hmm_compact_t *hmm)
+{
+    uint16 const *senid;
+    int i;
+
+    if (acmod->compallsen)
+        return;
+    senid = ctx->sseq[hmm_compact_ssid(hmm)];
+    for (i = 0; i < ctx->n_emit_state; ++i)
+        bitvec_set(acmod->senone_active_vec, senid[i]);
+}
+
 int32
 acmod_flags2list(acmod_t *acmod)
 {
-    int32 w, l, n, b, total_dists, total_words, extra_bits;
+    int32 w, l, n, total_dists, total_words;
     bitvec_t *flagptr;
 
     total_dists = bin_mdef_n_sen(acmod->mdef);
@@ -1261,32 +1638,18 @@ acmod_flags2list(acmod_t *acmod)
         acmod->n_senone_active = total_dists;
         return total_dists;
     }
-    total_words = total_dists / BITVEC_BITS;
-    extra_bits = total_dists % BITVEC_BITS;
-    w = n = l = 0;
-    for (flagptr = acmod->senone_active_vec; w < total_words; ++w, ++flagptr) {
-        if (*flagptr == 0)
-            continue;
-        for (b = 0; b < BITVEC_BITS; ++b) {
-            if (*flagptr & (1UL << b)) {
-                int32 sen = w * BITVEC_BITS + b;
-                int32 delta = sen - l;
-                /* Handle excessive deltas "lossily" by adding a few
-                   extra senones to bridge the gap. */
-                while (delta > 255) {
-                    acmod->senone_active[n++] = 255;
-                    delta -= 255;
-                }
-                acmod->senone_active[n++] = delta;
-                l = sen;
-            }
-        }
-    }
-
-    for (b = 0; b < extra_bits; ++b) {
-        if (*flagptr & (1UL << b)) {
-            int32 sen = w * BITVEC_BITS + b;
+    /* Bits past the last senone are never set, so the last partial
+     * word can be treated like the others. */
+    total_words = bitvec_size(total_dists);
+    n = l = 0;
+    for (w = 0, flagptr = acmod->senone_active_vec;
+         w < total_words; ++w, ++flagptr) {
+        bitvec_t bits = *flagptr;
+        /* Visit only the set bits, lowest first. */
+        while (bits) {
+            int32 sen = w * BITVEC_BITS + acmod_bitvec_ctz(bits);
             int32 delta = sen - l;
+            bits &= bits - 1;
             /* Handle excessive deltas "lossily" by adding a few
                extra senones to bridge the gap. */
             while (delta > 255) {
@@ -1322,20 +1685,18 @@ acmod_set_rawdata_size(acmod_t *acmod, int32 size)
 {	
     assert(size >= 0);
     acmod->rawdata_size = size;
-    if (acmod->rawdata_size > 0) {
-	ckd_free(acmod->rawdata);
-	acmod->rawdata = ckd_calloc(size, sizeof(int16));
-    }
+    if (size > ps_rawring_size(acmod->rawring))
+        ps_rawring_resize(acmod->rawring, size);
 }
 
 void
 acmod_get_rawdata(acmod_t *acmod, int16 **buffer, int32 *size)
 {
-    if (buffer) {
-	*buffer = acmod->rawdata;
-    }
+    int32 n;
+
+    n = ps_rawring_get(acmod->rawring, acmod->rawdata_size, buffer);
     if (size) {
-	*size = acmod->rawdata_pos;
+	*size = n;
     }
 }
 
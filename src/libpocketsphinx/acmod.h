@@ -60,6 +60,10 @@
 #include "bin_mdef.h"
 #include "tmat.h"
 #include "hmm.h"
+#include "ps_workpool.h"
+#include "senfile.h"
+#include "ps_rawring.h"
+#include "ps_logwriter.h"
 
 /**
  * States in utterance processing.
@@ -105,6 +109,18 @@ typedef struct ps_mgaufuncs_s {
                       mfcc_t ** feat,
                       int32 frame,
                       int32 compallsen);
+    /** Score all senones for n_frames consecutive frames (or NULL). */
+    int (*frame_eval_batch)(ps_mgau_t *mgau,
+                            int16 **senscr,
+                            mfcc_t ***feat,
+                            int32 frame,
+                            int32 n_frames);
+    /** Score the senones set in a bitvector (or NULL). */
+    int (*frame_eval_active)(ps_mgau_t *mgau,
+                             int16 *senscr,
+                             bitvec_t const *senone_active_vec,
+                             mfcc_t **feat,
+                             int32 frame);
     int (*transform)(ps_mgau_t *mgau,
                      ps_mllr_t *mllr);
     void (*free)(ps_mgau_t *mgau);
@@ -119,6 +135,12 @@ struct ps_mgau_s {
 #define ps_mgau_frame_eval(mg,senscr,senone_active,n_senone_active,feat,frame,compallsen) \
     (*ps_mgau_base(mg)->vt->frame_eval)                                 \
     (mg, senscr, senone_active, n_senone_active, feat, frame, compallsen)
+#define ps_mgau_frame_eval_batch(mg,senscr,feat,frame,n_frames)        \
+    (*ps_mgau_base(mg)->vt->frame_eval_batch)                           \
+    (mg, senscr, feat, frame, n_frames)
+#define ps_mgau_frame_eval_active(mg,senscr,senone_active_vec,feat,frame) \
+    (*ps_mgau_base(mg)->vt->frame_eval_active)                          \
+    (mg, senscr, senone_active_vec, feat, frame)
 #define ps_mgau_transform(mg, mllr)                                  \
     (*ps_mgau_base(mg)->vt->transform)(mg, mllr)
 #define ps_mgau_free(mg)                                  \
@@ -169,25 +191,48 @@ struct acmod_s {
     int n_senone_active;       /**< Number of active GMMs. */
     int log_zero;              /**< Zero log-probability value. */
 
+    /* Batched senone scoring (all senones, several frames at once): */
+    int16 **senscr_batch;      /**< Senone scores for recent frames, by
+                                    frame index modulo n_batch_ring. */
+    int16 **senscr_eval;       /**< Score buffers for the frames being scored. */
+    mfcc_t ***feat_batch;      /**< Features for the frames being scored. */
+    int n_batch_alloc;         /**< Maximum number of frames in batch. */
+    int n_batch_ring;          /**< Number of frames in senscr_batch. */
+    int batch_start;           /**< First frame with scores in senscr_batch. */
+    int n_batch_frame;         /**< Number of frames with scores in senscr_batch. */
+    int n_batch_pending;       /**< Number of frames being scored after those. */
+    int batch_rv;              /**< Result of scoring them. */
+    ps_workpool_t *score_pool; /**< Thread scoring frames ahead of the
+                                    search (-pipeline), or NULL. */
+
     /* Utterance processing: */
     mfcc_t **mfc_buf;   /**< Temporary buffer of acoustic features. */
     mfcc_t ***feat_buf; /**< Temporary buffer of dynamic features. */
-    FILE *rawfh;        /**< File for writing raw audio data. */
-    FILE *mfcfh;        /**< File for writing acoustic feature data. */
-    FILE *senfh;        /**< File for writing senone score data. */
+    ps_logwriter_t *logwriter; /**< Thread writing the log files below. */
+    ps_logfile_t *rawlog; /**< File for writing raw audio data. */
+    ps_logfile_t *mfclog; /**< File for writing acoustic feature data. */
+    ps_logfile_t *senlog; /**< File for writing senone score data. */
+    uint8 *senlog_buf;  /**< Buffer for encoding a frame for senlog. */
     FILE *insenfh;	/**< Input senone score file. */
-    long *framepos;     /**< File positions of recent frames in senone file. */
+    long *framepos;     /**< File positions (or, with insenfile, frame
+                             numbers) of recent frames in senone file. */
+    senfile_writer_t *senwriter; /**< Writer for senlog if it is in
+                                      the indexed format. */
+    senfile_t *insenfile; /**< Input senone score file if it is in the
+                               indexed format. */
+    int32 insen_frame;  /**< Next frame to read from insenfile. */
 
     /* Rawdata collected during decoding */
-    int16 *rawdata;
-    int32 rawdata_size;
-    int32 rawdata_pos;
+    ps_rawring_t *rawring; /**< Recent audio. */
+    int32 rawdata_size;    /**< Number of samples kept for
+                                acmod_get_rawdata(). */
 
     /* A whole bunch of flags and counters: */
     uint8 state;        /**< State of utterance processing. */
     uint8 compallsen;   /**< Compute all senones? */
     uint8 grow_feat;    /**< Whether to grow feat_buf. */
     uint8 insen_swap;   /**< Whether to swap input senone score. */
+    uint8 hold_active;  /**< Active senones are shared by several searches. */
 
     frame_idx_t utt_start_frame; /**< Index of the utterance start in the stream, all timings are relative to that. */
 
@@ -235,6 +280,8 @@ ps_mllr_t *acmod_update_mllr(acmod_t *acmod, ps_mllr_t *mllr);
 /**
  * Start logging senone scores to a filehandle.
  *
+ * The file is written in the format given by -senlogfmt.
+ *
  * @param acmod Acoustic model object.
  * @param logfh Filehandle to log to.
  * @return 0 for success, <0 on error.
@@ -332,6 +379,48 @@ int acmod_process_raw(acmod_t *acmod,
                       size_t *inout_n_samps,
                       int full_utt);
 
+/**
+ * Compute cepstra from raw audio data without passing them on.
+ *
+ * This runs only the front end, and touches nothing else in the
+ * acoustic model, so that it can run in one thread while
+ * acmod_process_cep() runs in another on the resulting cepstra.  The
+ * audio must then be given to acmod_keep_raw(), in whichever thread
+ * owns the rest of the acoustic model.
+ *
+ * @param inout_raw In: Pointer to buffer of raw samples
+ *                  Out: Pointer to next sample to be read
+ * @param inout_n_samps In: Number of samples available
+ *                      Out: Number of samples remaining
+ * @param cep Output buffer of cepstra.
+ * @param inout_n_frames In: Number of frames available in cep
+ *                       Out: Number of frames written to cep
+ * @param out_frameidx Output: index of the utterance start in the
+ *                     stream if it was found, or 0.
+ * @return 0, or <0 on error.
+ */
+int acmod_process_raw_cep(acmod_t *acmod,
+                          int16 const **inout_raw,
+                          size_t *inout_n_samps,
+                          mfcc_t **cep,
+                          int32 *inout_n_frames,
+                          int32 *out_frameidx);
+
+/**
+ * Keep raw audio used by acmod_process_raw_cep().
+ *
+ * This records the start of the utterance, and saves the audio in the
+ * raw data ring and log file, if any.
+ *
+ * @param raw Samples consumed by acmod_process_raw_cep().
+ * @param n_samps Number of samples.
+ * @param frameidx Frame index returned by acmod_process_raw_cep().
+ */
+void acmod_keep_raw(acmod_t *acmod,
+                    int16 const *raw,
+                    size_t n_samps,
+                    int32 frameidx);
+
 /**
  * Feed acoustic feature data into the acoustic model for scoring.
  *
@@ -372,6 +461,18 @@ int acmod_process_feat(acmod_t *acmod,
  */
 int acmod_set_insenfh(acmod_t *acmod, FILE *insenfh);
 
+/**
+ * Set up a senone score dump file for input, given its name.
+ *
+ * This is the same as acmod_set_insenfh(), except that files in the
+ * indexed format (see senfile.h) can be memory-mapped.
+ *
+ * @param insenfh File handle of dump file
+ * @param file Name of dump file
+ * @return 0 for success, <0 for failure
+ */
+int acmod_set_insenfile(acmod_t *acmod, FILE *insenfh, char const *file);
+
 /**
  * Read one frame of scores from senone score dump file.
  *
@@ -415,7 +516,7 @@ int acmod_write_senfh_header(acmod_t *acmod, FILE *logfh);
  * Write a frame of senone scores to a dump file.
  */
 int acmod_write_scores(acmod_t *acmod, int n_active, uint8 const *active,
-                       int16 const *senscr, FILE *senfh);
+                       int16 const *senscr, ps_logfile_t *senlog);
 
 
 /**
@@ -433,6 +534,22 @@ void acmod_clear_active(acmod_t *acmod);
  */
 void acmod_activate_hmm(acmod_t *acmod, hmm_t *hmm);
 
+/**
+ * Activate senones associated with a compact HMM.
+ */
+void acmod_activate_hmm_compact(acmod_t *acmod, hmm_context_t *ctx,
+                                hmm_compact_t *hmm);
+
+/**
+ * Hold or release the set of active senones.
+ *
+ * While it is held, acmod_clear_active() does nothing, so that
+ * several searches can add their HMMs to the active set for the same
+ * frame, and acmod_score() returns the scores already computed for
+ * that frame instead of computing them again.
+ */
+void acmod_hold_active(acmod_t *acmod, int hold);
+
 /**
  * Activate a single senone.
  */
@@ -443,6 +560,40 @@ void acmod_activate_hmm(acmod_t *acmod, hmm_t *hmm);
  */
 int32 acmod_flags2list(acmod_t *acmod);
 
+/**
+ * Index of the lowest set bit in a (non-zero) bitvector word.
+ */
+static inline int
+acmod_bitvec_ctz(bitvec_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(bits);
+#else
+    int b = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        ++b;
+    }
+    return b;
+#endif
+}
+
+/**
+ * Number of set bits in a bitvector word.
+ */
+static inline int
+acmod_bitvec_popcount(bitvec_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_popcount(bits);
+#else
+    int n = 0;
+    for (; bits; bits &= bits - 1)
+        ++n;
+    return n;
+#endif
+}
+
 /**
  * Get the offset of the utterance start of the current stream, helpful for stream-wide timing.
  */
@@ -455,11 +606,16 @@ void acmod_start_stream(acmod_t *acmod);
 
 /**
  * Sets the limit of the raw audio data to store
+ *
+ * The most recent size samples of the utterance are kept.
  */
 void acmod_set_rawdata_size(acmod_t *acmod, int32 size);
 
 /**
  * Retrieves the raw data collected during utterance decoding
+ *
+ * The buffer returned is valid until more audio is processed or a new
+ * utterance is started.
  */
 void acmod_get_rawdata(acmod_t *acmod, int16 **buffer, int32 *size);
 
@@ -123,6 +123,8 @@ allphone_search_seg_iter(ps_search_t * search)
     return (ps_seg_t *) iter;
 }
 
+static void allphone_search_sen_active(ps_search_t *search, int frame_idx);
+
 static ps_searchfuncs_t allphone_funcs = {
     /* start: */ allphone_search_start,
     /* step: */ allphone_search_step,
@@ -133,6 +135,7 @@ static ps_searchfuncs_t allphone_funcs = {
     /* hyp: */ allphone_search_hyp,
     /* prob: */ allphone_search_prob,
     /* seg_iter: */ allphone_search_seg_iter,
+    /* sen_active: */ allphone_search_sen_active,
 };
 
 /**
@@ -351,20 +354,16 @@ phmm_eval_all(allphone_search_t * allphs, const int16 * senscr)
     mdef = ((ps_search_t *) allphs)->acmod->mdef;
     ci_phmm = allphs->ci_phmm;
 
-    best = WORST_SCORE;
-
     hmm_context_set_senscore(allphs->hmmctx, senscr);
     for (ci = 0; ci < mdef->n_ciphone; ci++) {
         for (p = ci_phmm[(unsigned) ci]; p; p = p->next) {
             if (hmm_frame(&(p->hmm)) == allphs->frame) {
-                int32 score;
                 allphs->n_hmm_eval++;
-                score = hmm_vit_eval((hmm_t *) p);
-                if (score > best)
-                    best = score;
+                hmm_batch_add(allphs->hmmctx, (hmm_t *) p);
             }
         }
     }
+    best = hmm_vit_eval_batch(allphs->hmmctx);
 
     return best;
 }
@@ -701,8 +700,9 @@ allphone_search_start(ps_search_t * search)
 }
 
 static void
-allphone_search_sen_active(allphone_search_t * allphs)
+allphone_search_sen_active(ps_search_t *search, int frame_idx)
 {
+    allphone_search_t *allphs = (allphone_search_t *) search;
     acmod_t *acmod;
     bin_mdef_t *mdef;
     phmm_t *p;
@@ -727,7 +727,7 @@ allphone_search_step(ps_search_t * search, int frame_idx)
     acmod_t *acmod = search->acmod;
 
     if (!acmod->compallsen)
-        allphone_search_sen_active(allphs);
+        allphone_search_sen_active(search, frame_idx);
     senscr = acmod_score(acmod, &frame_idx);
     allphs->n_sen_eval += acmod->n_senone_active;
     bestscr = phmm_eval_all(allphs, senscr);
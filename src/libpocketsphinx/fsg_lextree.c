@@ -416,7 +416,7 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                 for (gn = lc_pnodelist; gn; gn = gnode_next(gn)) {
                     pnode = (fsg_pnode_t *) gnode_ptr(gn);
 
-                    if (hmm_nonmpx_ssid(&pnode->hmm) == ssid) {
+                    if (hmm_compact_ssid(&pnode->hmm) == ssid) {
                         /* already allocated; share it for this context phone */
                         fsg_pnode_add_ctxt(pnode, lc);
                         break;
@@ -426,7 +426,6 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                 if (!gn) {      /* ssid not already allocated */
                     pnode =
                         (fsg_pnode_t *) ckd_calloc(1, sizeof(fsg_pnode_t));
-                    pnode->ctx = lextree->ctx;
                     pnode->next.fsglink = fsglink;
                     pnode->logs2prob =
                         (fsg_link_logs2prob(fsglink) >> SENSCR_SHIFT)
@@ -441,7 +440,7 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                     root = pnode;
                     ++n_lc_alloc;
 
-                    hmm_init(lextree->ctx, &pnode->hmm, FALSE, ssid, tmatid);
+                    hmm_compact_init(lextree->ctx, &pnode->hmm, ssid, tmatid);
 
                     lc_pnodelist =
                         glist_add_ptr(lc_pnodelist, (void *) pnode);
@@ -455,7 +454,6 @@ psubtree_add_trans(fsg_lextree_t *lextree,
             tmatid = bin_mdef_pid2tmatid(lextree->mdef, ci);
 
             pnode = (fsg_pnode_t *) ckd_calloc(1, sizeof(fsg_pnode_t));
-            pnode->ctx = lextree->ctx;
             pnode->next.fsglink = fsglink;
             pnode->logs2prob = (fsg_link_logs2prob(fsglink) >> SENSCR_SHIFT)
                 + lextree->wip + lextree->pip;
@@ -469,7 +467,7 @@ psubtree_add_trans(fsg_lextree_t *lextree,
             root = pnode;
             ++n_int_alloc;
 
-            hmm_init(lextree->ctx, &pnode->hmm, FALSE, ssid, tmatid);
+            hmm_compact_init(lextree->ctx, &pnode->hmm, ssid, tmatid);
         }
     }
     else {                      /* Multi-phone word */
@@ -526,7 +524,7 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                     pnode = ssid_pnode_map[0];
                     for (j = 0; j < n_ci && ssid_pnode_map[j] != NULL; ++j) {
                         pnode = ssid_pnode_map[j];
-                        if (hmm_nonmpx_ssid(&pnode->hmm) == ssid)
+                        if (hmm_compact_ssid(&pnode->hmm) == ssid)
                             break;
                     }
                     assert(j < n_ci);
@@ -535,7 +533,6 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                             (fsg_pnode_t *) ckd_calloc(1,
                                                        sizeof
                                                        (fsg_pnode_t));
-                        pnode->ctx = lextree->ctx;
 	                /* This bit is tricky! For now we'll put the prob in the final link only */
                         /* pnode->logs2prob = (fsg_link_logs2prob(fsglink) >> SENSCR_SHIFT)
                            + lextree->wip + lextree->pip; */
@@ -549,7 +546,7 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                         root = pnode;
                         ++n_lc_alloc;
 
-                        hmm_init(lextree->ctx, &pnode->hmm, FALSE, ssid, tmatid);
+                        hmm_compact_init(lextree->ctx, &pnode->hmm, ssid, tmatid);
 
                         lc_pnodelist =
                             glist_add_ptr(lc_pnodelist, (void *) pnode);
@@ -571,10 +568,10 @@ psubtree_add_trans(fsg_lextree_t *lextree,
 	        /* First check if we already have this ssid in our tree */
 		pnode = pred->next.succ;
 		pnodeyoungest = pnode; /* The youngest sibling */
-		while (pnode && (hmm_nonmpx_ssid(&pnode->hmm) != ssid || pnode->leaf)) {
+		while (pnode && (hmm_compact_ssid(&pnode->hmm) != ssid || pnode->leaf)) {
 		    pnode = pnode->sibling;
 		}
-		if (pnode && (hmm_nonmpx_ssid(&pnode->hmm) == ssid && !pnode->leaf)) {
+		if (pnode && (hmm_compact_ssid(&pnode->hmm) == ssid && !pnode->leaf)) {
 		    /* Found the ssid; go to next phoneme */
                     E_DEBUG("Found match for %d\n", ci);
 		    pred = pnode;
@@ -583,7 +580,6 @@ psubtree_add_trans(fsg_lextree_t *lextree,
 
 		/* pnode not found, allocate it */
                 pnode = (fsg_pnode_t *) ckd_calloc(1, sizeof(fsg_pnode_t));
-                pnode->ctx = lextree->ctx;
                 pnode->logs2prob = lextree->pip;
                 pnode->ci_ext = dict_pron(lextree->dict, dictwid, p);
                 pnode->ppos = p;
@@ -602,7 +598,7 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                 head = pnode;
                 ++n_int_alloc;
 
-                hmm_init(lextree->ctx, &pnode->hmm, FALSE, ssid, tmatid);
+                hmm_compact_init(lextree->ctx, &pnode->hmm, ssid, tmatid);
 
                 pred = pnode;
             }
@@ -627,7 +623,6 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                             (fsg_pnode_t *) ckd_calloc(1,
                                                        sizeof
                                                        (fsg_pnode_t));
-                        pnode->ctx = lextree->ctx;
 			/* We are plugging the word prob here. Ugly */
                         /* pnode->logs2prob = lextree->pip; */
                         pnode->logs2prob = (fsg_link_logs2prob(fsglink) >> SENSCR_SHIFT)
@@ -642,14 +637,14 @@ psubtree_add_trans(fsg_lextree_t *lextree,
                         head = pnode;
                         ++n_rc_alloc;
 
-                        hmm_init(lextree->ctx, &pnode->hmm, FALSE, ssid, tmatid);
+                        hmm_compact_init(lextree->ctx, &pnode->hmm, ssid, tmatid);
 
                         rc_pnodelist =
                             glist_add_ptr(rc_pnodelist, (void *) pnode);
                         ssid_pnode_map[j] = pnode;
                     }
                     else {
-                        assert(hmm_nonmpx_ssid(&pnode->hmm) == ssid);
+                        assert(hmm_compact_ssid(&pnode->hmm) == ssid);
                     }
                     fsg_pnode_add_ctxt(pnode, rc);
                 }
@@ -751,7 +746,6 @@ fsg_psubtree_free(fsg_pnode_t * head)
 
     while (head) {
         next = head->alloc_next;
-        hmm_deinit(&head->hmm);
         ckd_free(head);
         head = next;
     }
@@ -768,7 +762,7 @@ void fsg_psubtree_dump_node(fsg_lextree_t *tree, fsg_pnode_t *node, FILE *fp)
 
     fprintf(fp, "%p.@", node);    /* Pointer used as node
                     		   * ID */
-    fprintf(fp, " %5d.SS", hmm_nonmpx_ssid(&node->hmm));
+    fprintf(fp, " %5d.SS", hmm_compact_ssid(&node->hmm));
     fprintf(fp, " %10d.LP", node->logs2prob);
     fprintf(fp, " %p.SIB", node->sibling);
     fprintf(fp, " %s.%d", bin_mdef_ciphone_str(tree->mdef, node->ci_ext), node->ppos);
@@ -831,5 +825,5 @@ fsg_psubtree_dump(fsg_lextree_t *tree, fsg_pnode_t *root, FILE * fp)
 void
 fsg_psubtree_pnode_deactivate(fsg_pnode_t * pnode)
 {
-    hmm_clear(&pnode->hmm);
+    hmm_compact_clear(&pnode->hmm);
 }
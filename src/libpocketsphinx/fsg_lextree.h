@@ -129,9 +129,8 @@ typedef struct fsg_pnode_s {
     uint8 ppos;	/* Phoneme position in pronunciation */
     uint8 leaf;	/* Whether this is a leaf node */
   
-    /* HMM-state-level stuff here */
-    hmm_context_t *ctx;
-    hmm_t hmm;
+    /* HMM-state-level stuff here (the context is in the lextree) */
+    hmm_compact_t hmm;
 } fsg_pnode_t;
 
 /* Access macros */
@@ -65,6 +65,7 @@
 #include "fsg_search_internal.h"
 #include "fsg_history.h"
 #include "fsg_lextree.h"
+#include "ps_histprune.h"
 
 /* Turn this on for detailed debugging dump */
 #define __FSG_DBG__		0
@@ -73,6 +74,7 @@
 static ps_seg_t *fsg_search_seg_iter(ps_search_t *search);
 static ps_lattice_t *fsg_search_lattice(ps_search_t *search);
 static int fsg_search_prob(ps_search_t *search);
+static void fsg_search_sen_active(ps_search_t *search, int frame_idx);
 
 static ps_searchfuncs_t fsg_funcs = {
     /* start: */  fsg_search_start,
@@ -84,6 +86,7 @@ static ps_searchfuncs_t fsg_funcs = {
     /* hyp: */      fsg_search_hyp,
     /* prob: */     fsg_search_prob,
     /* seg_iter: */ fsg_search_seg_iter,
+    /* sen_active: */ fsg_search_sen_active,
 };
 
 static int
@@ -307,19 +310,21 @@ fsg_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2p)
 
 
 static void
-fsg_search_sen_active(fsg_search_t *fsgs)
+fsg_search_sen_active(ps_search_t *search, int frame_idx)
 {
+    fsg_search_t *fsgs = (fsg_search_t *)search;
     gnode_t *gn;
     fsg_pnode_t *pnode;
-    hmm_t *hmm;
+    hmm_compact_t *hmm;
 
     acmod_clear_active(ps_search_acmod(fsgs));
 
     for (gn = fsgs->pnode_active; gn; gn = gnode_next(gn)) {
         pnode = (fsg_pnode_t *) gnode_ptr(gn);
         hmm = fsg_pnode_hmmptr(pnode);
-        assert(hmm_frame(hmm) == fsgs->frame);
-        acmod_activate_hmm(ps_search_acmod(fsgs), hmm);
+        assert(hmm_compact_frame(hmm) == fsgs->frame);
+        acmod_activate_hmm_compact(ps_search_acmod(fsgs),
+                                   fsgs->hmmctx, hmm);
     }
 }
 
@@ -333,39 +338,36 @@ fsg_search_hmm_eval(fsg_search_t *fsgs)
 {
     gnode_t *gn;
     fsg_pnode_t *pnode;
-    hmm_t *hmm;
+    hmm_compact_t *hmm;
     int32 bestscore;
     int32 n, maxhmmpf;
 
-    bestscore = WORST_SCORE;
-
     if (!fsgs->pnode_active) {
         E_ERROR("Frame %d: No active HMM!!\n", fsgs->frame);
         return;
     }
 
     for (n = 0, gn = fsgs->pnode_active; gn; gn = gnode_next(gn), n++) {
-        int32 score;
-
         pnode = (fsg_pnode_t *) gnode_ptr(gn);
         hmm = fsg_pnode_hmmptr(pnode);
-        assert(hmm_frame(hmm) == fsgs->frame);
+        assert(hmm_compact_frame(hmm) == fsgs->frame);
 
 #if __FSG_DBG__
         E_INFO("pnode(%08x) active @frm %5d\n", (int32) pnode,
                fsgs->frame);
-        hmm_dump(hmm, stdout);
+        hmm_compact_dump(fsgs->hmmctx, hmm, stdout);
 #endif
-        score = hmm_vit_eval(hmm);
+        hmm_batch_add(fsgs->hmmctx, hmm);
+    }
+    bestscore = hmm_compact_vit_eval_batch(fsgs->hmmctx);
 #if __FSG_DBG_CHAN__
+    for (gn = fsgs->pnode_active; gn; gn = gnode_next(gn)) {
+        pnode = (fsg_pnode_t *) gnode_ptr(gn);
         E_INFO("pnode(%08x) after eval @frm %5d\n",
                (int32) pnode, fsgs->frame);
-        hmm_dump(hmm, stdout);
-#endif
-
-        if (score BETTER_THAN bestscore)
-            bestscore = score;
+        hmm_compact_dump(fsgs->hmmctx, fsg_pnode_hmmptr(pnode), stdout);
     }
+#endif
 
 #if __FSG_DBG__
     E_INFO("[%5d] %6d HMM; bestscr: %11d\n", fsgs->frame, n, bestscore);
@@ -375,19 +377,24 @@ fsg_search_hmm_eval(fsg_search_t *fsgs)
     /* Adjust beams if #active HMMs larger than absolute threshold */
     maxhmmpf = cmd_ln_int32_r(ps_search_config(fsgs), "-maxhmmpf");
     if (maxhmmpf != -1 && n > maxhmmpf) {
+        ps_histprune_t hist;
+
         /*
-         * Too many HMMs active; reduce the beam factor applied to the default
-         * beams, but not if the factor is already at a floor (0.1).
+         * Too many HMMs active; narrow the beam to the one which
+         * keeps maxhmmpf of them, and the other beams along with it.
          */
-        if (fsgs->beam_factor > 0.1) {        /* Hack!!  Hardwired constant 0.1 */
-            fsgs->beam_factor *= 0.9f;        /* Hack!!  Hardwired constant 0.9 */
-            fsgs->beam =
-                (int32) (fsgs->beam_orig * fsgs->beam_factor);
-            fsgs->pbeam =
-                (int32) (fsgs->pbeam_orig * fsgs->beam_factor);
-            fsgs->wbeam =
-                (int32) (fsgs->wbeam_orig * fsgs->beam_factor);
+        ps_histprune_reset(&hist, bestscore, fsgs->beam_orig);
+        for (gn = fsgs->pnode_active; gn; gn = gnode_next(gn)) {
+            hmm = fsg_pnode_hmmptr((fsg_pnode_t *) gnode_ptr(gn));
+            ps_histprune_add(&hist, hmm_compact_bestscore(fsgs->hmmctx, hmm));
         }
+        fsgs->beam = ps_histprune_beam(&hist, maxhmmpf, fsgs->beam_orig);
+        fsgs->beam_factor = fsgs->beam_orig
+            ? (float32) fsgs->beam / fsgs->beam_orig : 1.0f;
+        fsgs->pbeam =
+            (int32) (fsgs->pbeam_orig * fsgs->beam_factor);
+        fsgs->wbeam =
+            (int32) (fsgs->wbeam_orig * fsgs->beam_factor);
     }
     else {
         fsgs->beam_factor = 1.0f;
@@ -408,7 +415,7 @@ static void
 fsg_search_pnode_trans(fsg_search_t *fsgs, fsg_pnode_t * pnode)
 {
     fsg_pnode_t *child;
-    hmm_t *hmm;
+    hmm_compact_t *hmm;
     int32 newscore, thresh, nf;
 
     assert(pnode);
@@ -421,19 +428,19 @@ fsg_search_pnode_trans(fsg_search_t *fsgs, fsg_pnode_t * pnode)
 
     for (child = fsg_pnode_succ(pnode);
          child; child = fsg_pnode_sibling(child)) {
-        newscore = hmm_out_score(hmm) + child->logs2prob;
+        newscore = hmm_compact_out_score(fsgs->hmmctx, hmm) + child->logs2prob;
 
         if ((newscore BETTER_THAN thresh)
-            && (newscore BETTER_THAN hmm_in_score(&child->hmm))) {
+            && (newscore BETTER_THAN hmm_compact_in_score(fsgs->hmmctx, &child->hmm))) {
             /* Incoming score > pruning threshold and > target's existing score */
-            if (hmm_frame(&child->hmm) < nf) {
+            if (hmm_compact_frame(&child->hmm) < nf) {
                 /* Child node not yet activated; do so */
                 fsgs->pnode_active_next =
                     glist_add_ptr(fsgs->pnode_active_next,
                                   (void *) child);
             }
 
-            hmm_enter(&child->hmm, newscore, hmm_out_history(hmm), nf);
+            hmm_compact_enter(fsgs->hmmctx, &child->hmm, newscore, hmm_compact_out_history(hmm), nf);
         }
     }
 }
@@ -442,7 +449,7 @@ fsg_search_pnode_trans(fsg_search_t *fsgs, fsg_pnode_t * pnode)
 static void
 fsg_search_pnode_exit(fsg_search_t *fsgs, fsg_pnode_t * pnode)
 {
-    hmm_t *hmm;
+    hmm_compact_t *hmm;
     fsg_link_t *fl;
     int32 wid;
     fsg_pnode_ctxt_t ctxt;
@@ -460,7 +467,7 @@ fsg_search_pnode_exit(fsg_search_t *fsgs, fsg_pnode_t * pnode)
 #if __FSG_DBG__
     E_INFO("[%5d] Exit(%08x) %10d(score) %5d(pred)\n",
            fsgs->frame, (int32) pnode,
-           hmm_out_score(hmm), hmm_out_history(hmm));
+           hmm_compact_out_score(fsgs->hmmctx, hmm), hmm_compact_out_history(hmm));
 #endif
 
     /*
@@ -479,8 +486,8 @@ fsg_search_pnode_exit(fsg_search_t *fsgs, fsg_pnode_t * pnode)
         fsg_history_entry_add(fsgs->history,
                               fl,
                               fsgs->frame,
-                              hmm_out_score(hmm),
-                              hmm_out_history(hmm),
+                              hmm_compact_out_score(fsgs->hmmctx, hmm),
+                              hmm_compact_out_history(hmm),
                               pnode->ci_ext, ctxt);
 
     }
@@ -489,8 +496,8 @@ fsg_search_pnode_exit(fsg_search_t *fsgs, fsg_pnode_t * pnode)
         fsg_history_entry_add(fsgs->history,
                               fl,
                               fsgs->frame,
-                              hmm_out_score(hmm),
-                              hmm_out_history(hmm),
+                              hmm_compact_out_score(fsgs->hmmctx, hmm),
+                              hmm_compact_out_history(hmm),
                               pnode->ci_ext, pnode->ctxt);
     }
 }
@@ -507,7 +514,7 @@ fsg_search_hmm_prune_prop(fsg_search_t *fsgs)
 {
     gnode_t *gn;
     fsg_pnode_t *pnode;
-    hmm_t *hmm;
+    hmm_compact_t *hmm;
     int32 thresh, word_thresh, phone_thresh;
 
     assert(fsgs->pnode_active_next == NULL);
@@ -520,26 +527,26 @@ fsg_search_hmm_prune_prop(fsg_search_t *fsgs)
         pnode = (fsg_pnode_t *) gnode_ptr(gn);
         hmm = fsg_pnode_hmmptr(pnode);
 
-        if (hmm_bestscore(hmm) >= thresh) {
+        if (hmm_compact_bestscore(fsgs->hmmctx, hmm) >= thresh) {
             /* Keep this HMM active in the next frame */
-            if (hmm_frame(hmm) == fsgs->frame) {
-                hmm_frame(hmm) = fsgs->frame + 1;
+            if (hmm_compact_frame(hmm) == fsgs->frame) {
+                hmm_compact_frame(hmm) = fsgs->frame + 1;
                 fsgs->pnode_active_next =
                     glist_add_ptr(fsgs->pnode_active_next,
                                   (void *) pnode);
             }
             else {
-                assert(hmm_frame(hmm) == fsgs->frame + 1);
+                assert(hmm_compact_frame(hmm) == fsgs->frame + 1);
             }
 
             if (!fsg_pnode_leaf(pnode)) {
-                if (hmm_out_score(hmm) >= phone_thresh) {
+                if (hmm_compact_out_score(fsgs->hmmctx, hmm) >= phone_thresh) {
                     /* Transition out of this phone into its children */
                     fsg_search_pnode_trans(fsgs, pnode);
                 }
             }
             else {
-                if (hmm_out_score(hmm) >= word_thresh) {
+                if (hmm_compact_out_score(fsgs->hmmctx, hmm) >= word_thresh) {
                     /* Transition out of leaf node into destination FSG state */
                     fsg_search_pnode_exit(fsgs, pnode);
                 }
@@ -655,8 +662,8 @@ fsg_search_word_trans(fsg_search_t *fsgs)
                 newscore = score + root->logs2prob;
 
                 if ((newscore BETTER_THAN thresh)
-                    && (newscore BETTER_THAN hmm_in_score(&root->hmm))) {
-                    if (hmm_frame(&root->hmm) < nf) {
+                    && (newscore BETTER_THAN hmm_compact_in_score(fsgs->hmmctx, &root->hmm))) {
+                    if (hmm_compact_frame(&root->hmm) < nf) {
                         /* Newly activated node; add to active list */
                         fsgs->pnode_active_next =
                             glist_add_ptr(fsgs->pnode_active_next,
@@ -675,7 +682,7 @@ fsg_search_word_trans(fsg_search_t *fsgs)
 #endif
                     }
 
-                    hmm_enter(&root->hmm, newscore, bpidx, nf);
+                    hmm_compact_enter(fsgs->hmmctx, &root->hmm, newscore, bpidx, nf);
                 }
             }
         }
@@ -691,15 +698,17 @@ fsg_search_step(ps_search_t *search, int frame_idx)
     acmod_t *acmod = search->acmod;
     gnode_t *gn;
     fsg_pnode_t *pnode;
-    hmm_t *hmm;
+    hmm_compact_t *hmm;
 
     /* Activate our HMMs for the current frame if need be. */
     if (!acmod->compallsen)
-        fsg_search_sen_active(fsgs);
+        fsg_search_sen_active(search, frame_idx);
     /* Compute GMM scores for the current frame. */
     senscr = acmod_score(acmod, &frame_idx);
     fsgs->n_sen_eval += acmod->n_senone_active;
     hmm_context_set_senscore(fsgs->hmmctx, senscr);
+    /* Scores in the lextree are kept relative to the previous best. */
+    hmm_context_set_base(fsgs->hmmctx, fsgs->bestscore);
 
     /* Mark backpointer table for current frame. */
     fsgs->bpidx_start = fsg_history_n_entries(fsgs->history);
@@ -738,12 +747,12 @@ fsg_search_step(ps_search_t *search, int frame_idx)
         pnode = (fsg_pnode_t *) gnode_ptr(gn);
         hmm = fsg_pnode_hmmptr(pnode);
 
-        if (hmm_frame(hmm) == fsgs->frame) {
+        if (hmm_compact_frame(hmm) == fsgs->frame) {
             /* This HMM NOT activated for the next frame; reset it */
             fsg_psubtree_pnode_deactivate(pnode);
         }
         else {
-            assert(hmm_frame(hmm) == (fsgs->frame + 1));
+            assert(hmm_compact_frame(hmm) == (fsgs->frame + 1));
         }
     }
 
@@ -795,6 +804,7 @@ fsg_search_start(ps_search_t *search)
     /* Create dummy history entry leading to start state */
     fsgs->frame = -1;
     fsgs->bestscore = 0;
+    hmm_context_set_base(fsgs->hmmctx, 0);
     fsg_history_entry_add(fsgs->history,
                           NULL, -1, 0, -1, silcipid, ctxt);
     fsgs->bpidx_start = 0;
@@ -83,7 +83,8 @@ typedef struct fsg_search_s {
     int32 wbeam_orig;		/**< Pruning threshold for word exit */
     float32 beam_factor;	/**< Dynamic/adaptive factor (<=1) applied to above
                                      beams to determine actual effective beams.
-                                     For implementing absolute pruning. */
+                                     For implementing absolute pruning, set
+                                     from a histogram of HMM scores. */
     int32 beam, pbeam, wbeam;	/**< Effective beams after applying beam_factor */
     int32 lw, pip, wip;         /**< Language weights */
   
@@ -0,0 +1,816 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file gmm_simd.c Vectorized diagonal Gaussian distance kernels.
+ *
+ * The x86 kernels are compiled with per-function target attributes,
+ * so that the rest of the library can still be built for a generic
+ * CPU and the right one picked at runtime.  This needs GCC 4.9 or
+ * Clang; other compilers only get the scalar code (and NEON, if it
+ * is enabled at compile time).  Nothing here is used with
+ * FIXED_POINT, since the scalar code saturates instead of wrapping.
+ *
+ * Note that the vector kernels sum the dimensions in a different
+ * order from the scalar one, so their results differ in the last few
+ * bits.  Use -gmm_simd none to get exactly the same scores as before.
+ *
+ * The mixture weight kernels, on the other hand, work on small
+ * integers in 16-bit lanes and give exactly the same results as the
+ * scalar code.  The log-add table lookup is done with byte shuffles,
+ * which only works because all but the first GMM_LOGADD_SIZE entries
+ * of the 8-bit table are zero.
+ */
+
+/* System headers. */
+#include <string.h>
+#include <limits.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/err.h>
+#include <sphinxbase/prim_type.h>
+
+/* Local headers. */
+#include "tied_mgau_common.h"
+#include "gmm_simd.h"
+
+#if !defined(FIXED_POINT) && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define GMM_SIMD_X86
+#include <immintrin.h>
+#define GMM_TARGET(isa) __attribute__((target(isa)))
+/* For kernels that must not fuse multiplies and adds (GCC does this
+ * across statements when the target has FMA, Clang does not). */
+#ifdef __clang__
+#define GMM_TARGET_EXACT(isa) GMM_TARGET(isa)
+#else
+#define GMM_TARGET_EXACT(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#endif
+#endif
+
+#if !defined(FIXED_POINT) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define GMM_SIMD_ARM
+#include <arm_neon.h>
+#endif
+
+static const char *gmm_simd_names[] = {
+    "none", "sse4", "avx2", "avx512", "neon", "auto"
+};
+
+mfcc_t
+gmm_dist_scalar(mfcc_t const *obs, mfcc_t const *mean,
+                mfcc_t const *var, int ceplen,
+                mfcc_t d, mfcc_t thresh)
+{
+    mfcc_t diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
+    int j;
+
+    /* Do the first dimension(s) one at a time, then 4 at a time.
+     * The order of operations here must stay the same as it always
+     * was, since this is the reference for the other kernels. */
+    for (j = 0; (j < ceplen % 4) && (d >= thresh); ++j) {
+        diff[0] = *obs++ - *mean++;
+        sqdiff[0] = MFCCMUL(diff[0], diff[0]);
+        compl[0] = MFCCMUL(sqdiff[0], *var++);
+        d = GMMSUB(d, compl[0]);
+    }
+    for (; j < ceplen && d >= thresh; j += 4) {
+        diff[0] = obs[0] - mean[0];
+        diff[1] = obs[1] - mean[1];
+        diff[2] = obs[2] - mean[2];
+        diff[3] = obs[3] - mean[3];
+        sqdiff[0] = MFCCMUL(diff[0], diff[0]);
+        sqdiff[1] = MFCCMUL(diff[1], diff[1]);
+        sqdiff[2] = MFCCMUL(diff[2], diff[2]);
+        sqdiff[3] = MFCCMUL(diff[3], diff[3]);
+        compl[0] = MFCCMUL(sqdiff[0], var[0]);
+        compl[1] = MFCCMUL(sqdiff[1], var[1]);
+        compl[2] = MFCCMUL(sqdiff[2], var[2]);
+        compl[3] = MFCCMUL(sqdiff[3], var[3]);
+        d = GMMSUB(d, compl[0]);
+        d = GMMSUB(d, compl[1]);
+        d = GMMSUB(d, compl[2]);
+        d = GMMSUB(d, compl[3]);
+        var += 4;
+        obs += 4;
+        mean += 4;
+    }
+    return d;
+}
+
+#ifdef GMM_SIMD_X86
+GMM_TARGET("sse4.1") static inline float
+hsum_sse4(__m128 v)
+{
+    __m128 sh;
+
+    sh = _mm_movehl_ps(v, v);
+    v = _mm_add_ps(v, sh);
+    sh = _mm_shuffle_ps(v, v, 0x55);
+    v = _mm_add_ss(v, sh);
+    return _mm_cvtss_f32(v);
+}
+
+GMM_TARGET("sse4.1") static mfcc_t
+gmm_dist_sse4(mfcc_t const *obs, mfcc_t const *mean,
+              mfcc_t const *var, int ceplen,
+              mfcc_t d, mfcc_t thresh)
+{
+    int j;
+
+    for (j = 0; j + 4 <= ceplen && d >= thresh; j += 4) {
+        __m128 diff, compl;
+
+        diff = _mm_sub_ps(_mm_loadu_ps(obs + j), _mm_loadu_ps(mean + j));
+        compl = _mm_mul_ps(_mm_mul_ps(diff, diff), _mm_loadu_ps(var + j));
+        d -= hsum_sse4(compl);
+    }
+    for (; j < ceplen && d >= thresh; ++j) {
+        mfcc_t diff = obs[j] - mean[j];
+        d -= diff * diff * var[j];
+    }
+    return d;
+}
+
+GMM_TARGET("avx2") static inline float
+hsum_avx2(__m256 v)
+{
+    return hsum_sse4(_mm_add_ps(_mm256_castps256_ps128(v),
+                                _mm256_extractf128_ps(v, 1)));
+}
+
+GMM_TARGET("avx2") static mfcc_t
+gmm_dist_avx2(mfcc_t const *obs, mfcc_t const *mean,
+              mfcc_t const *var, int ceplen,
+              mfcc_t d, mfcc_t thresh)
+{
+    int j;
+
+    for (j = 0; j + 8 <= ceplen && d >= thresh; j += 8) {
+        __m256 diff, compl;
+
+        diff = _mm256_sub_ps(_mm256_loadu_ps(obs + j),
+                             _mm256_loadu_ps(mean + j));
+        compl = _mm256_mul_ps(_mm256_mul_ps(diff, diff),
+                              _mm256_loadu_ps(var + j));
+        d -= hsum_avx2(compl);
+    }
+    /* Masked loads for the leftovers (masked-out lanes are zero). */
+    if (j < ceplen && d >= thresh) {
+        __m256i mask;
+        __m256 diff, compl;
+
+        mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(ceplen - j),
+                                  _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        diff = _mm256_sub_ps(_mm256_maskload_ps(obs + j, mask),
+                             _mm256_maskload_ps(mean + j, mask));
+        compl = _mm256_mul_ps(_mm256_mul_ps(diff, diff),
+                              _mm256_maskload_ps(var + j, mask));
+        d -= hsum_avx2(compl);
+    }
+    return d;
+}
+
+GMM_TARGET("avx512f") static inline float
+hsum_avx512(__m512 v)
+{
+    __m256 lo, hi;
+
+    lo = _mm512_castps512_ps256(v);
+    hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+    return hsum_avx2(_mm256_add_ps(lo, hi));
+}
+
+GMM_TARGET("avx512f") static mfcc_t
+gmm_dist_avx512(mfcc_t const *obs, mfcc_t const *mean,
+                mfcc_t const *var, int ceplen,
+                mfcc_t d, mfcc_t thresh)
+{
+    int j;
+
+    for (j = 0; j + 16 <= ceplen && d >= thresh; j += 16) {
+        __m512 diff, compl;
+
+        diff = _mm512_sub_ps(_mm512_loadu_ps(obs + j),
+                             _mm512_loadu_ps(mean + j));
+        compl = _mm512_mul_ps(_mm512_mul_ps(diff, diff),
+                              _mm512_loadu_ps(var + j));
+        d -= hsum_avx512(compl);
+    }
+    if (j < ceplen && d >= thresh) {
+        __mmask16 mask;
+        __m512 diff, compl;
+
+        mask = (__mmask16)((1U << (ceplen - j)) - 1);
+        diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, obs + j),
+                             _mm512_maskz_loadu_ps(mask, mean + j));
+        compl = _mm512_mul_ps(_mm512_mul_ps(diff, diff),
+                              _mm512_maskz_loadu_ps(mask, var + j));
+        d -= hsum_avx512(compl);
+    }
+    return d;
+}
+
+/*
+ * Interleaved kernels: these do the same arithmetic as the scalar
+ * code in ms_gauden.c, in the same order, for each of
+ * GMM_SOA_WIDTH densities, and thus give exactly the same results.
+ * They check every 8 dimensions whether all of the densities have
+ * dropped below the threshold.
+ */
+GMM_TARGET_EXACT("sse4.1") static void
+gmm_dist_soa_sse4(mfcc_t *out, mfcc_t const *obs, mfcc_t const *mean,
+                  mfcc_t const *var, int ceplen, mfcc_t const *det,
+                  mfcc_t thresh)
+{
+    __m128 d[4], th;
+    int i, k;
+
+    th = _mm_set1_ps(thresh);
+    for (k = 0; k < 4; ++k)
+        d[k] = _mm_load_ps(det + k * 4);
+    for (i = 0; i < ceplen; ++i) {
+        __m128 o = _mm_set1_ps(obs[i]);
+
+        for (k = 0; k < 4; ++k) {
+            __m128 diff;
+
+            diff = _mm_sub_ps(o, _mm_load_ps(mean + k * 4));
+            d[k] = _mm_sub_ps(d[k], _mm_mul_ps(_mm_mul_ps(diff, diff),
+                                               _mm_load_ps(var + k * 4)));
+        }
+        mean += GMM_SOA_WIDTH;
+        var += GMM_SOA_WIDTH;
+        if ((i & 7) == 7
+            && _mm_movemask_ps(_mm_or_ps(_mm_or_ps(_mm_cmpge_ps(d[0], th),
+                                                   _mm_cmpge_ps(d[1], th)),
+                                         _mm_or_ps(_mm_cmpge_ps(d[2], th),
+                                                   _mm_cmpge_ps(d[3], th))))
+            == 0)
+            break;
+    }
+    for (k = 0; k < 4; ++k)
+        _mm_storeu_ps(out + k * 4, d[k]);
+}
+
+GMM_TARGET_EXACT("avx2") static void
+gmm_dist_soa_avx2(mfcc_t *out, mfcc_t const *obs, mfcc_t const *mean,
+                  mfcc_t const *var, int ceplen, mfcc_t const *det,
+                  mfcc_t thresh)
+{
+    __m256 d0, d1, th;
+    int i;
+
+    th = _mm256_set1_ps(thresh);
+    d0 = _mm256_load_ps(det);
+    d1 = _mm256_load_ps(det + 8);
+    for (i = 0; i < ceplen; ++i) {
+        __m256 o, diff0, diff1;
+
+        o = _mm256_set1_ps(obs[i]);
+        diff0 = _mm256_sub_ps(o, _mm256_load_ps(mean));
+        diff1 = _mm256_sub_ps(o, _mm256_load_ps(mean + 8));
+        d0 = _mm256_sub_ps(d0, _mm256_mul_ps(_mm256_mul_ps(diff0, diff0),
+                                             _mm256_load_ps(var)));
+        d1 = _mm256_sub_ps(d1, _mm256_mul_ps(_mm256_mul_ps(diff1, diff1),
+                                             _mm256_load_ps(var + 8)));
+        mean += GMM_SOA_WIDTH;
+        var += GMM_SOA_WIDTH;
+        if ((i & 7) == 7
+            && _mm256_movemask_ps(_mm256_or_ps
+                                  (_mm256_cmp_ps(d0, th, _CMP_GE_OQ),
+                                   _mm256_cmp_ps(d1, th, _CMP_GE_OQ))) == 0)
+            break;
+    }
+    _mm256_storeu_ps(out, d0);
+    _mm256_storeu_ps(out + 8, d1);
+}
+
+GMM_TARGET_EXACT("avx512f") static void
+gmm_dist_soa_avx512(mfcc_t *out, mfcc_t const *obs, mfcc_t const *mean,
+                    mfcc_t const *var, int ceplen, mfcc_t const *det,
+                    mfcc_t thresh)
+{
+    __m512 d, th;
+    int i;
+
+    th = _mm512_set1_ps(thresh);
+    d = _mm512_load_ps(det);
+    for (i = 0; i < ceplen; ++i) {
+        __m512 diff;
+
+        diff = _mm512_sub_ps(_mm512_set1_ps(obs[i]), _mm512_load_ps(mean));
+        d = _mm512_sub_ps(d, _mm512_mul_ps(_mm512_mul_ps(diff, diff),
+                                           _mm512_load_ps(var)));
+        mean += GMM_SOA_WIDTH;
+        var += GMM_SOA_WIDTH;
+        if ((i & 7) == 7
+            && _mm512_cmp_ps_mask(d, th, _CMP_GE_OQ) == 0)
+            break;
+    }
+    _mm512_storeu_ps(out, d);
+}
+
+/* Scalar log-add, exactly as fast_logmath_add() does it. */
+static inline int32
+logadd_scalar(uint8 const *logadd, int32 x, int32 y)
+{
+    if (x > y)
+        return y - logadd[x - y];
+    else
+        return x - logadd[y - x];
+}
+
+/* Scalar mixture weight code for the leftovers. */
+static void
+gmm_mixw8_tail(int16 *senone_scores, uint8 const *const *mixw,
+               int16 const *score, int topn, int32 start, int32 end,
+               uint8 const *logadd)
+{
+    int32 j;
+    int k;
+
+    for (j = start; j < end; ++j) {
+        int32 tmp = mixw[0][j] + score[0];
+        for (k = 1; k < topn; ++k)
+            tmp = logadd_scalar(logadd, tmp, mixw[k][j] + score[k]);
+        senone_scores[j] += tmp;
+    }
+}
+
+static void
+gmm_mixw4_tail(int16 *senone_scores, uint8 const *const *mixw,
+               int16 const *score, int topn, int32 start, int32 end,
+               uint8 const *mixw_cb, uint8 const *logadd)
+{
+    int32 j;
+    int k;
+
+    for (j = start; j < end; j += 2) {
+        int32 tmp0, tmp1;
+
+        tmp0 = mixw_cb[mixw[0][j/2] & 0x0f] + score[0];
+        tmp1 = mixw_cb[mixw[0][j/2] >> 4] + score[0];
+        for (k = 1; k < topn; ++k) {
+            tmp0 = logadd_scalar(logadd, tmp0,
+                                 mixw_cb[mixw[k][j/2] & 0x0f] + score[k]);
+            tmp1 = logadd_scalar(logadd, tmp1,
+                                 mixw_cb[mixw[k][j/2] >> 4] + score[k]);
+        }
+        senone_scores[j] += tmp0;
+        senone_scores[j + 1] += tmp1;
+    }
+}
+
+static void
+gmm_logadd_tail(int16 *out, int16 const *den, int stride,
+                int topn, int start, int n, uint8 const *logadd)
+{
+    int j, k;
+
+    for (j = start; j < n; ++j) {
+        int32 tmp = den[j];
+        for (k = 1; k < topn; ++k)
+            tmp = logadd_scalar(logadd, tmp, den[k * stride + j]);
+        out[j] = tmp;
+    }
+}
+
+/*
+ * Log-add two vectors of 16-bit scores.  The table index goes in the
+ * low byte of each lane, with 0x80 in the high byte so that the
+ * shuffle gives zero there.  Adding 0x70 with saturation sets the top
+ * bit (and thus gives zero) for anything past the 16 entries in each
+ * half of the table.
+ */
+GMM_TARGET("sse4.1") static inline __m128i
+logadd_sse4(__m128i x, __m128i y, __m128i tlo, __m128i thi)
+{
+    __m128i r, d, lo, hi;
+
+    r = _mm_min_epi16(x, y);
+    d = _mm_abs_epi16(_mm_sub_epi16(x, y));
+    d = _mm_or_si128(_mm_min_epi16(d, _mm_set1_epi16(0xff)),
+                     _mm_set1_epi16((short)0x8000));
+    lo = _mm_shuffle_epi8(tlo, _mm_adds_epu8(d, _mm_set1_epi16(0x70)));
+    d = _mm_sub_epi8(d, _mm_set1_epi16(0x10));
+    hi = _mm_shuffle_epi8(thi, _mm_adds_epu8(d, _mm_set1_epi16(0x70)));
+    return _mm_sub_epi16(r, _mm_or_si128(lo, hi));
+}
+
+GMM_TARGET("sse4.1") static void
+gmm_mixw8_sse4(int16 *senone_scores, uint8 const *const *mixw,
+               int16 const *score, int topn, int32 start, int32 end,
+               uint8 const *logadd)
+{
+    __m128i tlo, thi;
+    int32 j;
+    int k;
+
+    tlo = _mm_loadu_si128((__m128i const *)logadd);
+    thi = _mm_loadu_si128((__m128i const *)(logadd + 16));
+    for (j = start; j + 8 <= end; j += 8) {
+        __m128i tmp, den;
+
+        tmp = _mm_cvtepu8_epi16(_mm_loadl_epi64((__m128i const *)
+                                                (mixw[0] + j)));
+        tmp = _mm_add_epi16(tmp, _mm_set1_epi16(score[0]));
+        for (k = 1; k < topn; ++k) {
+            den = _mm_cvtepu8_epi16(_mm_loadl_epi64((__m128i const *)
+                                                    (mixw[k] + j)));
+            den = _mm_add_epi16(den, _mm_set1_epi16(score[k]));
+            tmp = logadd_sse4(tmp, den, tlo, thi);
+        }
+        tmp = _mm_add_epi16(tmp, _mm_loadu_si128((__m128i *)
+                                                 (senone_scores + j)));
+        _mm_storeu_si128((__m128i *)(senone_scores + j), tmp);
+    }
+    gmm_mixw8_tail(senone_scores, mixw, score, topn, j, end, logadd);
+}
+
+/* Unpack 16 4-bit mixture weights and look them up in the codebook. */
+GMM_TARGET("sse4.1") static inline __m128i
+unpack_mixw4_sse4(uint8 const *mixw, __m128i cb)
+{
+    __m128i b, lo, hi, mask;
+
+    mask = _mm_set1_epi8(0x0f);
+    b = _mm_loadl_epi64((__m128i const *)mixw);
+    lo = _mm_and_si128(b, mask);
+    hi = _mm_and_si128(_mm_srli_epi16(b, 4), mask);
+    /* Even senones are in the low nibble. */
+    return _mm_shuffle_epi8(cb, _mm_unpacklo_epi8(lo, hi));
+}
+
+GMM_TARGET("sse4.1") static void
+gmm_mixw4_sse4(int16 *senone_scores, uint8 const *const *mixw,
+               int16 const *score, int topn, int32 start, int32 end,
+               uint8 const *mixw_cb, uint8 const *logadd)
+{
+    __m128i tlo, thi, cb;
+    int32 j;
+    int k;
+
+    tlo = _mm_loadu_si128((__m128i const *)logadd);
+    thi = _mm_loadu_si128((__m128i const *)(logadd + 16));
+    cb = _mm_loadu_si128((__m128i const *)mixw_cb);
+    for (j = start; j + 16 <= end; j += 16) {
+        __m128i w, tmp0, tmp1, den;
+
+        w = unpack_mixw4_sse4(mixw[0] + j/2, cb);
+        tmp0 = _mm_add_epi16(_mm_cvtepu8_epi16(w), _mm_set1_epi16(score[0]));
+        tmp1 = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(w, 8)),
+                             _mm_set1_epi16(score[0]));
+        for (k = 1; k < topn; ++k) {
+            w = unpack_mixw4_sse4(mixw[k] + j/2, cb);
+            den = _mm_add_epi16(_mm_cvtepu8_epi16(w), _mm_set1_epi16(score[k]));
+            tmp0 = logadd_sse4(tmp0, den, tlo, thi);
+            den = _mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(w, 8)),
+                                _mm_set1_epi16(score[k]));
+            tmp1 = logadd_sse4(tmp1, den, tlo, thi);
+        }
+        tmp0 = _mm_add_epi16(tmp0, _mm_loadu_si128((__m128i *)
+                                                   (senone_scores + j)));
+        _mm_storeu_si128((__m128i *)(senone_scores + j), tmp0);
+        tmp1 = _mm_add_epi16(tmp1, _mm_loadu_si128((__m128i *)
+                                                   (senone_scores + j + 8)));
+        _mm_storeu_si128((__m128i *)(senone_scores + j + 8), tmp1);
+    }
+    gmm_mixw4_tail(senone_scores, mixw, score, topn, j, end, mixw_cb, logadd);
+}
+
+GMM_TARGET("sse4.1") static void
+gmm_logadd_sse4(int16 *out, int16 const *den, int stride,
+                int topn, int n, uint8 const *logadd)
+{
+    __m128i tlo, thi;
+    int j, k;
+
+    tlo = _mm_loadu_si128((__m128i const *)logadd);
+    thi = _mm_loadu_si128((__m128i const *)(logadd + 16));
+    for (j = 0; j + 8 <= n; j += 8) {
+        __m128i tmp;
+
+        tmp = _mm_loadu_si128((__m128i const *)(den + j));
+        for (k = 1; k < topn; ++k)
+            tmp = logadd_sse4(tmp, _mm_loadu_si128((__m128i const *)
+                                                   (den + k * stride + j)),
+                              tlo, thi);
+        _mm_storeu_si128((__m128i *)(out + j), tmp);
+    }
+    gmm_logadd_tail(out, den, stride, topn, j, n, logadd);
+}
+
+GMM_TARGET("avx2") static inline __m256i
+logadd_avx2(__m256i x, __m256i y, __m256i tlo, __m256i thi)
+{
+    __m256i r, d, lo, hi;
+
+    r = _mm256_min_epi16(x, y);
+    d = _mm256_abs_epi16(_mm256_sub_epi16(x, y));
+    d = _mm256_or_si256(_mm256_min_epi16(d, _mm256_set1_epi16(0xff)),
+                        _mm256_set1_epi16((short)0x8000));
+    lo = _mm256_shuffle_epi8(tlo, _mm256_adds_epu8(d, _mm256_set1_epi16(0x70)));
+    d = _mm256_sub_epi8(d, _mm256_set1_epi16(0x10));
+    hi = _mm256_shuffle_epi8(thi, _mm256_adds_epu8(d, _mm256_set1_epi16(0x70)));
+    return _mm256_sub_epi16(r, _mm256_or_si256(lo, hi));
+}
+
+/* The shuffles work within each 128-bit lane, so the table halves
+ * have to be repeated in both. */
+GMM_TARGET("avx2") static inline void
+load_logadd_avx2(uint8 const *logadd, __m256i *tlo, __m256i *thi)
+{
+    *tlo = _mm256_broadcastsi128_si256
+        (_mm_loadu_si128((__m128i const *)logadd));
+    *thi = _mm256_broadcastsi128_si256
+        (_mm_loadu_si128((__m128i const *)(logadd + 16)));
+}
+
+GMM_TARGET("avx2") static void
+gmm_mixw8_avx2(int16 *senone_scores, uint8 const *const *mixw,
+               int16 const *score, int topn, int32 start, int32 end,
+               uint8 const *logadd)
+{
+    __m256i tlo, thi;
+    int32 j;
+    int k;
+
+    load_logadd_avx2(logadd, &tlo, &thi);
+    for (j = start; j + 16 <= end; j += 16) {
+        __m256i tmp, den;
+
+        tmp = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *)
+                                                   (mixw[0] + j)));
+        tmp = _mm256_add_epi16(tmp, _mm256_set1_epi16(score[0]));
+        for (k = 1; k < topn; ++k) {
+            den = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *)
+                                                       (mixw[k] + j)));
+            den = _mm256_add_epi16(den, _mm256_set1_epi16(score[k]));
+            tmp = logadd_avx2(tmp, den, tlo, thi);
+        }
+        tmp = _mm256_add_epi16(tmp, _mm256_loadu_si256((__m256i *)
+                                                       (senone_scores + j)));
+        _mm256_storeu_si256((__m256i *)(senone_scores + j), tmp);
+    }
+    gmm_mixw8_tail(senone_scores, mixw, score, topn, j, end, logadd);
+}
+
+GMM_TARGET("avx2") static void
+gmm_mixw4_avx2(int16 *senone_scores, uint8 const *const *mixw,
+               int16 const *score, int topn, int32 start, int32 end,
+               uint8 const *mixw_cb, uint8 const *logadd)
+{
+    __m256i tlo, thi;
+    __m128i cb;
+    int32 j;
+    int k;
+
+    load_logadd_avx2(logadd, &tlo, &thi);
+    cb = _mm_loadu_si128((__m128i const *)mixw_cb);
+    for (j = start; j + 16 <= end; j += 16) {
+        __m256i tmp, den;
+
+        tmp = _mm256_cvtepu8_epi16(unpack_mixw4_sse4(mixw[0] + j/2, cb));
+        tmp = _mm256_add_epi16(tmp, _mm256_set1_epi16(score[0]));
+        for (k = 1; k < topn; ++k) {
+            den = _mm256_cvtepu8_epi16(unpack_mixw4_sse4(mixw[k] + j/2, cb));
+            den = _mm256_add_epi16(den, _mm256_set1_epi16(score[k]));
+            tmp = logadd_avx2(tmp, den, tlo, thi);
+        }
+        tmp = _mm256_add_epi16(tmp, _mm256_loadu_si256((__m256i *)
+                                                       (senone_scores + j)));
+        _mm256_storeu_si256((__m256i *)(senone_scores + j), tmp);
+    }
+    gmm_mixw4_tail(senone_scores, mixw, score, topn, j, end, mixw_cb, logadd);
+}
+
+GMM_TARGET("avx2") static void
+gmm_logadd_avx2(int16 *out, int16 const *den, int stride,
+                int topn, int n, uint8 const *logadd)
+{
+    __m256i tlo, thi;
+    int j, k;
+
+    load_logadd_avx2(logadd, &tlo, &thi);
+    for (j = 0; j + 16 <= n; j += 16) {
+        __m256i tmp;
+
+        tmp = _mm256_loadu_si256((__m256i const *)(den + j));
+        for (k = 1; k < topn; ++k)
+            tmp = logadd_avx2(tmp, _mm256_loadu_si256((__m256i const *)
+                                                      (den + k * stride + j)),
+                              tlo, thi);
+        _mm256_storeu_si256((__m256i *)(out + j), tmp);
+    }
+    gmm_logadd_tail(out, den, stride, topn, j, n, logadd);
+}
+
+static const gmm_mixw_funcs_t gmm_mixw_sse4 = {
+    gmm_mixw8_sse4, gmm_mixw4_sse4, gmm_logadd_sse4
+};
+static const gmm_mixw_funcs_t gmm_mixw_avx2 = {
+    gmm_mixw8_avx2, gmm_mixw4_avx2, gmm_logadd_avx2
+};
+#endif /* GMM_SIMD_X86 */
+
+#ifdef GMM_SIMD_ARM
+static inline float
+hsum_neon(float32x4_t v)
+{
+    float32x2_t s;
+
+    s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    s = vpadd_f32(s, s);
+    return vget_lane_f32(s, 0);
+}
+
+static mfcc_t
+gmm_dist_neon(mfcc_t const *obs, mfcc_t const *mean,
+              mfcc_t const *var, int ceplen,
+              mfcc_t d, mfcc_t thresh)
+{
+    int j;
+
+    for (j = 0; j + 4 <= ceplen && d >= thresh; j += 4) {
+        float32x4_t diff, compl;
+
+        diff = vsubq_f32(vld1q_f32(obs + j), vld1q_f32(mean + j));
+        compl = vmulq_f32(vmulq_f32(diff, diff), vld1q_f32(var + j));
+        d -= hsum_neon(compl);
+    }
+    for (; j < ceplen && d >= thresh; ++j) {
+        mfcc_t diff = obs[j] - mean[j];
+        d -= diff * diff * var[j];
+    }
+    return d;
+}
+#endif /* GMM_SIMD_ARM */
+
+int
+gmm_simd_from_str(char const *str)
+{
+    int i;
+
+    if (str == NULL)
+        return GMM_SIMD_AUTO;
+    for (i = 0; i < (int)(sizeof(gmm_simd_names)/sizeof(gmm_simd_names[0])); ++i)
+        if (0 == strcmp(str, gmm_simd_names[i]))
+            return i;
+    return -1;
+}
+
+char const *
+gmm_simd_name(gmm_simd_t level)
+{
+    return gmm_simd_names[level];
+}
+
+gmm_simd_t
+gmm_simd_detect(void)
+{
+#if defined(GMM_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return GMM_SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return GMM_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return GMM_SIMD_SSE4;
+#elif defined(GMM_SIMD_ARM)
+    return GMM_SIMD_NEON;
+#endif
+    return GMM_SIMD_NONE;
+}
+
+static int
+gmm_simd_supported(gmm_simd_t level, gmm_simd_t best)
+{
+    if (level == GMM_SIMD_NONE)
+        return TRUE;
+    if (best == GMM_SIMD_NEON)
+        return level == GMM_SIMD_NEON;
+    return level != GMM_SIMD_NEON && level <= best;
+}
+
+gmm_simd_t
+gmm_simd_select(char const *str)
+{
+    gmm_simd_t best;
+    int level;
+
+    best = gmm_simd_detect();
+    if ((level = gmm_simd_from_str(str)) < 0) {
+        E_WARN("Unknown SIMD level '%s', using %s\n",
+               str, gmm_simd_name(best));
+        level = best;
+    }
+    else if (level == GMM_SIMD_AUTO)
+        level = best;
+    else if (!gmm_simd_supported(level, best)) {
+        E_WARN("SIMD level %s not supported, using %s\n",
+               gmm_simd_name(level), gmm_simd_name(best));
+        level = best;
+    }
+    E_INFO("SIMD level for Gaussian computation: %s\n", gmm_simd_name(level));
+    return level;
+}
+
+gmm_dist_func_t
+gmm_simd_dist_func(gmm_simd_t level)
+{
+    switch (level) {
+#ifdef GMM_SIMD_X86
+    case GMM_SIMD_SSE4:
+        return gmm_dist_sse4;
+    case GMM_SIMD_AVX2:
+        return gmm_dist_avx2;
+    case GMM_SIMD_AVX512:
+        return gmm_dist_avx512;
+#endif
+#ifdef GMM_SIMD_ARM
+    case GMM_SIMD_NEON:
+        return gmm_dist_neon;
+#endif
+    default:
+        return gmm_dist_scalar;
+    }
+}
+
+gmm_dist_soa_func_t
+gmm_simd_dist_soa_func(gmm_simd_t level)
+{
+    switch (level) {
+#ifdef GMM_SIMD_X86
+    case GMM_SIMD_SSE4:
+        return gmm_dist_soa_sse4;
+    case GMM_SIMD_AVX2:
+        return gmm_dist_soa_avx2;
+    case GMM_SIMD_AVX512:
+        return gmm_dist_soa_avx512;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+gmm_mixw_funcs_t const *
+gmm_simd_mixw_funcs(gmm_simd_t level)
+{
+    switch (level) {
+#ifdef GMM_SIMD_X86
+    case GMM_SIMD_SSE4:
+        return &gmm_mixw_sse4;
+    case GMM_SIMD_AVX2:
+    case GMM_SIMD_AVX512:
+        /* 16-bit lanes need AVX512BW, so just use AVX2. */
+        return &gmm_mixw_avx2;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+int
+gmm_simd_logadd_ok(uint8 const *logadd, int size)
+{
+    int i;
+
+    if (size < 256)
+        return FALSE;
+    for (i = GMM_LOGADD_SIZE; i < 256; ++i)
+        if (logadd[i] != 0)
+            return FALSE;
+    return TRUE;
+}
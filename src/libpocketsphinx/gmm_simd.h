@@ -0,0 +1,228 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file gmm_simd.h Vectorized diagonal Gaussian distance kernels
+ * (and mixture weight kernels for the tied-mixture models).
+ *
+ * These compute the (negated, scaled) log-likelihood of one diagonal
+ * Gaussian in the form used by the tied-mixture models, i.e. the
+ * determinant term minus the variance-weighted squared distance from
+ * the mean, with the same early termination as the scalar code when
+ * the running total drops below a threshold.  The implementation is
+ * selected at runtime based on what the CPU supports, or forced with
+ * the -gmm_simd option.
+ */
+
+#ifndef __GMM_SIMD_H__
+#define __GMM_SIMD_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+/**
+ * Threshold value which never causes early termination.
+ */
+#ifdef FIXED_POINT
+#define GMM_NO_THRESH ((mfcc_t)MAX_NEG_INT32)
+#else
+#define GMM_NO_THRESH ((mfcc_t)MAX_NEG_FLOAT32)
+#endif
+
+/**
+ * Instruction set levels for Gaussian evaluation.
+ */
+typedef enum gmm_simd_e {
+    GMM_SIMD_NONE,    /**< Plain C, identical to the original code. */
+    GMM_SIMD_SSE4,    /**< SSE4.1, 4 dimensions per instruction. */
+    GMM_SIMD_AVX2,    /**< AVX2, 8 dimensions per instruction. */
+    GMM_SIMD_AVX512,  /**< AVX-512F, 16 dimensions per instruction. */
+    GMM_SIMD_NEON,    /**< ARM NEON, 4 dimensions per instruction. */
+    GMM_SIMD_AUTO     /**< Best level supported by this CPU. */
+} gmm_simd_t;
+
+/**
+ * Gaussian distance kernel.
+ *
+ * @param obs Observation vector.
+ * @param mean Mean vector.
+ * @param var Inverse variance vector (already scaled by 1/2).
+ * @param ceplen Length of the vectors.
+ * @param d Initial score (normally the determinant term).
+ * @param thresh Threshold below which evaluation may stop early.
+ * @return Score for this Gaussian.  If this is less than
+ *         <code>thresh</code>, it is not a complete score, but only
+ *         guaranteed to be less than <code>thresh</code>.
+ */
+typedef mfcc_t (*gmm_dist_func_t)(mfcc_t const *obs, mfcc_t const *mean,
+                                  mfcc_t const *var, int ceplen,
+                                  mfcc_t d, mfcc_t thresh);
+
+/**
+ * Parse a SIMD level name (auto, none, sse4, avx2, avx512, neon).
+ *
+ * @return the level, or -1 if the name is not recognized.
+ */
+int gmm_simd_from_str(char const *str);
+
+/**
+ * Get the name of a SIMD level.
+ */
+char const *gmm_simd_name(gmm_simd_t level);
+
+/**
+ * Find the best SIMD level supported by the CPU we are running on.
+ */
+gmm_simd_t gmm_simd_detect(void);
+
+/**
+ * Choose a SIMD level based on a configuration string.
+ *
+ * If the requested level is not supported by this CPU (or was not
+ * compiled in), this falls back to the best one that is, with a
+ * warning.
+ *
+ * @param str Level name as for gmm_simd_from_str(), or NULL for auto.
+ */
+gmm_simd_t gmm_simd_select(char const *str);
+
+/**
+ * Get the distance kernel for a SIMD level (which must already have
+ * been validated with gmm_simd_select()).
+ */
+gmm_dist_func_t gmm_simd_dist_func(gmm_simd_t level);
+
+/**
+ * Scalar distance kernel, exposed for comparison and testing.
+ */
+mfcc_t gmm_dist_scalar(mfcc_t const *obs, mfcc_t const *mean,
+                       mfcc_t const *var, int ceplen,
+                       mfcc_t d, mfcc_t thresh);
+
+/**
+ * Number of densities scored at once by the interleaved kernels.
+ * This is one 64-byte cache line of single-precision values.
+ */
+#define GMM_SOA_WIDTH 16
+
+/**
+ * Gaussian distance kernel for interleaved parameters.  This scores
+ * GMM_SOA_WIDTH densities at once, whose means (and variances) are
+ * stored dimension by dimension, i.e. <code>mean[i * GMM_SOA_WIDTH +
+ * k]</code> is dimension <code>i</code> of density <code>k</code>.
+ * The parameters must be 64-byte aligned.
+ * @param out Output: scores for each density.  Those less than
+ *            <code>thresh</code> may be incomplete.
+ * @param det Initial scores (determinants) for each density.
+ * @param thresh Evaluation may stop once all scores are below this.
+ */
+typedef void (*gmm_dist_soa_func_t)(mfcc_t *out, mfcc_t const *obs,
+                                    mfcc_t const *mean, mfcc_t const *var,
+                                    int ceplen, mfcc_t const *det,
+                                    mfcc_t thresh);
+
+/**
+ * Get the interleaved distance kernel for a SIMD level.
+ * @return the kernel, or NULL if there is none for this level.
+ */
+gmm_dist_soa_func_t gmm_simd_dist_soa_func(gmm_simd_t level);
+
+/**
+ * Number of log-add table entries used by the mixture weight kernels.
+ */
+#define GMM_LOGADD_SIZE 32
+
+/**
+ * Mixture weight kernel for 8-bit mixture weights.  For each senone
+ * <code>j</code> from <code>start</code> to <code>end</code>, this
+ * log-adds <code>mixw[k][j] + score[k]</code> over the top-N
+ * codewords, in order, exactly as fast_logmath_add() would, and adds
+ * the result to <code>senone_scores[j]</code>.
+ * @param mixw Mixture weight rows for each of the top-N codewords.
+ * @param score Scores for each of the top-N codewords.
+ * @param logadd 8-bit log-add table (see gmm_simd_logadd_ok()).
+ */
+typedef void (*gmm_mixw8_func_t)(int16 *senone_scores,
+                                 uint8 const *const *mixw,
+                                 int16 const *score, int topn,
+                                 int32 start, int32 end,
+                                 uint8 const *logadd);
+
+/**
+ * Mixture weight kernel for 4-bit mixture weights (packed two per
+ * byte, the even senone in the low nibble), which are looked up in
+ * <code>mixw_cb</code>.  Otherwise the same as gmm_mixw8_func_t,
+ * except that <code>start</code> and <code>end</code> must be even.
+ */
+typedef void (*gmm_mixw4_func_t)(int16 *senone_scores,
+                                 uint8 const *const *mixw,
+                                 int16 const *score, int topn,
+                                 int32 start, int32 end,
+                                 uint8 const *mixw_cb,
+                                 uint8 const *logadd);
+
+/**
+ * Log-add kernel for densities that have already been gathered.
+ * Sets <code>out[j]</code> to the log-sum of <code>den[k * stride +
+ * j]</code> over the top-N, for <code>j</code> from 0 to
+ * <code>n</code>.
+ */
+typedef void (*gmm_logadd_func_t)(int16 *out, int16 const *den,
+                                  int stride, int topn, int n,
+                                  uint8 const *logadd);
+
+/**
+ * Set of mixture weight kernels.
+ */
+typedef struct gmm_mixw_funcs_s {
+    gmm_mixw8_func_t mixw8;
+    gmm_mixw4_func_t mixw4;
+    gmm_logadd_func_t logadd;
+} gmm_mixw_funcs_t;
+
+/**
+ * Get the mixture weight kernels for a SIMD level.
+ * @return the kernels, or NULL if there are none for this level, in
+ *         which case the plain C code should be used.
+ */
+gmm_mixw_funcs_t const *gmm_simd_mixw_funcs(gmm_simd_t level);
+
+/**
+ * Check that a log-add table can be used by the mixture weight
+ * kernels, i.e. that it has at least 256 entries, of which all but
+ * the first GMM_LOGADD_SIZE are zero.
+ */
+int gmm_simd_logadd_ok(uint8 const *logadd, int size);
+
+#endif /* __GMM_SIMD_H__ */
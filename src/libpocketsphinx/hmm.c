@@ -71,7 +71,6 @@ hmm_context_init(int32 n_emit_state,
     ctx->tp = tp;
     ctx->senscore = senscore;
     ctx->sseq = sseq;
-    ctx->st_sen_scr = ckd_calloc(n_emit_state, sizeof(*ctx->st_sen_scr));
 
     return ctx;
 }
@@ -81,7 +80,8 @@ hmm_context_free(hmm_context_t *ctx)
 {
     if (ctx == NULL)
         return;
-    ckd_free(ctx->st_sen_scr);
+    ckd_free(ctx->batch);
+    ckd_free(ctx->soa);
     ckd_free(ctx);
 }
 
@@ -711,17 +711,18 @@ hmm_vit_eval_3st_lr_mpx(hmm_t * hmm)
 static int32
 hmm_vit_eval_anytopo(hmm_t * hmm)
 {
-    hmm_context_t *ctx = hmm->ctx;
+    /* On the stack so that HMMs can be evaluated in several threads. */
+    int32 st_sen_scr[HMM_MAX_NSTATE];
     int32 to, from, bestfrom;
     int32 newscr, scr, bestscr;
     int final_state;
 
     /* Compute previous state-score + observation output prob for each emitting state */
-    ctx->st_sen_scr[0] = hmm_in_score(hmm) + hmm_senscr(hmm, 0);
+    st_sen_scr[0] = hmm_in_score(hmm) + hmm_senscr(hmm, 0);
     for (from = 1; from < hmm_n_emit_state(hmm); ++from) {
-        if ((ctx->st_sen_scr[from] =
+        if ((st_sen_scr[from] =
              hmm_score(hmm, from) + hmm_senscr(hmm, from)) WORSE_THAN WORST_SCORE)
-            ctx->st_sen_scr[from] = WORST_SCORE;
+            st_sen_scr[from] = WORST_SCORE;
     }
 
     /* FIXME/TODO: Use the BLAS for all this. */
@@ -732,7 +733,7 @@ hmm_vit_eval_anytopo(hmm_t * hmm)
     bestfrom = -1;
     for (from = to - 1; from >= 0; --from) {
         if ((hmm_tprob(hmm, from, to) BETTER_THAN TMAT_WORST_SCORE) &&
-            ((newscr = ctx->st_sen_scr[from]
+            ((newscr = st_sen_scr[from]
               + hmm_tprob(hmm, from, to)) BETTER_THAN scr)) {
             scr = newscr;
             bestfrom = from;
@@ -748,14 +749,14 @@ hmm_vit_eval_anytopo(hmm_t * hmm)
         /* Score from self-transition, if any */
         scr =
             (hmm_tprob(hmm, to, to) BETTER_THAN TMAT_WORST_SCORE)
-            ? ctx->st_sen_scr[to] + hmm_tprob(hmm, to, to)
+            ? st_sen_scr[to] + hmm_tprob(hmm, to, to)
             : WORST_SCORE;
 
         /* Scores from transitions from other states */
         bestfrom = -1;
         for (from = to - 1; from >= 0; --from) {
             if ((hmm_tprob(hmm, from, to) BETTER_THAN TMAT_WORST_SCORE) &&
-                ((newscr = ctx->st_sen_scr[from]
+                ((newscr = st_sen_scr[from]
                   + hmm_tprob(hmm, from, to)) BETTER_THAN scr)) {
                 scr = newscr;
                 bestfrom = from;
@@ -823,3 +824,538 @@ hmm_dump_vit_eval(hmm_t * hmm, FILE * fp)
 
     return bs;
 }
+
+/**
+ * Structure-of-arrays copy of up to HMM_BATCH_WIDTH HMMs.
+ *
+ * State HMM_MAX_NSTATE is used for the non-emitting exit state
+ * regardless of the actual number of states.  Transition scores are
+ * indexed like ctx->tp[tmatid][0], i.e. (from * (n_emit_state + 1) + to),
+ * and are negated, like hmm_tprob().
+ */
+struct hmm_batch_s {
+    int32 score[HMM_MAX_NSTATE + 1][HMM_BATCH_WIDTH];
+    int32 history[HMM_MAX_NSTATE + 1][HMM_BATCH_WIDTH];
+    int32 senscr[HMM_MAX_NSTATE][HMM_BATCH_WIDTH];
+    int32 tp[HMM_MAX_NSTATE * (HMM_MAX_NSTATE + 1)][HMM_BATCH_WIDTH];
+    int32 bestscore[HMM_BATCH_WIDTH];
+    void *hmm[HMM_BATCH_WIDTH]; /**< hmm_t or hmm_compact_t */
+};
+
+/* Transitions used by the left-to-right topologies. */
+static const uint8 tp_5st_lr[][2] = {
+    {0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}, {1, 3}, {2, 2},
+    {2, 3}, {2, 4}, {3, 3}, {3, 4}, {3, 5}, {4, 4}, {4, 5}
+};
+static const uint8 tp_3st_lr[][2] = {
+    {0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}, {1, 3}, {2, 2}, {2, 3}
+};
+
+void
+hmm_batch_grow(hmm_context_t *ctx)
+{
+    ctx->n_batch_alloc = ctx->n_batch_alloc ? ctx->n_batch_alloc * 2 : 256;
+    ctx->batch = ckd_realloc(ctx->batch,
+                             ctx->n_batch_alloc * sizeof(*ctx->batch));
+}
+
+static void
+hmm_batch_gather_tp(hmm_context_t *ctx, struct hmm_batch_s *b,
+                    int i, int tmatid)
+{
+    uint8 const (*tpidx)[2];
+    uint8 const *tp = ctx->tp[tmatid][0];
+    int n_tp, n_emit, j;
+
+    n_emit = ctx->n_emit_state;
+    if (n_emit == 5) {
+        tpidx = tp_5st_lr;
+        n_tp = sizeof(tp_5st_lr) / sizeof(tp_5st_lr[0]);
+    }
+    else {
+        tpidx = tp_3st_lr;
+        n_tp = sizeof(tp_3st_lr) / sizeof(tp_3st_lr[0]);
+    }
+    for (j = 0; j < n_tp; ++j) {
+        int k = tpidx[j][0] * (n_emit + 1) + tpidx[j][1];
+        b->tp[k][i] = -tp[k];
+    }
+}
+
+static void
+hmm_batch_gather(hmm_context_t *ctx, struct hmm_batch_s *b, int n)
+{
+    int i, j;
+
+    for (i = 0; i < n; ++i) {
+        hmm_t *h = b->hmm[i];
+
+        for (j = 0; j < ctx->n_emit_state; ++j) {
+            b->score[j][i] = h->score[j];
+            b->history[j][i] = h->history[j];
+            b->senscr[j][i] = -ctx->senscore[h->senid[j]];
+        }
+        b->score[HMM_MAX_NSTATE][i] = h->out_score;
+        b->history[HMM_MAX_NSTATE][i] = h->out_history;
+        hmm_batch_gather_tp(ctx, b, i, h->tmatid);
+    }
+}
+
+static int32
+hmm_batch_scatter(hmm_context_t *ctx, struct hmm_batch_s *b, int n)
+{
+    int32 best;
+    int i, j;
+
+    best = WORST_SCORE;
+    for (i = 0; i < n; ++i) {
+        hmm_t *h = b->hmm[i];
+
+        /* History of the entry state never changes. */
+        h->score[0] = b->score[0][i];
+        for (j = 1; j < ctx->n_emit_state; ++j) {
+            h->score[j] = b->score[j][i];
+            h->history[j] = b->history[j][i];
+        }
+        h->out_score = b->score[HMM_MAX_NSTATE][i];
+        h->out_history = b->history[HMM_MAX_NSTATE][i];
+        h->bestscore = b->bestscore[i];
+        if (h->bestscore BETTER_THAN best)
+            best = h->bestscore;
+    }
+    return best;
+}
+
+/*
+ * The kernels below do exactly what hmm_vit_eval_5st_lr() and
+ * hmm_vit_eval_3st_lr() do, down to the choice among equal scores,
+ * but with every if turned into a select so that the loop over lanes
+ * can be vectorized.  Since all scores are read before any are
+ * written, the order of the states does not matter here.
+ */
+#define SEL(c, a, b) ((c) ? (a) : (b))
+#define MAX3(t0, t1, t2, h0, h1, h2, out, hout)                 \
+    do {                                                        \
+        int32 b01_ = SEL(t0 BETTER_THAN t1, t0, t1);            \
+        int32 hb01_ = SEL(t0 BETTER_THAN t1, h0, h1);           \
+        out = SEL(t2 BETTER_THAN b01_, t2, b01_);               \
+        hout = SEL(t2 BETTER_THAN b01_, h2, hb01_);             \
+        out = SEL(out WORSE_THAN WORST_SCORE, WORST_SCORE, out);\
+    } while (0)
+#define btp5(i, j) (b->tp[(i)*6+(j)][k])
+
+static void
+hmm_batch_eval_5st_lr(struct hmm_batch_s *b, int n)
+{
+    int k;
+
+    for (k = 0; k < n; ++k) {
+        int32 s0 = b->score[0][k] + b->senscr[0][k];
+        int32 s1 = b->score[1][k] + b->senscr[1][k];
+        int32 s2 = b->score[2][k] + b->senscr[2][k];
+        int32 s3 = b->score[3][k] + b->senscr[3][k];
+        int32 s4 = b->score[4][k] + b->senscr[4][k];
+        int32 h0 = b->history[0][k], h1 = b->history[1][k];
+        int32 h2 = b->history[2][k], h3 = b->history[3][k];
+        int32 h4 = b->history[4][k];
+        int32 t0, t1, t2, x, hx, best;
+        int act;
+
+        /* Transitions into non-emitting state 5 */
+        act = s3 BETTER_THAN WORST_SCORE;
+        t1 = s4 + btp5(4, 5);
+        t2 = s3 + btp5(3, 5);
+        x = SEL(t1 BETTER_THAN t2, t1, t2);
+        hx = SEL(t1 BETTER_THAN t2, h4, h3);
+        x = SEL(x WORSE_THAN WORST_SCORE, WORST_SCORE, x);
+        b->score[5][k] = SEL(act, x, b->score[5][k]);
+        b->history[5][k] = SEL(act, hx, b->history[5][k]);
+        best = SEL(act, x, WORST_SCORE);
+
+        /* All transitions into state 4 */
+        act = s2 BETTER_THAN WORST_SCORE;
+        t0 = s4 + btp5(4, 4);
+        t1 = s3 + btp5(3, 4);
+        t2 = s2 + btp5(2, 4);
+        MAX3(t0, t1, t2, h4, h3, h2, x, hx);
+        b->score[4][k] = SEL(act, x, b->score[4][k]);
+        b->history[4][k] = SEL(act, hx, h4);
+        best = SEL(act && x BETTER_THAN best, x, best);
+
+        /* All transitions into state 3 */
+        act = s1 BETTER_THAN WORST_SCORE;
+        t0 = s3 + btp5(3, 3);
+        t1 = s2 + btp5(2, 3);
+        t2 = s1 + btp5(1, 3);
+        MAX3(t0, t1, t2, h3, h2, h1, x, hx);
+        b->score[3][k] = SEL(act, x, b->score[3][k]);
+        b->history[3][k] = SEL(act, hx, h3);
+        best = SEL(act && x BETTER_THAN best, x, best);
+
+        /* All transitions into state 2 (state 0 is always active) */
+        t0 = s2 + btp5(2, 2);
+        t1 = s1 + btp5(1, 2);
+        t2 = s0 + btp5(0, 2);
+        MAX3(t0, t1, t2, h2, h1, h0, x, hx);
+        b->score[2][k] = x;
+        b->history[2][k] = hx;
+        best = SEL(x BETTER_THAN best, x, best);
+
+        /* All transitions into state 1 */
+        t0 = s1 + btp5(1, 1);
+        t1 = s0 + btp5(0, 1);
+        x = SEL(t0 BETTER_THAN t1, t0, t1);
+        hx = SEL(t0 BETTER_THAN t1, h1, h0);
+        x = SEL(x WORSE_THAN WORST_SCORE, WORST_SCORE, x);
+        b->score[1][k] = x;
+        b->history[1][k] = hx;
+        best = SEL(x BETTER_THAN best, x, best);
+
+        /* All transitions into state 0 */
+        x = s0 + btp5(0, 0);
+        x = SEL(x WORSE_THAN WORST_SCORE, WORST_SCORE, x);
+        b->score[0][k] = x;
+        best = SEL(x BETTER_THAN best, x, best);
+
+        b->bestscore[k] = best;
+    }
+}
+
+#define btp3(i, j) (b->tp[(i)*4+(j)][k])
+
+static void
+hmm_batch_eval_3st_lr(struct hmm_batch_s *b, int n)
+{
+    int k;
+
+    for (k = 0; k < n; ++k) {
+        int32 s0 = b->score[0][k] + b->senscr[0][k];
+        int32 s1 = b->score[1][k] + b->senscr[1][k];
+        int32 s2 = b->score[2][k] + b->senscr[2][k];
+        int32 h0 = b->history[0][k], h1 = b->history[1][k];
+        int32 h2 = b->history[2][k];
+        int32 t0, t1, t2, x, hx, best;
+        int act;
+
+        /* Transitions into non-emitting state 3.  As in
+         * hmm_vit_eval_3st_lr(), t2 carries over to state 2 if there
+         * is no skip from state 0. */
+        act = s1 BETTER_THAN WORST_SCORE;
+        t1 = s2 + btp3(2, 3);
+        t2 = SEL(act && btp3(1, 3) BETTER_THAN TMAT_WORST_SCORE,
+                 s1 + btp3(1, 3), INT_MIN);
+        x = SEL(t1 BETTER_THAN t2, t1, t2);
+        hx = SEL(t1 BETTER_THAN t2, h2, h1);
+        x = SEL(x WORSE_THAN WORST_SCORE, WORST_SCORE, x);
+        b->score[HMM_MAX_NSTATE][k] = SEL(act, x, b->score[HMM_MAX_NSTATE][k]);
+        b->history[HMM_MAX_NSTATE][k]
+            = SEL(act, hx, b->history[HMM_MAX_NSTATE][k]);
+        best = SEL(act, x, WORST_SCORE);
+
+        /* All transitions into state 2 (state 0 is always active) */
+        t0 = s2 + btp3(2, 2);
+        t1 = s1 + btp3(1, 2);
+        t2 = SEL(btp3(0, 2) BETTER_THAN TMAT_WORST_SCORE,
+                 s0 + btp3(0, 2), t2);
+        MAX3(t0, t1, t2, h2, h1, h0, x, hx);
+        b->score[2][k] = x;
+        b->history[2][k] = hx;
+        best = SEL(x BETTER_THAN best, x, best);
+
+        /* All transitions into state 1 */
+        t0 = s1 + btp3(1, 1);
+        t1 = s0 + btp3(0, 1);
+        x = SEL(t0 BETTER_THAN t1, t0, t1);
+        hx = SEL(t0 BETTER_THAN t1, h1, h0);
+        x = SEL(x WORSE_THAN WORST_SCORE, WORST_SCORE, x);
+        b->score[1][k] = x;
+        b->history[1][k] = hx;
+        best = SEL(x BETTER_THAN best, x, best);
+
+        /* All transitions into state 0 */
+        x = s0 + btp3(0, 0);
+        x = SEL(x WORSE_THAN WORST_SCORE, WORST_SCORE, x);
+        b->score[0][k] = x;
+        best = SEL(x BETTER_THAN best, x, best);
+
+        b->bestscore[k] = best;
+    }
+}
+
+static int32
+hmm_batch_eval(hmm_context_t *ctx, int n)
+{
+    struct hmm_batch_s *b = ctx->soa;
+
+    hmm_batch_gather(ctx, b, n);
+    if (ctx->n_emit_state == 5)
+        hmm_batch_eval_5st_lr(b, n);
+    else
+        hmm_batch_eval_3st_lr(b, n);
+    return hmm_batch_scatter(ctx, b, n);
+}
+
+int32
+hmm_vit_eval_batch(hmm_context_t *ctx)
+{
+    int32 i, n, score, best;
+    int batchable;
+
+    best = WORST_SCORE;
+    batchable = (ctx->n_emit_state == 5 || ctx->n_emit_state == 3);
+    if (batchable && ctx->soa == NULL)
+        ctx->soa = ckd_calloc(1, sizeof(*ctx->soa));
+    for (i = n = 0; i < ctx->n_batch; ++i) {
+        hmm_t *h = ctx->batch[i];
+
+        if (!batchable || hmm_is_mpx(h)) {
+            score = hmm_vit_eval(h);
+            if (score BETTER_THAN best)
+                best = score;
+            continue;
+        }
+        ctx->soa->hmm[n++] = h;
+        if (n == HMM_BATCH_WIDTH) {
+            score = hmm_batch_eval(ctx, n);
+            if (score BETTER_THAN best)
+                best = score;
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        score = hmm_batch_eval(ctx, n);
+        if (score BETTER_THAN best)
+            best = score;
+    }
+    ctx->n_batch = 0;
+
+    return best;
+}
+
+int32
+hmm_dump_vit_eval_batch(hmm_context_t *ctx, FILE *fp)
+{
+    int32 i, n, bs;
+
+    n = ctx->n_batch;
+    if (fp) {
+        fprintf(fp, "BEFORE:\n");
+        for (i = 0; i < n; ++i)
+            hmm_dump(ctx->batch[i], fp);
+    }
+    bs = hmm_vit_eval_batch(ctx);
+    /* The queue is empty now but its contents are still there. */
+    if (fp) {
+        fprintf(fp, "AFTER:\n");
+        for (i = 0; i < n; ++i)
+            hmm_dump(ctx->batch[i], fp);
+    }
+
+    return bs;
+}
+
+/* Like hmm_compact_decode() but with an explicit base. */
+#define compact_score(s, base) ((s) == HMM_COMPACT_WORST_SCORE \
+                                ? WORST_SCORE : (base) + (s))
+
+static int16
+compact_encode(int32 score, int32 base)
+{
+    /* Anything that far below the base would have been pruned. */
+    if (score == WORST_SCORE || score WORSE_THAN base - 32767)
+        return HMM_COMPACT_WORST_SCORE;
+    /* And nothing should be much above it, but just in case. */
+    if (score - base > 32767)
+        return 32767;
+    return (int16)(score - base);
+}
+
+int16
+hmm_compact_encode(hmm_context_t *ctx, int32 score)
+{
+    return compact_encode(score, ctx->score_base);
+}
+
+void
+hmm_compact_init(hmm_context_t *ctx, hmm_compact_t *h, int ssid, int tmatid)
+{
+    h->ssid = ssid;
+    h->tmatid = tmatid;
+    hmm_compact_clear(h);
+}
+
+void
+hmm_compact_clear_scores(hmm_compact_t *h)
+{
+    int32 i;
+
+    for (i = 0; i < HMM_MAX_NSTATE; i++)
+        h->score[i] = HMM_COMPACT_WORST_SCORE;
+    h->out_score = HMM_COMPACT_WORST_SCORE;
+    h->bestscore = HMM_COMPACT_WORST_SCORE;
+}
+
+void
+hmm_compact_clear(hmm_compact_t *h)
+{
+    int32 i;
+
+    hmm_compact_clear_scores(h);
+    for (i = 0; i < HMM_MAX_NSTATE; i++)
+        h->history[i] = -1;
+    h->out_history = -1;
+    h->frame = -1;
+}
+
+void
+hmm_compact_enter(hmm_context_t *ctx, hmm_compact_t *h,
+                  int32 score, int32 histid, int frame)
+{
+    h->score[0] = hmm_compact_encode(ctx, score);
+    h->history[0] = histid;
+    h->frame = frame;
+}
+
+/*
+ * Copy a compact HMM to a full one, with scores relative to base.
+ */
+static void
+hmm_compact_expand(hmm_context_t *ctx, hmm_compact_t const *c,
+                   hmm_t *h, int32 base)
+{
+    int i;
+
+    h->ctx = ctx;
+    h->mpx = FALSE;
+    h->n_emit_state = ctx->n_emit_state;
+    h->ssid = c->ssid;
+    h->tmatid = c->tmatid;
+    h->frame = c->frame;
+    for (i = 0; i < h->n_emit_state; ++i) {
+        h->senid[i] = ctx->sseq[c->ssid][i];
+        h->score[i] = compact_score(c->score[i], base);
+        h->history[i] = c->history[i];
+    }
+    h->out_score = compact_score(c->out_score, base);
+    h->out_history = c->out_history;
+    h->bestscore = compact_score(c->bestscore, base);
+}
+
+int32
+hmm_compact_vit_eval(hmm_context_t *ctx, hmm_compact_t *c)
+{
+    hmm_t h;
+    int32 i, bs;
+
+    hmm_compact_expand(ctx, c, &h, ctx->prev_score_base);
+    bs = hmm_vit_eval(&h);
+    for (i = 0; i < h.n_emit_state; ++i) {
+        c->score[i] = compact_encode(h.score[i], ctx->score_base);
+        c->history[i] = h.history[i];
+    }
+    c->out_score = compact_encode(h.out_score, ctx->score_base);
+    c->out_history = h.out_history;
+    c->bestscore = compact_encode(bs, ctx->score_base);
+
+    return bs;
+}
+
+static void
+hmm_compact_batch_gather(hmm_context_t *ctx, struct hmm_batch_s *b, int n)
+{
+    int32 base = ctx->prev_score_base;
+    int i, j;
+
+    for (i = 0; i < n; ++i) {
+        hmm_compact_t *h = b->hmm[i];
+        uint16 const *senid = ctx->sseq[h->ssid];
+
+        for (j = 0; j < ctx->n_emit_state; ++j) {
+            b->score[j][i] = compact_score(h->score[j], base);
+            b->history[j][i] = h->history[j];
+            b->senscr[j][i] = -ctx->senscore[senid[j]];
+        }
+        b->score[HMM_MAX_NSTATE][i] = compact_score(h->out_score, base);
+        b->history[HMM_MAX_NSTATE][i] = h->out_history;
+        hmm_batch_gather_tp(ctx, b, i, h->tmatid);
+    }
+}
+
+static int32
+hmm_compact_batch_scatter(hmm_context_t *ctx, struct hmm_batch_s *b, int n)
+{
+    int32 base = ctx->score_base;
+    int32 best;
+    int i, j;
+
+    best = WORST_SCORE;
+    for (i = 0; i < n; ++i) {
+        hmm_compact_t *h = b->hmm[i];
+
+        h->score[0] = compact_encode(b->score[0][i], base);
+        for (j = 1; j < ctx->n_emit_state; ++j) {
+            h->score[j] = compact_encode(b->score[j][i], base);
+            h->history[j] = b->history[j][i];
+        }
+        h->out_score = compact_encode(b->score[HMM_MAX_NSTATE][i], base);
+        h->out_history = b->history[HMM_MAX_NSTATE][i];
+        h->bestscore = compact_encode(b->bestscore[i], base);
+        if (b->bestscore[i] BETTER_THAN best)
+            best = b->bestscore[i];
+    }
+    return best;
+}
+
+static int32
+hmm_compact_batch_eval(hmm_context_t *ctx, int n)
+{
+    struct hmm_batch_s *b = ctx->soa;
+
+    hmm_compact_batch_gather(ctx, b, n);
+    if (ctx->n_emit_state == 5)
+        hmm_batch_eval_5st_lr(b, n);
+    else
+        hmm_batch_eval_3st_lr(b, n);
+    return hmm_compact_batch_scatter(ctx, b, n);
+}
+
+int32
+hmm_compact_vit_eval_batch(hmm_context_t *ctx)
+{
+    int32 i, n, score, best;
+
+    best = WORST_SCORE;
+    if (ctx->n_emit_state != 5 && ctx->n_emit_state != 3) {
+        for (i = 0; i < ctx->n_batch; ++i) {
+            score = hmm_compact_vit_eval(ctx, ctx->batch[i]);
+            if (score BETTER_THAN best)
+                best = score;
+        }
+        ctx->n_batch = 0;
+        return best;
+    }
+
+    if (ctx->soa == NULL)
+        ctx->soa = ckd_calloc(1, sizeof(*ctx->soa));
+    for (i = 0; i < ctx->n_batch; i += n) {
+        n = ctx->n_batch - i;
+        if (n > HMM_BATCH_WIDTH)
+            n = HMM_BATCH_WIDTH;
+        memcpy(ctx->soa->hmm, ctx->batch + i, n * sizeof(*ctx->batch));
+        score = hmm_compact_batch_eval(ctx, n);
+        if (score BETTER_THAN best)
+            best = score;
+    }
+    ctx->n_batch = 0;
+
+    return best;
+}
+
+void
+hmm_compact_dump(hmm_context_t *ctx, hmm_compact_t *c, FILE *fp)
+{
+    hmm_t h;
+
+    hmm_compact_expand(ctx, c, &h, ctx->score_base);
+    hmm_dump(&h, fp);
+}
@@ -149,9 +149,15 @@ typedef struct hmm_context_s {
     int16 const *senscore;  /**< State emission scores senscore[senid]
                                (negated scaled logs3 values). */
     uint16 * const *sseq;   /**< Senone sequence mapping. */
-    int32 *st_sen_scr;      /**< Temporary array of senone scores (for some topologies). */
     listelem_alloc_t *mpx_ssid_alloc; /**< Allocator for senone sequence ID arrays. */
     void *udata;            /**< Whatever you feel like, gosh. */
+    void **batch;           /**< HMMs (hmm_t or hmm_compact_t) queued by
+                               hmm_batch_add(). */
+    int32 n_batch;          /**< Number of HMMs in batch. */
+    int32 n_batch_alloc;    /**< Allocated size of batch. */
+    struct hmm_batch_s *soa; /**< Scratch space for hmm_vit_eval_batch(). */
+    int32 score_base;       /**< Scores in hmm_compact_t are relative to this. */
+    int32 prev_score_base;  /**< Value of score_base in the previous frame. */
 } hmm_context_t;
 
 /**
@@ -159,6 +165,14 @@ typedef struct hmm_context_s {
  */
 #define HMM_MAX_NSTATE 5
 
+/**
+ * Number of HMMs evaluated side by side by hmm_vit_eval_batch().
+ *
+ * Scores are 32 bits, so this is one AVX-512 or two AVX2 registers
+ * per state.
+ */
+#define HMM_BATCH_WIDTH 16
+
 /**
  * @struct hmm_t
  * @brief An individual HMM among the HMM search space.
@@ -213,6 +227,64 @@ typedef struct hmm_s {
 #define hmm_n_emit_state(h) ((h)->n_emit_state)
 #define hmm_n_state(h) ((h)->n_emit_state + 1)
 
+/**
+ * Score stored in an hmm_compact_t for WORST_SCORE and anything
+ * too far below hmm_context_t::score_base.
+ */
+#define HMM_COMPACT_WORST_SCORE ((int16)-32768)
+
+/**
+ * @struct hmm_compact_t
+ * @brief Smaller version of hmm_t for large, non-multiplex HMM sets.
+ *
+ * This holds the same state as a non-multiplex hmm_t in 48 bytes
+ * instead of 80.  The context is not stored, so it has to be passed
+ * to all functions, scores are 16-bit offsets from
+ * hmm_context_t::score_base, and senone IDs are looked up in the
+ * context's senone sequences rather than copied.
+ *
+ * Because of the relative scores, searches using these have to call
+ * hmm_context_set_base() once per frame before evaluating, and all
+ * active HMMs have to be evaluated in every frame (inactive ones are
+ * cleared, so they do not care).  A score more than 32767 below the
+ * base is treated as WORST_SCORE, which is far wider than any sensible
+ * beam, since scores are shifted by SENSCR_SHIFT.
+ *
+ * Only FSG search uses these for now.  The N-Gram lexicon tree keeps
+ * hmm_t, since its root channels are multiplex HMMs, and chan_t and
+ * root_chan_t have to share the same HMM structure as they are used
+ * interchangeably there and in the fwdflat search.
+ */
+typedef struct hmm_compact_s {
+    int32 history[HMM_MAX_NSTATE]; /**< History indices for emitting states. */
+    int32 out_history;             /**< History index for non-emitting exit state. */
+    frame_idx_t frame;  /**< Frame in which this HMM was last active; <0 if inactive */
+    int16 score[HMM_MAX_NSTATE];   /**< State scores relative to score_base. */
+    int16 out_score;    /**< Exit state score relative to score_base. */
+    int16 bestscore;    /**< Best state score relative to score_base. */
+    uint16 ssid;        /**< Senone sequence ID. */
+    int16 tmatid;       /**< Transition matrix ID (see hmm_context_t). */
+} hmm_compact_t;
+
+/** Convert a score to and from hmm_compact_t representation. */
+#define hmm_compact_decode(ctx,s) ((s) == HMM_COMPACT_WORST_SCORE      \
+                                   ? WORST_SCORE                        \
+                                   : (ctx)->score_base + (s))
+int16 hmm_compact_encode(hmm_context_t *ctx, int32 score);
+
+/** Access macros for hmm_compact_t, giving absolute scores. */
+#define hmm_compact_in_score(ctx,h) hmm_compact_decode(ctx, (h)->score[0])
+#define hmm_compact_score(ctx,h,st) hmm_compact_decode(ctx, (h)->score[st])
+#define hmm_compact_out_score(ctx,h) hmm_compact_decode(ctx, (h)->out_score)
+#define hmm_compact_bestscore(ctx,h) hmm_compact_decode(ctx, (h)->bestscore)
+#define hmm_compact_in_history(h) (h)->history[0]
+#define hmm_compact_history(h,st) (h)->history[st]
+#define hmm_compact_out_history(h) (h)->out_history
+#define hmm_compact_frame(h) (h)->frame
+#define hmm_compact_ssid(h) (h)->ssid
+#define hmm_compact_tmatid(h) (h)->tmatid
+#define hmm_compact_senid(ctx,h,st) ((ctx)->sseq[(h)->ssid][st])
+
 /**
  * Create an HMM context.
  **/
@@ -226,6 +298,17 @@ hmm_context_t *hmm_context_init(int32 n_emit_state,
  **/
 #define hmm_context_set_senscore(ctx, senscr) ((ctx)->senscore = (senscr))
 
+/**
+ * Start a new frame for compact HMMs.
+ *
+ * HMMs evaluated from now on will be read relative to the previous
+ * base and stored relative to this one, which should be close to
+ * the best score, e.g. that of the previous frame.
+ */
+#define hmm_context_set_base(ctx, base)                 \
+    ((ctx)->prev_score_base = (ctx)->score_base,        \
+     (ctx)->score_base = (base))
+
 /**
  * Free an HMM context.
  *
@@ -281,6 +364,81 @@ void hmm_enter(hmm_t *h, int32 score,
  * well.
 */
 int32 hmm_vit_eval(hmm_t *hmm);
+
+/**
+ * Queue an HMM for evaluation by hmm_vit_eval_batch() (or an
+ * hmm_compact_t for hmm_compact_vit_eval_batch(), but not both at
+ * once).
+ */
+#define hmm_batch_add(ctx, h)                                   \
+    (((ctx)->n_batch == (ctx)->n_batch_alloc                    \
+      ? hmm_batch_grow(ctx) : (void)0),                         \
+     (ctx)->batch[(ctx)->n_batch++] = (h))
+
+/**
+ * Make room for more HMMs in the batch (used by hmm_batch_add()).
+ */
+void hmm_batch_grow(hmm_context_t *ctx);
+
+/**
+ * Viterbi evaluation of all HMMs queued with hmm_batch_add().
+ *
+ * This gives exactly the same results as calling hmm_vit_eval() on
+ * each of them in turn, including hmm_bestscore(), but non-multiplex
+ * 3- and 5-state left-to-right HMMs are copied in blocks of
+ * HMM_BATCH_WIDTH into a structure of arrays and evaluated together,
+ * in branch-free loops which the compiler can vectorize.  Other HMMs
+ * fall back to hmm_vit_eval().  The queue is emptied afterwards.
+ *
+ * @return best score of all HMMs in the batch, or WORST_SCORE if empty.
+ */
+int32 hmm_vit_eval_batch(hmm_context_t *ctx);
+
+/**
+ * Like hmm_vit_eval_batch, but dump the HMMs before and after, for debugging.
+ */
+int32 hmm_dump_vit_eval_batch(hmm_context_t *ctx, FILE *fp);
+
+/**
+ * Populate a compact HMM.
+ */
+void hmm_compact_init(hmm_context_t *ctx, hmm_compact_t *h, int ssid, int tmatid);
+
+/**
+ * Reset the states of a compact HMM to the invalid condition.
+ */
+void hmm_compact_clear(hmm_compact_t *h);
+
+/**
+ * Reset the scores of a compact HMM.
+ */
+void hmm_compact_clear_scores(hmm_compact_t *h);
+
+/**
+ * Enter a compact HMM with the given path score and history ID.
+ */
+void hmm_compact_enter(hmm_context_t *ctx, hmm_compact_t *h,
+                       int32 score, int32 histid, int frame);
+
+/**
+ * Viterbi evaluation of a compact HMM, moving its scores from the
+ * previous base to the current one.
+ *
+ * @return best state score.
+ */
+int32 hmm_compact_vit_eval(hmm_context_t *ctx, hmm_compact_t *h);
+
+/**
+ * Viterbi evaluation of all compact HMMs queued with hmm_batch_add().
+ *
+ * @return best score of all HMMs in the batch, or WORST_SCORE if empty.
+ */
+int32 hmm_compact_vit_eval_batch(hmm_context_t *ctx);
+
+/**
+ * For debugging, dump a compact HMM out.
+ */
+void hmm_compact_dump(hmm_context_t *ctx, hmm_compact_t *h, FILE *fp);
   
 
 /**
@@ -0,0 +1,557 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file kdtree.c Gaussian selection with kd-trees (BBI).
+ */
+
+/* System headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+#include <sphinxbase/bio.h>
+#include <sphinxbase/logmath.h>
+
+/* Local headers. */
+#include "kdtree.h"
+
+/** Number of int32 values in the file header. */
+#define KDTREE_HDR_SIZE 7
+
+/** Size of everything after the header. */
+#define KDTREE_DATA_SIZE(kd)                                   \
+    ((size_t)(kd)->n_feat * 4                                   \
+     + (size_t)(kd)->n_mgau * (kd)->n_feat * 4                  \
+     + (size_t)(kd)->n_node * sizeof(kd_node_t)                 \
+     + (size_t)(kd)->n_cw * sizeof(uint16))
+
+/**
+ * Convert a precomputed variance term to floating point.  Under
+ * FIXED_POINT the means are fixed-point MFCC values, but
+ * gauden_dist_precompute() stores the variance terms as plain
+ * integers in log units (compute_dist() scales them back with
+ * MFCCMUL()), so they must not go through MFCC2FLOAT().
+ */
+#ifdef FIXED_POINT
+#define VAR2FLOAT(x) ((float64)(int32)(x))
+#else
+#define VAR2FLOAT(x) ((float64)(x))
+#endif
+
+kdtree_t *
+kdtree_read(cmd_ln_t *config, char const *file)
+{
+    kdtree_t *kd;
+    FILE *fh;
+    int32 hdr[KDTREE_HDR_SIZE];
+    int32 i, swap, do_mmap;
+    size_t size;
+    long pos, end;
+    char *ptr;
+
+    E_INFO("Reading kd-trees: %s\n", file);
+    if ((fh = fopen(file, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open kd-tree file '%s' for reading", file);
+        return NULL;
+    }
+    if (fread(hdr, 4, KDTREE_HDR_SIZE, fh) != KDTREE_HDR_SIZE) {
+        E_ERROR_SYSTEM("Failed to read header from %s", file);
+        fclose(fh);
+        return NULL;
+    }
+    swap = 0;
+    if (hdr[0] == KDTREE_OTHER_ENDIAN) {
+        swap = 1;
+        E_INFO("Must byte-swap %s\n", file);
+    }
+    else if (hdr[0] != KDTREE_NATIVE_ENDIAN) {
+        E_ERROR("%s is not a kd-tree file\n", file);
+        fclose(fh);
+        return NULL;
+    }
+    if (swap) {
+        for (i = 1; i < KDTREE_HDR_SIZE; ++i)
+            SWAP_INT32(hdr + i);
+    }
+    if (hdr[1] > KDTREE_FORMAT_VERSION) {
+        E_ERROR("File format version %d for %s is newer than library\n",
+                hdr[1], file);
+        fclose(fh);
+        return NULL;
+    }
+
+    kd = ckd_calloc(1, sizeof(*kd));
+    kd->n_mgau = hdr[2];
+    kd->n_feat = hdr[3];
+    kd->n_density = hdr[4];
+    kd->n_node = hdr[5];
+    kd->n_cw = hdr[6];
+    size = KDTREE_DATA_SIZE(kd);
+    pos = ftell(fh);
+    fseek(fh, 0, SEEK_END);
+    end = ftell(fh);
+    if (end - pos < (long)size) {
+        E_ERROR("%s is truncated: expected %ld bytes of data, got %ld\n",
+                file, (long)size, end - pos);
+        goto error_out;
+    }
+
+    /* Decide whether to read in the whole file or mmap it. */
+    do_mmap = config ? cmd_ln_boolean_r(config, "-mmap") : TRUE;
+    if (swap && do_mmap) {
+        E_WARN("-mmap specified, but kd-tree file is other-endian.  Will not memory-map.\n");
+        do_mmap = FALSE;
+    }
+    if (do_mmap) {
+        kd->filemap = mmio_file_read(file);
+        if (kd->filemap == NULL)
+            do_mmap = FALSE;
+    }
+    if (do_mmap) {
+        ptr = (char *)mmio_file_ptr(kd->filemap) + pos;
+    }
+    else {
+        fseek(fh, pos, SEEK_SET);
+        ptr = kd->data = ckd_malloc(size);
+        if (fread(kd->data, 1, size, fh) != size) {
+            E_ERROR_SYSTEM("Failed to read %ld bytes of data from %s",
+                           (long)size, file);
+            goto error_out;
+        }
+    }
+    fclose(fh);
+    fh = NULL;
+
+    kd->featlen = (int32 *)ptr;
+    ptr += kd->n_feat * 4;
+    kd->root = (int32 *)ptr;
+    ptr += kd->n_mgau * kd->n_feat * 4;
+    kd->node = (kd_node_t *)ptr;
+    ptr += kd->n_node * sizeof(kd_node_t);
+    kd->bucket = (uint16 *)ptr;
+
+    if (swap) {
+        for (i = 0; i < kd->n_feat; ++i)
+            SWAP_INT32(kd->featlen + i);
+        for (i = 0; i < kd->n_mgau * kd->n_feat; ++i)
+            SWAP_INT32(kd->root + i);
+        for (i = 0; i < kd->n_node; ++i) {
+            SWAP_INT32(&kd->node[i].split_dim);
+            SWAP_FLOAT32(&kd->node[i].split);
+            SWAP_INT32(&kd->node[i].left);
+            SWAP_INT32(&kd->node[i].right);
+        }
+        for (i = 0; i < kd->n_cw; ++i)
+            SWAP_INT16(kd->bucket + i);
+    }
+
+    /* Make sure that a corrupt file can't send us off into the weeds. */
+    for (i = 0; i < kd->n_mgau * kd->n_feat; ++i) {
+        if (kd->root[i] < 0 || kd->root[i] >= kd->n_node) {
+            E_ERROR("Root node %d out of range in %s\n", kd->root[i], file);
+            goto error_out;
+        }
+    }
+    for (i = 0; i < kd->n_node; ++i) {
+        kd_node_t *node = kd->node + i;
+        if (node->split_dim < 0) {
+            if (node->left < 0 || node->right < 0
+                || node->left + node->right > kd->n_cw) {
+                E_ERROR("Bucket for node %d out of range in %s\n", i, file);
+                goto error_out;
+            }
+        }
+        else if (node->left <= i || node->left >= kd->n_node
+                 || node->right <= i || node->right >= kd->n_node) {
+            E_ERROR("Children of node %d out of range in %s\n", i, file);
+            goto error_out;
+        }
+    }
+    for (i = 0; i < kd->n_cw; ++i) {
+        if (kd->bucket[i] >= kd->n_density) {
+            E_ERROR("Codeword %d out of range in %s\n", kd->bucket[i], file);
+            goto error_out;
+        }
+    }
+
+    E_INFO("%d kd-trees, %d nodes, %d codewords in buckets\n",
+           kd->n_mgau * kd->n_feat, kd->n_node, kd->n_cw);
+    return kd;
+
+error_out:
+    if (fh)
+        fclose(fh);
+    kdtree_free(kd);
+    return NULL;
+}
+
+int
+kdtree_check(kdtree_t *kd, gauden_t *g)
+{
+    int i;
+
+    if (kd->n_mgau != g->n_mgau || kd->n_feat != g->n_feat
+        || kd->n_density != g->n_density) {
+        E_ERROR("kd-tree dimensions %dx%dx%d do not match Gaussians %dx%dx%d\n",
+                kd->n_mgau, kd->n_feat, kd->n_density,
+                g->n_mgau, g->n_feat, g->n_density);
+        return -1;
+    }
+    for (i = 0; i < kd->n_feat; ++i) {
+        if (kd->featlen[i] != g->featlen[i]) {
+            E_ERROR("kd-tree feature %d length %d does not match Gaussians: %d\n",
+                    i, kd->featlen[i], g->featlen[i]);
+            return -1;
+        }
+    }
+    /* Check split dimensions against the feature stream lengths. */
+    for (i = 0; i < kd->n_mgau * kd->n_feat; ++i) {
+        int32 featlen = kd->featlen[i % kd->n_feat];
+        int32 *stack, n_stack;
+
+        stack = ckd_calloc(kd->n_node, sizeof(*stack));
+        n_stack = 0;
+        stack[n_stack++] = kd->root[i];
+        while (n_stack > 0) {
+            kd_node_t *node = kd->node + stack[--n_stack];
+            if (node->split_dim < 0)
+                continue;
+            if (node->split_dim >= featlen || n_stack + 2 > kd->n_node) {
+                E_ERROR("kd-tree %d is malformed\n", i);
+                ckd_free(stack);
+                return -1;
+            }
+            stack[n_stack++] = node->left;
+            stack[n_stack++] = node->right;
+        }
+        ckd_free(stack);
+    }
+    return 0;
+}
+
+void
+kdtree_free(kdtree_t *kd)
+{
+    if (kd == NULL)
+        return;
+    if (kd->filemap)
+        mmio_file_unmap(kd->filemap);
+    else if (kd->data)
+        ckd_free(kd->data);
+    else {
+        /* Built in memory by kdtree_build(). */
+        ckd_free(kd->featlen);
+        ckd_free(kd->root);
+        ckd_free(kd->node);
+        ckd_free(kd->bucket);
+    }
+    ckd_free(kd);
+}
+
+int32
+kdtree_query(kdtree_t *kd, int mgau, int feat,
+             mfcc_t const *obs, uint16 const **out_cw)
+{
+    kd_node_t *node;
+
+    node = kd->node + kd->root[mgau * kd->n_feat + feat];
+    while (node->split_dim >= 0) {
+        if (MFCC2FLOAT(obs[node->split_dim]) < node->split)
+            node = kd->node + node->left;
+        else
+            node = kd->node + node->right;
+    }
+    *out_cw = kd->bucket + node->left;
+    return node->right;
+}
+
+/**
+ * State for building one set of trees.
+ */
+typedef struct kd_build_s {
+    kdtree_t *kd;
+    int32 n_node_alloc;
+    int32 n_cw_alloc;
+    int32 featlen;
+    int32 max_depth;
+    int32 max_bucket;
+    float32 **lo;      /**< Lower edge of each Gaussian's box. */
+    float32 **hi;      /**< Upper edge of each Gaussian's box. */
+    float32 *reg_lo;   /**< Lower edge of the current region. */
+    float32 *reg_hi;   /**< Upper edge of the current region. */
+    float32 *tmp;      /**< Scratch space for finding medians. */
+} kd_build_t;
+
+static int32
+kd_new_node(kd_build_t *b)
+{
+    kdtree_t *kd = b->kd;
+
+    if (kd->n_node == b->n_node_alloc) {
+        b->n_node_alloc += 256;
+        kd->node = ckd_realloc(kd->node,
+                               b->n_node_alloc * sizeof(*kd->node));
+    }
+    return kd->n_node++;
+}
+
+static void
+kd_make_leaf(kd_build_t *b, int32 idx, int32 *cand, int32 n_cand)
+{
+    kdtree_t *kd = b->kd;
+    int32 i;
+
+    if (kd->n_cw + n_cand > b->n_cw_alloc) {
+        b->n_cw_alloc = kd->n_cw + n_cand + 1024;
+        kd->bucket = ckd_realloc(kd->bucket,
+                                 b->n_cw_alloc * sizeof(*kd->bucket));
+    }
+    kd->node[idx].split_dim = -1;
+    kd->node[idx].split = 0;
+    kd->node[idx].left = kd->n_cw;
+    kd->node[idx].right = n_cand;
+    for (i = 0; i < n_cand; ++i)
+        kd->bucket[kd->n_cw++] = (uint16)cand[i];
+}
+
+static int
+cmp_float32(void const *a, void const *b)
+{
+    float32 x = *(float32 const *)a, y = *(float32 const *)b;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/**
+ * Choose a split for a node, minimizing the size of the larger
+ * child's bucket.
+ *
+ * @return the larger child's bucket size, or n_cand if no split helps.
+ */
+static int32
+kd_choose_split(kd_build_t *b, int32 *cand, int32 n_cand,
+                int32 *out_dim, float32 *out_split)
+{
+    int32 i, k, best;
+
+    *out_dim = 0;
+    *out_split = 0;
+    best = n_cand;
+    for (k = 0; k < b->featlen; ++k) {
+        float32 split;
+        int32 n_left, n_right, cost;
+
+        /* Try the median of the box centers in this dimension. */
+        for (i = 0; i < n_cand; ++i)
+            b->tmp[i] = (b->lo[cand[i]][k] + b->hi[cand[i]][k]) / 2;
+        qsort(b->tmp, n_cand, sizeof(*b->tmp), cmp_float32);
+        split = b->tmp[n_cand / 2];
+        /* It has to actually divide the current region. */
+        if (split <= b->reg_lo[k] || split >= b->reg_hi[k])
+            continue;
+        n_left = n_right = 0;
+        for (i = 0; i < n_cand; ++i) {
+            if (b->lo[cand[i]][k] < split)
+                ++n_left;
+            if (b->hi[cand[i]][k] >= split)
+                ++n_right;
+        }
+        /* Never create an empty bucket. */
+        if (n_left == 0 || n_right == 0)
+            continue;
+        cost = n_left > n_right ? n_left : n_right;
+        if (cost < best) {
+            best = cost;
+            *out_dim = k;
+            *out_split = split;
+        }
+    }
+    return best;
+}
+
+static int32
+kd_build_node(kd_build_t *b, int32 *cand, int32 n_cand, int32 depth)
+{
+    int32 idx, dim, i, n_sub, left, right;
+    int32 *sub;
+    float32 split, saved;
+
+    idx = kd_new_node(b);
+    if (depth >= b->max_depth || n_cand <= b->max_bucket
+        || kd_choose_split(b, cand, n_cand, &dim, &split) >= n_cand) {
+        kd_make_leaf(b, idx, cand, n_cand);
+        return idx;
+    }
+
+    sub = ckd_calloc(n_cand, sizeof(*sub));
+    /* Left child: everything whose box extends below the split. */
+    for (n_sub = i = 0; i < n_cand; ++i)
+        if (b->lo[cand[i]][dim] < split)
+            sub[n_sub++] = cand[i];
+    saved = b->reg_hi[dim];
+    b->reg_hi[dim] = split;
+    left = kd_build_node(b, sub, n_sub, depth + 1);
+    b->reg_hi[dim] = saved;
+    /* Right child: everything whose box extends above it. */
+    for (n_sub = i = 0; i < n_cand; ++i)
+        if (b->hi[cand[i]][dim] >= split)
+            sub[n_sub++] = cand[i];
+    saved = b->reg_lo[dim];
+    b->reg_lo[dim] = split;
+    right = kd_build_node(b, sub, n_sub, depth + 1);
+    b->reg_lo[dim] = saved;
+    ckd_free(sub);
+
+    b->kd->node[idx].split_dim = dim;
+    b->kd->node[idx].split = split;
+    b->kd->node[idx].left = left;
+    b->kd->node[idx].right = right;
+    return idx;
+}
+
+kdtree_t *
+kdtree_build(gauden_t *g, float32 threshold,
+             int32 max_depth, int32 max_bucket)
+{
+    kd_build_t b;
+    kdtree_t *kd;
+    int32 *cand;
+    float64 ln_base;
+    int32 m, f, d, i;
+
+    if (g->n_density > 65536) {
+        E_ERROR("Too many densities for kd-trees: %d\n", g->n_density);
+        return NULL;
+    }
+    kd = ckd_calloc(1, sizeof(*kd));
+    kd->n_mgau = g->n_mgau;
+    kd->n_feat = g->n_feat;
+    kd->n_density = g->n_density;
+    kd->featlen = ckd_calloc(g->n_feat, sizeof(*kd->featlen));
+    memcpy(kd->featlen, g->featlen, g->n_feat * sizeof(*kd->featlen));
+    kd->root = ckd_calloc(g->n_mgau * g->n_feat, sizeof(*kd->root));
+
+    memset(&b, 0, sizeof(b));
+    b.kd = kd;
+    b.max_depth = max_depth;
+    b.max_bucket = max_bucket;
+    b.tmp = ckd_calloc(g->n_density, sizeof(*b.tmp));
+    cand = ckd_calloc(g->n_density, sizeof(*cand));
+    for (d = 0; d < g->n_density; ++d)
+        cand[d] = d;
+
+    /* The precomputed variances are 1/(2*var) in log units. */
+    ln_base = log(logmath_get_base(g->lmath));
+    for (m = 0; m < g->n_mgau; ++m) {
+        for (f = 0; f < g->n_feat; ++f) {
+            b.featlen = g->featlen[f];
+            b.lo = (float32 **)ckd_calloc_2d(g->n_density, b.featlen,
+                                             sizeof(**b.lo));
+            b.hi = (float32 **)ckd_calloc_2d(g->n_density, b.featlen,
+                                             sizeof(**b.hi));
+            b.reg_lo = ckd_calloc(b.featlen, sizeof(*b.reg_lo));
+            b.reg_hi = ckd_calloc(b.featlen, sizeof(*b.reg_hi));
+            for (i = 0; i < b.featlen; ++i) {
+                b.reg_lo[i] = -FLT_MAX;
+                b.reg_hi[i] = FLT_MAX;
+            }
+            for (d = 0; d < g->n_density; ++d) {
+                for (i = 0; i < b.featlen; ++i) {
+                    float64 mean = MFCC2FLOAT(g->mean[m][f][d][i]);
+                    float64 var = VAR2FLOAT(g->var[m][f][d][i]);
+
+                    if (var > 0) {
+                        float64 sd = sqrt(1.0 / (2.0 * var * ln_base));
+                        b.lo[d][i] = (float32)(mean - threshold * sd);
+                        b.hi[d][i] = (float32)(mean + threshold * sd);
+                    }
+                    else {
+                        b.lo[d][i] = -FLT_MAX;
+                        b.hi[d][i] = FLT_MAX;
+                    }
+                }
+            }
+            kd->root[m * g->n_feat + f] =
+                kd_build_node(&b, cand, g->n_density, 0);
+            ckd_free_2d(b.lo);
+            ckd_free_2d(b.hi);
+            ckd_free(b.reg_lo);
+            ckd_free(b.reg_hi);
+        }
+    }
+    ckd_free(cand);
+    ckd_free(b.tmp);
+
+    E_INFO("Built %d kd-trees, %d nodes, %d codewords in buckets\n",
+           kd->n_mgau * kd->n_feat, kd->n_node, kd->n_cw);
+    return kd;
+}
+
+int
+kdtree_write(kdtree_t *kd, char const *file)
+{
+    FILE *fh;
+    int32 hdr[KDTREE_HDR_SIZE];
+
+    if ((fh = fopen(file, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open kd-tree file '%s' for writing", file);
+        return -1;
+    }
+    hdr[0] = KDTREE_NATIVE_ENDIAN;
+    hdr[1] = KDTREE_FORMAT_VERSION;
+    hdr[2] = kd->n_mgau;
+    hdr[3] = kd->n_feat;
+    hdr[4] = kd->n_density;
+    hdr[5] = kd->n_node;
+    hdr[6] = kd->n_cw;
+    if (fwrite(hdr, 4, KDTREE_HDR_SIZE, fh) != KDTREE_HDR_SIZE
+        || fwrite(kd->featlen, 4, kd->n_feat, fh) != (size_t)kd->n_feat
+        || fwrite(kd->root, 4, kd->n_mgau * kd->n_feat, fh)
+        != (size_t)(kd->n_mgau * kd->n_feat)
+        || fwrite(kd->node, sizeof(*kd->node), kd->n_node, fh)
+        != (size_t)kd->n_node
+        || fwrite(kd->bucket, sizeof(*kd->bucket), kd->n_cw, fh)
+        != (size_t)kd->n_cw) {
+        E_ERROR_SYSTEM("Failed to write kd-trees to %s", file);
+        fclose(fh);
+        return -1;
+    }
+    fclose(fh);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file kdtree.h Gaussian selection with kd-trees (BBI).
+ *
+ * This implements "bucket box intersection" Gaussian selection for
+ * the tied-mixture models.  Each Gaussian is approximated by a box
+ * around its mean, some number of standard deviations wide, and the
+ * feature space for each codebook and feature stream is cut up by a
+ * kd-tree, whose leaves contain the list of Gaussians whose boxes
+ * intersect that leaf's region.  At run time only the Gaussians in
+ * the bucket for the observation need to be evaluated.
+ *
+ * The trees are built offline (see pocketsphinx_kdtree) and stored in
+ * a binary file which is memory-mapped when possible.
+ */
+
+#ifndef __KDTREE_H__
+#define __KDTREE_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/mmio.h>
+
+/* Local headers. */
+#include "ms_gauden.h"
+
+#define KDTREE_FORMAT_VERSION 1
+/* Little-endian machines will write "KDTR" to disk, big-endian ones "RTDK". */
+#define KDTREE_NATIVE_ENDIAN 0x5254444b /* 'KDTR' in little-endian order */
+#define KDTREE_OTHER_ENDIAN 0x4b445452  /* 'KDTR' in big-endian order */
+
+/**
+ * Node in a kd-tree (on-disk, 16 bytes).
+ */
+typedef struct kd_node_s {
+    int32 split_dim; /**< Dimension to split on, or -1 for a leaf. */
+    float32 split;   /**< Split value (left child is below it). */
+    int32 left;      /**< Left child, or start of bucket for a leaf. */
+    int32 right;     /**< Right child, or size of bucket for a leaf. */
+} kd_node_t;
+
+/**
+ * Set of kd-trees, one per codebook and feature stream.
+ */
+typedef struct kdtree_s kdtree_t;
+struct kdtree_s {
+    int32 n_mgau;      /**< Number of codebooks. */
+    int32 n_feat;      /**< Number of feature streams. */
+    int32 n_density;   /**< Number of densities in each codebook. */
+    int32 n_node;      /**< Total number of nodes. */
+    int32 n_cw;        /**< Total number of codewords in all buckets. */
+    int32 *featlen;    /**< Length of each feature stream. */
+    int32 *root;       /**< Root node for each codebook and feature. */
+    kd_node_t *node;   /**< All nodes. */
+    uint16 *bucket;    /**< Codewords for all leaves. */
+
+    mmio_file_t *filemap; /**< Memory map for file (or NULL if not mmap). */
+    void *data;        /**< In-memory copy of file (or NULL if mmap). */
+};
+
+/**
+ * Read a set of kd-trees from a file.
+ *
+ * @param config Configuration (used for -mmap), or NULL.
+ * @return newly allocated kd-trees, or NULL on failure.
+ */
+kdtree_t *kdtree_read(cmd_ln_t *config, char const *file);
+
+/**
+ * Check that a set of kd-trees matches a set of Gaussians.
+ *
+ * @return 0 if they match, <0 otherwise.
+ */
+int kdtree_check(kdtree_t *kd, gauden_t *g);
+
+/**
+ * Build kd-trees for a set of Gaussians.
+ *
+ * @param g Gaussians to build trees for.
+ * @param threshold Half-width of the box around each Gaussian, in
+ *                  standard deviations.
+ * @param max_depth Maximum depth of each tree.
+ * @param max_bucket Stop splitting nodes with this many Gaussians.
+ * @return newly allocated kd-trees, or NULL on failure.
+ */
+kdtree_t *kdtree_build(gauden_t *g, float32 threshold,
+                       int32 max_depth, int32 max_bucket);
+
+/**
+ * Write a set of kd-trees to a file.
+ *
+ * @return 0 for success, <0 on failure.
+ */
+int kdtree_write(kdtree_t *kd, char const *file);
+
+/**
+ * Release a set of kd-trees.
+ */
+void kdtree_free(kdtree_t *kd);
+
+/**
+ * Find the candidate Gaussians for an observation.
+ *
+ * @param mgau Codebook index.
+ * @param feat Feature stream index.
+ * @param obs Observation vector for this feature stream.
+ * @param out_cw Output: pointer to the list of candidate codewords.
+ * @return Number of candidate codewords.
+ */
+int32 kdtree_query(kdtree_t *kd, int mgau, int feat,
+                   mfcc_t const *obs, uint16 const **out_cw);
+
+#endif /* __KDTREE_H__ */
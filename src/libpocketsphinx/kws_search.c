@@ -48,6 +48,7 @@
 
 #include "pocketsphinx_internal.h"
 #include "kws_search.h"
+#include "ps_histprune.h"
 
 /** Access macros */
 #define hmm_is_active(hmm) ((hmm)->frame > 0)
@@ -139,6 +140,8 @@ kws_search_seg_iter(ps_search_t * search)
     return (ps_seg_t *)itor;
 }
 
+static void kws_search_sen_active(ps_search_t *search, int frame_idx);
+
 static ps_searchfuncs_t kws_funcs = {
     /* start: */ kws_search_start,
     /* step: */ kws_search_step,
@@ -149,13 +152,15 @@ static ps_searchfuncs_t kws_funcs = {
     /* hyp: */ kws_search_hyp,
     /* prob: */ kws_search_prob,
     /* seg_iter: */ kws_search_seg_iter,
+    /* sen_active: */ kws_search_sen_active,
 };
 
 
 /* Activate senones for scoring */
 static void
-kws_search_sen_active(kws_search_t * kwss)
+kws_search_sen_active(ps_search_t *search, int frame_idx)
 {
+    kws_search_t *kwss = (kws_search_t *)search;
     int i;
     gnode_t *gn;
 
@@ -184,33 +189,24 @@ kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
 {
     int32 i;
     gnode_t *gn;
-    int32 bestscore = WORST_SCORE;
+    int32 bestscore;
 
     hmm_context_set_senscore(kwss->hmmctx, senscr);
 
     /* evaluate hmms from phone loop */
-    for (i = 0; i < kwss->n_pl; ++i) {
-        hmm_t *hmm = &kwss->pl_hmms[i];
-        int32 score;
-
-        score = hmm_vit_eval(hmm);
-        if (score BETTER_THAN bestscore)
-            bestscore = score;
-    }
+    for (i = 0; i < kwss->n_pl; ++i)
+        hmm_batch_add(kwss->hmmctx, &kwss->pl_hmms[i]);
     /* evaluate hmms for active nodes */
     for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
         kws_keyphrase_t *keyphrase = gnode_ptr(gn);
         for (i = 0; i < keyphrase->n_hmms; i++) {
             hmm_t *hmm = kws_nth_hmm(keyphrase, i);
 
-            if (hmm_is_active(hmm)) {
-                int32 score;
-                score = hmm_vit_eval(hmm);
-                if (score BETTER_THAN bestscore)
-                    bestscore = score;
-            }
+            if (hmm_is_active(hmm))
+                hmm_batch_add(kwss->hmmctx, hmm);
         }
     }
+    bestscore = hmm_vit_eval_batch(kwss->hmmctx);
 
     kwss->bestscore = bestscore;
 }
@@ -226,6 +222,32 @@ kws_search_hmm_prune(kws_search_t * kwss)
     gnode_t *gn;
 
     thresh = kwss->bestscore + kwss->beam;
+    if (kwss->maxhmmpf != -1) {
+        int32 n_active = 0;
+
+        for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
+            kws_keyphrase_t *keyphrase = gnode_ptr(gn);
+            for (i = 0; i < keyphrase->n_hmms; i++)
+                if (hmm_is_active(kws_nth_hmm(keyphrase, i)))
+                    ++n_active;
+        }
+        /* Narrow the beam if too many keyphrase HMMs are active. */
+        if (n_active > kwss->maxhmmpf) {
+            ps_histprune_t hist;
+
+            ps_histprune_reset(&hist, kwss->bestscore, kwss->beam);
+            for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
+                kws_keyphrase_t *keyphrase = gnode_ptr(gn);
+                for (i = 0; i < keyphrase->n_hmms; i++) {
+                    hmm_t *hmm = kws_nth_hmm(keyphrase, i);
+                    if (hmm_is_active(hmm))
+                        ps_histprune_add(&hist, hmm_bestscore(hmm));
+                }
+            }
+            thresh = kwss->bestscore
+                + ps_histprune_beam(&hist, kwss->maxhmmpf, kwss->beam);
+        }
+    }
 
     for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
         kws_keyphrase_t *keyphrase = gnode_ptr(gn);
@@ -388,6 +410,8 @@ kws_search_init(const char *name,
                             cmd_ln_float64_r(config,
                                              "-beam")) >> SENSCR_SHIFT;
 
+    kwss->maxhmmpf = cmd_ln_int32_r(config, "-maxhmmpf");
+
     kwss->plp =
         (int32) logmath_log(acmod->lmath,
                             cmd_ln_float32_r(config,
@@ -617,7 +641,7 @@ kws_search_step(ps_search_t * search, int frame_idx)
 
     /* Activate senones */
     if (!acmod->compallsen)
-        kws_search_sen_active(kwss);
+        kws_search_sen_active(search, frame_idx);
 
     /* Calculate senone scores for current frame. */
     senscr = acmod_score(acmod, &frame_idx);
@@ -78,6 +78,7 @@ typedef struct kws_search_s {
     frame_idx_t frame;            /**< Frame index */
 
     int32 beam;
+    int32 maxhmmpf;               /**< Maximum number of active keyphrase HMMs */
 
     int32 plp;                    /**< Phone loop probability */
     int32 bestscore;              /**< For beam pruning */
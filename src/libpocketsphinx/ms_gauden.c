@@ -354,11 +354,102 @@ gauden_init(char const *meanfile, char const *varfile, float32 varfloor, logmath
     return g;
 }
 
+static void
+gauden_soa_free(gauden_t * g)
+{
+    if (g->soa_mean)
+        ckd_free_2d(g->soa_mean);
+    if (g->soa_var)
+        ckd_free_2d(g->soa_var);
+    if (g->soa_det)
+        ckd_free_2d(g->soa_det);
+    ckd_free(g->soa_buf);
+    g->soa_mean = g->soa_var = g->soa_det = NULL;
+    g->soa_buf = NULL;
+}
+
+/*
+ * Build the interleaved copy of the (precomputed) parameters.  Every
+ * block is a whole number of groups of GMM_SOA_WIDTH values, so
+ * aligning the start of the buffer aligns all of them.
+ */
+static void
+gauden_soa_build(gauden_t * g)
+{
+    size_t n_total;
+    mfcc_t *ptr;
+    int32 m, f, d, i;
+
+    gauden_soa_free(g);
+    g->n_soa_group = (g->n_density + GMM_SOA_WIDTH - 1) / GMM_SOA_WIDTH;
+    n_total = 0;
+    for (f = 0; f < g->n_feat; ++f)
+        n_total += (size_t)g->n_soa_group * GMM_SOA_WIDTH
+            * (2 * g->featlen[f] + 1);
+    n_total *= g->n_mgau;
+    g->soa_buf = ckd_malloc(n_total * sizeof(mfcc_t) + 63);
+    ptr = (mfcc_t *)(((size_t)g->soa_buf + 63) & ~(size_t)63);
+    g->soa_mean = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat,
+                                            sizeof(**g->soa_mean));
+    g->soa_var = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat,
+                                           sizeof(**g->soa_var));
+    g->soa_det = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat,
+                                           sizeof(**g->soa_det));
+    for (m = 0; m < g->n_mgau; ++m) {
+        for (f = 0; f < g->n_feat; ++f) {
+            int32 flen = g->featlen[f];
+            size_t n_group_vals = (size_t)g->n_soa_group * GMM_SOA_WIDTH;
+
+            g->soa_mean[m][f] = ptr;
+            ptr += n_group_vals * flen;
+            g->soa_var[m][f] = ptr;
+            ptr += n_group_vals * flen;
+            g->soa_det[m][f] = ptr;
+            ptr += n_group_vals;
+            for (d = 0; d < (int32)n_group_vals; ++d) {
+                mfcc_t *mean = g->soa_mean[m][f]
+                    + (d / GMM_SOA_WIDTH) * flen * GMM_SOA_WIDTH
+                    + d % GMM_SOA_WIDTH;
+                mfcc_t *var = g->soa_var[m][f]
+                    + (d / GMM_SOA_WIDTH) * flen * GMM_SOA_WIDTH
+                    + d % GMM_SOA_WIDTH;
+
+                /* Padding densities are never good enough to keep
+                 * the kernel going. */
+                if (d >= g->n_density) {
+                    for (i = 0; i < flen; ++i)
+                        mean[i * GMM_SOA_WIDTH] = var[i * GMM_SOA_WIDTH] = 0;
+                    g->soa_det[m][f][d] = MAX_NEG_FLOAT32;
+                    continue;
+                }
+                for (i = 0; i < flen; ++i) {
+                    mean[i * GMM_SOA_WIDTH] = g->mean[m][f][d][i];
+                    var[i * GMM_SOA_WIDTH] = g->var[m][f][d][i];
+                }
+                g->soa_det[m][f][d] = g->det[m][f][d];
+            }
+        }
+    }
+    E_INFO("Interleaved %d codebooks in groups of %d densities\n",
+           g->n_mgau, GMM_SOA_WIDTH);
+}
+
+void
+gauden_set_simd(gauden_t * g, gmm_simd_t level)
+{
+    g->dist_soa = gmm_simd_dist_soa_func(level);
+    if (g->dist_soa)
+        gauden_soa_build(g);
+    else
+        gauden_soa_free(g);
+}
+
 void
 gauden_free(gauden_t * g)
 {
     if (g == NULL)
         return;
+    gauden_soa_free(g);
     if (g->mean)
         gauden_param_free(g->mean);
     if (g->var)
@@ -480,6 +571,63 @@ compute_dist(gauden_dist_t * out_dist, int32 n_top,
 }
 
 
+/*
+ * Same as compute_dist(), but using the interleaved parameters to
+ * score GMM_SOA_WIDTH densities at a time.  Densities are still
+ * inserted in order, and those that the scalar code would stop early
+ * on are below the worst score either way, so the results are the
+ * same.
+ */
+static int32
+compute_dist_soa(gauden_t * g, gauden_dist_t * out_dist, int32 n_top,
+                 mfcc_t * obs, int mgau, int feat)
+{
+    mfcc_t dval[GMM_SOA_WIDTH];
+    int32 featlen, i, j, k, grp;
+    gauden_dist_t *worst;
+    int all;
+
+    featlen = g->featlen[feat];
+    /* Special case optimization when n_density <= n_top */
+    all = (n_top >= g->n_density);
+    if (!all) {
+        for (i = 0; i < n_top; i++)
+            out_dist[i].dist = WORST_DIST;
+    }
+    worst = &(out_dist[n_top - 1]);
+
+    for (grp = 0; grp < g->n_soa_group; ++grp) {
+        (*g->dist_soa)(dval, obs,
+                       g->soa_mean[mgau][feat] + grp * featlen * GMM_SOA_WIDTH,
+                       g->soa_var[mgau][feat] + grp * featlen * GMM_SOA_WIDTH,
+                       featlen,
+                       g->soa_det[mgau][feat] + grp * GMM_SOA_WIDTH,
+                       all ? GMM_NO_THRESH : worst->dist);
+        for (k = 0; k < GMM_SOA_WIDTH; ++k) {
+            int32 d = grp * GMM_SOA_WIDTH + k;
+
+            if (d >= g->n_density)
+                break;
+            if (all) {
+                out_dist[d].dist = dval[k];
+                out_dist[d].id = d;
+                continue;
+            }
+            if (dval[k] < worst->dist)     /* Codeword d worse than worst */
+                continue;
+            for (i = 0; (i < n_top) && (dval[k] < out_dist[i].dist); i++);
+            assert(i < n_top);
+            for (j = n_top - 1; j > i; --j)
+                out_dist[j] = out_dist[j - 1];
+            out_dist[i].dist = dval[k];
+            out_dist[i].id = d;
+        }
+    }
+
+    return 0;
+}
+
+
 /*
  * Compute distances of the input observation from the top N codewords in the given
  * codebook (g->{mean,var}[mgau]).  The input observation, obs, includes vectors for
@@ -494,10 +642,13 @@ gauden_dist(gauden_t * g,
     assert((n_top > 0) && (n_top <= g->n_density));
 
     for (f = 0; f < g->n_feat; f++) {
-        compute_dist(out_dist[f], n_top,
-                     obs[f], g->featlen[f],
-                     g->mean[mgau][f], g->var[mgau][f], g->det[mgau][f],
-                     g->n_density);
+        if (g->dist_soa)
+            compute_dist_soa(g, out_dist[f], n_top, obs[f], mgau, f);
+        else
+            compute_dist(out_dist[f], n_top,
+                         obs[f], g->featlen[f],
+                         g->mean[mgau][f], g->var[mgau][f], g->det[mgau][f],
+                         g->n_density);
         E_DEBUG("Top CW(%d,%d) = %d %d\n", mgau, f, out_dist[f][0].id,
                 (int)out_dist[f][0].dist >> SENSCR_SHIFT);
     }
@@ -565,5 +716,8 @@ gauden_mllr_transform(gauden_t *g, ps_mllr_t *mllr, cmd_ln_t *config)
     /* Re-precompute (if we aren't adapting variances this isn't
      * actually necessary...) */
     gauden_dist_precompute(g, g->lmath, cmd_ln_float32_r(config, "-varfloor"));
+    /* And rebuild the interleaved parameters if we are using them. */
+    if (g->dist_soa)
+        gauden_soa_build(g);
     return 0;
 }
@@ -59,6 +59,7 @@
 #include "vector.h"
 #include "pocketsphinx_internal.h"
 #include "hmm.h"
+#include "gmm_simd.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -89,6 +90,16 @@ typedef struct {
     int32 n_feat;	/**< Number feature streams in each codebook */
     int32 n_density;	/**< Number gaussian densities in each codebook-feature stream */
     int32 *featlen;	/**< feature length for each feature */
+
+    /* Interleaved copy of the parameters for vector code. */
+    gmm_dist_soa_func_t dist_soa; /**< Interleaved distance kernel, or NULL
+                                     to use the parameters above */
+    int32 n_soa_group;  /**< Number of groups of GMM_SOA_WIDTH densities */
+    mfcc_t ***soa_mean; /**< soa_mean[codebook][feature] = means for each
+                           group, interleaved dimension by dimension */
+    mfcc_t ***soa_var;  /**< like soa_mean */
+    mfcc_t ***soa_det;  /**< like det, padded to a whole number of groups */
+    void *soa_buf;      /**< Memory for all of the above (unaligned) */
 } gauden_t;
 
 
@@ -108,6 +119,15 @@ gauden_init (char const *meanfile,/**< Input: File containing means of mixture g
 /** Release memory allocated by gauden_init. */
 void gauden_free(gauden_t *g); /**< In: The gauden_t to free */
 
+/**
+ * Choose the vector code used to compute densities.  For SIMD levels
+ * that have an interleaved kernel, this builds a contiguous, 64-byte
+ * aligned copy of the parameters with the densities in groups of
+ * GMM_SOA_WIDTH, which is kept up to date by gauden_mllr_transform().
+ * Scores are exactly the same either way.
+ */
+void gauden_set_simd(gauden_t *g, gmm_simd_t level);
+
 /** Transform Gaussians according to an MLLR matrix (or, eventually, more). */
 int32 gauden_mllr_transform(gauden_t *s, ps_mllr_t *mllr, cmd_ln_t *config);
 
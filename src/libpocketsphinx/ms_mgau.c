@@ -74,6 +74,8 @@
 static ps_mgaufuncs_t ms_mgau_funcs = {
     "ms",
     ms_cont_mgau_frame_eval, /* frame_eval */
+    ms_cont_mgau_frame_eval_batch, /* frame_eval_batch */
+    NULL,                    /* frame_eval_active */
     ms_mgau_mllr_transform,  /* transform */
     ms_mgau_free             /* free */
 };
@@ -87,6 +89,7 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
     gauden_t *g;
     senone_t *s;
     cmd_ln_t *config;
+    gmm_simd_t simd;
     int i;
 
     config = acmod->config;
@@ -103,6 +106,8 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
 	E_ERROR("Failed to read means and variances\n");	
 	goto error_out;
     }
+    simd = gmm_simd_select(cmd_ln_str_r(config, "-gmm_simd"));
+    gauden_set_simd(g, simd);
 
     /* Verify n_feat and veclen, against acmod. */
     if (g->n_feat != feat_dimension1(acmod->fcb)) {
@@ -122,7 +127,9 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
                              cmd_ln_str_r(config, "_mixw"),
                              cmd_ln_str_r(config, "_senmgau"),
                              cmd_ln_float32_r(config, "-mixwfloor"),
-                             lmath, mdef);
+                             lmath, mdef,
+                             cmd_ln_boolean_r(config, "-fastlogadd"));
+    senone_set_simd(s, simd);
 
     s->aw = cmd_ln_int32_r(config, "-aw");
 
@@ -153,6 +160,24 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
         ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
                       sizeof(gauden_dist_t));
     msg->mgau_active = ckd_calloc(g->n_mgau, sizeof(int8));
+    /* Densities for frames scored ahead of the search. */
+    msg->n_dist_batch = cmd_ln_int32_r(config, "-score_batch");
+    if (msg->n_dist_batch > 1) {
+        msg->dist_batch = ckd_calloc(msg->n_dist_batch,
+                                     sizeof(*msg->dist_batch));
+        for (i = 0; i < msg->n_dist_batch; ++i)
+            msg->dist_batch[i] = (gauden_dist_t ***)
+                ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
+                              sizeof(gauden_dist_t));
+    }
+    else
+        msg->n_dist_batch = 0;
+
+    msg->pool = ps_workpool_init(cmd_ln_int32_r(config, "-nthreads_score"));
+    msg->thread_best = ckd_calloc(ps_workpool_n_threads(msg->pool),
+                                  sizeof(*msg->thread_best));
+    msg->thread_lastsen = ckd_calloc(ps_workpool_n_threads(msg->pool),
+                                     sizeof(*msg->thread_lastsen));
 
     mg = (ps_mgau_t *)msg;
     mg->vt = &ms_mgau_funcs;
@@ -177,6 +202,15 @@ ms_mgau_free(ps_mgau_t * mg)
         ckd_free_3d((void *) msg->dist);
     if (msg->mgau_active)
         ckd_free(msg->mgau_active);
+    if (msg->dist_batch) {
+        int i;
+        for (i = 0; i < msg->n_dist_batch; ++i)
+            ckd_free_3d((void *) msg->dist_batch[i]);
+        ckd_free(msg->dist_batch);
+    }
+    ps_workpool_free(msg->pool);
+    ckd_free(msg->thread_best);
+    ckd_free(msg->thread_lastsen);
     
     ckd_free(msg);
 }
@@ -189,6 +223,114 @@ ms_mgau_mllr_transform(ps_mgau_t *s,
     return gauden_mllr_transform(msg->g, mllr, msg->config);
 }
 
+/**
+ * Arguments for work done by the scoring threads.
+ */
+typedef struct ms_work_s {
+    ms_mgau_model_t *msg;
+    int16 *senscr;
+    uint8 *senone_active;
+    int32 n_senone_active;
+    mfcc_t **feat;
+    int32 compallsen;
+    gauden_dist_t ***dist;
+    mfcc_t ***feat_batch;
+    int32 n_frames;
+} ms_work_t;
+
+/* Compute topn gaussian density values for a share of the codebooks. */
+static void
+ms_mgau_dist_work(void *arg, int idx, int n_threads)
+{
+    ms_work_t *w = (ms_work_t *)arg;
+    ms_mgau_model_t *msg = w->msg;
+    gauden_t *g = ms_mgau_gauden(msg);
+    int32 gid, start, end;
+
+    ps_workpool_range(g->n_mgau, idx, n_threads, &start, &end);
+    for (gid = start; gid < end; gid++) {
+        if (w->compallsen || msg->mgau_active[gid])
+            gauden_dist(g, gid, ms_mgau_topn(msg), w->feat, msg->dist[gid]);
+    }
+}
+
+/* Compute topn gaussian density values for a share of the codebooks
+ * over several frames. */
+static void
+ms_mgau_dist_batch_work(void *arg, int idx, int n_threads)
+{
+    ms_work_t *w = (ms_work_t *)arg;
+    ms_mgau_model_t *msg = w->msg;
+    gauden_t *g = ms_mgau_gauden(msg);
+    int32 gid, t, start, end;
+
+    ps_workpool_range(g->n_mgau, idx, n_threads, &start, &end);
+    for (gid = start; gid < end; gid++) {
+        for (t = 0; t < w->n_frames; t++)
+            gauden_dist(g, gid, ms_mgau_topn(msg), w->feat_batch[t],
+                        msg->dist_batch[t][gid]);
+    }
+}
+
+/* Compute senone scores for a share of the (active) senones. */
+static void
+ms_mgau_senone_work(void *arg, int idx, int n_threads)
+{
+    ms_work_t *w = (ms_work_t *)arg;
+    ms_mgau_model_t *msg = w->msg;
+    senone_t *sen = ms_mgau_senone(msg);
+    int32 topn = ms_mgau_topn(msg);
+    int16 *senscr = w->senscr;
+    int32 best, start, end;
+
+    best = (int32) 0x7fffffff;
+    if (w->compallsen) {
+        ps_workpool_range(sen->n_sen, idx, n_threads, &start, &end);
+        best = senone_eval_all(sen, w->dist, topn, senscr, start, end);
+    }
+    else {
+        int32 i, n;
+
+        ps_workpool_range(w->n_senone_active, idx, n_threads, &start, &end);
+	n = msg->thread_lastsen[idx];
+	for (i = start; i < end; i++) {
+	    int32 s = w->senone_active[i] + n;
+	    senscr[s] = senone_eval(sen, s, w->dist[sen->mgau[s]], topn);
+	    if (best > senscr[s]) {
+		best = senscr[s];
+	    }
+	    n = s;
+	}
+    }
+    msg->thread_best[idx] = best;
+}
+
+/* Compute and normalize scores for all senones. */
+static void
+ms_mgau_senone_eval_all(ms_mgau_model_t *msg, ms_work_t *w)
+{
+    senone_t *sen = ms_mgau_senone(msg);
+    int32 best, s;
+    int i;
+
+    ps_workpool_run(msg->pool, ms_mgau_senone_work, w);
+
+    best = (int32) 0x7fffffff;
+    for (i = 0; i < ps_workpool_n_threads(msg->pool); i++)
+	if (best > msg->thread_best[i])
+	    best = msg->thread_best[i];
+
+    /* Normalize senone scores */
+    for (s = 0; s < sen->n_sen; s++) {
+	int32 bs = w->senscr[s] - best;
+	if (bs > 32767)
+	    bs = 32767;
+	if (bs < -32768)
+	    bs = -32768;
+	w->senscr[s] = bs;
+    }
+}
+
 int32
 ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 			int16 *senscr,
@@ -200,41 +342,32 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 {
     ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
     int32 gid;
-    int32 topn;
     int32 best;
     gauden_t *g;
     senone_t *sen;
+    ms_work_t w;
+    int i, n_threads;
 
-    topn = ms_mgau_topn(msg);
     g = ms_mgau_gauden(msg);
     sen = ms_mgau_senone(msg);
+    n_threads = ps_workpool_n_threads(msg->pool);
 
-    if (compallsen) {
-	int32 s;
-
-	for (gid = 0; gid < g->n_mgau; gid++)
-	    gauden_dist(g, gid, topn, feat, msg->dist[gid]);
-
-	best = (int32) 0x7fffffff;
-	for (s = 0; s < sen->n_sen; s++) {
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	}
+    w.msg = msg;
+    w.senscr = senscr;
+    w.senone_active = senone_active;
+    w.n_senone_active = n_senone_active;
+    w.feat = feat;
+    w.compallsen = compallsen;
+    w.dist = msg->dist;
 
-	/* Normalize senone scores */
-	for (s = 0; s < sen->n_sen; s++) {
-	    int32 bs = senscr[s] - best;
-	    if (bs > 32767)
-		bs = 32767;
-	    if (bs < -32768)
-		bs = -32768;
-	    senscr[s] = bs;
-	}
+    if (compallsen) {
+	/* Codebooks and senones are independent, so they can be split
+	 * up between threads. */
+	ps_workpool_run(msg->pool, ms_mgau_dist_work, &w);
+	ms_mgau_senone_eval_all(msg, &w);
     }
     else {
-	int32 i, n;
+	int32 n;
 	/* Flag all active mixture-gaussian codebooks */
 	for (gid = 0; gid < g->n_mgau; gid++)
 	    msg->mgau_active[gid] = 0;
@@ -246,23 +379,18 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 	    msg->mgau_active[sen->mgau[s]] = 1;
 	    n = s;
 	}
+	ps_workpool_split_deltas(senone_active, n_senone_active,
+				 n_threads, msg->thread_lastsen);
 
 	/* Compute topn gaussian density values (for active codebooks) */
-	for (gid = 0; gid < g->n_mgau; gid++) {
-	    if (msg->mgau_active[gid])
-		gauden_dist(g, gid, topn, feat, msg->dist[gid]);
-	}
+	ps_workpool_run(msg->pool, ms_mgau_dist_work, &w);
+	/* Compute senone scores */
+	ps_workpool_run(msg->pool, ms_mgau_senone_work, &w);
 
 	best = (int32) 0x7fffffff;
-	n = 0;
-	for (i = 0; i < n_senone_active; i++) {
-	    int32 s = senone_active[i] + n;
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	    n = s;
-	}
+	for (i = 0; i < n_threads; i++)
+	    if (best > msg->thread_best[i])
+		best = msg->thread_best[i];
 
 	/* Normalize senone scores */
 	n = 0;
@@ -280,3 +408,40 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 
     return 0;
 }
+
+int32
+ms_cont_mgau_frame_eval_batch(ps_mgau_t * mg,
+                              int16 **senscr,
+                              mfcc_t *** feat,
+                              int32 frame,
+                              int32 n_frames)
+{
+    ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
+    ms_work_t w;
+    int t;
+
+    if (n_frames > msg->n_dist_batch) {
+        E_ERROR("Batch of %d frames is larger than %d\n",
+                n_frames, msg->n_dist_batch);
+        return -1;
+    }
+
+    w.msg = msg;
+    w.senone_active = NULL;
+    w.n_senone_active = 0;
+    w.feat = NULL;
+    w.compallsen = TRUE;
+    w.feat_batch = feat;
+    w.n_frames = n_frames;
+
+    /* Go through all the frames for each codebook, then score the
+     * senones in each frame. */
+    ps_workpool_run(msg->pool, ms_mgau_dist_batch_work, &w);
+    for (t = 0; t < n_frames; t++) {
+        w.senscr = senscr[t];
+        w.dist = msg->dist_batch[t];
+        ms_mgau_senone_eval_all(msg, &w);
+    }
+
+    return 0;
+}
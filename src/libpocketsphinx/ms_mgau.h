@@ -106,6 +106,7 @@
 #include "bin_mdef.h"
 #include "ms_gauden.h"
 #include "ms_senone.h"
+#include "ps_workpool.h"
 
 /** \struct ms_mgau_t
     \brief Multi-stream mixture gaussian. It is not necessary to be continr
@@ -120,6 +121,11 @@ typedef struct {
     /**< Intermediate used in computation */
     gauden_dist_t ***dist;  
     uint8 *mgau_active;
+    gauden_dist_t ****dist_batch; /**< Densities for a batch of frames (or NULL) */
+    int32 n_dist_batch;     /**< Number of frames in dist_batch */
+    ps_workpool_t *pool;    /**< Worker threads for scoring (or NULL) */
+    int32 *thread_best;     /**< Best senone score found by each thread */
+    int32 *thread_lastsen;  /**< Senone preceding each thread's active senones */
     cmd_ln_t *config;
 } ms_mgau_model_t;  
 
@@ -136,6 +142,11 @@ int32 ms_cont_mgau_frame_eval(ps_mgau_t * msg,
                               mfcc_t ** feat,
                               int32 frame,
                               int32 compallsen);
+int32 ms_cont_mgau_frame_eval_batch(ps_mgau_t * msg,
+                                    int16 **senscr,
+                                    mfcc_t *** feat,
+                                    int32 frame,
+                                    int32 n_frames);
 int32 ms_mgau_mllr_transform(ps_mgau_t *s,
                              ps_mllr_t *mllr);
 
@@ -45,6 +45,7 @@
 
 /* Local headers. */
 #include "ms_senone.h"
+#include "tied_mgau_common.h"
 
 #define MIXW_PARAM_VERSION	"1.0"
 #define SPDEF_PARAM_VERSION	"1.2"
@@ -240,13 +241,15 @@ senone_mixw_read(senone_t * s, char const *file_name, logmath_t *lmath)
             for (c = 0; c < s->n_cw; c++) {
                 p = -(logmath_log(lmath, pdf[c]));
                 p += (1 << (SENSCR_SHIFT - 1)) - 1; /* Rounding before truncation */
+                p = (p < (255 << SENSCR_SHIFT)) ? (p >> SENSCR_SHIFT) : 255;
+                /* Leave room for the densities in the log-add table. */
+                if (s->fastlogadd && p > MAX_NEG_MIXW)
+                    p = MAX_NEG_MIXW;
 
                 if (s->n_gauden > 1)
-                    s->pdf[i][f][c] =
-                        (p < (255 << SENSCR_SHIFT)) ? (p >> SENSCR_SHIFT) : 255;
+                    s->pdf[i][f][c] = p;
                 else
-                    s->pdf[f][c][i] =
-                        (p < (255 << SENSCR_SHIFT)) ? (p >> SENSCR_SHIFT) : 255;
+                    s->pdf[f][c][i] = p;
             }
         }
     }
@@ -273,7 +276,8 @@ senone_mixw_read(senone_t * s, char const *file_name, logmath_t *lmath)
 
 senone_t *
 senone_init(gauden_t *g, char const *mixwfile, char const *sen2mgau_map_file,
-	    float32 mixwfloor, logmath_t *lmath, bin_mdef_t *mdef)
+	    float32 mixwfloor, logmath_t *lmath, bin_mdef_t *mdef,
+            int32 fastlogadd)
 {
     senone_t *s;
     int32 n = 0, i;
@@ -281,6 +285,15 @@ senone_init(gauden_t *g, char const *mixwfile, char const *sen2mgau_map_file,
     s = (senone_t *) ckd_calloc(1, sizeof(senone_t));
     s->lmath = logmath_init(logmath_get_base(lmath), SENSCR_SHIFT, TRUE);
     s->mixwfloor = mixwfloor;
+    if (fastlogadd) {
+        if (LOGMATH_TABLE(s->lmath)->width != 1) {
+            E_WARN("Log-add table is not 8 bits wide, not using fast log-add\n");
+            fastlogadd = FALSE;
+        }
+        else
+            E_INFO("Using fast log-add for senone scores\n");
+    }
+    s->fastlogadd = fastlogadd;
 
     s->n_gauden = g->n_mgau;
     if (sen2mgau_map_file) {
@@ -337,6 +350,16 @@ senone_init(gauden_t *g, char const *mixwfile, char const *sen2mgau_map_file,
     return s;
 }
 
+void
+senone_set_simd(senone_t *s, gmm_simd_t level)
+{
+    s->mixw_simd = NULL;
+    if (s->fastlogadd
+        && gmm_simd_logadd_ok(LOGMATH_TABLE(s->lmath)->table,
+                              LOGMATH_TABLE(s->lmath)->table_size))
+        s->mixw_simd = gmm_simd_mixw_funcs(level);
+}
+
 void
 senone_free(senone_t * s)
 {
@@ -353,6 +376,152 @@ senone_free(senone_t * s)
 }
 
 
+/* Number of senones scored at once by senone_eval_all(). */
+#define SIMD_BLOCK 64
+/* Maximum top-N for senone_eval_all() to use vector code. */
+#define SIMD_MAX_TOPN 16
+
+/* Scaled density for one codeword. */
+#define SENONE_FDEN(d) \
+    (((int32)(d).dist + ((1<<SENSCR_SHIFT) - 1)) >> SENSCR_SHIFT)
+
+/* Mixture weight for one senone and codeword. */
+#define SENONE_PDF(s,id,f,c) \
+    (((s)->n_gauden > 1) ? (s)->pdf[id][f][c] : (s)->pdf[f][c][id])
+
+/* Downscale a senone score and avoid overflowing int16. */
+static int32
+senone_scale(senone_t *s, int32 scr)
+{
+    scr /= s->aw;
+    if (scr > 32767)
+      scr = 32767;
+    if (scr < -32768)
+      scr = -32768;
+    return scr;
+}
+
+/*
+ * Find the best scaled density among the top N for one feature, and
+ * the negated densities relative to it, clamped so that they can be
+ * combined with the (also clamped) mixture weights using
+ * fast_logmath_add().  The top N are not always sorted, since
+ * gauden_dist() doesn't bother when it computes all of them.
+ */
+static int32
+senone_rel_dist(gauden_dist_t *fdist, int32 n_top, int16 *rel)
+{
+    int32 norm, t;
+
+    norm = SENONE_FDEN(fdist[0]);
+    for (t = 1; t < n_top; t++) {
+        int32 fden = SENONE_FDEN(fdist[t]);
+        if (fden > norm)
+            norm = fden;
+    }
+    for (t = 0; t < n_top; t++) {
+        int32 d = norm - SENONE_FDEN(fdist[t]);
+        rel[t] = (d > MAX_NEG_ASCR) ? MAX_NEG_ASCR : d;
+    }
+    return norm;
+}
+
+/*
+ * Compute senone score for one senone with fast log-addition.
+ */
+static int32
+senone_eval_fast(senone_t * s, int id, gauden_dist_t ** dist, int32 n_top)
+{
+    int16 rel[SIMD_MAX_TOPN], *r;
+    int32 scr, norm, fscr, f, t;
+
+    r = (n_top > SIMD_MAX_TOPN) ? ckd_calloc(n_top, sizeof(*r)) : rel;
+    scr = 0;
+    for (f = 0; f < s->n_feat; f++) {
+        gauden_dist_t *fdist = dist[f];
+
+        norm = senone_rel_dist(fdist, n_top, r);
+        /* Negated log-sum of weights and relative densities. */
+        fscr = SENONE_PDF(s, id, f, fdist[0].id) + r[0];
+        for (t = 1; t < n_top; t++)
+            fscr = fast_logmath_add(s->lmath, fscr,
+                                    SENONE_PDF(s, id, f, fdist[t].id) + r[t]);
+        scr += fscr - norm;
+    }
+    if (r != rel)
+        ckd_free(r);
+    return senone_scale(s, scr);
+}
+
+int32
+senone_eval_all(senone_t *s, gauden_dist_t ***dist, int n_top,
+                int16 *senscr, int32 start, int32 end)
+{
+    int16 den[SIMD_MAX_TOPN][SIMD_BLOCK];
+    int16 rel[SIMD_MAX_TOPN];
+    int16 tmp[SIMD_BLOCK];
+    int32 scr[SIMD_BLOCK];
+    uint8 const *logadd;
+    int32 best, j, n, f, t;
+    int b;
+
+    best = (int32) 0x7fffffff;
+    if (s->mixw_simd == NULL || n_top > SIMD_MAX_TOPN) {
+        for (j = start; j < end; j++) {
+            senscr[j] = senone_eval(s, j, dist[s->mgau[j]], n_top);
+            if (best > senscr[j])
+                best = senscr[j];
+        }
+        return best;
+    }
+
+    logadd = (uint8 const *)LOGMATH_TABLE(s->lmath)->table;
+    for (j = start; j < end; j += n) {
+        n = MIN(SIMD_BLOCK, end - j);
+        memset(scr, 0, n * sizeof(*scr));
+        for (f = 0; f < s->n_feat; f++) {
+            if (s->n_gauden == 1) {
+                /* All senones share one codebook, and the weights are
+                 * transposed, so they can be used in place. */
+                gauden_dist_t *fdist = dist[0][f];
+                uint8 const *pid_cw[SIMD_MAX_TOPN];
+                int32 norm;
+
+                norm = senone_rel_dist(fdist, n_top, rel);
+                for (t = 0; t < n_top; t++)
+                    pid_cw[t] = s->pdf[f][fdist[t].id] + j;
+                memset(tmp, 0, n * sizeof(*tmp));
+                (*s->mixw_simd->mixw8)(tmp, pid_cw, rel, n_top, 0, n, logadd);
+                for (b = 0; b < n; b++)
+                    scr[b] += tmp[b] - norm;
+            }
+            else {
+                int32 norm[SIMD_BLOCK];
+
+                /* Gather the weights for each senone's own codebook. */
+                for (b = 0; b < n; b++) {
+                    int32 id = j + b;
+                    gauden_dist_t *fdist = dist[s->mgau[id]][f];
+
+                    norm[b] = senone_rel_dist(fdist, n_top, rel);
+                    for (t = 0; t < n_top; t++)
+                        den[t][b] = s->pdf[id][f][fdist[t].id] + rel[t];
+                }
+                (*s->mixw_simd->logadd)(tmp, den[0], SIMD_BLOCK,
+                                        n_top, n, logadd);
+                for (b = 0; b < n; b++)
+                    scr[b] += tmp[b] - norm[b];
+            }
+        }
+        for (b = 0; b < n; b++) {
+            senscr[j + b] = senone_scale(s, scr[b]);
+            if (best > senscr[j + b])
+                best = senscr[j + b];
+        }
+    }
+    return best;
+}
+
 /*
  * Compute senone score for one senone.
  * NOTE:  Remember that senone PDF tables contain SCALED, NEGATED logs3 values.
@@ -371,6 +540,9 @@ senone_eval(senone_t * s, int id, gauden_dist_t ** dist, int32 n_top)
     assert((id >= 0) && (id < s->n_sen));
     assert((n_top > 0) && (n_top <= s->n_cw));
 
+    if (s->fastlogadd)
+        return senone_eval_fast(s, id, dist, n_top);
+
     scr = 0;
 
     for (f = 0; f < s->n_feat; f++) {
@@ -403,13 +575,5 @@ senone_eval(senone_t * s, int id, gauden_dist_t ** dist, int32 n_top)
 	 * we have to negate the stuff we calculated above. */
         scr -= fscr;
     }
-    /* Downscale scores. */
-    scr /= s->aw;
-
-    /* Avoid overflowing int16 */
-    if (scr > 32767)
-      scr = 32767;
-    if (scr < -32768)
-      scr = -32768;
-    return scr;
+    return senone_scale(s, scr);
 }
@@ -51,6 +51,7 @@
 /* Local headers. */
 #include "ms_gauden.h"
 #include "bin_mdef.h"
+#include "gmm_simd.h"
 
 /** \file ms_senone.h
  *  \brief (Sphinx 3.0 specific) multiple streams senones. used with ms_gauden.h
@@ -90,6 +91,8 @@ typedef struct {
     uint32 *mgau;		/**< senone-id -> mgau-id mapping for senones in this set */
     int32 *featscr;              /**< The feature score for every senone, will be initialized inside senone_eval_all */
     int32 aw;			/**< Inverse acoustic weight */
+    int32 fastlogadd;		/**< Use 8-bit relative densities and fast log-add */
+    gmm_mixw_funcs_t const *mixw_simd; /**< Vectorized log-add kernels (or NULL) */
 } senone_t;
 
 
@@ -106,14 +109,28 @@ senone_t *senone_init (gauden_t *g,             /**< In: codebooks */
 						   If NULL all senones map to codebook 0 */
 		       float32 mixwfloor,	/**< In: Floor value for senone weights */
                        logmath_t *lmath,        /**< In: log math computation */
-                       bin_mdef_t *mdef         /**< In: model definition */
+                       bin_mdef_t *mdef,        /**< In: model definition */
+                       int32 fastlogadd         /**< In: Clamp weights for fast
+                                                   log-addition (see
+                                                   senone_eval()) */
     );
 
+/**
+ * Select vector code for senone_eval_all().  This only has an effect
+ * if fast log-addition is in use.
+ */
+void senone_set_simd(senone_t *s, gmm_simd_t level);
+
 /** Release memory allocated by senone_init. */
 void senone_free(senone_t *s); /**< In: The senone_t to free */
 
 /**
  * Evaluate the score for the given senone wrt to the given top N gaussian codewords.
+ *
+ * With fast log-addition, the densities for each feature are taken
+ * relative to the best one and clamped to MAX_NEG_ASCR, and the
+ * mixture weights to MAX_NEG_MIXW, so that the 8-bit log-add table
+ * can be used without any range checks, as in the tied-state models.
  * @return senone score (in logs3 domain).
  */
 int32 senone_eval (senone_t *s, int id,		/**< In: senone for which score desired */
@@ -124,6 +141,21 @@ int32 senone_eval (senone_t *s, int id,		/**< In: senone for which score desired
 		   int n_top		/**< In: Length of dist[f], for each f */
     );
 
+/**
+ * Evaluate the scores for a range of senones, using vector code across
+ * senones if possible.
+ * @return the best (lowest) senone score in the range.
+ */
+int32 senone_eval_all(senone_t *s,
+                      gauden_dist_t ***dist,	/**< In: top N codewords and
+                                                   densities for each codebook,
+                                                   as for senone_eval() */
+                      int n_top,		/**< In: Length of dist[m][f] */
+                      int16 *senscr,		/**< Out: senone scores */
+                      int32 start,		/**< In: First senone */
+                      int32 end			/**< In: Last senone plus one */
+    );
+
 #ifdef __cplusplus
 }
 #endif
@@ -62,6 +62,12 @@ static int ngram_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2
 static char const *ngram_search_hyp(ps_search_t *search, int32 *out_score);
 static int32 ngram_search_prob(ps_search_t *search);
 static ps_seg_t *ngram_search_seg_iter(ps_search_t *search);
+static void ngram_search_sen_active(ps_search_t *search, int frame_idx);
+static void ngram_search_lmcache_init(ngram_search_t *ngs, int32 size);
+static void ngram_search_lmcache_flush(ngram_search_t *ngs);
+
+/* Number of slots to look at before giving up on a cache lookup. */
+#define LMCACHE_PROBE 8
 
 static ps_searchfuncs_t ngram_funcs = {
     /* start: */  ngram_search_start,
@@ -73,6 +79,7 @@ static ps_searchfuncs_t ngram_funcs = {
     /* hyp: */      ngram_search_hyp,
     /* prob: */     ngram_search_prob,
     /* seg_iter: */ ngram_search_seg_iter,
+    /* sen_active: */ ngram_search_sen_active,
 };
 
 static ngram_model_t *default_lm;
@@ -190,6 +197,7 @@ ngram_search_init(const char *name,
     ngs->bp_table_idx = ckd_calloc(ngs->n_frame_alloc + 1,
                                    sizeof(*ngs->bp_table_idx));
     ++ngs->bp_table_idx; /* Make bptableidx[-1] valid */
+    ngs->bp_stable = NO_BP;
 
     /* Allocate active word list array */
     ngs->active_word_list = ckd_calloc_2d(2, dict_size(dict),
@@ -198,6 +206,7 @@ ngram_search_init(const char *name,
     ngs->lmset = ngram_model_set_init(config, &lm, &lmname, NULL, 1);
     if (!ngs->lmset)
         goto error_out;
+    ngram_search_lmcache_init(ngs, cmd_ln_int32_r(config, "-lmcache"));
 
     if (ngram_wid(ngs->lmset, S3_FINISH_WORD) ==
         ngram_unknown_wid(ngs->lmset))
@@ -228,6 +237,12 @@ ngram_search_init(const char *name,
         ngs->bestpath_perf.name = "bestpath";
         ptmr_init(&ngs->bestpath_perf);
     }
+    ngs->bptbl_gc = cmd_ln_int32_r(config, "-bptbl_gc");
+    if (ngs->bptbl_gc > 0
+        && (!ngs->fwdtree || ngs->fwdflat || ngs->bestpath)) {
+        E_WARN("-bptbl_gc requires -fwdtree yes -fwdflat no -bestpath no, ignoring it\n");
+        ngs->bptbl_gc = 0;
+    }
 
     return (ps_search_t *)ngs;
 
@@ -266,6 +281,9 @@ ngram_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2p)
     if (ngs->lmset == NULL)
         return 0;
 
+    /* The language model may have changed. */
+    ngram_search_lmcache_flush(ngs);
+
     /* Update beam widths. */
     ngram_search_calc_beams(ngs);
 
@@ -320,15 +338,18 @@ ngram_search_free(ps_search_t *search)
     ckd_free(ngs->bscore_stack);
     if (ngs->bp_table_idx != NULL)
         ckd_free(ngs->bp_table_idx - 1);
+    ckd_free(ngs->stable_hyp);
+    ckd_free(ngs->stable_out);
     ckd_free_2d(ngs->active_word_list);
     ckd_free(ngs->last_ltrans);
+    ckd_free(ngs->lmcache);
     ckd_free(ngs);
 }
 
 int
 ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx)
 {
-    if (frame_idx >= ngs->n_frame_alloc) {
+    if (frame_idx - ngs->bp_frame_base >= ngs->n_frame_alloc) {
         ngs->n_frame_alloc *= 2;
         ngs->bp_table_idx = ckd_realloc(ngs->bp_table_idx - 1,
                                         (ngs->n_frame_alloc + 1)
@@ -340,7 +361,7 @@ ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx)
         }
         ++ngs->bp_table_idx; /* Make bptableidx[-1] valid */
     }
-    ngs->bp_table_idx[frame_idx] = ngs->bpidx;
+    ngram_search_bptbl_idx(ngs, frame_idx) = ngs->bpidx;
     return ngs->bpidx;
 }
 
@@ -516,21 +537,22 @@ ngram_search_find_exit(ngram_search_t *ngs, int frame_idx, int32 *out_best_score
 
     if (frame_idx == -1 || frame_idx >= ngs->n_frame)
         frame_idx = ngs->n_frame - 1;
-    end_bpidx = ngs->bp_table_idx[frame_idx];
+    end_bpidx = ngram_search_bptbl_idx(ngs, frame_idx);
 
     best_score = WORST_SCORE;
     best_exit = NO_BP;
 
     /* Scan back to find a frame with some backpointers in it. */
-    while (frame_idx >= 0 && ngs->bp_table_idx[frame_idx] == end_bpidx)
+    while (frame_idx >= ngs->bp_frame_base
+           && ngram_search_bptbl_idx(ngs, frame_idx) == end_bpidx)
         --frame_idx;
     /* This is NOT an error, it just means there is no hypothesis yet. */
-    if (frame_idx < 0)
+    if (frame_idx < ngs->bp_frame_base)
         return NO_BP;
 
     /* Now find the entry for </s> OR the best scoring entry. */
     assert(end_bpidx < ngs->bp_table_size);
-    for (bp = ngs->bp_table_idx[frame_idx]; bp < end_bpidx; ++bp) {
+    for (bp = ngram_search_bptbl_idx(ngs, frame_idx); bp < end_bpidx; ++bp) {
         if (ngs->bp_table[bp].wid == ps_search_finish_wid(ngs)
             || ngs->bp_table[bp].score BETTER_THAN best_score) {
             best_score = ngs->bp_table[bp].score;
@@ -554,12 +576,16 @@ ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx)
     size_t len;
     int bp;
 
-    if (bpidx == NO_BP)
+    if (bpidx == NO_BP && ngs->stable_hyp == NULL)
         return NULL;
 
-    bp = bpidx;
+    /* Words which are already final (see ngram_search_stable_hyp())
+     * come first, the backtrace stops at the last of them. */
     len = 0;
-    while (bp != NO_BP) {
+    if (ngs->stable_hyp)
+        len = strlen(ngs->stable_hyp) + 1;
+    bp = bpidx;
+    while (bp != NO_BP && bp != ngs->bp_stable) {
         bptbl_t *be = &ngs->bp_table[bp];
         bp = be->bp;
         if (dict_real_word(ps_search_dict(ngs), be->wid))
@@ -572,10 +598,12 @@ ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx)
 	return base->hyp_str;
     }
     base->hyp_str = ckd_calloc(1, len);
+    if (ngs->stable_hyp)
+        memcpy(base->hyp_str, ngs->stable_hyp, strlen(ngs->stable_hyp));
 
     bp = bpidx;
     c = base->hyp_str + len - 1;
-    while (bp != NO_BP) {
+    while (bp != NO_BP && bp != ngs->bp_stable) {
         bptbl_t *be = &ngs->bp_table[bp];
         size_t len;
 
@@ -594,6 +622,15 @@ ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx)
     return base->hyp_str;
 }
 
+char const *
+ngram_search_stable_hyp(ngram_search_t *ngs)
+{
+    ckd_free(ngs->stable_out);
+    ngs->stable_out = ngs->stable_hyp;
+    ngs->stable_hyp = NULL;
+    return ngs->stable_out;
+}
+
 void
 ngram_search_alloc_all_rc(ngram_search_t *ngs, int32 w)
 {
@@ -656,6 +693,74 @@ ngram_search_free_all_rc(ngram_search_t *ngs, int32 w)
     ngs->word_chan[w] = NULL;
 }
 
+static void
+ngram_search_lmcache_init(ngram_search_t *ngs, int32 size)
+{
+    int32 n;
+
+    if (size <= 0)
+        return;
+    /* Round up to a power of two. */
+    for (n = 1; n < size; n <<= 1)
+        ;
+    ngs->lmcache = ckd_calloc(n, sizeof(*ngs->lmcache));
+    ngs->lmcache_mask = n - 1;
+    ngs->lmcache_gen = 1;
+}
+
+static void
+ngram_search_lmcache_flush(ngram_search_t *ngs)
+{
+    if (ngs->lmcache == NULL)
+        return;
+    /* Generation 0 means an empty entry. */
+    if (++ngs->lmcache_gen <= 0) {
+        memset(ngs->lmcache, 0,
+               (ngs->lmcache_mask + 1) * sizeof(*ngs->lmcache));
+        ngs->lmcache_gen = 1;
+    }
+}
+
+int32
+ngram_search_lm_score(ngram_search_t *ngs, int32 wid, int32 w1, int32 w2)
+{
+    lmcache_entry_t *ent, *victim;
+    uint32 h;
+    int32 i, n_used;
+
+    if (ngs->lmcache == NULL)
+        return ngram_tg_score(ngs->lmset, wid, w1, w2, &n_used);
+
+    h = (uint32)wid * 0x9e3779b1u;
+    h ^= (uint32)w1 * 0x85ebca6bu;
+    h ^= (uint32)w2 * 0xc2b2ae35u;
+    h ^= h >> 15;
+    victim = NULL;
+    for (i = 0; i < LMCACHE_PROBE; ++i) {
+        ent = ngs->lmcache + ((h + i) & ngs->lmcache_mask);
+        if (ent->gen != ngs->lmcache_gen) {
+            /* Nothing beyond a free slot, since we never delete. */
+            victim = ent;
+            break;
+        }
+        if (ent->wid == wid && ent->w1 == w1 && ent->w2 == w2) {
+            ++ngs->st.n_lmcache_hit;
+            return ent->score;
+        }
+    }
+    /* If the neighbourhood is full, just replace the first entry. */
+    if (victim == NULL)
+        victim = ngs->lmcache + (h & ngs->lmcache_mask);
+
+    ++ngs->st.n_lmcache_miss;
+    victim->wid = wid;
+    victim->w1 = w1;
+    victim->w2 = w2;
+    victim->score = ngram_tg_score(ngs->lmset, wid, w1, w2, &n_used);
+    victim->gen = ngs->lmcache_gen;
+    return victim->score;
+}
+
 int32
 ngram_search_exit_score(ngram_search_t *ngs, bptbl_t *pbe, int rcphone)
 {
@@ -712,12 +817,10 @@ ngram_compute_seg_score(ngram_search_t *ngs, bptbl_t *be, float32 lwf,
         *out_lscr = ngs->fillpen;
     }
     else {
-        int32 n_used;
-        *out_lscr = ngram_tg_score(ngs->lmset,
-                                   be->real_wid,
-                                   pbe->real_wid,
-                                   pbe->prev_real_wid,
-                                   &n_used)>>SENSCR_SHIFT;
+        *out_lscr = ngram_search_lm_score(ngs,
+                                          be->real_wid,
+                                          pbe->real_wid,
+                                          pbe->prev_real_wid)>>SENSCR_SHIFT;
         *out_lscr = *out_lscr * lwf;
     }
     *out_ascr = be->score - start_score - *out_lscr;
@@ -730,6 +833,7 @@ ngram_search_start(ps_search_t *search)
 
     ngs->done = FALSE;
     ngram_model_flush(ngs->lmset);
+    ngram_search_lmcache_flush(ngs);
     if (ngs->fwdtree)
         ngram_fwdtree_start(ngs);
     else if (ngs->fwdflat)
@@ -752,6 +856,17 @@ ngram_search_step(ps_search_t *search, int frame_idx)
         return -1;
 }
 
+static void
+ngram_search_sen_active(ps_search_t *search, int frame_idx)
+{
+    ngram_search_t *ngs = (ngram_search_t *)search;
+
+    if (ngs->fwdtree)
+        ngram_fwdtree_sen_active(ngs, frame_idx);
+    else if (ngs->fwdflat)
+        ngram_fwdflat_sen_active(ngs, frame_idx);
+}
+
 void
 dump_bptable(ngram_search_t *ngs)
 {
@@ -880,7 +995,7 @@ ngram_search_hyp(ps_search_t *search, int32 *out_score)
 
         /* fwdtree and fwdflat use same backpointer table. */
         bpidx = ngram_search_find_exit(ngs, -1, out_score);
-        if (bpidx != NO_BP)
+        if (bpidx != NO_BP || ngs->stable_hyp)
             return ngram_search_bp_hyp(ngs, bpidx);
     }
 
@@ -974,7 +1089,7 @@ ngram_search_bp_iter(ngram_search_t *ngs, int bpidx, float32 lwf)
     itor->base.lwf = lwf;
     itor->n_bpidx = 0;
     bp = bpidx;
-    while (bp != NO_BP) {
+    while (bp != NO_BP && bp != ngs->bp_stable) {
         bptbl_t *be = &ngs->bp_table[bp];
         bp = be->bp;
         ++itor->n_bpidx;
@@ -986,7 +1101,7 @@ ngram_search_bp_iter(ngram_search_t *ngs, int bpidx, float32 lwf)
     itor->bpidx = ckd_calloc(itor->n_bpidx, sizeof(*itor->bpidx));
     cur = itor->n_bpidx - 1;
     bp = bpidx;
-    while (bp != NO_BP) {
+    while (bp != NO_BP && bp != ngs->bp_stable) {
         bptbl_t *be = &ngs->bp_table[bp];
         itor->bpidx[cur] = bp;
         bp = be->bp;
@@ -1162,7 +1277,7 @@ find_end_node(ngram_search_t *ngs, ps_lattice_t *dag, float32 lwf)
      * find the node corresponding to the best exit. */
     /* Find the last frame containing a word exit. */
     for (ef = dag->n_frames - 1;
-         ef >= 0 && ngs->bp_table_idx[ef] == ngs->bpidx;
+         ef >= 0 && ngram_search_bptbl_idx(ngs, ef) == ngs->bpidx;
          --ef);
     if (ef < 0) {
         E_ERROR("Empty backpointer table: can not build DAG.\n");
@@ -1172,7 +1287,8 @@ find_end_node(ngram_search_t *ngs, ps_lattice_t *dag, float32 lwf)
     /* Find best word exit in that frame. */
     bestscore = WORST_SCORE;
     bestbp = NO_BP;
-    for (bp = ngs->bp_table_idx[ef]; bp < ngs->bp_table_idx[ef + 1]; ++bp) {
+    for (bp = ngram_search_bptbl_idx(ngs, ef);
+         bp < ngram_search_bptbl_idx(ngs, ef + 1); ++bp) {
         int32 n_used, l_scr, wid, prev_wid;
         wid = ngs->bp_table[bp].real_wid;
         prev_wid = ngs->bp_table[bp].prev_real_wid;
@@ -1224,6 +1340,12 @@ ngram_search_lattice(ps_search_t *search)
     ngs = (ngram_search_t *)search;
     min_endfr = cmd_ln_int32_r(ps_search_config(search), "-min_endfr");
 
+    /* Most of the backpointer table is gone. */
+    if (ngs->bptbl_gc > 0) {
+        E_ERROR("Word lattices are not available with -bptbl_gc\n");
+        return NULL;
+    }
+
     /* If the best score is WORST_SCORE or worse, there is no way to
      * make a lattice. */
     if (ngs->best_score == WORST_SCORE || ngs->best_score WORSE_THAN WORST_SCORE)
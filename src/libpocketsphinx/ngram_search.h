@@ -52,6 +52,7 @@
 /* Local headers. */
 #include "pocketsphinx_internal.h"
 #include "hmm.h"
+#include "ps_workpool.h"
 
 /**
  * Lexical tree node data type.
@@ -59,7 +60,9 @@
  * Not the first HMM for words, which multiplex HMMs based on
  * different left contexts.  This structure is used both in the
  * dynamic HMM tree structure and in the per-word last-phone right
- * context fanout.
+ * context fanout.  These are not hmm_compact_t, even though they are
+ * never multiplex, since they have to be interchangeable with
+ * root_chan_t.
  */
 typedef struct chan_s {
     hmm_t hmm;                  /**< Basic HMM structure.  This *must* be first in
@@ -78,6 +81,9 @@ typedef struct chan_s {
 				   only within HMM tree.  -1 if none */
 	int32 rc_id;		/**< right-context id for last phone of words */
     } info;
+    int32 lmla;                 /**< LM lookahead score: best unigram score of
+                                   any word in the subtree below this channel,
+                                   or 0 if LM lookahead is not used */
 } chan_t;
 
 /**
@@ -101,6 +107,7 @@ typedef struct root_chan_s {
 				   node begin with this ciphone */
     int16    ci2phone;		/**< second ciphone of this node; one root HMM for each
                                    unique right context */
+    int32    lmla;              /**< LM lookahead score, as in chan_t */
 } root_chan_t;
 
 /**
@@ -188,8 +195,35 @@ typedef struct ngram_search_stats_s {
     int32 n_fwdflat_words;
     int32 n_fwdflat_word_transition;
     int32 n_senone_active_utt;
+    int32 n_lmcache_hit;
+    int32 n_lmcache_miss;
 } ngram_search_stats_t;
 
+/**
+ * Per-thread state for evaluating fwdtree channels in parallel.
+ */
+typedef struct ngram_eval_thread_s {
+    hmm_context_t *hmmctx;        /**< Batch queue and scratch space for
+                                     this thread (HMMs still point to the
+                                     search's own context). */
+    int32 best_score;             /**< Best score of tree channels. */
+    int32 last_phone_best_score;  /**< Best score of word channels. */
+    int32 n_root_chan_eval;       /**< Root channels evaluated. */
+    int32 n_last_chan_eval;       /**< Last phone channels evaluated. */
+    int32 n_1ph_eval;             /**< Single-phone words evaluated. */
+} ngram_eval_thread_t;
+
+/**
+ * Entry in the language model score cache.
+ */
+typedef struct lmcache_entry_s {
+    int32 wid;     /**< Word ID. */
+    int32 w1;      /**< Previous word ID. */
+    int32 w2;      /**< Word ID before that. */
+    int32 score;   /**< Trigram score (not shifted or weighted). */
+    int32 gen;     /**< Generation in which this entry was filled in. */
+} lmcache_entry_t;
+
 
 /**
  * N-Gram search module structure.
@@ -204,6 +238,13 @@ struct ngram_search_s {
     uint8 fwdflat;
     uint8 bestpath;
 
+    /** Apply unigram LM lookahead scores in the fwdtree lexical tree. */
+    uint8 lm_lookahead;
+
+    /** Threads for evaluating fwdtree channels, or NULL for none. */
+    ps_workpool_t *search_pool;
+    ngram_eval_thread_t *eval_threads; /**< Per-thread state for search_pool. */
+
     /* State of procesing. */
     uint8 done;
 
@@ -297,6 +338,17 @@ struct ngram_search_s {
     cand_sf_t *cand_sf;
     bestbp_rc_t *bestbp_rc;
 
+    /**
+     * Cache of trigram scores, an open-addressing hash table keyed
+     * on the three words.  Entries are only valid if their generation
+     * is the current one, so the whole cache is invalidated at the
+     * start of each utterance and when the language model changes by
+     * incrementing lmcache_gen.
+     */
+    lmcache_entry_t *lmcache;
+    int32 lmcache_mask;      /**< Size of lmcache minus one. */
+    int32 lmcache_gen;       /**< Current generation of lmcache. */
+
     bptbl_t *bp_table;       /* Forward pass lattice */
     int32 bpidx;             /* First free BPTable entry */
     int32 bp_table_size;
@@ -306,7 +358,23 @@ struct ngram_search_s {
 
     int32 n_frame_alloc; /**< Number of frames allocated in bp_table_idx and friends. */
     int32 n_frame;       /**< Number of frames actually present. */
-    int32 *bp_table_idx; /* First BPTable entry for each frame */
+    int32 *bp_table_idx; /* First BPTable entry for each frame, starting
+                            at bp_frame_base (use ngram_search_bptbl_idx()) */
+    int32 bp_frame_base; /**< First frame in bp_table_idx. */
+
+    /*
+     * Garbage collection of the backpointer table for endless
+     * utterances (fwdtree only).  Entries that no active path can
+     * reach are dropped, and words that every active path goes
+     * through are final, so they are moved to stable_hyp and their
+     * entries dropped too, except for the last one, bp_stable.
+     */
+    int32 bptbl_gc;      /**< Frames between collections, or 0 for none. */
+    int32 bp_stable;     /**< Last final entry, or NO_BP. */
+    char *stable_hyp;    /**< Final words not yet returned by
+                            ngram_search_stable_hyp(), or NULL.  This
+                            grows until that is called. */
+    char *stable_out;    /**< Words last returned by ngram_search_stable_hyp(). */
     int32 *word_lat_idx; /* BPTable index for any word in current frame;
                             cleared before each frame */
 
@@ -409,6 +477,20 @@ int ngram_search_find_exit(ngram_search_t *ngs, int frame_idx, int32 *out_best_s
  */
 char const *ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx);
 
+/**
+ * First backpointer table entry for frame f (which must not be
+ * before bp_frame_base).
+ */
+#define ngram_search_bptbl_idx(ngs, f) \
+    ((ngs)->bp_table_idx[(f) - (ngs)->bp_frame_base])
+
+/**
+ * Get the words that have become final since the last call.
+ *
+ * @return a <strong>read-only</strong> string, or NULL if there are none.
+ */
+char const *ngram_search_stable_hyp(ngram_search_t *ngs);
+
 /**
  * Compute language and acoustic scores for backpointer table entries.
  */
@@ -419,6 +501,15 @@ void ngram_compute_seg_scores(ngram_search_t *ngs, float32 lwf);
  */
 ps_lattice_t *ngram_search_lattice(ps_search_t *search);
 
+/**
+ * Get the trigram score for a word and its history, from the cache
+ * if possible.
+ *
+ * This is the same as ngram_tg_score() on ngs->lmset, minus the
+ * number of N-Grams used.
+ */
+int32 ngram_search_lm_score(ngram_search_t *ngs, int32 wid, int32 w1, int32 w2);
+
 /**
  * Get the exit score for a backpointer entry with a given right context.
  */
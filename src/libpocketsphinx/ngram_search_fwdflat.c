@@ -56,8 +56,10 @@
 #define __CHAN_DUMP__		0
 #if __CHAN_DUMP__
 #define chan_v_eval(chan) hmm_dump_vit_eval(&(chan)->hmm, stderr)
+#define chan_v_eval_batch(ctx) hmm_dump_vit_eval_batch(ctx, stderr)
 #else
 #define chan_v_eval(chan) hmm_vit_eval(&(chan)->hmm)
+#define chan_v_eval_batch(ctx) hmm_vit_eval_batch(ctx)
 #endif
 
 static void
@@ -383,6 +385,7 @@ ngram_fwdflat_start(ngram_search_t *ngs)
 
     ngs->bpidx = 0;
     ngs->bss_head = 0;
+    ngs->bp_frame_base = 0;
 
     for (i = 0; i < ps_search_n_words(ngs); i++)
         ngs->word_lat_idx[i] = NO_BP;
@@ -414,10 +417,12 @@ ngram_fwdflat_start(ngram_search_t *ngs)
     ngs->st.n_fwdflat_words = 0;
     ngs->st.n_fwdflat_word_transition = 0;
     ngs->st.n_senone_active_utt = 0;
+    ngs->st.n_lmcache_hit = 0;
+    ngs->st.n_lmcache_miss = 0;
 }
 
-static void
-compute_fwdflat_sen_active(ngram_search_t *ngs, int frame_idx)
+void
+ngram_fwdflat_sen_active(ngram_search_t *ngs, int frame_idx)
 {
     int32 i, nw, w;
     int32 *awl;
@@ -458,26 +463,27 @@ fwdflat_eval_chan(ngram_search_t *ngs, int frame_idx)
 
     ngs->st.n_fwdflat_words += nw;
 
-    /* Scan all active words. */
+    /* Scan all active words, queueing their channels for evaluation. */
     for (i = 0; i < nw; i++) {
         w = *(awl++);
         rhmm = (root_chan_t *) ngs->word_chan[w];
         if (hmm_frame(&rhmm->hmm) == frame_idx) {
-            int32 score = chan_v_eval(rhmm);
-            if ((score BETTER_THAN bestscore) && (w != ps_search_finish_wid(ngs)))
-                bestscore = score;
+            /* The final word's score does not count towards the best. */
+            if (w == ps_search_finish_wid(ngs))
+                chan_v_eval(rhmm);
+            else
+                hmm_batch_add(ngs->hmmctx, &rhmm->hmm);
             ngs->st.n_fwdflat_chan++;
         }
 
         for (hmm = rhmm->next; hmm; hmm = hmm->next) {
             if (hmm_frame(&hmm->hmm) == frame_idx) {
-                int32 score = chan_v_eval(hmm);
-                if (score BETTER_THAN bestscore)
-                    bestscore = score;
+                hmm_batch_add(ngs->hmmctx, &hmm->hmm);
                 ngs->st.n_fwdflat_chan++;
             }
         }
     }
+    bestscore = chan_v_eval_batch(ngs->hmmctx);
 
     ngs->best_score = bestscore;
 }
@@ -667,7 +673,7 @@ fwdflat_word_transition(ngram_search_t *ngs, int frame_idx)
     get_expand_wordlist(ngs, cf, ngs->max_sf_win);
 
     /* Scan words exited in current frame */
-    for (b = ngs->bp_table_idx[cf]; b < ngs->bpidx; b++) {
+    for (b = ngram_search_bptbl_idx(ngs, cf); b < ngs->bpidx; b++) {
         xwdssid_t *rssid;
         int32 silscore;
 
@@ -688,8 +694,6 @@ fwdflat_word_transition(ngram_search_t *ngs, int frame_idx)
 
         /* Transition to all successor words. */
         for (i = 0; ngs->expand_word_list[i] >= 0; i++) {
-            int32 n_used;
-
             w = ngs->expand_word_list[i];
 
             /* Get the exit score we recorded in save_bwd_ptr(), or
@@ -702,11 +706,10 @@ fwdflat_word_transition(ngram_search_t *ngs, int frame_idx)
                 continue;
             /* FIXME: Floating point... */
             newscore += lwf
-                * (ngram_tg_score(ngs->lmset,
-                                  dict_basewid(dict, w),
-                                  bp->real_wid,
-                                  bp->prev_real_wid,
-                                  &n_used) >> SENSCR_SHIFT);
+                * (ngram_search_lm_score(ngs,
+                                         dict_basewid(dict, w),
+                                         bp->real_wid,
+                                         bp->prev_real_wid) >> SENSCR_SHIFT);
             newscore += pip;
 
             /* Enter the next word */
@@ -821,7 +824,7 @@ ngram_fwdflat_search(ngram_search_t *ngs, int frame_idx)
 
     /* Activate our HMMs for the current frame if need be. */
     if (!ps_search_acmod(ngs)->compallsen)
-        compute_fwdflat_sen_active(ngs, frame_idx);
+        ngram_fwdflat_sen_active(ngs, frame_idx);
 
     /* Compute GMM scores for the current frame. */
     senscr = acmod_score(ps_search_acmod(ngs), &frame_idx);
@@ -955,6 +958,9 @@ ngram_fwdflat_finish(ngram_search_t *ngs)
         E_INFO("%8d word transitions (%d/fr)\n",
                ngs->st.n_fwdflat_word_transition,
                ngs->st.n_fwdflat_word_transition / (cf + 1));
+        E_INFO("%8d LM scores looked up, %d cached\n",
+               ngs->st.n_lmcache_hit + ngs->st.n_lmcache_miss,
+               ngs->st.n_lmcache_hit);
         E_INFO("fwdflat %.2f CPU %.3f xRT\n",
                ngs->fwdflat_perf.t_cpu,
                ngs->fwdflat_perf.t_cpu / n_speech);
@@ -51,13 +51,17 @@
 /* Local headers. */
 #include "ngram_search_fwdtree.h"
 #include "phone_loop_search.h"
+#include "ps_histprune.h"
+#include "ngram_search_lextree.h"
 
 /* Turn this on to dump channels for debugging */
 #define __CHAN_DUMP__		0
 #if __CHAN_DUMP__
 #define chan_v_eval(chan) hmm_dump_vit_eval(&(chan)->hmm, stderr)
+#define chan_v_eval_batch(ctx) hmm_dump_vit_eval_batch(ctx, stderr)
 #else
 #define chan_v_eval(chan) hmm_vit_eval(&(chan)->hmm)
+#define chan_v_eval_batch(ctx) hmm_vit_eval_batch(ctx)
 #endif
 
 /*
@@ -158,11 +162,71 @@ init_nonroot_chan(ngram_search_t *ngs, chan_t * hmm, int32 ph, int32 ci, int32 t
     hmm->alt = NULL;
     hmm->info.penult_phn_wid = -1;
     hmm->ciphone = ci;
+    hmm->lmla = 0;
     hmm_init(ngs->hmmctx, &hmm->hmm, FALSE, ph, tmatid);
 }
 
 /*
- * Allocate and initialize search channel-tree structure.
+ * Unigram LM score for word w, used for LM lookahead.
+ */
+static int32
+lmla_word_score(ngram_search_t *ngs, int32 w)
+{
+    int32 n_used;
+
+    return ngram_ng_score(ngs->lmset,
+                          dict_basewid(ps_search_dict(ngs), w),
+                          NULL, 0, &n_used) >> SENSCR_SHIFT;
+}
+
+/*
+ * Set the LM lookahead score of hmm and all channels below it, i.e.
+ * the best unigram score of any word whose pronunciation goes through
+ * each channel.  Since a channel's score is never better than its
+ * parent's, the difference can be added as a (non-positive) penalty
+ * when moving down the tree, and is removed again in favour of the
+ * real LM score when entering the last phone of a word.
+ */
+static int32
+set_lmla_subtree(ngram_search_t *ngs, chan_t *hmm)
+{
+    chan_t *child;
+    int32 w, best, score;
+
+    best = WORST_SCORE;
+    for (w = hmm->info.penult_phn_wid; w >= 0; w = ngs->homophone_set[w])
+        if ((score = lmla_word_score(ngs, w)) BETTER_THAN best)
+            best = score;
+    for (child = hmm->next; child; child = child->alt)
+        if ((score = set_lmla_subtree(ngs, child)) BETTER_THAN best)
+            best = score;
+    hmm->lmla = best;
+    return best;
+}
+
+/*
+ * Compute LM lookahead scores for the whole search tree.
+ */
+static void
+set_lmla(ngram_search_t *ngs)
+{
+    root_chan_t *rhmm;
+    chan_t *hmm;
+    int32 i, w, score;
+
+    for (i = 0, rhmm = ngs->root_chan; i < ngs->n_root_chan; i++, rhmm++) {
+        rhmm->lmla = WORST_SCORE;
+        for (w = rhmm->penult_phn_wid; w >= 0; w = ngs->homophone_set[w])
+            if ((score = lmla_word_score(ngs, w)) BETTER_THAN rhmm->lmla)
+                rhmm->lmla = score;
+        for (hmm = rhmm->next; hmm; hmm = hmm->alt)
+            if ((score = set_lmla_subtree(ngs, hmm)) BETTER_THAN rhmm->lmla)
+                rhmm->lmla = score;
+    }
+}
+
+/*
+ * Build the search channel-tree structure from the dictionary.
  * At this point, all the root-channels have been allocated and partly initialized
  * (as per init_search_tree()), and channels for all the single-phone words have been
  * allocated and initialized.  None of the interior channels of search-trees have
@@ -172,7 +236,7 @@ init_nonroot_chan(ngram_search_t *ngs, chan_t * hmm, int32 ph, int32 ci, int32 t
  * search tree to suit the currently active LM.
  */
 static void
-create_search_channels(ngram_search_t *ngs)
+build_search_channels(ngram_search_t *ngs)
 {
     chan_t *hmm;
     root_chan_t *rhmm;
@@ -316,6 +380,34 @@ create_search_channels(ngram_search_t *ngs)
                    ngs->n_1ph_words, dict_wordstr(dict, w));
         ngs->single_phone_wid[ngs->n_1ph_words++] = w;
     }
+}
+
+/*
+ * Allocate and initialize search channel-tree structure, either by
+ * building it or by loading it from a precompiled image (see
+ * ngram_search_lextree.h).  A tree that had to be built is written
+ * back to the image only if write_image is set, which it is not when
+ * the dictionary or language model changes at run time: otherwise
+ * every ps_add_word() would rewrite the image, and decoders sharing it
+ * would keep replacing each other's trees.
+ */
+static void
+create_search_channels(ngram_search_t *ngs, int write_image)
+{
+    char const *imgfile;
+
+    imgfile = cmd_ln_str_r(ps_search_config(ngs), "-lextreeimg");
+    if (imgfile) {
+        uint64 hash = ngram_lextree_hash(ngs);
+
+        if (ngram_lextree_read(ngs, imgfile, hash) < 0) {
+            build_search_channels(ngs);
+            if (write_image)
+                ngram_lextree_write(ngs, imgfile, hash);
+        }
+    }
+    else
+        build_search_channels(ngs);
 
     if (ngs->n_nonroot_chan >= ngs->max_nonroot_chan) {
         /* Give some room for channels for new words added dynamically at run time */
@@ -331,6 +423,8 @@ create_search_channels(ngram_search_t *ngs)
 
     E_INFO("Created %d root, %d non-root channels, %d single-phone words\n",
            ngs->n_root_chan, ngs->n_nonroot_chan, ngs->n_1ph_words);
+    if (ngs->lm_lookahead)
+        set_lmla(ngs);
 
     if (ngs->n_root_chan + ngs->n_1ph_words == 0)
 	E_ERROR("No word from the language model has pronunciation in the dictionary\n");
@@ -373,6 +467,7 @@ reinit_search_tree(ngram_search_t *ngs)
 
         ngs->root_chan[i].penult_phn_wid = -1;
         ngs->root_chan[i].next = NULL;
+        ngs->root_chan[i].lmla = 0;
     }
     ngs->n_nonroot_chan = 0;
 }
@@ -385,8 +480,22 @@ ngram_fwdtree_init(ngram_search_t *ngs)
                                 sizeof(*ngs->bestbp_rc));
     ngs->lastphn_cand = ckd_calloc(ps_search_n_words(ngs),
                                    sizeof(*ngs->lastphn_cand));
+    ngs->lm_lookahead = cmd_ln_boolean_r(ps_search_config(ngs), "-lmlookahead");
+    ngs->search_pool = ps_workpool_init(cmd_ln_int32_r(ps_search_config(ngs),
+                                                       "-nthreads_search"));
+    if (ngs->search_pool) {
+        acmod_t *acmod = ps_search_acmod(ngs);
+        int i, n_threads = ps_workpool_n_threads(ngs->search_pool);
+
+        E_INFO("Evaluating search channels in %d threads\n", n_threads);
+        ngs->eval_threads = ckd_calloc(n_threads, sizeof(*ngs->eval_threads));
+        for (i = 0; i < n_threads; ++i)
+            ngs->eval_threads[i].hmmctx =
+                hmm_context_init(bin_mdef_n_emit_state(acmod->mdef),
+                                 acmod->tmat->tp, NULL, acmod->mdef->sseq);
+    }
     init_search_tree(ngs);
-    create_search_channels(ngs);
+    create_search_channels(ngs, TRUE);
 }
 
 static void
@@ -445,6 +554,15 @@ ngram_fwdtree_deinit(ngram_search_t *ngs)
     ngs->bestbp_rc = NULL;
     ckd_free(ngs->lastphn_cand);
     ngs->lastphn_cand = NULL;
+    if (ngs->search_pool) {
+        int i;
+        for (i = 0; i < ps_workpool_n_threads(ngs->search_pool); ++i)
+            hmm_context_free(ngs->eval_threads[i].hmmctx);
+        ckd_free(ngs->eval_threads);
+        ngs->eval_threads = NULL;
+        ps_workpool_free(ngs->search_pool);
+        ngs->search_pool = NULL;
+    }
 }
 
 int
@@ -463,7 +581,7 @@ ngram_fwdtree_reinit(ngram_search_t *ngs)
                                 sizeof(*ngs->word_chan));
     /* Rebuild the search tree. */
     init_search_tree(ngs);
-    create_search_channels(ngs);
+    create_search_channels(ngs, FALSE);
     return 0;
 }
 
@@ -484,6 +602,10 @@ ngram_fwdtree_start(ngram_search_t *ngs)
     /* Reset backpointer table. */
     ngs->bpidx = 0;
     ngs->bss_head = 0;
+    ngs->bp_frame_base = 0;
+    ngs->bp_stable = NO_BP;
+    ckd_free(ngs->stable_hyp);
+    ngs->stable_hyp = NULL;
 
     /* Reset word lattice. */
     for (i = 0; i < n_words; ++i)
@@ -524,8 +646,8 @@ ngram_fwdtree_start(ngram_search_t *ngs)
  * Mark the active senones for all senones belonging to channels that are active in the
  * current frame.
  */
-static void
-compute_sen_active(ngram_search_t *ngs, int frame_idx)
+void
+ngram_fwdtree_sen_active(ngram_search_t *ngs, int frame_idx)
 {
     root_chan_t *rhmm;
     chan_t *hmm, **acl;
@@ -625,21 +747,18 @@ static int32
 eval_nonroot_chan(ngram_search_t *ngs, int frame_idx)
 {
     chan_t *hmm, **acl;
-    int32 i, bestscore;
+    int32 i;
 
     i = ngs->n_active_chan[frame_idx & 0x1];
     acl = ngs->active_chan_list[frame_idx & 0x1];
-    bestscore = WORST_SCORE;
     ngs->st.n_nonroot_chan_eval += i;
 
     for (hmm = *(acl++); i > 0; --i, hmm = *(acl++)) {
-        int32 score = chan_v_eval(hmm);
         assert(hmm_frame(&hmm->hmm) == frame_idx);
-        if (score BETTER_THAN bestscore)
-            bestscore = score;
+        hmm_batch_add(ngs->hmmctx, &hmm->hmm);
     }
 
-    return bestscore;
+    return chan_v_eval_batch(ngs->hmmctx);
 }
 
 static int32
@@ -660,18 +779,12 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
         assert(ngs->word_chan[w] != NULL);
 
         for (hmm = ngs->word_chan[w]; hmm; hmm = hmm->next) {
-            int32 score;
-
             assert(hmm_frame(&hmm->hmm) == frame_idx);
-            score = chan_v_eval(hmm);
-            /*printf("eval word chan %d score %d\n", w, score); */
-
-            if (score BETTER_THAN bestscore)
-                bestscore = score;
-
+            hmm_batch_add(ngs->hmmctx, &hmm->hmm);
             k++;
         }
     }
+    bestscore = chan_v_eval_batch(ngs->hmmctx);
 
     /* Similarly for statically allocated single-phone words */
     j = 0;
@@ -699,12 +812,139 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
     return bestscore;
 }
 
+/*
+ * Evaluate one worker's share of the root channels, the active
+ * nonroot channels, the active words and the single-phone words.
+ * Evaluating an HMM touches nothing but the HMM itself, so this gives
+ * the same results however the work is divided up.
+ */
+typedef struct eval_work_s {
+    ngram_search_t *ngs;
+    int frame_idx;
+} eval_work_t;
+
+static void
+eval_channels_work(void *arg, int idx, int n_threads)
+{
+    eval_work_t *work = (eval_work_t *)arg;
+    ngram_search_t *ngs = work->ngs;
+    ngram_eval_thread_t *t = ngs->eval_threads + idx;
+    int frame_idx = work->frame_idx;
+    root_chan_t *rhmm;
+    chan_t *hmm, **acl;
+    int32 i, w, score, *awl;
+    int start, end;
+
+    t->best_score = t->last_phone_best_score = WORST_SCORE;
+    t->n_root_chan_eval = t->n_last_chan_eval = t->n_1ph_eval = 0;
+
+    ps_workpool_range(ngs->n_root_chan, idx, n_threads, &start, &end);
+    for (i = start, rhmm = ngs->root_chan + start; i < end; ++i, ++rhmm) {
+        if (hmm_frame(&rhmm->hmm) == frame_idx) {
+            score = chan_v_eval(rhmm);
+            if (score BETTER_THAN t->best_score)
+                t->best_score = score;
+            ++t->n_root_chan_eval;
+        }
+    }
+
+    ps_workpool_range(ngs->n_active_chan[frame_idx & 0x1],
+                      idx, n_threads, &start, &end);
+    acl = ngs->active_chan_list[frame_idx & 0x1];
+    for (i = start; i < end; ++i) {
+        assert(hmm_frame(&acl[i]->hmm) == frame_idx);
+        hmm_batch_add(t->hmmctx, &acl[i]->hmm);
+    }
+    if ((score = chan_v_eval_batch(t->hmmctx)) BETTER_THAN t->best_score)
+        t->best_score = score;
+
+    ps_workpool_range(ngs->n_active_word[frame_idx & 0x1],
+                      idx, n_threads, &start, &end);
+    awl = ngs->active_word_list[frame_idx & 0x1];
+    for (i = start; i < end; ++i) {
+        w = awl[i];
+        assert(bitvec_is_set(ngs->word_active, w));
+        assert(ngs->word_chan[w] != NULL);
+        for (hmm = ngs->word_chan[w]; hmm; hmm = hmm->next) {
+            assert(hmm_frame(&hmm->hmm) == frame_idx);
+            hmm_batch_add(t->hmmctx, &hmm->hmm);
+            ++t->n_last_chan_eval;
+        }
+    }
+    t->last_phone_best_score = chan_v_eval_batch(t->hmmctx);
+
+    ps_workpool_range(ngs->n_1ph_words, idx, n_threads, &start, &end);
+    for (i = start; i < end; ++i) {
+        w = ngs->single_phone_wid[i];
+        rhmm = (root_chan_t *) ngs->word_chan[w];
+        if (hmm_frame(&rhmm->hmm) < frame_idx)
+            continue;
+        score = chan_v_eval(rhmm);
+        if (score BETTER_THAN t->last_phone_best_score
+            && w != ps_search_finish_wid(ngs))
+            t->last_phone_best_score = score;
+        ++t->n_1ph_eval;
+    }
+}
+
+/*
+ * Evaluate all channels using the worker pool, then combine the
+ * per-thread best scores and statistics.
+ */
+static int32
+evaluate_channels_parallel(ngram_search_t *ngs, int frame_idx)
+{
+    eval_work_t work;
+    int32 i, w, *awl, n_threads, k, j, bs;
+
+    work.ngs = ngs;
+    work.frame_idx = frame_idx;
+    ps_workpool_run(ngs->search_pool, eval_channels_work, &work);
+
+    n_threads = ps_workpool_n_threads(ngs->search_pool);
+    ngs->best_score = bs = WORST_SCORE;
+    k = j = 0;
+    for (i = 0; i < n_threads; ++i) {
+        ngram_eval_thread_t *t = ngs->eval_threads + i;
+        if (t->best_score BETTER_THAN ngs->best_score)
+            ngs->best_score = t->best_score;
+        if (t->last_phone_best_score BETTER_THAN bs)
+            bs = t->last_phone_best_score;
+        ngs->st.n_root_chan_eval += t->n_root_chan_eval;
+        k += t->n_last_chan_eval;
+        j += t->n_1ph_eval;
+    }
+    if (bs BETTER_THAN ngs->best_score)
+        ngs->best_score = bs;
+    ngs->last_phone_best_score = bs;
+
+    /* Words are marked active again as they are pruned. */
+    i = ngs->n_active_word[frame_idx & 0x1];
+    awl = ngs->active_word_list[frame_idx & 0x1];
+    for (w = *(awl++); i > 0; --i, w = *(awl++))
+        bitvec_clear(ngs->word_active, w);
+
+    ngs->st.n_nonroot_chan_eval += ngs->n_active_chan[frame_idx & 0x1] + k + j;
+    ngs->st.n_last_chan_eval += k + j;
+    ngs->st.n_word_lastchan_eval +=
+        ngs->n_active_word[frame_idx & 0x1] + j;
+
+    return ngs->best_score;
+}
+
 static int32
 evaluate_channels(ngram_search_t *ngs, int16 const *senone_scores, int frame_idx)
 {
     int32 bs;
 
     hmm_context_set_senscore(ngs->hmmctx, senone_scores);
+    if (ngs->search_pool) {
+        int i;
+        for (i = 0; i < ps_workpool_n_threads(ngs->search_pool); ++i)
+            hmm_context_set_senscore(ngs->eval_threads[i].hmmctx,
+                                     senone_scores);
+        return evaluate_channels_parallel(ngs, frame_idx);
+    }
     ngs->best_score = eval_root_chan(ngs, frame_idx);
     if ((bs = eval_nonroot_chan(ngs, frame_idx)) BETTER_THAN ngs->best_score)
         ngs->best_score = bs;
@@ -753,12 +993,15 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
             newphone_score = hmm_out_score(&rhmm->hmm) + ngs->pip;
             if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
                 for (hmm = rhmm->next; hmm; hmm = hmm->alt) {
-                    int32 pl_newphone_score = newphone_score
+                    /* Apply the change in LM lookahead score (if any). */
+                    int32 la_newphone_score = newphone_score
+                        + hmm->lmla - rhmm->lmla;
+                    int32 pl_newphone_score = la_newphone_score
                         + phone_loop_search_score(pls, hmm->ciphone);
                     if (pl_newphone_score BETTER_THAN newphone_thresh) {
                         if ((hmm_frame(&hmm->hmm) < frame_idx)
-                            || (newphone_score BETTER_THAN hmm_in_score(&hmm->hmm))) {
-                            hmm_enter(&hmm->hmm, newphone_score,
+                            || (la_newphone_score BETTER_THAN hmm_in_score(&hmm->hmm))) {
+                            hmm_enter(&hmm->hmm, la_newphone_score,
                                       hmm_out_history(&rhmm->hmm), nf);
                             *(nacl++) = hmm;
                         }
@@ -783,7 +1026,7 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
                         ngs->n_lastphn_cand++;
                         candp->wid = w;
                         candp->score =
-                            newphone_score - ngs->nwpen;
+                            newphone_score - ngs->nwpen - rhmm->lmla;
                         candp->bp = hmm_out_history(&rhmm->hmm);
                     }
                 }
@@ -832,17 +1075,20 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
             newphone_score = hmm_out_score(&hmm->hmm) + ngs->pip;
             if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
                 for (nexthmm = hmm->next; nexthmm; nexthmm = nexthmm->alt) {
-                    int32 pl_newphone_score = newphone_score
+                    /* Apply the change in LM lookahead score (if any). */
+                    int32 la_newphone_score = newphone_score
+                        + nexthmm->lmla - hmm->lmla;
+                    int32 pl_newphone_score = la_newphone_score
                         + phone_loop_search_score(pls, nexthmm->ciphone);
                     if ((pl_newphone_score BETTER_THAN newphone_thresh)
                         && ((hmm_frame(&nexthmm->hmm) < frame_idx)
-                            || (newphone_score
+                            || (la_newphone_score
                                 BETTER_THAN hmm_in_score(&nexthmm->hmm)))) {
                         if (hmm_frame(&nexthmm->hmm) != nf) {
                             /* Keep this HMM on the active list */
                             *(nacl++) = nexthmm;
                         }
-                        hmm_enter(&nexthmm->hmm, newphone_score,
+                        hmm_enter(&nexthmm->hmm, la_newphone_score,
                                   hmm_out_history(&hmm->hmm), nf);
                     }
                 }
@@ -864,7 +1110,7 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
                         ngs->n_lastphn_cand++;
                         candp->wid = w;
                         candp->score =
-                            newphone_score - ngs->nwpen;
+                            newphone_score - ngs->nwpen - hmm->lmla;
                         candp->bp = hmm_out_history(&hmm->hmm);
                     }
                 }
@@ -966,25 +1212,23 @@ last_phone_transition(ngram_search_t *ngs, int frame_idx)
     /* Compute best LM score and bp for new cands entered in the sorted lists above */
     for (i = 0; i < n_cand_sf; i++) {
         /* For the i-th unique end frame... */
-        bp = ngs->bp_table_idx[ngs->cand_sf[i].bp_ef];
-        bpend = ngs->bp_table_idx[ngs->cand_sf[i].bp_ef + 1];
+        bp = ngram_search_bptbl_idx(ngs, ngs->cand_sf[i].bp_ef);
+        bpend = ngram_search_bptbl_idx(ngs, ngs->cand_sf[i].bp_ef + 1);
         for (bpe = &(ngs->bp_table[bp]); bp < bpend; bp++, bpe++) {
             if (!bpe->valid)
                 continue;
             /* For each candidate at the start frame find bp->cand transition-score */
             for (j = ngs->cand_sf[i].cand; j >= 0; j = candp->next) {
-                int32 n_used;
                 candp = &(ngs->lastphn_cand[j]);
                 dscr = 
                     ngram_search_exit_score
                     (ngs, bpe, dict_first_phone(ps_search_dict(ngs), candp->wid));
                 if (dscr BETTER_THAN WORST_SCORE) {
                     assert(!dict_filler_word(ps_search_dict(ngs), candp->wid));
-                    dscr += ngram_tg_score(ngs->lmset,
-                                           dict_basewid(ps_search_dict(ngs), candp->wid),
-                                           bpe->real_wid,
-                                           bpe->prev_real_wid,
-                                           &n_used)>>SENSCR_SHIFT;
+                    dscr += ngram_search_lm_score(ngs,
+                                                  dict_basewid(ps_search_dict(ngs), candp->wid),
+                                                  bpe->real_wid,
+                                                  bpe->prev_real_wid)>>SENSCR_SHIFT;
                 }
 
                 if (dscr BETTER_THAN ngs->last_ltrans[candp->wid].dscr) {
@@ -1137,42 +1381,25 @@ prune_channels(ngram_search_t *ngs, int frame_idx)
     if (ngs->maxhmmpf != -1
         && ngs->st.n_root_chan_eval + ngs->st.n_nonroot_chan_eval > ngs->maxhmmpf) {
         /* Build a histogram to approximately prune them. */
-        int32 bins[256], bw, nhmms, i;
+        ps_histprune_t hist;
         root_chan_t *rhmm;
         chan_t **acl, *hmm;
+        int32 i;
 
-        /* Bins go from zero (best score) to edge of beam. */
-        bw = -ngs->beam / 256;
-        memset(bins, 0, sizeof(bins));
+        ps_histprune_reset(&hist, ngs->best_score, ngs->beam);
         /* For each active root channel. */
         for (i = 0, rhmm = ngs->root_chan; i < ngs->n_root_chan; i++, rhmm++) {
-            int32 b;
-
-            /* Put it in a bin according to its bestscore. */
-            b = (ngs->best_score - hmm_bestscore(&rhmm->hmm)) / bw;
-            if (b >= 256)
-                b = 255;
-            ++bins[b];
+            if (hmm_frame(&rhmm->hmm) < frame_idx)
+                continue;
+            ps_histprune_add(&hist, hmm_bestscore(&rhmm->hmm));
         }
         /* For each active non-root channel. */
         acl = ngs->active_chan_list[frame_idx & 0x1];       /* currently active HMMs in tree */
         for (i = ngs->n_active_chan[frame_idx & 0x1], hmm = *(acl++);
              i > 0; --i, hmm = *(acl++)) {
-            int32 b;
-
-            /* Put it in a bin according to its bestscore. */
-            b = (ngs->best_score - hmm_bestscore(&hmm->hmm)) / bw;
-            if (b >= 256)
-                b = 255;
-            ++bins[b];
-        }
-        /* Walk down the bins to find the new beam. */
-        for (i = nhmms = 0; i < 256; ++i) {
-            nhmms += bins[i];
-            if (nhmms > ngs->maxhmmpf)
-                break;
+            ps_histprune_add(&hist, hmm_bestscore(&hmm->hmm));
         }
-        ngs->dynamic_beam = -(i * bw);
+        ngs->dynamic_beam = ps_histprune_beam(&hist, ngs->maxhmmpf, ngs->beam);
     }
 
     prune_root_chan(ngs, frame_idx);
@@ -1189,22 +1416,25 @@ static void
 bptable_maxwpf(ngram_search_t *ngs, int frame_idx)
 {
     int32 bp, n;
-    int32 bestscr, worstscr;
-    bptbl_t *bpe, *bestbpe, *worstbpe;
+    int32 bestscr, bestfillscr, thresh;
+    bptbl_t *bpe, *bestbpe;
+    ps_histprune_t hist;
 
     /* Don't prune if no pruing. */
     if (ngs->maxwpf == -1 || ngs->maxwpf == ps_search_n_words(ngs))
         return;
 
     /* Allow only one filler word exit (the best) per frame */
-    bestscr = (int32) 0x80000000;
+    bestscr = bestfillscr = (int32) 0x80000000;
     bestbpe = NULL;
     n = 0;
-    for (bp = ngs->bp_table_idx[frame_idx]; bp < ngs->bpidx; bp++) {
+    for (bp = ngram_search_bptbl_idx(ngs, frame_idx); bp < ngs->bpidx; bp++) {
         bpe = &(ngs->bp_table[bp]);
+        if (bpe->score BETTER_THAN bestscr)
+            bestscr = bpe->score;
         if (dict_filler_word(ps_search_dict(ngs), bpe->wid)) {
-            if (bpe->score BETTER_THAN bestscr) {
-                bestscr = bpe->score;
+            if (bpe->score BETTER_THAN bestfillscr) {
+                bestfillscr = bpe->score;
                 bestbpe = bpe;
             }
             bpe->valid = FALSE;
@@ -1219,22 +1449,22 @@ bptable_maxwpf(ngram_search_t *ngs, int frame_idx)
 
     /* Allow up to maxwpf best entries to survive; mark the remaining with valid = 0 */
     n = (ngs->bpidx
-         - ngs->bp_table_idx[frame_idx]) - n;  /* No. of entries after limiting fillers */
-    for (; n > ngs->maxwpf; --n) {
-        /* Find worst BPTable entry */
-        worstscr = (int32) 0x7fffffff;
-        worstbpe = NULL;
-        for (bp = ngs->bp_table_idx[frame_idx]; (bp < ngs->bpidx); bp++) {
-            bpe = &(ngs->bp_table[bp]);
-            if (bpe->valid && (bpe->score WORSE_THAN worstscr)) {
-                worstscr = bpe->score;
-                worstbpe = bpe;
-            }
-        }
-        /* FIXME: Don't panic! */
-        if (worstbpe == NULL)
-            E_FATAL("PANIC: No worst BPtable entry remaining\n");
-        worstbpe->valid = FALSE;
+         - ngram_search_bptbl_idx(ngs, frame_idx)) - n;  /* No. of entries after limiting fillers */
+    if (n <= ngs->maxwpf)
+        return;
+    /* Word exits all lie within the word beam of the best HMM, so
+     * that is the range covered by the histogram. */
+    ps_histprune_reset(&hist, bestscr, ngs->wbeam);
+    for (bp = ngram_search_bptbl_idx(ngs, frame_idx); bp < ngs->bpidx; bp++) {
+        bpe = &(ngs->bp_table[bp]);
+        if (bpe->valid)
+            ps_histprune_add(&hist, bpe->score);
+    }
+    thresh = bestscr + ps_histprune_beam(&hist, ngs->maxwpf, ngs->wbeam);
+    for (bp = ngram_search_bptbl_idx(ngs, frame_idx); bp < ngs->bpidx; bp++) {
+        bpe = &(ngs->bp_table[bp]);
+        if (bpe->valid && !(bpe->score BETTER_THAN thresh))
+            bpe->valid = FALSE;
     }
 }
 
@@ -1262,7 +1492,7 @@ word_transition(ngram_search_t *ngs, int frame_idx)
     pls = (phone_loop_search_t *)ps_search_lookahead(ngs);
     /* Ugh, this is complicated.  Scan all word exits for this frame
      * (they have already been created by prune_word_chan()). */
-    for (bp = ngs->bp_table_idx[frame_idx]; bp < ngs->bpidx; bp++) {
+    for (bp = ngram_search_bptbl_idx(ngs, frame_idx); bp < ngs->bpidx; bp++) {
         bpe = &(ngs->bp_table[bp]);
         ngs->word_lat_idx[bpe->wid] = NO_BP;
 
@@ -1312,7 +1542,7 @@ word_transition(ngram_search_t *ngs, int frame_idx)
     for (i = ngs->n_root_chan, rhmm = ngs->root_chan; i > 0; --i, rhmm++) {
         bestbp_rc_ptr = &(ngs->bestbp_rc[rhmm->ciphone]);
 
-        newscore = bestbp_rc_ptr->score + ngs->nwpen + ngs->pip;
+        newscore = bestbp_rc_ptr->score + ngs->nwpen + ngs->pip + rhmm->lmla;
         pl_newscore = newscore
             + phone_loop_search_score(pls, rhmm->ciphone);
         if (pl_newscore BETTER_THAN thresh) {
@@ -1337,24 +1567,22 @@ word_transition(ngram_search_t *ngs, int frame_idx)
         w = ngs->single_phone_wid[i];
         ngs->last_ltrans[w].dscr = (int32) 0x80000000;
     }
-    for (bp = ngs->bp_table_idx[frame_idx]; bp < ngs->bpidx; bp++) {
+    for (bp = ngram_search_bptbl_idx(ngs, frame_idx); bp < ngs->bpidx; bp++) {
         bpe = &(ngs->bp_table[bp]);
         if (!bpe->valid)
             continue;
 
         for (i = 0; i < ngs->n_1ph_LMwords; i++) {
-            int32 n_used;
             w = ngs->single_phone_wid[i];
             newscore = ngram_search_exit_score
                 (ngs, bpe, dict_first_phone(dict, w));
             E_DEBUG("initial newscore for %s: %d\n",
                     dict_wordstr(dict, w), newscore);
             if (newscore != WORST_SCORE)
-                newscore += ngram_tg_score(ngs->lmset,
-                                           dict_basewid(dict, w),
-                                           bpe->real_wid,
-                                           bpe->prev_real_wid,
-                                           &n_used)>>SENSCR_SHIFT;
+                newscore += ngram_search_lm_score(ngs,
+                                                  dict_basewid(dict, w),
+                                                  bpe->real_wid,
+                                                  bpe->prev_real_wid)>>SENSCR_SHIFT;
 
             /* FIXME: Not sure how WORST_SCORE could be better, but it
              * apparently happens. */
@@ -1451,6 +1679,238 @@ deactivate_channels(ngram_search_t *ngs, int frame_idx)
     }
 }
 
+/*
+ * Mark (if newidx is NULL) or renumber a reference to the backpointer
+ * table.
+ */
+static void
+gc_history(int32 *hist, uint8 *keep, int32 const *newidx, int32 n_bp)
+{
+    if (*hist < 0 || *hist >= n_bp)
+        return;
+    if (newidx == NULL)
+        keep[*hist] = TRUE;
+    else
+        *hist = keep[*hist] ? newidx[*hist] : NO_BP;
+}
+
+static void
+gc_hmm_history(hmm_t *hmm, uint8 *keep, int32 const *newidx, int32 n_bp)
+{
+    int32 i;
+
+    for (i = 0; i < hmm_n_emit_state(hmm); ++i)
+        gc_history(&hmm_history(hmm, i), keep, newidx, n_bp);
+    gc_history(&hmm_out_history(hmm), keep, newidx, n_bp);
+}
+
+/*
+ * Mark or renumber the histories of all channels active in frame nf.
+ * Inactive channels have been cleared, so they refer to nothing.
+ */
+static void
+gc_live_histories(ngram_search_t *ngs, int nf,
+                  uint8 *keep, int32 const *newidx, int32 n_bp)
+{
+    root_chan_t *rhmm;
+    chan_t *hmm, **acl;
+    int32 i, w, *awl;
+
+    for (i = ngs->n_root_chan, rhmm = ngs->root_chan; i > 0; --i, rhmm++) {
+        if (hmm_frame(&rhmm->hmm) == nf)
+            gc_hmm_history(&rhmm->hmm, keep, newidx, n_bp);
+    }
+    i = ngs->n_active_chan[nf & 0x1];
+    acl = ngs->active_chan_list[nf & 0x1];
+    for (hmm = *(acl++); i > 0; --i, hmm = *(acl++)) {
+        gc_hmm_history(&hmm->hmm, keep, newidx, n_bp);
+    }
+    i = ngs->n_active_word[nf & 0x1];
+    awl = ngs->active_word_list[nf & 0x1];
+    for (w = *(awl++); i > 0; --i, w = *(awl++)) {
+        /* Single-phone words are done below. */
+        if (dict_is_single_phone(ps_search_dict(ngs), w))
+            continue;
+        for (hmm = ngs->word_chan[w]; hmm; hmm = hmm->next)
+            gc_hmm_history(&hmm->hmm, keep, newidx, n_bp);
+    }
+    for (i = 0; i < ngs->n_1ph_words; i++) {
+        rhmm = (root_chan_t *) ngs->word_chan[ngs->single_phone_wid[i]];
+        if (hmm_frame(&rhmm->hmm) == nf)
+            gc_hmm_history(&rhmm->hmm, keep, newidx, n_bp);
+    }
+}
+
+/*
+ * Latest backpointer entry which both a and b go through.
+ */
+static int32
+common_ancestor(ngram_search_t *ngs, int32 a, int32 b)
+{
+    /* Predecessors always come earlier in the table. */
+    while (a != b) {
+        if (a > b)
+            a = ngs->bp_table[a].bp;
+        else
+            b = ngs->bp_table[b].bp;
+    }
+    return a;
+}
+
+/*
+ * Append the words from the last final entry up to bpidx to
+ * stable_hyp.
+ */
+static void
+append_stable_words(ngram_search_t *ngs, int32 bpidx)
+{
+    dict_t *dict = ps_search_dict(ngs);
+    size_t len, old_len;
+    int32 bp;
+    char *c;
+
+    len = 0;
+    for (bp = bpidx; bp != NO_BP && bp != ngs->bp_stable;
+         bp = ngs->bp_table[bp].bp) {
+        if (dict_real_word(dict, ngs->bp_table[bp].wid))
+            len += strlen(dict_basestr(dict, ngs->bp_table[bp].wid)) + 1;
+    }
+    if (len == 0)
+        return;
+
+    /* Including the space before the new words. */
+    old_len = ngs->stable_hyp ? strlen(ngs->stable_hyp) + 1 : 0;
+    ngs->stable_hyp = ckd_realloc(ngs->stable_hyp, old_len + len);
+    if (old_len)
+        ngs->stable_hyp[old_len - 1] = ' ';
+    c = ngs->stable_hyp + old_len + len - 1;
+    *c = '\0';
+    for (bp = bpidx; bp != NO_BP && bp != ngs->bp_stable;
+         bp = ngs->bp_table[bp].bp) {
+        int32 wid = ngs->bp_table[bp].wid;
+        size_t wlen;
+
+        if (!dict_real_word(dict, wid))
+            continue;
+        wlen = strlen(dict_basestr(dict, wid));
+        c -= wlen;
+        memcpy(c, dict_basestr(dict, wid), wlen);
+        if (c > ngs->stable_hyp + old_len)
+            *--c = ' ';
+    }
+}
+
+/*
+ * Garbage-collect the backpointer table at the end of a frame, so
+ * that it does not grow without limit in an endless utterance.
+ *
+ * Entries that active channels refer to are kept, along with all
+ * other word exits in the same frames, since last_phone_transition()
+ * may still pick any of them as the predecessor of a word, and all of
+ * their ancestors.  The latest entry which all of those go through
+ * can never change, so the words up to it are moved to stable_hyp and
+ * its own predecessors are forgotten.  Everything else is dropped and
+ * the tables are compacted.  This does not change the search results.
+ */
+static void
+gc_bptable(ngram_search_t *ngs, int frame_idx)
+{
+    int32 nf, n_bp, bp, f, base, lca, n_kept, bss_head, w;
+    int first;
+    uint8 *keep;
+    int32 *newidx;
+
+    nf = frame_idx + 1;
+    n_bp = ngs->bpidx;
+    if (n_bp == 0)
+        return;
+    keep = ckd_calloc(n_bp, sizeof(*keep));
+    newidx = ckd_calloc(n_bp + 1, sizeof(*newidx));
+
+    /* Find all frames with exits that active channels refer to. */
+    gc_live_histories(ngs, nf, keep, NULL, n_bp);
+    base = frame_idx;
+    lca = NO_BP;
+    first = TRUE;
+    for (f = ngs->bp_frame_base; f <= frame_idx; ++f) {
+        int32 start, end;
+
+        start = ngram_search_bptbl_idx(ngs, f);
+        end = (f == frame_idx) ? n_bp : ngram_search_bptbl_idx(ngs, f + 1);
+        for (bp = start; bp < end && !keep[bp]; ++bp)
+            ;
+        if (bp == end)
+            continue;
+        if (f < base)
+            base = f;
+        for (bp = start; bp < end; ++bp) {
+            keep[bp] = TRUE;
+            if (first)
+                lca = bp;
+            else if (lca != NO_BP)
+                lca = common_ancestor(ngs, lca, bp);
+            first = FALSE;
+        }
+    }
+
+    /* Everything up to their common ancestor is final. */
+    if (lca != NO_BP && lca != ngs->bp_stable) {
+        append_stable_words(ngs, lca);
+        ngs->bp_stable = lca;
+        ngs->bp_table[lca].bp = NO_BP;
+    }
+
+    /* Keep the ancestors of the entries kept so far. */
+    for (bp = n_bp - 1; bp >= 0; --bp) {
+        if (keep[bp] && ngs->bp_table[bp].bp != NO_BP)
+            keep[ngs->bp_table[bp].bp] = TRUE;
+    }
+
+    /* Compact the backpointer table and score stack. */
+    n_kept = bss_head = 0;
+    for (bp = 0; bp < n_bp; ++bp) {
+        bptbl_t *be = ngs->bp_table + bp;
+
+        newidx[bp] = n_kept;
+        if (!keep[bp])
+            continue;
+        if (be->s_idx != -1) {
+            int32 rcsize = dict2pid_rssid(ps_search_dict2pid(ngs),
+                                          be->last_phone,
+                                          be->last2_phone)->n_ssid;
+            memmove(ngs->bscore_stack + bss_head,
+                    ngs->bscore_stack + be->s_idx,
+                    rcsize * sizeof(*ngs->bscore_stack));
+            be->s_idx = bss_head;
+            bss_head += rcsize;
+        }
+        if (be->bp != NO_BP)
+            be->bp = newidx[be->bp];
+        ngs->bp_table[n_kept++] = *be;
+    }
+    newidx[n_bp] = n_kept;
+    E_DEBUG("Frame %d: kept %d of %d backpointers\n", frame_idx, n_kept, n_bp);
+    ngs->bpidx = n_kept;
+    ngs->bss_head = bss_head;
+
+    /* Renumber everything that refers to it. */
+    gc_live_histories(ngs, nf, keep, newidx, n_bp);
+    if (ngs->bp_stable != NO_BP)
+        ngs->bp_stable = newidx[ngs->bp_stable];
+    for (f = base; f <= frame_idx; ++f)
+        ngram_search_bptbl_idx(ngs, f) = newidx[ngram_search_bptbl_idx(ngs, f)];
+    memmove(ngs->bp_table_idx,
+            ngs->bp_table_idx + (base - ngs->bp_frame_base),
+            (frame_idx + 1 - base) * sizeof(*ngs->bp_table_idx));
+    ngs->bp_frame_base = base;
+    /* Best transitions into last phones will be found again. */
+    for (w = 0; w < ps_search_n_words(ngs); ++w)
+        ngs->last_ltrans[w].sf = -1;
+
+    ckd_free(keep);
+    ckd_free(newidx);
+}
+
 int
 ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
 {
@@ -1458,7 +1918,7 @@ ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
 
     /* Activate our HMMs for the current frame if need be. */
     if (!ps_search_acmod(ngs)->compallsen)
-        compute_sen_active(ngs, frame_idx);
+        ngram_fwdtree_sen_active(ngs, frame_idx);
 
     /* Compute GMM scores for the current frame. */
     if ((senscr = acmod_score(ps_search_acmod(ngs), &frame_idx)) == NULL)
@@ -1489,6 +1949,9 @@ ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
     word_transition(ngs, frame_idx);
     /* Deactivate pruned HMMs. */
     deactivate_channels(ngs, frame_idx);
+    /* Forget backpointers that no active path can reach. */
+    if (ngs->bptbl_gc > 0 && (frame_idx + 1) % ngs->bptbl_gc == 0)
+        gc_bptable(ngs, frame_idx);
 
     ++ngs->n_frame;
     /* Return the number of frames processed. */
@@ -1559,6 +2022,9 @@ ngram_fwdtree_finish(ngram_search_t *ngs)
                ngs->st.n_word_lastchan_eval / (cf + 1));
         E_INFO("%8d candidate words for entering last phone (%d/fr)\n",
                ngs->st.n_lastphn_cand_utt, ngs->st.n_lastphn_cand_utt / (cf + 1));
+        E_INFO("%8d LM scores looked up, %d cached\n",
+               ngs->st.n_lmcache_hit + ngs->st.n_lmcache_miss,
+               ngs->st.n_lmcache_hit);
         E_INFO("fwdtree %.2f CPU %.3f xRT\n",
                ngs->fwdtree_perf.t_cpu,
                ngs->fwdtree_perf.t_cpu / n_speech);
@@ -74,6 +74,11 @@ void ngram_fwdtree_start(ngram_search_t *ngs);
  */
 int ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx);
 
+/**
+ * Activate the senones needed to search one frame.
+ */
+void ngram_fwdtree_sen_active(ngram_search_t *ngs, int frame_idx);
+
 /**
  * Finish fwdtree decoding for an utterance.
  */
@@ -0,0 +1,422 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ngram_search_lextree.c Precompiled lexicon tree images.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* System headers. */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#elif defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#else
+#define getpid() 0
+#endif
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/listelem_alloc.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/err.h>
+
+/* Local headers. */
+#include "ngram_search_lextree.h"
+
+#define LEXTREE_HDR_SIZE (sizeof(lextree_hdr_t) / sizeof(int32))
+#define LEXTREE_REC_SIZE (sizeof(lextree_node_t) / sizeof(int32))
+
+/* 64-bit FNV-1a, one 32-bit value at a time. */
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64
+hash_int32(uint64 h, int32 val)
+{
+    uint32 v = (uint32)val;
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        h ^= v & 0xff;
+        h *= FNV_PRIME;
+        v >>= 8;
+    }
+    return h;
+}
+
+uint64
+ngram_lextree_hash(ngram_search_t *ngs)
+{
+    dict_t *dict = ps_search_dict(ngs);
+    dict2pid_t *d2p = ps_search_dict2pid(ngs);
+    bin_mdef_t *mdef = ps_search_acmod(ngs)->mdef;
+    int32 w, p, n_words;
+    uint64 h;
+
+    h = FNV_OFFSET;
+    h = hash_int32(h, LEXTREE_VERSION);
+    /* Phones of the acoustic model. */
+    h = hash_int32(h, bin_mdef_n_ciphone(mdef));
+    h = hash_int32(h, bin_mdef_silphone(mdef));
+    for (p = 0; p < bin_mdef_n_ciphone(mdef); ++p) {
+        h = hash_int32(h, bin_mdef_pid2ssid(mdef, p));
+        h = hash_int32(h, bin_mdef_pid2tmatid(mdef, p));
+    }
+    /* Pronunciations, the triphones chosen for them, and whether
+     * each word is in the language model. */
+    n_words = ps_search_n_words(ngs);
+    h = hash_int32(h, n_words);
+    for (w = 0; w < n_words; ++w) {
+        h = hash_int32(h, dict_real_word(dict, w));
+        h = hash_int32(h, ngram_model_set_known_wid(ngs->lmset,
+                                                    dict_basewid(dict, w)));
+        h = hash_int32(h, dict_pronlen(dict, w));
+        for (p = 0; p < dict_pronlen(dict, w); ++p) {
+            h = hash_int32(h, dict_pron(dict, w, p));
+            if (p > 0 && p < dict_pronlen(dict, w) - 1)
+                h = hash_int32(h, dict2pid_internal(d2p, w, p));
+        }
+    }
+    return h;
+}
+
+/*
+ * Recreate the subtree starting at node idx (and its siblings).
+ */
+static chan_t *
+load_subtree(ngram_search_t *ngs, lextree_node_t const *nodes, int32 idx)
+{
+    chan_t *hmm;
+
+    if (idx < 0)
+        return NULL;
+    hmm = listelem_malloc(ngs->chan_alloc);
+    hmm->ciphone = nodes[idx].ciphone;
+    hmm->info.penult_phn_wid = nodes[idx].penult_phn_wid;
+    hmm->lmla = 0;
+    hmm_init(ngs->hmmctx, &hmm->hmm, FALSE,
+             nodes[idx].ssid, nodes[idx].tmatid);
+    ++ngs->n_nonroot_chan;
+    hmm->next = load_subtree(ngs, nodes, nodes[idx].next);
+    hmm->alt = load_subtree(ngs, nodes, nodes[idx].alt);
+    return hmm;
+}
+
+/*
+ * Check that all the indices in an image are in range, and that each
+ * non-root channel has exactly one parent (or previous sibling), so
+ * that the image really is a tree.  Children and siblings always come
+ * after their parents, which rules out cycles.
+ */
+static int
+check_image(ngram_search_t *ngs, lextree_hdr_t const *hdr,
+            lextree_root_t const *roots, lextree_node_t const *nodes,
+            int32 const *homophone_set, int32 const *single_phone_wid)
+{
+    acmod_t *acmod = ps_search_acmod(ngs);
+    int32 n_ciphone = bin_mdef_n_ciphone(acmod->mdef);
+    int32 n_sseq = bin_mdef_n_sseq(acmod->mdef);
+    uint8 *refs;
+    int32 i;
+    int rv = -1;
+
+#define CHECK_WID(w) ((w) >= -1 && (w) < hdr->n_words)
+#define CHECK_NODE(n, i) ((n) == -1 || ((n) > (i) && (n) < hdr->n_nonroot_chan))
+#define CHECK_RANGE(x, n) ((x) >= 0 && (x) < (n))
+#define ADD_REF(n) ((n) == -1 || refs[n]++ == 0)
+    refs = ckd_calloc(hdr->n_nonroot_chan + 1, sizeof(*refs));
+    for (i = 0; i < hdr->n_root_chan; ++i) {
+        if (!CHECK_RANGE(roots[i].ciphone, n_ciphone)
+            || !CHECK_RANGE(roots[i].ci2phone, n_ciphone)
+            || !CHECK_RANGE(roots[i].ssid, n_sseq)
+            || !CHECK_RANGE(roots[i].tmatid, acmod->tmat->n_tmat)
+            || !CHECK_WID(roots[i].penult_phn_wid)
+            || !CHECK_NODE(roots[i].next, -1)
+            || !ADD_REF(roots[i].next))
+            goto error_out;
+    }
+    for (i = 0; i < hdr->n_nonroot_chan; ++i) {
+        if (!CHECK_RANGE(nodes[i].ciphone, n_ciphone)
+            || !CHECK_RANGE(nodes[i].ssid, n_sseq)
+            || !CHECK_RANGE(nodes[i].tmatid, acmod->tmat->n_tmat)
+            || !CHECK_WID(nodes[i].penult_phn_wid)
+            || !CHECK_NODE(nodes[i].next, i)
+            || !CHECK_NODE(nodes[i].alt, i)
+            || !ADD_REF(nodes[i].next)
+            || !ADD_REF(nodes[i].alt))
+            goto error_out;
+    }
+    for (i = 0; i < hdr->n_nonroot_chan; ++i)
+        if (refs[i] != 1)
+            goto error_out;
+    for (i = 0; i < hdr->n_words; ++i)
+        if (!CHECK_WID(homophone_set[i]))
+            goto error_out;
+    for (i = 0; i < hdr->n_1ph_words; ++i)
+        if (!CHECK_RANGE(single_phone_wid[i], hdr->n_words))
+            goto error_out;
+    rv = 0;
+#undef CHECK_WID
+#undef CHECK_NODE
+#undef CHECK_RANGE
+#undef ADD_REF
+
+error_out:
+    ckd_free(refs);
+    return rv;
+}
+
+int
+ngram_lextree_read(ngram_search_t *ngs, char const *file, uint64 hash)
+{
+    lextree_hdr_t const *hdr;
+    lextree_root_t const *roots;
+    lextree_node_t const *nodes;
+    int32 const *homophone_set, *single_phone_wid;
+    mmio_file_t *filemap = NULL;
+    void *data = NULL;
+    int32 const *ptr;
+    size_t size;
+    FILE *fh;
+    int32 i;
+
+    /* Find out whether it's there and how big it is (quietly, as the
+     * first decoder to use an image won't find one). */
+    if ((fh = fopen(file, "rb")) == NULL) {
+        E_INFO("No lexicon tree image %s, will create it\n", file);
+        return -1;
+    }
+    fseek(fh, 0, SEEK_END);
+    size = ftell(fh);
+    if (size < sizeof(*hdr)) {
+        E_WARN("Lexicon tree image %s is truncated\n", file);
+        fclose(fh);
+        return -1;
+    }
+    if (cmd_ln_boolean_r(ps_search_config(ngs), "-mmap"))
+        filemap = mmio_file_read(file);
+    if (filemap) {
+        fclose(fh);
+        ptr = mmio_file_ptr(filemap);
+    }
+    else {
+        fseek(fh, 0, SEEK_SET);
+        data = ckd_malloc(size);
+        if (fread(data, 1, size, fh) != size) {
+            E_ERROR_SYSTEM("Failed to read lexicon tree image %s", file);
+            fclose(fh);
+            ckd_free(data);
+            return -1;
+        }
+        fclose(fh);
+        ptr = data;
+    }
+
+    hdr = (lextree_hdr_t const *)ptr;
+    if (hdr->magic != LEXTREE_MAGIC || hdr->version != LEXTREE_VERSION) {
+        E_WARN("%s is not a lexicon tree image for this machine\n", file);
+        goto error_out;
+    }
+    if (hdr->hash[0] != (uint32)hash || hdr->hash[1] != (uint32)(hash >> 32)
+        || hdr->n_words != ps_search_n_words(ngs)) {
+        E_INFO("Lexicon tree image %s is out of date\n", file);
+        goto error_out;
+    }
+    if (hdr->n_root_chan < 0 || hdr->n_root_chan > ngs->n_root_chan_alloc
+        || hdr->n_1ph_LMwords < 0 || hdr->n_1ph_LMwords > hdr->n_1ph_words
+        || hdr->n_1ph_words > ngs->n_1ph_words
+        || hdr->n_nonroot_chan < 0
+        || size != sizeof(int32) * (LEXTREE_HDR_SIZE
+                                    + (size_t)(hdr->n_root_chan
+                                               + hdr->n_nonroot_chan)
+                                    * LEXTREE_REC_SIZE
+                                    + hdr->n_words + hdr->n_1ph_words)) {
+        E_WARN("Lexicon tree image %s is corrupt\n", file);
+        goto error_out;
+    }
+    roots = (lextree_root_t const *)(ptr + LEXTREE_HDR_SIZE);
+    nodes = (lextree_node_t const *)(roots + hdr->n_root_chan);
+    homophone_set = (int32 const *)(nodes + hdr->n_nonroot_chan);
+    single_phone_wid = homophone_set + hdr->n_words;
+    if (check_image(ngs, hdr, roots, nodes,
+                    homophone_set, single_phone_wid) < 0) {
+        E_WARN("Lexicon tree image %s is corrupt\n", file);
+        goto error_out;
+    }
+
+    E_INFO("Loading search channels from %s\n", file);
+    ngs->n_nonroot_chan = 0;
+    for (i = 0; i < hdr->n_root_chan; ++i) {
+        root_chan_t *rhmm = &ngs->root_chan[i];
+
+        rhmm->ciphone = roots[i].ciphone;
+        rhmm->ci2phone = roots[i].ci2phone;
+        rhmm->hmm.tmatid = roots[i].tmatid;
+        hmm_mpx_ssid(&rhmm->hmm, 0) = roots[i].ssid;
+        rhmm->penult_phn_wid = roots[i].penult_phn_wid;
+        rhmm->next = load_subtree(ngs, nodes, roots[i].next);
+    }
+    ngs->n_root_chan = hdr->n_root_chan;
+    memcpy(ngs->homophone_set, homophone_set,
+           hdr->n_words * sizeof(*ngs->homophone_set));
+    memcpy(ngs->single_phone_wid, single_phone_wid,
+           hdr->n_1ph_words * sizeof(*ngs->single_phone_wid));
+    ngs->n_1ph_LMwords = hdr->n_1ph_LMwords;
+    ngs->n_1ph_words = hdr->n_1ph_words;
+
+    if (filemap)
+        mmio_file_unmap(filemap);
+    ckd_free(data);
+    return 0;
+
+error_out:
+    if (filemap)
+        mmio_file_unmap(filemap);
+    ckd_free(data);
+    return -1;
+}
+
+/*
+ * Flatten the subtree starting at hmm (and its siblings) in preorder.
+ */
+static int32
+save_subtree(lextree_node_t *nodes, int32 *n_nodes, chan_t *hmm)
+{
+    int32 idx;
+
+    if (hmm == NULL)
+        return -1;
+    idx = (*n_nodes)++;
+    nodes[idx].ssid = hmm_nonmpx_ssid(&hmm->hmm);
+    nodes[idx].ciphone = hmm->ciphone;
+    nodes[idx].tmatid = hmm_tmatid(&hmm->hmm);
+    nodes[idx].penult_phn_wid = hmm->info.penult_phn_wid;
+    nodes[idx].next = save_subtree(nodes, n_nodes, hmm->next);
+    nodes[idx].alt = save_subtree(nodes, n_nodes, hmm->alt);
+    return idx;
+}
+
+int
+ngram_lextree_write(ngram_search_t *ngs, char const *file, uint64 hash)
+{
+    lextree_hdr_t hdr;
+    lextree_root_t *roots;
+    lextree_node_t *nodes;
+    int32 i, n_nodes;
+    char suffix[64];
+    char *tmpfile;
+    FILE *fh;
+    int rv = -1;
+
+    roots = ckd_calloc(ngs->n_root_chan + 1, sizeof(*roots));
+    nodes = ckd_calloc(ngs->n_nonroot_chan + 1, sizeof(*nodes));
+    n_nodes = 0;
+    for (i = 0; i < ngs->n_root_chan; ++i) {
+        root_chan_t *rhmm = &ngs->root_chan[i];
+
+        roots[i].ciphone = rhmm->ciphone;
+        roots[i].ci2phone = rhmm->ci2phone;
+        roots[i].ssid = hmm_mpx_ssid(&rhmm->hmm, 0);
+        roots[i].tmatid = hmm_tmatid(&rhmm->hmm);
+        roots[i].penult_phn_wid = rhmm->penult_phn_wid;
+        roots[i].next = save_subtree(nodes, &n_nodes, rhmm->next);
+    }
+    assert(n_nodes == ngs->n_nonroot_chan);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = LEXTREE_MAGIC;
+    hdr.version = LEXTREE_VERSION;
+    hdr.hash[0] = (uint32)hash;
+    hdr.hash[1] = (uint32)(hash >> 32);
+    hdr.n_words = ps_search_n_words(ngs);
+    hdr.n_root_chan = ngs->n_root_chan;
+    hdr.n_nonroot_chan = n_nodes;
+    hdr.n_1ph_LMwords = ngs->n_1ph_LMwords;
+    hdr.n_1ph_words = ngs->n_1ph_words;
+
+    /* Write to a temporary file next to the image, named so that
+     * other processes or decoders writing the same image at the same
+     * time don't use it too. */
+    sprintf(suffix, ".%ld.%p.tmp", (long)getpid(), (void *)ngs);
+    tmpfile = string_join(file, suffix, NULL);
+    if ((fh = fopen(tmpfile, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s for writing", tmpfile);
+        goto error_out;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, fh) != 1
+        || fwrite(roots, sizeof(*roots), ngs->n_root_chan, fh)
+        != (size_t)ngs->n_root_chan
+        || fwrite(nodes, sizeof(*nodes), n_nodes, fh) != (size_t)n_nodes
+        || fwrite(ngs->homophone_set, sizeof(*ngs->homophone_set),
+                  hdr.n_words, fh) != (size_t)hdr.n_words
+        || fwrite(ngs->single_phone_wid, sizeof(*ngs->single_phone_wid),
+                  hdr.n_1ph_words, fh) != (size_t)hdr.n_1ph_words) {
+        E_ERROR_SYSTEM("Failed to write lexicon tree image %s", tmpfile);
+        fclose(fh);
+        remove(tmpfile);
+        goto error_out;
+    }
+    if (fclose(fh) != 0) {
+        E_ERROR_SYSTEM("Failed to write lexicon tree image %s", tmpfile);
+        remove(tmpfile);
+        goto error_out;
+    }
+#ifdef _WIN32
+    /* Windows won't rename over an existing file. */
+    remove(file);
+#endif
+    if (rename(tmpfile, file) != 0) {
+        E_ERROR_SYSTEM("Failed to rename %s to %s", tmpfile, file);
+        remove(tmpfile);
+        goto error_out;
+    }
+    E_INFO("Wrote lexicon tree image %s\n", file);
+    rv = 0;
+
+error_out:
+    ckd_free(tmpfile);
+    ckd_free(roots);
+    ckd_free(nodes);
+    return rv;
+}
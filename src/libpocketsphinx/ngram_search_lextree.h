@@ -0,0 +1,140 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ngram_search_lextree.h Precompiled lexicon tree images.
+ *
+ * Building the lexicon tree for fwdtree search means finding the
+ * root and interior channels for every phone of every word in the
+ * dictionary, which takes a noticeable amount of time with large
+ * dictionaries.  Since the tree only depends on the pronunciations,
+ * the acoustic model's phone set and the set of words known to the
+ * language model, it can be written out once and loaded directly
+ * from then on, as long as a hash of those inputs matches.
+ *
+ * The image is a flat array of 32-bit integers in the byte order of
+ * the machine that wrote it, meant to be memory-mapped:
+ *
+ * (9 words) header, as in lextree_hdr_t
+ * (n_root_chan * 6 words) root channels, as in lextree_root_t
+ * (n_nonroot_chan * 6 words) non-root channels in preorder, as in
+ *                            lextree_node_t
+ * (n_words words) homophone_set
+ * (n_1ph_words words) single_phone_wid
+ *
+ * Channels refer to their children and siblings by index in the
+ * non-root channel array, or -1 for none.
+ */
+
+#ifndef __NGRAM_SEARCH_LEXTREE_H__
+#define __NGRAM_SEARCH_LEXTREE_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+/* Local headers. */
+#include "ngram_search.h"
+
+#define LEXTREE_MAGIC 0x4954584c /* 'LXTI' in little-endian order */
+#define LEXTREE_VERSION 1
+
+/**
+ * Header of a lexicon tree image.
+ */
+typedef struct lextree_hdr_s {
+    uint32 magic;          /**< LEXTREE_MAGIC. */
+    int32 version;         /**< LEXTREE_VERSION. */
+    uint32 hash[2];        /**< Hash of inputs, low word first. */
+    int32 n_words;         /**< Number of words in dictionary. */
+    int32 n_root_chan;     /**< Number of root channels. */
+    int32 n_nonroot_chan;  /**< Number of non-root channels. */
+    int32 n_1ph_LMwords;   /**< Number of single-phone words in the LM. */
+    int32 n_1ph_words;     /**< Number of single-phone words in total. */
+} lextree_hdr_t;
+
+/**
+ * Root channel in a lexicon tree image.
+ */
+typedef struct lextree_root_s {
+    int32 ciphone;         /**< First CI phone. */
+    int32 ci2phone;        /**< Second CI phone. */
+    int32 ssid;            /**< Senone sequence of the first CI phone. */
+    int32 tmatid;          /**< Transition matrix. */
+    int32 penult_phn_wid;  /**< First two-phone word ending below it, or -1. */
+    int32 next;            /**< First child, or -1. */
+} lextree_root_t;
+
+/**
+ * Non-root channel in a lexicon tree image.
+ */
+typedef struct lextree_node_s {
+    int32 ssid;            /**< Senone sequence. */
+    int32 ciphone;         /**< CI phone. */
+    int32 tmatid;          /**< Transition matrix. */
+    int32 penult_phn_wid;  /**< First word whose last phone follows it, or -1. */
+    int32 next;            /**< First child, or -1. */
+    int32 alt;             /**< Next sibling, or -1. */
+} lextree_node_t;
+
+/**
+ * Compute the hash of everything the lexicon tree depends on, i.e.
+ * the dictionary, the phones of the acoustic model, and the set of
+ * words in the current language model.
+ */
+uint64 ngram_lextree_hash(ngram_search_t *ngs);
+
+/**
+ * Load the lexicon tree from an image.
+ *
+ * This takes the place of create_search_channels(), i.e. the root
+ * channels and single-phone word channels must already have been
+ * allocated, and there must not be any non-root channels.
+ *
+ * @param hash Hash of current inputs, from ngram_lextree_hash().
+ * @return 0 for success, <0 if the image does not exist, is invalid
+ *         or does not match, in which case the tree is left empty.
+ */
+int ngram_lextree_read(ngram_search_t *ngs, char const *file, uint64 hash);
+
+/**
+ * Write the current lexicon tree to an image.
+ *
+ * The image is written to a temporary file first, then renamed, so
+ * that several decoders starting at once don't see partial images.
+ *
+ * @return 0 for success, <0 on failure.
+ */
+int ngram_lextree_write(ngram_search_t *ngs, char const *file, uint64 hash);
+
+#endif /* __NGRAM_SEARCH_LEXTREE_H__ */
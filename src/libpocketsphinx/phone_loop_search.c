@@ -62,6 +62,7 @@ static ps_searchfuncs_t phone_loop_search_funcs = {
     /* hyp: */      phone_loop_search_hyp,
     /* prob: */     phone_loop_search_prob,
     /* seg_iter: */ phone_loop_search_seg_iter,
+    /* sen_active: */ NULL,
 };
 
 static int
@@ -201,23 +202,18 @@ renormalize_hmms(phone_loop_search_t *pls, int frame_idx, int32 norm)
 static void
 evaluate_hmms(phone_loop_search_t *pls, int16 const *senscr, int frame_idx)
 {
-    int32 bs = WORST_SCORE;
     int i;
 
     hmm_context_set_senscore(pls->hmmctx, senscr);
 
     for (i = 0; i < pls->n_phones; ++i) {
         hmm_t *hmm = (hmm_t *)&pls->hmms[i];
-        int32 score;
 
         if (hmm_frame(hmm) < frame_idx)
             continue;
-        score = hmm_vit_eval(hmm);
-        if (score BETTER_THAN bs) {
-            bs = score;
-        }
+        hmm_batch_add(pls->hmmctx, hmm);
     }
-    pls->best_score = bs;
+    pls->best_score = hmm_vit_eval_batch(pls->hmmctx);
 }
 
 static void
@@ -63,6 +63,7 @@
 #include "ngram_search_fwdtree.h"
 #include "ngram_search_fwdflat.h"
 #include "allphone_search.h"
+#include "wfst_search.h"
 
 static const arg_t ps_args_def[] = {
     POCKETSPHINX_OPTIONS,
@@ -94,6 +95,23 @@ hmmdir_exists(const char *path)
 }
 #endif
 
+static int ps_pipeline_search(void *arg);
+
+/* Keep the decoding thread, if any, out of the search. */
+static void
+ps_lock_search(ps_decoder_t *ps)
+{
+    if (ps->pipeline)
+        ps_pipeline_lock(ps->pipeline);
+}
+
+static void
+ps_unlock_search(ps_decoder_t *ps)
+{
+    if (ps->pipeline)
+        ps_pipeline_unlock(ps->pipeline);
+}
+
 static void
 ps_expand_file_config(ps_decoder_t *ps, const char *arg, const char *extra_arg,
 	              const char *hmmdir, const char *file)
@@ -139,6 +157,7 @@ ps_expand_model_config(ps_decoder_t *ps)
     ps_expand_file_config(ps, "-tmat", "_tmat", hmmdir, "transition_matrices");
     ps_expand_file_config(ps, "-mixw", "_mixw", hmmdir, "mixture_weights");
     ps_expand_file_config(ps, "-sendump", "_sendump", hmmdir, "sendump");
+    ps_expand_file_config(ps, "-kdtree", "_kdtree", hmmdir, "kdtrees");
     ps_expand_file_config(ps, "-fdict", "_fdict", hmmdir, "noisedict");
     ps_expand_file_config(ps, "-lda", "_lda", hmmdir, "feature_transform");
     ps_expand_file_config(ps, "-featparams", "_featparams", hmmdir, "feat.params");
@@ -170,10 +189,31 @@ ps_free_searches(ps_decoder_t *ps)
         hash_table_free(ps->searches);
     }
 
+    glist_free(ps->extra_searches);
+    ps->extra_searches = NULL;
     ps->searches = NULL;
     ps->search = NULL;
 }
 
+/* Remove a search from the list of extra searches, if it is there. */
+static int
+ps_remove_extra_search(ps_decoder_t *ps, ps_search_t *search)
+{
+    gnode_t *gn, *prev;
+
+    for (prev = NULL, gn = ps->extra_searches; gn;
+         prev = gn, gn = gnode_next(gn)) {
+        if (gnode_ptr(gn) == search) {
+            if (prev)
+                gnode_free(gn, prev);
+            else
+                ps->extra_searches = gnode_free(gn, NULL);
+            return 0;
+        }
+    }
+    return -1;
+}
+
 static ps_search_t *
 ps_find_search(ps_decoder_t *ps, char const *name)
 {
@@ -202,6 +242,7 @@ ps_default_search_args(cmd_ln_t *config)
         && !cmd_ln_str_r(config, "-lmctl")
         && !cmd_ln_str_r(config, "-kws")
         && !cmd_ln_str_r(config, "-keyphrase")
+        && !cmd_ln_str_r(config, "-wfst")
         && file_exists(MODELDIR "/en-us/en-us.lm.bin")) {
         lmfile = MODELDIR "/en-us/en-us.lm.bin";
         cmd_ln_set_str_r(config, "-lm", lmfile);
@@ -246,7 +287,9 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
     ps_free_searches(ps);
     ps->searches = hash_table_new(3, HASH_CASE_YES);
 
-    /* Free old acmod. */
+    /* Free old pipeline and acmod. */
+    ps_pipeline_free(ps->pipeline);
+    ps->pipeline = NULL;
     acmod_free(ps->acmod);
     ps->acmod = NULL;
 
@@ -376,6 +419,17 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
         }
     }
 
+    /* Or a decoding graph */
+    if ((path = cmd_ln_str_r(ps->config, "-wfst"))) {
+        if (ps_set_wfst_file(ps, PS_DEFAULT_SEARCH, path)
+            || ps_set_search(ps, PS_DEFAULT_SEARCH))
+            return -1;
+    }
+
+    /* Start the decoding thread for live input. */
+    if (cmd_ln_boolean_r(ps->config, "-pipeline"))
+        ps->pipeline = ps_pipeline_init(ps->acmod, ps_pipeline_search, ps);
+
     /* Initialize performance timer. */
     ps->perf.name = "decode";
     ptmr_init(&ps->perf);
@@ -422,6 +476,7 @@ ps_free(ps_decoder_t *ps)
         return 0;
     if (--ps->refcount > 0)
         return ps->refcount;
+    ps_pipeline_free(ps->pipeline);
     ps_free_searches(ps);
     dict_free(ps->dict);
     dict2pid_free(ps->d2p);
@@ -459,6 +514,7 @@ ps_get_feat(ps_decoder_t *ps)
 ps_mllr_t *
 ps_update_mllr(ps_decoder_t *ps, ps_mllr_t *mllr)
 {
+    ps_wait_frames(ps);
     return acmod_update_mllr(ps->acmod, mllr);
 }
 
@@ -477,6 +533,7 @@ ps_set_search(ps_decoder_t *ps, const char *name)
     }
 
     ps->search = search;
+    ps_remove_extra_search(ps, search);
     /* Set pl window depending on the search */
     if (!strcmp(PS_SEARCH_TYPE_NGRAM, ps_search_type(search))) {
         ps->pl_window = cmd_ln_int32_r(ps->config, "-pl_window");
@@ -510,10 +567,48 @@ ps_unset_search(ps_decoder_t *ps, const char *name)
         return -1;
     if (ps->search == search)
         ps->search = NULL;
+    ps_remove_extra_search(ps, search);
     ps_search_free(search);
     return 0;
 }
 
+int
+ps_activate_search(ps_decoder_t *ps, const char *name)
+{
+    ps_search_t *search;
+    gnode_t *gn;
+
+    if (ps->acmod->state != ACMOD_ENDED && ps->acmod->state != ACMOD_IDLE) {
+        E_ERROR("Cannot change search while decoding, end utterance first\n");
+        return -1;
+    }
+
+    if (!(search = ps_find_search(ps, name)))
+        return -1;
+    if (search == ps->search || search == ps->phone_loop)
+        return 0;
+    for (gn = ps->extra_searches; gn; gn = gnode_next(gn))
+        if (gnode_ptr(gn) == search)
+            return 0;
+    ps->extra_searches = glist_add_ptr(ps->extra_searches, search);
+    return 0;
+}
+
+int
+ps_deactivate_search(ps_decoder_t *ps, const char *name)
+{
+    ps_search_t *search;
+
+    if (ps->acmod->state != ACMOD_ENDED && ps->acmod->state != ACMOD_IDLE) {
+        E_ERROR("Cannot change search while decoding, end utterance first\n");
+        return -1;
+    }
+
+    if (!(search = ps_find_search(ps, name)))
+        return -1;
+    return ps_remove_extra_search(ps, search);
+}
+
 ps_search_iter_t *
 ps_search_iter(ps_decoder_t *ps)
 {
@@ -575,8 +670,13 @@ set_search_internal(ps_decoder_t *ps, ps_search_t *search)
 
     search->pls = ps->phone_loop;
     old_search = (ps_search_t *) hash_table_replace(ps->searches, ps_search_name(search), search);
-    if (old_search != search)
+    if (old_search != search) {
+        gnode_t *gn;
+        for (gn = ps->extra_searches; gn; gn = gnode_next(gn))
+            if (gnode_ptr(gn) == old_search)
+                gnode_ptr(gn) = search;
         ps_search_free(old_search);
+    }
 
     return 0;
 }
@@ -627,6 +727,33 @@ ps_set_allphone_file(ps_decoder_t *ps, const char *name, const char *path)
   return result;
 }
 
+int
+ps_set_wfst_file(ps_decoder_t *ps, const char *name, const char *path)
+{
+    ps_search_t *search;
+    wfst_graph_t *graph;
+
+    if ((graph = wfst_graph_read(ps->config, path, ps->acmod)) == NULL)
+        return -1;
+    search = wfst_search_init(name, graph, ps->config,
+                              ps->acmod, ps->dict, ps->d2p);
+    return set_search_internal(ps, search);
+}
+
+int
+ps_build_wfst_fsg(ps_decoder_t *ps, fsg_model_t *fsg, const char *path)
+{
+    return wfst_graph_build_fsg(ps->config, ps->acmod, ps->dict, ps->d2p,
+                                fsg, path);
+}
+
+int
+ps_build_wfst_lm(ps_decoder_t *ps, ngram_model_t *lm, const char *path)
+{
+    return wfst_graph_build_lm(ps->config, ps->acmod, ps->dict, ps->d2p,
+                               lm, path);
+}
+
 int
 ps_set_kws(ps_decoder_t *ps, const char *name, const char *keyfile)
 {
@@ -766,6 +893,7 @@ ps_load_dict(ps_decoder_t *ps, char const *dictfile,
     /* Success!  Update the existing config to reflect new dicts and
      * drop everything into place. */
     cmd_ln_free_r(newconfig);
+    ps_wait_frames(ps);
     dict_free(ps->dict);
     ps->dict = dict;
     dict2pid_free(ps->d2p);
@@ -823,6 +951,9 @@ ps_add_word(ps_decoder_t *ps,
     ckd_free(phonestr);
     ckd_free(tmp);
 
+    /* The search must not be running while it changes. */
+    ps_wait_frames(ps);
+
     /* Add it to the dictionary. */
     if ((wid = dict_add_word(ps->dict, word, pron, np)) == -1) {
         ckd_free(pron);
@@ -924,6 +1055,68 @@ ps_decode_raw(ps_decoder_t *ps, FILE *rawfh,
     return total;
 }
 
+int
+ps_decode_multi(ps_decoder_t *ps, FILE *rawfh,
+                char const * const *names, int n_names,
+                char const **out_hyps, int32 *out_scores)
+{
+    ps_search_t *old_search;
+    glist_t old_extra;
+    int old_pl_window;
+    int i, best;
+    int32 best_score;
+
+    if (ps->acmod->state != ACMOD_ENDED && ps->acmod->state != ACMOD_IDLE) {
+        E_ERROR("Cannot change search while decoding, end utterance first\n");
+        return -1;
+    }
+    if (n_names < 1)
+        return -1;
+    for (i = 0; i < n_names; ++i) {
+        if (ps_find_search(ps, names[i]) == NULL) {
+            E_ERROR("No search named '%s'\n", names[i]);
+            return -1;
+        }
+    }
+
+    /* Run the first search as the main one and the rest alongside
+     * it, then put back whatever was set up before. */
+    old_search = ps->search;
+    old_pl_window = ps->pl_window;
+    old_extra = ps->extra_searches;
+    ps->extra_searches = NULL;
+    ps_set_search(ps, names[0]);
+    for (i = 1; i < n_names; ++i)
+        ps_activate_search(ps, names[i]);
+
+    best = -1;
+    best_score = WORST_SCORE;
+    if (ps_decode_raw(ps, rawfh, -1) >= 0) {
+        for (i = 0; i < n_names; ++i) {
+            ps_search_t *search = ps_find_search(ps, names[i]);
+            char const *hyp;
+            int32 score = WORST_SCORE;
+
+            hyp = ps_search_hyp(search, &score);
+            if (out_hyps)
+                out_hyps[i] = hyp;
+            if (out_scores)
+                out_scores[i] = score;
+            if (hyp != NULL && (best == -1 || score BETTER_THAN best_score)) {
+                best = i;
+                best_score = score;
+            }
+        }
+    }
+
+    glist_free(ps->extra_searches);
+    ps->extra_searches = old_extra;
+    ps->search = old_search;
+    ps->pl_window = old_pl_window;
+
+    return best;
+}
+
 int
 ps_start_stream(ps_decoder_t *ps)
 {
@@ -931,11 +1124,24 @@ ps_start_stream(ps_decoder_t *ps)
     return 0;
 }
 
+/* Remove any residual word lattice and hypothesis from a search. */
+static void
+ps_search_clear_hyp(ps_search_t *search)
+{
+    ps_lattice_free(search->dag);
+    search->dag = NULL;
+    search->last_link = NULL;
+    search->post = 0;
+    ckd_free(search->hyp_str);
+    search->hyp_str = NULL;
+}
+
 int
 ps_start_utt(ps_decoder_t *ps)
 {
     int rv;
     char uttid[16];
+    gnode_t *gn;
     
     if (ps->acmod->state == ACMOD_STARTED || ps->acmod->state == ACMOD_PROCESSING) {
 	E_ERROR("Utterance already started\n");
@@ -955,14 +1161,13 @@ ps_start_utt(ps_decoder_t *ps)
     ++ps->uttno;
 
     /* Remove any residual word lattice and hypothesis. */
-    ps_lattice_free(ps->search->dag);
-    ps->search->dag = NULL;
-    ps->search->last_link = NULL;
-    ps->search->post = 0;
-    ckd_free(ps->search->hyp_str);
-    ps->search->hyp_str = NULL;
+    ps_search_clear_hyp(ps->search);
+    for (gn = ps->extra_searches; gn; gn = gnode_next(gn))
+        ps_search_clear_hyp(gnode_ptr(gn));
     if ((rv = acmod_start_utt(ps->acmod)) < 0)
         return rv;
+    if (ps->pipeline)
+        ps_pipeline_reset(ps->pipeline);
 
     /* Start logging features and audio if requested. */
     if (ps->mfclogdir) {
@@ -1009,9 +1214,54 @@ ps_start_utt(ps_decoder_t *ps)
     if (ps->phone_loop)
         ps_search_start(ps->phone_loop);
 
+    /* Start searches that run alongside the main one. */
+    for (gn = ps->extra_searches; gn; gn = gnode_next(gn))
+        if ((rv = ps_search_start(gnode_ptr(gn))) < 0)
+            return rv;
+
     return ps_search_start(ps->search);
 }
 
+/*
+ * Search one frame with the main search and any extra searches.  If
+ * they can all tell us which senones they need, score the union of
+ * those once and let each search reuse the scores.
+ */
+static int
+ps_search_step_all(ps_decoder_t *ps, int frame_idx)
+{
+    acmod_t *acmod = ps->acmod;
+    gnode_t *gn;
+    int shared, k;
+
+    if (ps->extra_searches == NULL)
+        return ps_search_step(ps->search, frame_idx);
+
+    shared = !acmod->compallsen
+        && ps_search_base(ps->search)->vt->sen_active != NULL;
+    for (gn = ps->extra_searches; shared && gn; gn = gnode_next(gn))
+        if (ps_search_base(gnode_ptr(gn))->vt->sen_active == NULL)
+            shared = FALSE;
+    if (shared) {
+        acmod_clear_active(acmod);
+        acmod_hold_active(acmod, TRUE);
+        ps_search_sen_active(ps->search, frame_idx);
+        for (gn = ps->extra_searches; gn; gn = gnode_next(gn))
+            ps_search_sen_active(gnode_ptr(gn), frame_idx);
+        acmod_hold_active(acmod, FALSE);
+        if (acmod_score(acmod, &frame_idx) != NULL)
+            acmod_hold_active(acmod, TRUE);
+    }
+
+    if ((k = ps_search_step(ps->search, frame_idx)) >= 0) {
+        for (gn = ps->extra_searches; gn; gn = gnode_next(gn))
+            if ((k = ps_search_step(gnode_ptr(gn), frame_idx)) < 0)
+                break;
+    }
+    acmod_hold_active(acmod, FALSE);
+    return k;
+}
+
 static int
 ps_search_forward(ps_decoder_t *ps)
 {
@@ -1024,8 +1274,8 @@ ps_search_forward(ps_decoder_t *ps)
             if ((k = ps_search_step(ps->phone_loop, ps->acmod->output_frame)) < 0)
                 return k;
         if (ps->acmod->output_frame >= ps->pl_window)
-            if ((k = ps_search_step(ps->search,
-                                    ps->acmod->output_frame - ps->pl_window)) < 0)
+            if ((k = ps_search_step_all(ps,
+                                        ps->acmod->output_frame - ps->pl_window)) < 0)
                 return k;
         acmod_advance(ps->acmod);
         ++ps->n_frame;
@@ -1034,14 +1284,33 @@ ps_search_forward(ps_decoder_t *ps)
     return nfr;
 }
 
+/* Search function for the decoding thread. */
+static int
+ps_pipeline_search(void *arg)
+{
+    return ps_search_forward((ps_decoder_t *)arg);
+}
+
 int
-ps_decode_senscr(ps_decoder_t *ps, FILE *senfh)
+ps_wait_frames(ps_decoder_t *ps)
+{
+    if (ps->pipeline == NULL)
+        return 0;
+    return ps_pipeline_wait(ps->pipeline);
+}
+
+static int
+ps_decode_senscr_internal(ps_decoder_t *ps, FILE *senfh, char const *file)
 {
     int nfr, n_searchfr;
 
     ps_start_utt(ps);
     n_searchfr = 0;
-    acmod_set_insenfh(ps->acmod, senfh);
+    if (acmod_set_insenfile(ps->acmod, senfh, file) < 0) {
+        ps_end_utt(ps);
+        acmod_set_insenfh(ps->acmod, NULL);
+        return -1;
+    }
     while ((nfr = acmod_read_scores(ps->acmod)) > 0) {
         if ((nfr = ps_search_forward(ps)) < 0) {
             ps_end_utt(ps);
@@ -1055,6 +1324,27 @@ ps_decode_senscr(ps_decoder_t *ps, FILE *senfh)
     return n_searchfr;
 }
 
+int
+ps_decode_senscr(ps_decoder_t *ps, FILE *senfh)
+{
+    return ps_decode_senscr_internal(ps, senfh, NULL);
+}
+
+int
+ps_decode_senscr_file(ps_decoder_t *ps, char const *file)
+{
+    FILE *senfh;
+    int rv;
+
+    if ((senfh = fopen(file, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open senone score file %s", file);
+        return -1;
+    }
+    rv = ps_decode_senscr_internal(ps, senfh, file);
+    fclose(senfh);
+    return rv;
+}
+
 int
 ps_process_raw(ps_decoder_t *ps,
                int16 const *data,
@@ -1069,6 +1359,13 @@ ps_process_raw(ps_decoder_t *ps,
 	return 0;
     }
 
+    /* Live input goes to the decoding thread, anything else has to
+     * wait for it to finish. */
+    if (ps->pipeline && !no_search && !full_utt)
+        return ps_pipeline_process_raw(ps->pipeline, data, n_samples);
+    if ((n_searchfr = ps_wait_frames(ps)) < 0)
+        return n_searchfr;
+
     if (no_search)
         acmod_set_grow(ps->acmod, TRUE);
 
@@ -1100,6 +1397,11 @@ ps_process_cep(ps_decoder_t *ps,
 {
     int n_searchfr = 0;
 
+    if (ps->pipeline && !no_search && !full_utt)
+        return ps_pipeline_process_cep(ps->pipeline, data, n_frames);
+    if ((n_searchfr = ps_wait_frames(ps)) < 0)
+        return n_searchfr;
+
     if (no_search)
         acmod_set_grow(ps->acmod, TRUE);
 
@@ -1126,12 +1428,19 @@ int
 ps_end_utt(ps_decoder_t *ps)
 {
     int rv, i;
+    gnode_t *gn;
 
     if (ps->acmod->state == ACMOD_ENDED || ps->acmod->state == ACMOD_IDLE) {
 	E_ERROR("Utterance is not started\n");
 	return -1;
     }
+    /* Everything from here on is done in this thread. */
+    rv = ps_wait_frames(ps);
     acmod_end_utt(ps->acmod);
+    if (rv < 0) {
+        ptmr_stop(&ps->perf);
+        return rv;
+    }
 
     /* Search any remaining frames. */
     if ((rv = ps_search_forward(ps)) < 0) {
@@ -1149,7 +1458,14 @@ ps_end_utt(ps_decoder_t *ps)
     if (ps->acmod->output_frame >= ps->pl_window) {
         for (i = ps->acmod->output_frame - ps->pl_window;
              i < ps->acmod->output_frame; ++i)
-            ps_search_step(ps->search, i);
+            ps_search_step_all(ps, i);
+    }
+    /* Finish extra searches. */
+    for (gn = ps->extra_searches; gn; gn = gnode_next(gn)) {
+        if ((rv = ps_search_finish(gnode_ptr(gn))) < 0) {
+            ptmr_stop(&ps->perf);
+            return rv;
+        }
     }
     /* Finish main search. */
     if ((rv = ps_search_finish(ps->search)) < 0) {
@@ -1194,18 +1510,35 @@ ps_get_hyp(ps_decoder_t *ps, int32 *out_best_score)
     char const *hyp;
 
     ptmr_start(&ps->perf);
+    ps_lock_search(ps);
     hyp = ps_search_hyp(ps->search, out_best_score);
+    ps_unlock_search(ps);
     ptmr_stop(&ps->perf);
     return hyp;
 }
 
+char const *
+ps_get_stable_hyp(ps_decoder_t *ps)
+{
+    char const *hyp = NULL;
+
+    ps_lock_search(ps);
+    if (ps->search
+        && !strcmp(PS_SEARCH_TYPE_NGRAM, ps_search_type(ps->search)))
+        hyp = ngram_search_stable_hyp((ngram_search_t *)ps->search);
+    ps_unlock_search(ps);
+    return hyp;
+}
+
 int32
 ps_get_prob(ps_decoder_t *ps)
 {
     int32 prob;
 
     ptmr_start(&ps->perf);
+    ps_lock_search(ps);
     prob = ps_search_prob(ps->search);
+    ps_unlock_search(ps);
     ptmr_stop(&ps->perf);
     return prob;
 }
@@ -1215,12 +1548,61 @@ ps_seg_iter(ps_decoder_t *ps)
 {
     ps_seg_t *itor;
 
+    /* The iterator looks at the search as it goes. */
+    ps_wait_frames(ps);
     ptmr_start(&ps->perf);
     itor = ps_search_seg_iter(ps->search);
     ptmr_stop(&ps->perf);
     return itor;
 }
 
+char const *
+ps_get_search_hyp(ps_decoder_t *ps, const char *name, int32 *out_best_score)
+{
+    ps_search_t *search;
+    char const *hyp;
+
+    if (!(search = ps_find_search(ps, name)))
+        return NULL;
+    ptmr_start(&ps->perf);
+    ps_lock_search(ps);
+    hyp = ps_search_hyp(search, out_best_score);
+    ps_unlock_search(ps);
+    ptmr_stop(&ps->perf);
+    return hyp;
+}
+
+int32
+ps_get_search_prob(ps_decoder_t *ps, const char *name)
+{
+    ps_search_t *search;
+    int32 prob;
+
+    if (!(search = ps_find_search(ps, name)))
+        return 0;
+    ptmr_start(&ps->perf);
+    ps_lock_search(ps);
+    prob = ps_search_prob(search);
+    ps_unlock_search(ps);
+    ptmr_stop(&ps->perf);
+    return prob;
+}
+
+ps_seg_t *
+ps_get_search_seg_iter(ps_decoder_t *ps, const char *name)
+{
+    ps_search_t *search;
+    ps_seg_t *itor;
+
+    if (!(search = ps_find_search(ps, name)))
+        return NULL;
+    ps_wait_frames(ps);
+    ptmr_start(&ps->perf);
+    itor = ps_search_seg_iter(search);
+    ptmr_stop(&ps->perf);
+    return itor;
+}
+
 ps_seg_t *
 ps_seg_next(ps_seg_t *seg)
 {
@@ -1260,6 +1642,7 @@ ps_seg_free(ps_seg_t *seg)
 ps_lattice_t *
 ps_get_lattice(ps_decoder_t *ps)
 {
+    ps_wait_frames(ps);
     return ps_search_lattice(ps->search);
 }
 
@@ -1336,7 +1719,12 @@ ps_nbest_seg(ps_nbest_t *nbest)
 int
 ps_get_n_frames(ps_decoder_t *ps)
 {
-    return ps->acmod->output_frame + 1;
+    int nfr;
+
+    ps_lock_search(ps);
+    nfr = ps->acmod->output_frame + 1;
+    ps_unlock_search(ps);
+    return nfr;
 }
 
 void
@@ -1346,7 +1734,9 @@ ps_get_utt_time(ps_decoder_t *ps, double *out_nspeech,
     int32 frate;
 
     frate = cmd_ln_int32_r(ps->config, "-frate");
+    ps_lock_search(ps);
     *out_nspeech = (double)ps->acmod->output_frame / frate;
+    ps_unlock_search(ps);
     *out_ncpu = ps->perf.t_cpu;
     *out_nwall = ps->perf.t_elapsed;
 }
@@ -1358,7 +1748,9 @@ ps_get_all_time(ps_decoder_t *ps, double *out_nspeech,
     int32 frate;
 
     frate = cmd_ln_int32_r(ps->config, "-frate");
+    ps_lock_search(ps);
     *out_nspeech = (double)ps->n_frame / frate;
+    ps_unlock_search(ps);
     *out_ncpu = ps->perf.t_tot_cpu;
     *out_nwall = ps->perf.t_tot_elapsed;
 }
@@ -1441,11 +1833,15 @@ ps_search_base_reinit(ps_search_t *search, dict_t *dict,
 void
 ps_set_rawdata_size(ps_decoder_t *ps, int32 size) 
 {
+    ps_lock_search(ps);
     acmod_set_rawdata_size(ps->acmod, size);
+    ps_unlock_search(ps);
 }
 
 void
 ps_get_rawdata(ps_decoder_t *ps, int16 **buffer, int32 *size)
 {
+    ps_lock_search(ps);
     acmod_get_rawdata(ps->acmod, buffer, size);
+    ps_unlock_search(ps);
 }
@@ -48,6 +48,7 @@
 #include <sphinxbase/cmd_ln.h>
 #include <sphinxbase/fe.h>
 #include <sphinxbase/feat.h>
+#include <sphinxbase/glist.h>
 #include <sphinxbase/hash_table.h>
 #include <sphinxbase/logmath.h>
 #include <sphinxbase/profile.h>
@@ -57,6 +58,7 @@
 #include "acmod.h"
 #include "dict.h"
 #include "dict2pid.h"
+#include "ps_pipeline.h"
 
 /**
  * Search algorithm structure.
@@ -75,6 +77,7 @@ typedef struct ps_search_s ps_search_t;
 #define PS_SEARCH_TYPE_ALLPHONE  "allphone"
 #define PS_SEARCH_TYPE_STATE_ALIGN  "state_align"
 #define PS_SEARCH_TYPE_PHONE_LOOP  "phone_loop"
+#define PS_SEARCH_TYPE_WFST   "wfst"
 
 /**
  * V-table for search algorithm.
@@ -90,6 +93,8 @@ typedef struct ps_searchfuncs_s {
     char const *(*hyp)(ps_search_t *search, int32 *out_score);
     int32 (*prob)(ps_search_t *search);
     ps_seg_t *(*seg_iter)(ps_search_t *search);
+    /** Activate the senones needed for a frame (or NULL). */
+    void (*sen_active)(ps_search_t *search, int frame_idx);
 } ps_searchfuncs_t;
 
 /**
@@ -141,6 +146,7 @@ struct ps_search_s {
 #define ps_search_hyp(s,sc) (*(ps_search_base(s)->vt->hyp))(s,sc)
 #define ps_search_prob(s) (*(ps_search_base(s)->vt->prob))(s)
 #define ps_search_seg_iter(s) (*(ps_search_base(s)->vt->seg_iter))(s)
+#define ps_search_sen_active(s,i) (*(ps_search_base(s)->vt->sen_active))(s,i)
 
 /* For convenience... */
 #define ps_search_silence_wid(s) ps_search_base(s)->silence_wid
@@ -216,6 +222,7 @@ struct ps_decoder_s {
     ps_search_t *search;     /**< Currently active search module. */
     ps_search_t *phone_loop; /**< Phone loop search for lookahead. */
     int pl_window;           /**< Window size for phoneme lookahead. */
+    glist_t extra_searches;  /**< Searches run alongside the current one. */
 
     /* Utterance-processing related stuff. */
     uint32 uttno;       /**< Utterance counter. */
@@ -224,6 +231,7 @@ struct ps_decoder_s {
     char const *mfclogdir; /**< Log directory for MFCC files. */
     char const *rawlogdir; /**< Log directory for audio files. */
     char const *senlogdir; /**< Log directory for senone score files. */
+    ps_pipeline_t *pipeline; /**< Decoding thread for live input (-pipeline). */
 };
 
 
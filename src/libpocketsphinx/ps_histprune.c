@@ -0,0 +1,78 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_histprune.c Histogram pruning of active HMMs and word exits.
+ */
+
+/* System headers. */
+#include <string.h>
+
+/* Local headers. */
+#include "ps_histprune.h"
+
+void
+ps_histprune_reset(ps_histprune_t *hp, int32 best, int32 beam)
+{
+    memset(hp->bins, 0, sizeof(hp->bins));
+    hp->best = best;
+    hp->bw = -beam / PS_HISTPRUNE_NBINS;
+    if (hp->bw < 1)
+        hp->bw = 1;
+    hp->n = 0;
+}
+
+int32
+ps_histprune_beam(ps_histprune_t *hp, int32 max_n, int32 beam)
+{
+    int32 i, n;
+
+    if (max_n < 0 || hp->n <= max_n)
+        return beam;
+    /* Walk down the bins until there are too many scores. */
+    for (i = n = 0; i < PS_HISTPRUNE_NBINS; ++i) {
+        n += hp->bins[i];
+        if (n > max_n)
+            break;
+    }
+    /* Always keep the first bin. */
+    if (i == 0)
+        i = 1;
+    /* Bin i holds scores from best - i * bw down to (but not
+     * including) best - (i + 1) * bw, so everything up to the end
+     * of bin i - 1 is let through by a beam of -i * bw. */
+    if (-(i * hp->bw) < beam)
+        return beam;
+    return -(i * hp->bw);
+}
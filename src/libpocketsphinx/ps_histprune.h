@@ -0,0 +1,119 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_histprune.h Histogram pruning of active HMMs and word exits.
+ *
+ * To keep at most N of a set of scores, each one is dropped into a
+ * bin according to how far it is from the best score in the frame,
+ * with the bins evenly spaced out to the edge of the beam (anything
+ * beyond that goes into the last bin).  Walking up the bins then
+ * gives a beam which lets through no more than N of them.  This takes
+ * a single pass over the scores, no matter how many have to go.
+ */
+
+#ifndef __PS_HISTPRUNE_H__
+#define __PS_HISTPRUNE_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * Number of bins in the histogram.
+ */
+#define PS_HISTPRUNE_NBINS 256
+
+/**
+ * Score histogram for one frame.
+ */
+typedef struct ps_histprune_s {
+    int32 bins[PS_HISTPRUNE_NBINS]; /**< Number of scores in each bin. */
+    int32 best;     /**< Best score in the frame. */
+    int32 bw;       /**< Width of each bin. */
+    int32 n;        /**< Total number of scores. */
+} ps_histprune_t;
+
+/**
+ * Empty a histogram for a new frame.
+ *
+ * @param best Best score in the frame.
+ * @param beam Beam width (negative, as usual), which gives the range
+ *             covered by the bins.
+ */
+void ps_histprune_reset(ps_histprune_t *hp, int32 best, int32 beam);
+
+/**
+ * Add a score to a histogram.
+ */
+static inline void
+ps_histprune_add(ps_histprune_t *hp, int32 score)
+{
+    int32 b;
+
+    /* Scores better than the best go in the first bin. */
+    b = (hp->best - score) / hp->bw;
+    if (b < 0)
+        b = 0;
+    else if (b >= PS_HISTPRUNE_NBINS)
+        b = PS_HISTPRUNE_NBINS - 1;
+    ++hp->bins[b];
+    ++hp->n;
+}
+
+/**
+ * Find the beam that lets through at most a given number of scores.
+ *
+ * The first bin is always let through, so that the best score is
+ * never pruned, even if there are more than max_n scores in it.
+ *
+ * @param max_n Maximum number of scores to keep.
+ * @param beam Beam to use if there are no more than max_n scores.
+ * @return Beam width (negative) relative to the best score, to be
+ *         used as a strict threshold, i.e. scores BETTER_THAN best +
+ *         this beam survive.
+ */
+int32 ps_histprune_beam(ps_histprune_t *hp, int32 max_n, int32 beam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PS_HISTPRUNE_H__ */
@@ -0,0 +1,435 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_logwriter.c Asynchronous writing of log files.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+/* Local headers. */
+#include "ps_logwriter.h"
+
+#define LOGFILE_MAX_PATCH 16
+
+struct ps_logfile_s {
+    ps_logwriter_t *w;
+    FILE *fh;
+    uint8 *buf;                 /**< Queue of data to write. */
+    int64 n_alloc;              /**< Size of the queue. */
+    ps_logfile_t *next;         /**< Next open file. */
+    long patch_offset;          /**< Where to write patch. */
+    uint8 patch[LOGFILE_MAX_PATCH]; /**< Data to write there at the end. */
+    size_t patch_size;          /**< Size of patch (0 for none). */
+
+    /* The rest is protected by the writer's mtx. */
+    int64 head;                 /**< Number of bytes queued. */
+    int64 tail;                 /**< Number of bytes written. */
+    ps_logstats_t stats;        /**< Statistics for this file. */
+    int rv;                     /**< First error writing the file. */
+    int closing;                /**< Close has been requested. */
+    int closed;                 /**< File has been closed. */
+};
+
+struct ps_logwriter_s {
+#ifdef HAVE_PTHREAD_H
+    pthread_t th;
+    pthread_mutex_t mtx;
+    pthread_cond_t work;        /**< Signalled when data is queued. */
+    pthread_cond_t space;       /**< Signalled when data is written. */
+    int quit;
+    int sync;                   /**< No thread, write synchronously. */
+#endif
+    ps_logfile_t *files;        /**< Open files. */
+    ps_logstats_t stats;        /**< Totals for closed files. */
+};
+
+/*
+ * Write the patch and close a file whose queue is empty, returning
+ * the new error status given the one so far.
+ */
+static int
+ps_logfile_finish(ps_logfile_t *lf, int rv)
+{
+    if (lf->patch_size > 0) {
+        if (fseek(lf->fh, lf->patch_offset, SEEK_SET) < 0
+            || fwrite(lf->patch, 1, lf->patch_size, lf->fh) != lf->patch_size) {
+            E_ERROR_SYSTEM("Failed to update header of log file");
+            rv = -1;
+        }
+    }
+    if (fclose(lf->fh) != 0) {
+        E_ERROR_SYSTEM("Failed to close log file");
+        rv = -1;
+    }
+    lf->fh = NULL;
+    return rv;
+}
+
+/* Add a file's statistics to the writer's totals. */
+static void
+ps_logfile_add_stats(ps_logstats_t *total, ps_logfile_t *lf)
+{
+    ++total->n_files;
+    if (lf->rv < 0)
+        ++total->n_errors;
+    total->n_bytes += lf->stats.n_bytes;
+    total->n_writes += lf->stats.n_writes;
+    total->n_stalls += lf->stats.n_stalls;
+    if (lf->stats.max_queued > total->max_queued)
+        total->max_queued = lf->stats.max_queued;
+}
+
+ps_logstats_t const *
+ps_logwriter_stats(ps_logwriter_t *w)
+{
+    return &w->stats;
+}
+
+static void
+ps_logwriter_report(ps_logwriter_t *w)
+{
+    if (w->stats.n_files > 0)
+        E_INFO("Wrote %d log files, %ld bytes in %d writes, "
+               "decoder waited %d times\n",
+               w->stats.n_files, (long)w->stats.n_bytes,
+               w->stats.n_writes, w->stats.n_stalls);
+}
+
+int64
+ps_logfile_tell(ps_logfile_t *lf)
+{
+    /* Only the queueing thread changes this. */
+    return lf->head;
+}
+
+void
+ps_logfile_patch(ps_logfile_t *lf, long offset,
+                 void const *data, size_t size)
+{
+    if (size > LOGFILE_MAX_PATCH) {
+        E_ERROR("Log file patch of %d bytes is too large\n", (int)size);
+        return;
+    }
+    lf->patch_offset = offset;
+    memcpy(lf->patch, data, size);
+    lf->patch_size = size;
+}
+
+/* Write data directly, when there is no thread to do it. */
+static int
+ps_logfile_write_sync(ps_logfile_t *lf, void const *data, size_t size)
+{
+    if (lf->rv == 0 && fwrite(data, 1, size, lf->fh) != size) {
+        E_ERROR_SYSTEM("Failed to write %ld bytes to log file", (long)size);
+        lf->rv = -1;
+    }
+    lf->head += size;
+    lf->stats.n_bytes += size;
+    ++lf->stats.n_writes;
+    return lf->rv;
+}
+
+/* Close a file written directly. */
+static int
+ps_logfile_close_sync(ps_logfile_t *lf)
+{
+    int rv;
+
+    lf->rv = ps_logfile_finish(lf, lf->rv);
+    ps_logfile_add_stats(&lf->w->stats, lf);
+    rv = lf->rv;
+    ckd_free(lf->buf);
+    ckd_free(lf);
+    return rv;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+/* Write out queued data as it comes in, taking turns between files. */
+static void *
+ps_logwriter_main(void *arg)
+{
+    ps_logwriter_t *w = (ps_logwriter_t *)arg;
+
+    pthread_mutex_lock(&w->mtx);
+    for (;;) {
+        ps_logfile_t *lf, *next, **prev;
+        int busy = FALSE;
+
+        /* Files are only ever removed by this thread, and added at
+         * the start of the list, so it is safe to keep following the
+         * list after releasing mtx to write. */
+        for (prev = &w->files, lf = w->files; lf; lf = next) {
+            next = lf->next;
+            if (lf->head > lf->tail) {
+                int64 start, n;
+                int rv;
+
+                /* Take everything contiguous at the tail.  It can't be
+                 * overwritten until tail is updated. */
+                start = lf->tail % lf->n_alloc;
+                n = lf->head - lf->tail;
+                if (start + n > lf->n_alloc)
+                    n = lf->n_alloc - start;
+                rv = lf->rv;
+                pthread_mutex_unlock(&w->mtx);
+
+                if (rv == 0
+                    && fwrite(lf->buf + start, 1, n, lf->fh) != n) {
+                    E_ERROR_SYSTEM("Failed to write %ld bytes to log file",
+                                   (long)n);
+                    rv = -1;
+                }
+
+                pthread_mutex_lock(&w->mtx);
+                lf->rv = rv;
+                lf->tail += n;
+                lf->stats.n_bytes += n;
+                ++lf->stats.n_writes;
+                pthread_cond_broadcast(&w->space);
+                busy = TRUE;
+            }
+            else if (lf->closing) {
+                int rv;
+
+                /* Everything has been written. */
+                *prev = next;
+                rv = lf->rv;
+                pthread_mutex_unlock(&w->mtx);
+                rv = ps_logfile_finish(lf, rv);
+                pthread_mutex_lock(&w->mtx);
+                lf->rv = rv;
+                lf->closed = TRUE;
+                pthread_cond_broadcast(&w->space);
+                /* Files may have been added meanwhile, so start over. */
+                busy = TRUE;
+                break;
+            }
+            prev = &lf->next;
+        }
+        if (busy)
+            continue;
+        if (w->quit)
+            break;
+        pthread_cond_wait(&w->work, &w->mtx);
+    }
+    pthread_mutex_unlock(&w->mtx);
+    return NULL;
+}
+
+ps_logwriter_t *
+ps_logwriter_init(void)
+{
+    ps_logwriter_t *w;
+
+    w = ckd_calloc(1, sizeof(*w));
+    pthread_mutex_init(&w->mtx, NULL);
+    pthread_cond_init(&w->work, NULL);
+    pthread_cond_init(&w->space, NULL);
+    if (pthread_create(&w->th, NULL, ps_logwriter_main, w) != 0) {
+        E_ERROR_SYSTEM("Failed to start log writing thread, "
+                       "writing log files synchronously");
+        pthread_cond_destroy(&w->space);
+        pthread_cond_destroy(&w->work);
+        pthread_mutex_destroy(&w->mtx);
+        w->sync = TRUE;
+    }
+    return w;
+}
+
+void
+ps_logwriter_free(ps_logwriter_t *w)
+{
+    if (w == NULL)
+        return;
+    if (w->sync) {
+        ps_logwriter_report(w);
+        ckd_free(w);
+        return;
+    }
+    pthread_mutex_lock(&w->mtx);
+    w->quit = TRUE;
+    pthread_cond_signal(&w->work);
+    pthread_mutex_unlock(&w->mtx);
+    pthread_join(w->th, NULL);
+    pthread_cond_destroy(&w->space);
+    pthread_cond_destroy(&w->work);
+    pthread_mutex_destroy(&w->mtx);
+    ps_logwriter_report(w);
+    ckd_free(w);
+}
+
+ps_logfile_t *
+ps_logfile_open(ps_logwriter_t *w, FILE *fh, size_t queue_size)
+{
+    ps_logfile_t *lf;
+
+    lf = ckd_calloc(1, sizeof(*lf));
+    lf->w = w;
+    lf->fh = fh;
+    if (w->sync)
+        return lf;
+    lf->n_alloc = queue_size > 0 ? queue_size : 1;
+    lf->buf = ckd_malloc(lf->n_alloc);
+    pthread_mutex_lock(&w->mtx);
+    lf->next = w->files;
+    w->files = lf;
+    pthread_mutex_unlock(&w->mtx);
+    return lf;
+}
+
+int
+ps_logfile_write(ps_logfile_t *lf, void const *data, size_t size)
+{
+    ps_logwriter_t *w = lf->w;
+    uint8 const *ptr = (uint8 const *)data;
+    int rv;
+
+    if (w->sync)
+        return ps_logfile_write_sync(lf, data, size);
+    while (size > 0) {
+        int64 start, n;
+
+        pthread_mutex_lock(&w->mtx);
+        if (lf->head - lf->tail == lf->n_alloc) {
+            if (lf->stats.n_stalls++ == 0)
+                E_WARN("Log file queue is full, waiting for the disk\n");
+            while (lf->head - lf->tail == lf->n_alloc)
+                pthread_cond_wait(&w->space, &w->mtx);
+        }
+        start = lf->head % lf->n_alloc;
+        n = lf->n_alloc - (lf->head - lf->tail);
+        if (start + n > lf->n_alloc)
+            n = lf->n_alloc - start;
+        pthread_mutex_unlock(&w->mtx);
+        if (n > size)
+            n = size;
+
+        memcpy(lf->buf + start, ptr, n);
+        ptr += n;
+        size -= n;
+
+        pthread_mutex_lock(&w->mtx);
+        lf->head += n;
+        if (lf->head - lf->tail > lf->stats.max_queued)
+            lf->stats.max_queued = lf->head - lf->tail;
+        pthread_cond_signal(&w->work);
+        pthread_mutex_unlock(&w->mtx);
+    }
+    pthread_mutex_lock(&w->mtx);
+    rv = lf->rv;
+    pthread_mutex_unlock(&w->mtx);
+    return rv;
+}
+
+int
+ps_logfile_close(ps_logfile_t *lf)
+{
+    ps_logwriter_t *w;
+    int rv;
+
+    if (lf == NULL)
+        return 0;
+    w = lf->w;
+    if (w->sync)
+        return ps_logfile_close_sync(lf);
+    pthread_mutex_lock(&w->mtx);
+    lf->closing = TRUE;
+    pthread_cond_signal(&w->work);
+    while (!lf->closed)
+        pthread_cond_wait(&w->space, &w->mtx);
+    ps_logfile_add_stats(&w->stats, lf);
+    rv = lf->rv;
+    pthread_mutex_unlock(&w->mtx);
+    ckd_free(lf->buf);
+    ckd_free(lf);
+    return rv;
+}
+
+#else /* !HAVE_PTHREAD_H */
+
+ps_logwriter_t *
+ps_logwriter_init(void)
+{
+    return ckd_calloc(1, sizeof(ps_logwriter_t));
+}
+
+void
+ps_logwriter_free(ps_logwriter_t *w)
+{
+    if (w == NULL)
+        return;
+    ps_logwriter_report(w);
+    ckd_free(w);
+}
+
+ps_logfile_t *
+ps_logfile_open(ps_logwriter_t *w, FILE *fh, size_t queue_size)
+{
+    ps_logfile_t *lf;
+
+    lf = ckd_calloc(1, sizeof(*lf));
+    lf->w = w;
+    lf->fh = fh;
+    return lf;
+}
+
+int
+ps_logfile_write(ps_logfile_t *lf, void const *data, size_t size)
+{
+    return ps_logfile_write_sync(lf, data, size);
+}
+
+int
+ps_logfile_close(ps_logfile_t *lf)
+{
+    if (lf == NULL)
+        return 0;
+    return ps_logfile_close_sync(lf);
+}
+
+#endif /* !HAVE_PTHREAD_H */
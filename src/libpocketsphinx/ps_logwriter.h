@@ -0,0 +1,148 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_logwriter.h Asynchronous writing of log files.
+ *
+ * The raw audio, cepstra and senone scores logged with -rawlogdir,
+ * -mfclogdir and -senlogdir are queued in memory and written out by a
+ * single I/O thread, so that a slow disk or network filesystem does
+ * not hold up decoding.  Each file has a bounded queue, and the
+ * decoder only waits for the I/O thread if that queue fills up, which
+ * is counted in the statistics.  The I/O thread writes everything
+ * waiting in a queue at once.  Without threads, everything is written
+ * immediately.
+ */
+
+#ifndef __PS_LOGWRITER_H__
+#define __PS_LOGWRITER_H__
+
+/* System headers. */
+#include <stdio.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * I/O thread shared by several log files.
+ */
+typedef struct ps_logwriter_s ps_logwriter_t;
+
+/**
+ * Log file being written by an I/O thread.
+ */
+typedef struct ps_logfile_s ps_logfile_t;
+
+/**
+ * Statistics for log files.
+ */
+typedef struct ps_logstats_s {
+    int32 n_files;      /**< Number of files closed. */
+    int32 n_errors;     /**< Number of files that could not be written. */
+    int64 n_bytes;      /**< Number of bytes written. */
+    int32 n_writes;     /**< Number of writes (batches of data). */
+    int32 n_stalls;     /**< Number of times the decoder had to wait
+                             for a full queue. */
+    int64 max_queued;   /**< Most data ever waiting in one queue. */
+} ps_logstats_t;
+
+/**
+ * Start an I/O thread.
+ */
+ps_logwriter_t *ps_logwriter_init(void);
+
+/**
+ * Stop an I/O thread.  All of its files must have been closed.
+ */
+void ps_logwriter_free(ps_logwriter_t *w);
+
+/**
+ * Get statistics for all files closed so far.
+ */
+ps_logstats_t const *ps_logwriter_stats(ps_logwriter_t *w);
+
+/**
+ * Start writing a file.
+ *
+ * @param fh File to write to, which becomes owned by the log file.
+ *           Anything written to it before this is written first.
+ * @param queue_size Number of bytes that can be waiting to be written.
+ */
+ps_logfile_t *ps_logfile_open(ps_logwriter_t *w, FILE *fh, size_t queue_size);
+
+/**
+ * Queue data to be written.
+ *
+ * This only waits if the queue is full.
+ *
+ * @return 0, or <0 if writing the file has already failed.
+ */
+int ps_logfile_write(ps_logfile_t *lf, void const *data, size_t size);
+
+/**
+ * Get the number of bytes queued since the file was opened.
+ */
+int64 ps_logfile_tell(ps_logfile_t *lf);
+
+/**
+ * Overwrite part of the file once everything else has been written,
+ * such as a header which includes the size of the data.
+ *
+ * @param offset Position in the file.
+ * @param size Size of data, at most 16 bytes.
+ */
+void ps_logfile_patch(ps_logfile_t *lf, long offset,
+                      void const *data, size_t size);
+
+/**
+ * Finish writing and close a file.
+ *
+ * This waits for everything in the queue to be written.
+ *
+ * @return 0, or <0 if the file could not be written.
+ */
+int ps_logfile_close(ps_logfile_t *lf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PS_LOGWRITER_H__ */
@@ -0,0 +1,353 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_pipeline.c Pipelined decoding of live input.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+/* Local headers. */
+#include "ps_pipeline.h"
+
+#ifdef HAVE_PTHREAD_H
+
+/* Number of frames of cepstra in the ring (2.56 seconds at the usual
+ * frame rate). */
+#define PIPELINE_N_FRAMES 256
+
+struct ps_pipeline_s {
+    acmod_t *acmod;
+    ps_pipeline_func_t search;
+    void *search_arg;
+    mfcc_t **cep;               /**< Ring of cepstra. */
+    int32 n_alloc;              /**< Number of frames in the ring. */
+    int32 ceplen;               /**< Length of each frame. */
+    int32 tail;                 /**< Next frame for the decoding thread. */
+    pthread_t th;
+    pthread_mutex_t search_mtx; /**< Held while searching. */
+
+    /* The rest is protected by mtx.  Only the indices are passed
+     * back and forth under it, not the frames themselves, and
+     * blocks of frames at a time. */
+    pthread_mutex_t mtx;
+    pthread_cond_t avail;       /**< Signalled when frames are added. */
+    pthread_cond_t space;       /**< Signalled when frames are decoded. */
+    int32 head;                 /**< Next frame for the front end. */
+    int32 n_frame;              /**< Number of frames not yet decoded. */
+    int rv;                     /**< First error in the decoding thread. */
+    int quit;
+};
+
+/* Decode frames as they come in. */
+static void *
+ps_pipeline_main(void *arg)
+{
+    ps_pipeline_t *pl = (ps_pipeline_t *)arg;
+
+    pthread_mutex_lock(&pl->mtx);
+    for (;;) {
+        mfcc_t **cep;
+        int32 n, nfr;
+        int rv;
+
+        while (pl->n_frame == 0 && !pl->quit)
+            pthread_cond_wait(&pl->avail, &pl->mtx);
+        if (pl->quit)
+            break;
+        /* Take all the contiguous frames at the tail.  They stay
+         * counted in n_frame until they have been decoded. */
+        n = pl->n_frame;
+        if (pl->tail + n > pl->n_alloc)
+            n = pl->n_alloc - pl->tail;
+        rv = pl->rv;
+        pthread_mutex_unlock(&pl->mtx);
+
+        /* After an error, just drop everything until the next
+         * utterance. */
+        cep = pl->cep + pl->tail;
+        nfr = n;
+        while (rv >= 0 && nfr > 0) {
+            pthread_mutex_lock(&pl->search_mtx);
+            if ((rv = acmod_process_cep(pl->acmod, &cep, &nfr, FALSE)) >= 0)
+                rv = (*pl->search)(pl->search_arg);
+            pthread_mutex_unlock(&pl->search_mtx);
+        }
+        pl->tail = (pl->tail + n) % pl->n_alloc;
+
+        pthread_mutex_lock(&pl->mtx);
+        if (rv < 0 && pl->rv == 0)
+            pl->rv = rv;
+        pl->n_frame -= n;
+        pthread_cond_signal(&pl->space);
+    }
+    pthread_mutex_unlock(&pl->mtx);
+    return NULL;
+}
+
+ps_pipeline_t *
+ps_pipeline_init(acmod_t *acmod, ps_pipeline_func_t search, void *arg)
+{
+    ps_pipeline_t *pl;
+
+    pl = ckd_calloc(1, sizeof(*pl));
+    pl->acmod = acmod;
+    pl->search = search;
+    pl->search_arg = arg;
+    pl->n_alloc = PIPELINE_N_FRAMES;
+    pl->ceplen = feat_cepsize(acmod->fcb);
+    pl->cep = (mfcc_t **)ckd_calloc_2d(pl->n_alloc, pl->ceplen,
+                                       sizeof(**pl->cep));
+    pthread_mutex_init(&pl->search_mtx, NULL);
+    pthread_mutex_init(&pl->mtx, NULL);
+    pthread_cond_init(&pl->avail, NULL);
+    pthread_cond_init(&pl->space, NULL);
+    if (pthread_create(&pl->th, NULL, ps_pipeline_main, pl) != 0) {
+        E_ERROR_SYSTEM("Failed to start decoding thread");
+        pthread_cond_destroy(&pl->space);
+        pthread_cond_destroy(&pl->avail);
+        pthread_mutex_destroy(&pl->mtx);
+        pthread_mutex_destroy(&pl->search_mtx);
+        ckd_free_2d(pl->cep);
+        ckd_free(pl);
+        return NULL;
+    }
+    E_INFO("Started decoding thread with %d frames of input\n", pl->n_alloc);
+    return pl;
+}
+
+void
+ps_pipeline_free(ps_pipeline_t *pl)
+{
+    if (pl == NULL)
+        return;
+    pthread_mutex_lock(&pl->mtx);
+    pl->quit = TRUE;
+    pthread_cond_signal(&pl->avail);
+    pthread_mutex_unlock(&pl->mtx);
+    pthread_join(pl->th, NULL);
+    pthread_cond_destroy(&pl->space);
+    pthread_cond_destroy(&pl->avail);
+    pthread_mutex_destroy(&pl->mtx);
+    pthread_mutex_destroy(&pl->search_mtx);
+    ckd_free_2d(pl->cep);
+    ckd_free(pl);
+}
+
+/*
+ * Find the contiguous free frames at the head of the ring, waiting
+ * for some if there are none.
+ */
+static int
+ps_pipeline_space(ps_pipeline_t *pl, int32 *out_head, int32 *out_n)
+{
+    int rv;
+
+    pthread_mutex_lock(&pl->mtx);
+    while (pl->n_frame == pl->n_alloc && pl->rv == 0)
+        pthread_cond_wait(&pl->space, &pl->mtx);
+    rv = pl->rv;
+    *out_head = pl->head;
+    *out_n = pl->n_alloc - pl->n_frame;
+    pthread_mutex_unlock(&pl->mtx);
+
+    if (*out_head + *out_n > pl->n_alloc)
+        *out_n = pl->n_alloc - *out_head;
+    return rv;
+}
+
+/* Hand n frames at the head of the ring to the decoding thread. */
+static void
+ps_pipeline_push(ps_pipeline_t *pl, int32 n)
+{
+    if (n == 0)
+        return;
+    pthread_mutex_lock(&pl->mtx);
+    pl->head = (pl->head + n) % pl->n_alloc;
+    pl->n_frame += n;
+    pthread_cond_signal(&pl->avail);
+    pthread_mutex_unlock(&pl->mtx);
+}
+
+int
+ps_pipeline_process_raw(ps_pipeline_t *pl,
+                        int16 const *data,
+                        size_t n_samples)
+{
+    int n_queued = 0;
+
+    while (n_samples) {
+        int16 const *prev_data = data;
+        int32 head, n, frameidx;
+        int rv;
+
+        if ((rv = ps_pipeline_space(pl, &head, &n)) < 0)
+            return rv;
+        /* The front end belongs to this thread, so it runs while the
+         * decoding thread searches.  Only the utterance start and the
+         * raw audio ring and log are shared with it. */
+        if (acmod_process_raw_cep(pl->acmod, &data, &n_samples,
+                                  pl->cep + head, &n, &frameidx) < 0)
+            return -1;
+        pthread_mutex_lock(&pl->search_mtx);
+        acmod_keep_raw(pl->acmod, prev_data, data - prev_data, frameidx);
+        pthread_mutex_unlock(&pl->search_mtx);
+        ps_pipeline_push(pl, n);
+        n_queued += n;
+    }
+    return n_queued;
+}
+
+int
+ps_pipeline_process_cep(ps_pipeline_t *pl,
+                        mfcc_t **data,
+                        int32 n_frames)
+{
+    int n_queued = 0;
+
+    while (n_frames) {
+        int32 head, n, i;
+        int rv;
+
+        if ((rv = ps_pipeline_space(pl, &head, &n)) < 0)
+            return rv;
+        if (n > n_frames)
+            n = n_frames;
+        for (i = 0; i < n; ++i)
+            memcpy(pl->cep[head + i], data[i], pl->ceplen * sizeof(**data));
+        ps_pipeline_push(pl, n);
+        data += n;
+        n_frames -= n;
+        n_queued += n;
+    }
+    return n_queued;
+}
+
+void
+ps_pipeline_lock(ps_pipeline_t *pl)
+{
+    pthread_mutex_lock(&pl->search_mtx);
+}
+
+void
+ps_pipeline_unlock(ps_pipeline_t *pl)
+{
+    pthread_mutex_unlock(&pl->search_mtx);
+}
+
+void
+ps_pipeline_reset(ps_pipeline_t *pl)
+{
+    pthread_mutex_lock(&pl->mtx);
+    pl->rv = 0;
+    pthread_mutex_unlock(&pl->mtx);
+}
+
+int
+ps_pipeline_wait(ps_pipeline_t *pl)
+{
+    int rv;
+
+    pthread_mutex_lock(&pl->mtx);
+    while (pl->n_frame > 0)
+        pthread_cond_wait(&pl->space, &pl->mtx);
+    rv = pl->rv;
+    pthread_mutex_unlock(&pl->mtx);
+    return rv;
+}
+
+#else /* !HAVE_PTHREAD_H */
+
+ps_pipeline_t *
+ps_pipeline_init(acmod_t *acmod, ps_pipeline_func_t search, void *arg)
+{
+    E_WARN("Threads are not supported on this platform, not using a pipeline\n");
+    return NULL;
+}
+
+void
+ps_pipeline_free(ps_pipeline_t *pl)
+{
+}
+
+int
+ps_pipeline_process_raw(ps_pipeline_t *pl,
+                        int16 const *data,
+                        size_t n_samples)
+{
+    return -1;
+}
+
+int
+ps_pipeline_process_cep(ps_pipeline_t *pl,
+                        mfcc_t **data,
+                        int32 n_frames)
+{
+    return -1;
+}
+
+void
+ps_pipeline_lock(ps_pipeline_t *pl)
+{
+}
+
+void
+ps_pipeline_unlock(ps_pipeline_t *pl)
+{
+}
+
+void
+ps_pipeline_reset(ps_pipeline_t *pl)
+{
+}
+
+int
+ps_pipeline_wait(ps_pipeline_t *pl)
+{
+    return 0;
+}
+
+#endif /* !HAVE_PTHREAD_H */
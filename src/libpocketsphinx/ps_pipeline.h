@@ -0,0 +1,157 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_pipeline.h Pipelined decoding of live input.
+ *
+ * The front end runs in the calling thread, which hands cepstra to a
+ * decoding thread through a single-producer, single-consumer ring of
+ * frames.  The decoding thread computes dynamic features and runs the
+ * search, which itself may have senone scores computed one batch
+ * ahead on a third thread (see acmod_score()).  Each stage blocks only
+ * when the ring in front of it is empty or the one behind it is full.
+ *
+ * The front end of the acoustic model belongs to the calling thread,
+ * so it runs while a block of frames is being searched.  Only the
+ * utterance start and the raw audio ring and log are shared with the
+ * decoding thread, and those are updated under the search lock (see
+ * ps_pipeline_lock()) after each block of audio.  Scoring ahead of
+ * the search only happens with -compallsen, since otherwise the
+ * senones to score are not known until the search gets to each frame.
+ */
+
+#ifndef __PS_PIPELINE_H__
+#define __PS_PIPELINE_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+/* Local headers. */
+#include "acmod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * Decoding pipeline.
+ */
+typedef struct ps_pipeline_s ps_pipeline_t;
+
+/**
+ * Function run by the decoding thread to search all frames in the
+ * acoustic model.
+ *
+ * @return Number of frames searched, or <0 on error.
+ */
+typedef int (*ps_pipeline_func_t)(void *arg);
+
+/**
+ * Create a pipeline and start its decoding thread.
+ *
+ * @param acmod Acoustic model, whose front end is used by the calling
+ *              thread and everything else by the decoding thread.
+ * @param search Function to search the frames in acmod.
+ * @param arg Argument to pass to search.
+ * @return Newly created pipeline, or NULL if threads are not
+ *         available.
+ */
+ps_pipeline_t *ps_pipeline_init(acmod_t *acmod, ps_pipeline_func_t search,
+                                void *arg);
+
+/**
+ * Stop the decoding thread and release a pipeline.
+ */
+void ps_pipeline_free(ps_pipeline_t *pl);
+
+/**
+ * Run the front end on raw audio and queue the cepstra for decoding.
+ *
+ * This blocks only if the ring is full.
+ *
+ * @return Number of frames queued, or <0 on error (including any error
+ *         in the decoding thread since the last ps_pipeline_reset()).
+ */
+int ps_pipeline_process_raw(ps_pipeline_t *pl,
+                            int16 const *data,
+                            size_t n_samples);
+
+/**
+ * Queue cepstra for decoding.
+ *
+ * @return Number of frames queued, or <0 on error.
+ */
+int ps_pipeline_process_cep(ps_pipeline_t *pl,
+                            mfcc_t **data,
+                            int32 n_frames);
+
+/**
+ * Keep the decoding thread from searching, so that the current state
+ * of the search can be looked at from the calling thread.
+ *
+ * The decoding thread takes this lock for each block of frames it
+ * searches, so this waits at most for one block.
+ */
+void ps_pipeline_lock(ps_pipeline_t *pl);
+
+/**
+ * Let the decoding thread search again.
+ */
+void ps_pipeline_unlock(ps_pipeline_t *pl);
+
+/**
+ * Forget any error from the decoding thread (at the start of an
+ * utterance).
+ */
+void ps_pipeline_reset(ps_pipeline_t *pl);
+
+/**
+ * Wait for all queued frames to be decoded.
+ *
+ * Afterwards, the acoustic model and search can be used from the
+ * calling thread until more frames are queued.
+ *
+ * @return 0, or <0 if there was an error in the decoding thread since
+ *         the last ps_pipeline_reset().
+ */
+int ps_pipeline_wait(ps_pipeline_t *pl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PS_PIPELINE_H__ */
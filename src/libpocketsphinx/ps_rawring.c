@@ -0,0 +1,152 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_rawring.c Ring buffer of recent raw audio.
+ */
+
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+/* Local headers. */
+#include "ps_rawring.h"
+
+struct ps_rawring_s {
+    int16 *buf;                 /**< Ring of samples. */
+    int32 n_alloc;              /**< Number of samples in the ring. */
+    int64 head;                 /**< Number of samples added. */
+};
+
+ps_rawring_t *
+ps_rawring_init(int32 n_samples)
+{
+    ps_rawring_t *ring;
+
+    ring = ckd_calloc(1, sizeof(*ring));
+    ring->n_alloc = n_samples > 0 ? n_samples : 1;
+    ring->buf = ckd_calloc(ring->n_alloc, sizeof(*ring->buf));
+    return ring;
+}
+
+void
+ps_rawring_free(ps_rawring_t *ring)
+{
+    if (ring == NULL)
+        return;
+    ckd_free(ring->buf);
+    ckd_free(ring);
+}
+
+int32
+ps_rawring_size(ps_rawring_t *ring)
+{
+    return ring->n_alloc;
+}
+
+void
+ps_rawring_resize(ps_rawring_t *ring, int32 n_samples)
+{
+    ckd_free(ring->buf);
+    ring->n_alloc = n_samples > 0 ? n_samples : 1;
+    ring->buf = ckd_calloc(ring->n_alloc, sizeof(*ring->buf));
+    ring->head = 0;
+}
+
+void
+ps_rawring_reset(ps_rawring_t *ring)
+{
+    ring->head = 0;
+}
+
+void
+ps_rawring_write(ps_rawring_t *ring, int16 const *data, size_t n_samples)
+{
+    /* Only the last n_alloc samples will survive. */
+    if (n_samples > ring->n_alloc) {
+        ring->head += n_samples - ring->n_alloc;
+        data += n_samples - ring->n_alloc;
+        n_samples = ring->n_alloc;
+    }
+    while (n_samples > 0) {
+        int32 start, n;
+
+        start = ring->head % ring->n_alloc;
+        n = ring->n_alloc - start;
+        if (n > n_samples)
+            n = (int32)n_samples;
+        memcpy(ring->buf + start, data, n * sizeof(*data));
+        ring->head += n;
+        data += n;
+        n_samples -= n;
+    }
+}
+
+/* Reverse a range of samples in place. */
+static void
+reverse_samples(int16 *s, int32 n)
+{
+    int32 i;
+
+    for (i = 0; i < n / 2; ++i) {
+        int16 tmp = s[i];
+        s[i] = s[n - 1 - i];
+        s[n - 1 - i] = tmp;
+    }
+}
+
+int32
+ps_rawring_get(ps_rawring_t *ring, int32 n_max, int16 **out_data)
+{
+    int32 n;
+
+    if (ring->head > ring->n_alloc) {
+        int32 start = ring->head % ring->n_alloc;
+        /* Rotate the oldest sample to the start of the ring. */
+        if (start > 0) {
+            reverse_samples(ring->buf, start);
+            reverse_samples(ring->buf + start, ring->n_alloc - start);
+            reverse_samples(ring->buf, ring->n_alloc);
+        }
+        ring->head = ring->n_alloc;
+    }
+    n = (int32)ring->head;
+    if (n > n_max)
+        n = n_max;
+    if (out_data)
+        *out_data = ring->buf + (int32)ring->head - n;
+    return n;
+}
@@ -0,0 +1,110 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_rawring.h Ring buffer of recent raw audio.
+ *
+ * This keeps the most recent audio passed to the decoder, for
+ * ps_get_rawdata().  Audio is copied into the ring once, and only
+ * rearranged when it is asked for.
+ */
+
+#ifndef __PS_RAWRING_H__
+#define __PS_RAWRING_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * Ring buffer of raw audio.
+ */
+typedef struct ps_rawring_s ps_rawring_t;
+
+/**
+ * Create a ring buffer.
+ *
+ * @param n_samples Size of the ring in samples.
+ */
+ps_rawring_t *ps_rawring_init(int32 n_samples);
+
+/**
+ * Release a ring buffer.
+ */
+void ps_rawring_free(ps_rawring_t *ring);
+
+/**
+ * Get the size of a ring buffer in samples.
+ */
+int32 ps_rawring_size(ps_rawring_t *ring);
+
+/**
+ * Change the size of a ring buffer, discarding its contents.
+ */
+void ps_rawring_resize(ps_rawring_t *ring, int32 n_samples);
+
+/**
+ * Discard the contents of a ring buffer, at the start of an utterance.
+ */
+void ps_rawring_reset(ps_rawring_t *ring);
+
+/**
+ * Add audio to a ring buffer, overwriting the oldest audio in it.
+ */
+void ps_rawring_write(ps_rawring_t *ring, int16 const *data, size_t n_samples);
+
+/**
+ * Get the most recent audio in a ring buffer.
+ *
+ * The ring is rearranged in place so that its contents are
+ * contiguous, and the data pointed to is only valid until the next
+ * call to ps_rawring_write() or ps_rawring_reset().
+ *
+ * @param n_max Maximum number of samples to return.
+ * @param out_data Output: pointer to the oldest of them.
+ * @return Number of samples available.
+ */
+int32 ps_rawring_get(ps_rawring_t *ring, int32 n_max, int16 **out_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PS_RAWRING_H__ */
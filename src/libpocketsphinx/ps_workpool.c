@@ -0,0 +1,277 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_workpool.c Worker thread pool for parallel computation.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+/* Local headers. */
+#include "ps_workpool.h"
+
+#ifdef HAVE_PTHREAD_H
+
+typedef struct ps_worker_s {
+    ps_workpool_t *pool;
+    pthread_t th;
+    int idx;
+} ps_worker_t;
+
+struct ps_workpool_s {
+    int n_threads;
+    ps_worker_t *workers;       /**< Workers 1 to n_threads - 1. */
+    pthread_mutex_t mtx;
+    pthread_cond_t start;       /**< Signalled when there is work to do. */
+    pthread_cond_t done;        /**< Signalled when all workers are done. */
+    ps_workfunc_t func;
+    void *arg;
+    int async;                  /**< Caller is not taking part in this run. */
+    uint32 generation;          /**< Incremented for each run. */
+    int n_running;              /**< Number of workers still running. */
+    int quit;
+};
+
+static void *
+ps_worker_main(void *arg)
+{
+    ps_worker_t *w = (ps_worker_t *)arg;
+    ps_workpool_t *pool = w->pool;
+    uint32 generation = 0;
+
+    pthread_mutex_lock(&pool->mtx);
+    for (;;) {
+        ps_workfunc_t func;
+        void *func_arg;
+        int async;
+
+        while (pool->generation == generation && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->mtx);
+        if (pool->quit)
+            break;
+        generation = pool->generation;
+        func = pool->func;
+        func_arg = pool->arg;
+        async = pool->async;
+        pthread_mutex_unlock(&pool->mtx);
+
+        if (async)
+            (*func)(func_arg, w->idx - 1, pool->n_threads - 1);
+        else
+            (*func)(func_arg, w->idx, pool->n_threads);
+
+        pthread_mutex_lock(&pool->mtx);
+        if (--pool->n_running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mtx);
+    return NULL;
+}
+
+ps_workpool_t *
+ps_workpool_init(int n_threads)
+{
+    ps_workpool_t *pool;
+    int i;
+
+    if (n_threads <= 1)
+        return NULL;
+
+    pool = ckd_calloc(1, sizeof(*pool));
+    pool->n_threads = n_threads;
+    pthread_mutex_init(&pool->mtx, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->workers = ckd_calloc(n_threads - 1, sizeof(*pool->workers));
+    for (i = 0; i < n_threads - 1; ++i) {
+        ps_worker_t *w = pool->workers + i;
+        w->pool = pool;
+        w->idx = i + 1;
+        if (pthread_create(&w->th, NULL, ps_worker_main, w) != 0) {
+            E_ERROR_SYSTEM("Failed to start worker thread %d", w->idx);
+            /* Only wait for the ones that actually started. */
+            pool->n_threads = i + 1;
+            ps_workpool_free(pool);
+            return NULL;
+        }
+    }
+    E_INFO("Started %d worker threads\n", n_threads - 1);
+    return pool;
+}
+
+void
+ps_workpool_free(ps_workpool_t *pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->mtx);
+    pool->quit = TRUE;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mtx);
+    for (i = 0; i < pool->n_threads - 1; ++i)
+        pthread_join(pool->workers[i].th, NULL);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mtx);
+    ckd_free(pool->workers);
+    ckd_free(pool);
+}
+
+/* Hand a function to the workers. */
+static void
+ps_workpool_signal(ps_workpool_t *pool, ps_workfunc_t func, void *arg,
+                   int async)
+{
+    pthread_mutex_lock(&pool->mtx);
+    pool->func = func;
+    pool->arg = arg;
+    pool->async = async;
+    pool->n_running = pool->n_threads - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mtx);
+}
+
+void
+ps_workpool_run(ps_workpool_t *pool, ps_workfunc_t func, void *arg)
+{
+    if (pool == NULL) {
+        (*func)(arg, 0, 1);
+        return;
+    }
+
+    ps_workpool_signal(pool, func, arg, FALSE);
+    (*func)(arg, 0, pool->n_threads);
+    ps_workpool_wait(pool);
+}
+
+void
+ps_workpool_start(ps_workpool_t *pool, ps_workfunc_t func, void *arg)
+{
+    if (pool == NULL) {
+        (*func)(arg, 0, 1);
+        return;
+    }
+
+    ps_workpool_signal(pool, func, arg, TRUE);
+}
+
+void
+ps_workpool_wait(ps_workpool_t *pool)
+{
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->mtx);
+    while (pool->n_running > 0)
+        pthread_cond_wait(&pool->done, &pool->mtx);
+    pthread_mutex_unlock(&pool->mtx);
+}
+
+int
+ps_workpool_n_threads(ps_workpool_t *pool)
+{
+    if (pool == NULL)
+        return 1;
+    return pool->n_threads;
+}
+
+#else /* !HAVE_PTHREAD_H */
+
+ps_workpool_t *
+ps_workpool_init(int n_threads)
+{
+    if (n_threads > 1)
+        E_WARN("Threads are not supported on this platform, using only one\n");
+    return NULL;
+}
+
+void
+ps_workpool_free(ps_workpool_t *pool)
+{
+}
+
+void
+ps_workpool_run(ps_workpool_t *pool, ps_workfunc_t func, void *arg)
+{
+    (*func)(arg, 0, 1);
+}
+
+void
+ps_workpool_start(ps_workpool_t *pool, ps_workfunc_t func, void *arg)
+{
+    (*func)(arg, 0, 1);
+}
+
+void
+ps_workpool_wait(ps_workpool_t *pool)
+{
+}
+
+int
+ps_workpool_n_threads(ps_workpool_t *pool)
+{
+    return 1;
+}
+
+#endif /* !HAVE_PTHREAD_H */
+
+void
+ps_workpool_split_deltas(uint8 const *deltas, int n, int n_threads,
+                         int32 *out_prev)
+{
+    int i, j;
+    int32 prev;
+
+    for (prev = i = j = 0; i < n_threads; ++i) {
+        int start, end;
+
+        ps_workpool_range(n, i, n_threads, &start, &end);
+        for (; j < start; ++j)
+            prev += deltas[j];
+        out_prev[i] = prev;
+    }
+}
@@ -0,0 +1,142 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_workpool.h Worker thread pool for parallel computation.
+ *
+ * This is a very simple fork/join pool: the calling thread hands the
+ * same function to every worker (and runs it itself as worker 0),
+ * then waits for all of them to finish, which acts as a barrier.
+ * Work is divided up statically by the function itself, using the
+ * worker index, so results do not depend on thread scheduling.
+ */
+
+#ifndef __PS_WORKPOOL_H__
+#define __PS_WORKPOOL_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * Worker thread pool.
+ */
+typedef struct ps_workpool_s ps_workpool_t;
+
+/**
+ * Function run by each worker.
+ *
+ * @param arg Argument passed to ps_workpool_run().
+ * @param idx Index of this worker, from 0 to n_threads - 1.
+ * @param n_threads Total number of workers.
+ */
+typedef void (*ps_workfunc_t)(void *arg, int idx, int n_threads);
+
+/**
+ * Create a worker pool.
+ *
+ * @param n_threads Total number of threads, including the caller.
+ * @return Newly created pool, or NULL if n_threads is 1 or less or
+ *         threads are not available, in which case the functions
+ *         below simply run everything in the calling thread.
+ */
+ps_workpool_t *ps_workpool_init(int n_threads);
+
+/**
+ * Release a worker pool, stopping its threads.
+ */
+void ps_workpool_free(ps_workpool_t *pool);
+
+/**
+ * Get the number of threads in a worker pool (1 for NULL).
+ */
+int ps_workpool_n_threads(ps_workpool_t *pool);
+
+/**
+ * Run a function on every thread in a pool and wait for it to finish.
+ */
+void ps_workpool_run(ps_workpool_t *pool, ps_workfunc_t func, void *arg);
+
+/**
+ * Start a function on the worker threads of a pool, but not the
+ * calling thread, and return without waiting for it.
+ *
+ * The workers see themselves as worker 0 to n_threads - 2 of
+ * n_threads - 1.  Nothing else may be run on the pool until
+ * ps_workpool_wait() has been called.  Without a pool, the function
+ * simply runs to completion in the calling thread.
+ */
+void ps_workpool_start(ps_workpool_t *pool, ps_workfunc_t func, void *arg);
+
+/**
+ * Wait for a function started with ps_workpool_start() to finish.
+ */
+void ps_workpool_wait(ps_workpool_t *pool);
+
+/**
+ * Find a worker's share of n items.
+ *
+ * The shares are contiguous and in order of worker index.
+ */
+static inline void
+ps_workpool_range(int n, int idx, int n_threads, int *out_start, int *out_end)
+{
+    *out_start = (int)((int64)n * idx / n_threads);
+    *out_end = (int)((int64)n * (idx + 1) / n_threads);
+}
+
+/**
+ * Split up a delta-encoded list (such as the active senone list).
+ *
+ * Since each entry is relative to the previous one, a worker starting
+ * in the middle of the list needs to know the value preceding its
+ * share, as given by ps_workpool_range().
+ *
+ * @param out_prev Output: value preceding each worker's share (0 for
+ *                 the first one).
+ */
+void ps_workpool_split_deltas(uint8 const *deltas, int n, int n_threads,
+                              int32 *out_prev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PS_WORKPOOL_H__ */
@@ -63,16 +63,24 @@
 static ps_mgaufuncs_t ptm_mgau_funcs = {
     "ptm",
     ptm_mgau_frame_eval,      /* frame_eval */
+    ptm_mgau_frame_eval_batch,/* frame_eval_batch */
+    ptm_mgau_frame_eval_active,/* frame_eval_active */
     ptm_mgau_mllr_transform,  /* transform */
     ptm_mgau_free             /* free */
 };
 
-#define COMPUTE_GMM_MAP(_idx)                           \
-    diff[_idx] = obs[_idx] - mean[_idx];                \
-    sqdiff[_idx] = MFCCMUL(diff[_idx], diff[_idx]);     \
-    compl[_idx] = MFCCMUL(sqdiff[_idx], var[_idx]);
-#define COMPUTE_GMM_REDUCE(_idx)                \
-    d = GMMSUB(d, compl[_idx]);
+/**
+ * Arguments for work done by the scoring threads.
+ */
+typedef struct ptm_work_s {
+    ptm_mgau_t *s;
+    mfcc_t **z;
+    int frame;
+    int16 *senone_scores;
+    int compall;
+    mfcc_t ***feat;
+    int n_frames;
+} ptm_work_t;
 
 static void
 insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
@@ -91,47 +99,26 @@ insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
 }
 
 static int
-eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+eval_topn(ptm_mgau_t *s, ptm_fast_eval_t *f, int cb, int feat, mfcc_t *z,
+          int start)
 {
     ptm_topn_t *topn;
+    mfcc_t *mean, *var, *det;
     int i, ceplen;
 
-    topn = s->f->topn[cb][feat];
+    topn = f->topn[cb][feat];
     ceplen = s->g->featlen[feat];
+    mean = s->g->mean[cb][feat][0];
+    var = s->g->var[cb][feat][0];
+    det = s->g->det[cb][feat];
 
-    for (i = 0; i < s->max_topn; i++) {
-        mfcc_t *mean, diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
-        mfcc_t *var, d;
-        mfcc_t *obs;
-        int32 cw, j;
+    for (i = start; i < s->max_topn; i++) {
+        mfcc_t d;
+        int32 cw;
 
         cw = topn[i].cw;
-        mean = s->g->mean[cb][feat][0] + cw * ceplen;
-        var = s->g->var[cb][feat][0] + cw * ceplen;
-        d = s->g->det[cb][feat][cw];
-        obs = z;
-        for (j = 0; j < ceplen % 4; ++j) {
-            diff[0] = *obs++ - *mean++;
-            sqdiff[0] = MFCCMUL(diff[0], diff[0]);
-            compl[0] = MFCCMUL(sqdiff[0], *var);
-            d = GMMSUB(d, compl[0]);
-            ++var;
-        }
-        /* We could vectorize this but it's unlikely to make much
-         * difference as the outer loop here isn't very big. */
-        for (;j < ceplen; j += 4) {
-            COMPUTE_GMM_MAP(0);
-            COMPUTE_GMM_MAP(1);
-            COMPUTE_GMM_MAP(2);
-            COMPUTE_GMM_MAP(3);
-            COMPUTE_GMM_REDUCE(0);
-            COMPUTE_GMM_REDUCE(1);
-            COMPUTE_GMM_REDUCE(2);
-            COMPUTE_GMM_REDUCE(3);
-            var += 4;
-            obs += 4;
-            mean += 4;
-        }
+        d = (*s->gmm_dist)(z, mean + cw * ceplen, var + cw * ceplen,
+                           ceplen, det[cw], GMM_NO_THRESH);
         insertion_sort_topn(topn, i, (int32)d);
     }
 
@@ -152,64 +139,40 @@ insertion_sort_cb(ptm_topn_t **cur, ptm_topn_t *worst, ptm_topn_t *best,
 }
 
 static int
-eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+eval_cb(ptm_mgau_t *s, ptm_fast_eval_t *f, int cb, int feat, mfcc_t *z)
 {
     ptm_topn_t *worst, *best, *topn;
     mfcc_t *mean;
-    mfcc_t *var, *det, *detP, *detE;
-    int32 i, ceplen;
+    mfcc_t *var, *det;
+    uint16 const *cand;
+    int32 i, k, n_cand, ceplen;
 
-    best = topn = s->f->topn[cb][feat];
+    best = topn = f->topn[cb][feat];
     worst = topn + (s->max_topn - 1);
     mean = s->g->mean[cb][feat][0];
     var = s->g->var[cb][feat][0];
     det = s->g->det[cb][feat];
-    detE = det + s->g->n_density;
     ceplen = s->g->featlen[feat];
 
-    for (detP = det; detP < detE; ++detP) {
-        mfcc_t diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
+    /* With kd-trees, only look at the Gaussians in this observation's bucket. */
+    cand = NULL;
+    if (s->kd)
+        n_cand = kdtree_query(s->kd, cb, feat, z, &cand);
+    else
+        n_cand = s->g->n_density;
+
+    for (k = 0; k < n_cand; ++k) {
         mfcc_t d, thresh;
-        mfcc_t *obs;
         ptm_topn_t *cur;
-        int32 cw, j;
+        int32 cw;
 
-        d = *detP;
         thresh = (mfcc_t) worst->score; /* Avoid int-to-float conversions */
-        obs = z;
-        cw = (int)(detP - det);
-
-        /* Unroll the loop starting with the first dimension(s).  In
-         * theory this might be a bit faster if this Gaussian gets
-         * "knocked out" by C0. In practice not. */
-        for (j = 0; (j < ceplen % 4) && (d >= thresh); ++j) {
-            diff[0] = *obs++ - *mean++;
-            sqdiff[0] = MFCCMUL(diff[0], diff[0]);
-            compl[0] = MFCCMUL(sqdiff[0], *var++);
-            d = GMMSUB(d, compl[0]);
-        }
-        /* Now do 4 dimensions at a time.  You'd think that GCC would
-         * vectorize this?  Apparently not.  And it's right, because
-         * that won't make this any faster, at least on x86-64. */
-        for (; j < ceplen && d >= thresh; j += 4) {
-            COMPUTE_GMM_MAP(0);
-            COMPUTE_GMM_MAP(1);
-            COMPUTE_GMM_MAP(2);
-            COMPUTE_GMM_MAP(3);
-            COMPUTE_GMM_REDUCE(0);
-            COMPUTE_GMM_REDUCE(1);
-            COMPUTE_GMM_REDUCE(2);
-            COMPUTE_GMM_REDUCE(3);
-            var += 4;
-            obs += 4;
-            mean += 4;
-        }
-        if (j < ceplen) {
-            /* terminated early, so not in topn */
-            mean += (ceplen - j);
-            var += (ceplen - j);
-            continue;
-        }
+        cw = cand ? cand[k] : k;
+
+        /* The kernel stops early (returning something below thresh)
+         * once this Gaussian can no longer make it into the top-N. */
+        d = (*s->gmm_dist)(z, mean + cw * ceplen, var + cw * ceplen,
+                           ceplen, det[cw], thresh);
         if (d < thresh)
             continue;
         for (i = 0; i < s->max_topn; i++) {
@@ -226,33 +189,181 @@ eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
 }
 
 /**
- * Compute top-N densities for active codebooks (and prune)
+ * Prune active codebooks using the previous frame's best codewords.
+ *
+ * Only the first of each codebook's top-N codewords is scored here,
+ * which is enough to get a good idea of how well it matches the
+ * current frame, and codebooks that fall outside the beam are not
+ * evaluated any further (their senones get the worst score).
  */
 static int
-ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
+ptm_mgau_codebook_prune(ptm_mgau_t *s, mfcc_t **z, int frame)
 {
     int i, j;
+    int32 best;
 
-    /* First evaluate top-N from previous frame. */
-    for (i = 0; i < s->g->n_mgau; ++i)
-        for (j = 0; j < s->g->n_feat; ++j)
-            eval_topn(s, i, j, z[j]);
-
-    /* If frame downsampling is in effect, possibly do nothing else. */
-    if (frame % s->ds_ratio)
-        return 0;
-
-    /* Evaluate remaining codebooks. */
+    best = WORST_SCORE;
     for (i = 0; i < s->g->n_mgau; ++i) {
         if (bitvec_is_clear(s->f->mgau_active, i))
             continue;
+        s->cb_score[i] = 0;
         for (j = 0; j < s->g->n_feat; ++j) {
-            eval_cb(s, i, j, z[j]);
+            ptm_topn_t *topn = s->f->topn[i][j];
+            int32 cw = topn[0].cw;
+            int32 ceplen = s->g->featlen[j];
+            mfcc_t d;
+
+            d = (*s->gmm_dist)(z[j],
+                               s->g->mean[i][j][0] + cw * ceplen,
+                               s->g->var[i][j][0] + cw * ceplen,
+                               ceplen, s->g->det[i][j][cw], GMM_NO_THRESH);
+            topn[0].score = (int32)d;
+            s->cb_score[i] += (int32)d;
+        }
+        if (s->cb_score[i] > best)
+            best = s->cb_score[i];
+    }
+
+    s->n_cb_pruned = 0;
+    for (i = 0; i < s->g->n_mgau; ++i) {
+        if (bitvec_is_clear(s->f->mgau_active, i))
+            continue;
+        if (s->cb_score[i] < best + s->cb_beam) {
+            bitvec_clear(s->f->mgau_active, i);
+            ++s->n_cb_pruned;
+        }
+    }
+    E_DEBUG("Frame %d: pruned %d codebooks\n", frame, s->n_cb_pruned);
+    ++s->n_cb_frames;
+    s->n_cb_pruned_total += s->n_cb_pruned;
+
+    return s->n_cb_pruned;
+}
+
+/**
+ * Compute top-N densities for a range of codebooks.
+ */
+static void
+ptm_mgau_codebook_eval_range(ptm_mgau_t *s, mfcc_t **z, int frame,
+                             int start, int end)
+{
+    int i, j;
+
+    for (i = start; i < end; ++i) {
+        /* First evaluate top-N from previous frame (if pruning, the
+         * first codeword was already evaluated, so do the rest). */
+        if (s->cb_beam) {
+            if (bitvec_is_clear(s->f->mgau_active, i))
+                continue;
+            for (j = 0; j < s->g->n_feat; ++j)
+                eval_topn(s, s->f, i, j, z[j], 1);
+        }
+        else {
+            for (j = 0; j < s->g->n_feat; ++j)
+                eval_topn(s, s->f, i, j, z[j], 0);
+        }
+
+        /* If frame downsampling is in effect, possibly do nothing else. */
+        if (frame % s->ds_ratio)
+            continue;
+
+        /* Evaluate the rest of the codebook. */
+        if (bitvec_is_clear(s->f->mgau_active, i))
+            continue;
+        for (j = 0; j < s->g->n_feat; ++j)
+            eval_cb(s, s->f, i, j, z[j]);
+    }
+}
+
+/**
+ * Compute top-N densities for a range of codebooks over several
+ * frames, all of whose codebooks are active.
+ */
+static void
+ptm_mgau_codebook_eval_batch_range(ptm_mgau_t *s, mfcc_t ***feat,
+                                   int frame, int n_frames,
+                                   int start, int end)
+{
+    int i, j, t;
+
+    for (i = start; i < end; ++i) {
+        /* Keep this codebook's Gaussians in cache while going
+         * through the frames. */
+        for (t = 0; t < n_frames; ++t) {
+            ptm_fast_eval_t *f, *lastf;
+
+            f = s->hist + (frame + t) % s->n_fast_hist;
+            lastf = s->hist
+                + (frame + t + s->n_fast_hist - 1) % s->n_fast_hist;
+            memcpy(f->topn[i][0], lastf->topn[i][0],
+                   s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+            for (j = 0; j < s->g->n_feat; ++j)
+                eval_topn(s, f, i, j, feat[t][j], 0);
+            if ((frame + t) % s->ds_ratio)
+                continue;
+            for (j = 0; j < s->g->n_feat; ++j)
+                eval_cb(s, f, i, j, feat[t][j]);
         }
     }
+}
+
+static void
+ptm_mgau_codebook_eval_batch_work(void *arg, int idx, int n_threads)
+{
+    ptm_work_t *w = (ptm_work_t *)arg;
+    int start, end;
+
+    ps_workpool_range(w->s->g->n_mgau, idx, n_threads, &start, &end);
+    ptm_mgau_codebook_eval_batch_range(w->s, w->feat, w->frame,
+                                       w->n_frames, start, end);
+}
+
+static void
+ptm_mgau_codebook_eval_work(void *arg, int idx, int n_threads)
+{
+    ptm_work_t *w = (ptm_work_t *)arg;
+    int start, end;
+
+    ps_workpool_range(w->s->g->n_mgau, idx, n_threads, &start, &end);
+    ptm_mgau_codebook_eval_range(w->s, w->z, w->frame, start, end);
+}
+
+/**
+ * Compute top-N densities for active codebooks (and prune)
+ */
+static int
+ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
+{
+    ptm_work_t w;
+
+    /* Prune codebooks based on the previous frame's best codewords. */
+    if (s->cb_beam)
+        ptm_mgau_codebook_prune(s, z, frame);
+
+    /* Every codebook's top-N is independent of the others, so they
+     * can be split up between threads. */
+    w.s = s;
+    w.z = z;
+    w.frame = frame;
+    ps_workpool_run(s->pool, ptm_mgau_codebook_eval_work, &w);
     return 0;
 }
 
+/**
+ * Report codebook pruning statistics and reset them.
+ */
+static void
+ptm_mgau_report_pruning(ptm_mgau_t *s)
+{
+    if (s->n_cb_frames == 0)
+        return;
+    E_INFO("Codebook pruning: %.2f of %d codebooks pruned per frame (%d frames)\n",
+           (double)s->n_cb_pruned_total / s->n_cb_frames,
+           s->g->n_mgau, s->n_cb_frames);
+    s->n_cb_frames = 0;
+    s->n_cb_pruned_total = 0;
+}
+
 /**
  * Normalize densities to produce "posterior probabilities",
  * i.e. things with a reasonable dynamic range, then scale and
@@ -320,34 +431,92 @@ ptm_mgau_calc_cb_active(ptm_mgau_t *s, uint8 *senone_active,
 }
 
 /**
- * Compute senone scores from top-N densities for active codebooks.
+ * Sort active senones by codebook.
+ *
+ * Since the active list is in increasing order, so are the senones
+ * for each codebook, which keeps the mixture weight accesses in
+ * ptm_mgau_senone_eval() moving forward through memory.
  */
-static int
-ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
-                     uint8 *senone_active, int32 n_senone_active,
-                     int compall)
+static void
+ptm_mgau_sort_active(ptm_mgau_t *s, uint8 *senone_active,
+                     int32 n_senone_active)
 {
-    int i, lastsen, bestscore;
+    int i, lastsen;
 
-    memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
-    /* FIXME: This is the non-cache-efficient way to do this.  We want
-     * to evaluate one codeword at a time but this requires us to have
-     * a reverse codebook to senone mapping, which we don't have
-     * (yet), since different codebooks have different top-N
-     * codewords. */
-    if (compall)
-        n_senone_active = s->n_sen;
-    bestscore = 0x7fffffff;
+    memset(s->cb_n_active, 0, s->g->n_mgau * sizeof(*s->cb_n_active));
     for (lastsen = i = 0; i < n_senone_active; ++i) {
-        int sen, f, cb;
-        int ascore;
-
-        if (compall)
-            sen = i;
-        else
-            sen = senone_active[i] + lastsen;
+        int sen = senone_active[i] + lastsen;
+        int cb = s->sen2cb[sen];
+        s->cb_active[s->cb2sen_idx[cb] + s->cb_n_active[cb]++] = sen;
         lastsen = sen;
-        cb = s->sen2cb[sen];
+    }
+}
+
+/**
+ * Find active codebooks and sort active senones by codebook, straight
+ * from the active senone bitvector.
+ *
+ * This does the work of ptm_mgau_calc_cb_active() and
+ * ptm_mgau_sort_active() in one pass, visiting only the set bits.
+ *
+ * @param calc_cb Whether to compute the active codebooks as well.
+ */
+static void
+ptm_mgau_vec_active(ptm_mgau_t *s, bitvec_t const *senone_active_vec,
+                    int calc_cb)
+{
+    int w, n_words;
+
+    memset(s->cb_n_active, 0, s->g->n_mgau * sizeof(*s->cb_n_active));
+    if (calc_cb)
+        bitvec_clear_all(s->f->mgau_active, s->g->n_mgau);
+    n_words = bitvec_size(s->n_sen);
+    for (w = 0; w < n_words; ++w) {
+        bitvec_t bits = senone_active_vec[w];
+        while (bits) {
+            int sen = w * BITVEC_BITS + acmod_bitvec_ctz(bits);
+            int cb = s->sen2cb[sen];
+            bits &= bits - 1;
+            if (calc_cb)
+                bitvec_set(s->f->mgau_active, cb);
+            s->cb_active[s->cb2sen_idx[cb] + s->cb_n_active[cb]++] = sen;
+        }
+    }
+}
+
+/**
+ * Compute senone scores from top-N densities for a range of codebooks.
+ *
+ * This goes one codebook at a time, and within each codebook one
+ * top-N codeword at a time, so that each codeword's row of mixture
+ * weights is read only once per frame, in increasing senone order,
+ * rather than jumping between max_topn rows for every senone.
+ *
+ * @param fden Temporary feature densities (n_sen entries).
+ * @return Best (lowest) senone score in these codebooks.
+ */
+static int32
+ptm_mgau_senone_eval_range(ptm_mgau_t *s, int16 *senone_scores,
+                           int compall, int start, int end, int32 *fden)
+{
+    int cb;
+    int32 bestscore;
+
+    bestscore = 0x7fffffff;
+    for (cb = start; cb < end; ++cb) {
+        int32 *senlist;
+        int f, k, n_cbsen;
+
+        if (compall) {
+            senlist = s->cb2sen + s->cb2sen_idx[cb];
+            n_cbsen = s->cb2sen_idx[cb + 1] - s->cb2sen_idx[cb];
+        }
+        else {
+            senlist = s->cb_active + s->cb2sen_idx[cb];
+            n_cbsen = s->cb_n_active[cb];
+        }
+        if (n_cbsen == 0)
+            continue;
 
         if (bitvec_is_clear(s->f->mgau_active, cb)) {
             int j;
@@ -363,35 +532,80 @@ ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
         }
         /* For each feature, log-sum codeword scores + mixw to get
          * feature density, then sum (multiply) to get ascore */
-        ascore = 0;
         for (f = 0; f < s->g->n_feat; ++f) {
             ptm_topn_t *topn;
-            int j, fden = 0;
+            int j;
+
             topn = s->f->topn[cb][f];
             for (j = 0; j < s->max_topn; ++j) {
-                int mixw;
-                /* Find mixture weight for this codeword. */
-                if (s->mixw_cb) {
-                    int dcw = s->mixw[f][topn[j].cw][sen/2];
-                    dcw = (dcw & 1) ? dcw >> 4 : dcw & 0x0f;
-                    mixw = s->mixw_cb[dcw];
-                }
-                else {
-                    mixw = s->mixw[f][topn[j].cw][sen];
+                uint8 *mixw_row = s->mixw[f][topn[j].cw];
+                int32 score = topn[j].score;
+
+                for (k = 0; k < n_cbsen; ++k) {
+                    int sen = senlist[k];
+                    int mixw;
+                    /* Find mixture weight for this codeword. */
+                    if (s->mixw_cb) {
+                        int dcw = mixw_row[sen/2];
+                        dcw = (dcw & 1) ? dcw >> 4 : dcw & 0x0f;
+                        mixw = s->mixw_cb[dcw];
+                    }
+                    else {
+                        mixw = mixw_row[sen];
+                    }
+                    if (j == 0)
+                        fden[k] = mixw + score;
+                    else
+                        fden[k] = fast_logmath_add(s->lmath_8b, fden[k],
+                                                   mixw + score);
+                    E_DEBUG("fden[%d][%d] l+= %d + %d = %d\n",
+                            sen, f, mixw, score, fden[k]);
                 }
-                if (j == 0)
-                    fden = mixw + topn[j].score;
-                else
-                    fden = fast_logmath_add(s->lmath_8b, fden,
-                                       mixw + topn[j].score);
-                E_DEBUG("fden[%d][%d] l+= %d + %d = %d\n",
-                        sen, f, mixw, topn[j].score, fden);
             }
-            ascore += fden;
+            for (k = 0; k < n_cbsen; ++k)
+                senone_scores[senlist[k]] += fden[k];
         }
-        if (ascore < bestscore) bestscore = ascore;
-        senone_scores[sen] = ascore;
+        for (k = 0; k < n_cbsen; ++k)
+            if (senone_scores[senlist[k]] < bestscore)
+                bestscore = senone_scores[senlist[k]];
     }
+
+    return bestscore;
+}
+
+static void
+ptm_mgau_senone_eval_work(void *arg, int idx, int n_threads)
+{
+    ptm_work_t *w = (ptm_work_t *)arg;
+    ptm_mgau_t *s = w->s;
+    int start, end;
+
+    ps_workpool_range(s->g->n_mgau, idx, n_threads, &start, &end);
+    s->thread_best[idx] =
+        ptm_mgau_senone_eval_range(s, w->senone_scores, w->compall,
+                                   start, end, s->fden + idx * s->n_sen);
+}
+
+/**
+ * Compute senone scores from top-N densities for active codebooks.
+ */
+static int
+ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores, int compall)
+{
+    ptm_work_t w;
+    int i, bestscore;
+
+    memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
+    /* Each codebook has its own set of senones, so they can be split
+     * up between threads. */
+    w.s = s;
+    w.senone_scores = senone_scores;
+    w.compall = compall;
+    ps_workpool_run(s->pool, ptm_mgau_senone_eval_work, &w);
+    bestscore = 0x7fffffff;
+    for (i = 0; i < ps_workpool_n_threads(s->pool); ++i)
+        if (s->thread_best[i] < bestscore)
+            bestscore = s->thread_best[i];
     /* Normalize the scores again (finishing the job we started above
      * in ptm_mgau_codebook_eval...) */
     for (i = 0; i < s->n_sen; ++i) {
@@ -402,19 +616,19 @@ ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
 }
 
 /**
- * Compute senone scores for the active senones.
+ * Find top-N history for a frame, and set it up if it is a new one.
+ *
+ * @return TRUE if codebooks have to be evaluated for this frame.
  */
-int32
-ptm_mgau_frame_eval(ps_mgau_t *ps,
-                    int16 *senone_scores,
-                    uint8 *senone_active,
-                    int32 n_senone_active,
-                    mfcc_t ** featbuf, int32 frame,
-                    int32 compallsen)
+static int
+ptm_mgau_frame_start(ptm_mgau_t *s, int32 frame)
 {
-    ptm_mgau_t *s = (ptm_mgau_t *)ps;
     int fast_eval_idx;
 
+    /* Report pruning statistics for the previous utterance. */
+    if (frame == 0)
+        ptm_mgau_report_pruning(s);
+
     /* Find the appropriate frame in the rotating history buffer
      * corresponding to the requested input frame.  No bounds checking
      * is done here, which just means you'll get semi-random crap if
@@ -426,7 +640,7 @@ ptm_mgau_frame_eval(ps_mgau_t *ps,
     /* Compute the top-N codewords for every codebook, unless this
      * is a past frame, in which case we already have them (we
      * hope!) */
-    if (frame >= ps_mgau_base(ps)->frame_idx) {
+    if (frame >= ps_mgau_base(s)->frame_idx) {
         ptm_fast_eval_t *lastf;
         /* Get the previous frame's top-N information (on the
          * first frame of the input this is just all WORST_DIST,
@@ -438,6 +652,25 @@ ptm_mgau_frame_eval(ps_mgau_t *ps,
         /* Copy in initial top-N info */
         memcpy(s->f->topn[0][0], lastf->topn[0][0],
                s->g->n_mgau * s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Compute senone scores for the active senones.
+ */
+int32
+ptm_mgau_frame_eval(ps_mgau_t *ps,
+                    int16 *senone_scores,
+                    uint8 *senone_active,
+                    int32 n_senone_active,
+                    mfcc_t ** featbuf, int32 frame,
+                    int32 compallsen)
+{
+    ptm_mgau_t *s = (ptm_mgau_t *)ps;
+
+    if (ptm_mgau_frame_start(s, frame)) {
         /* Generate initial active codebook list (this might not be
          * necessary) */
         ptm_mgau_calc_cb_active(s, senone_active, n_senone_active, compallsen);
@@ -446,8 +679,81 @@ ptm_mgau_frame_eval(ps_mgau_t *ps,
         ptm_mgau_codebook_norm(s, featbuf, frame);
     }
     /* Evaluate intersection of active senones and active codebooks. */
-    ptm_mgau_senone_eval(s, senone_scores, senone_active,
-                         n_senone_active, compallsen);
+    if (!compallsen)
+        ptm_mgau_sort_active(s, senone_active, n_senone_active);
+    ptm_mgau_senone_eval(s, senone_scores, compallsen);
+
+    return 0;
+}
+
+/**
+ * Compute senone scores for the senones set in a bitvector.
+ */
+int
+ptm_mgau_frame_eval_active(ps_mgau_t *ps,
+                           int16 *senone_scores,
+                           bitvec_t const *senone_active_vec,
+                           mfcc_t ** featbuf, int32 frame)
+{
+    ptm_mgau_t *s = (ptm_mgau_t *)ps;
+    int new_frame;
+
+    new_frame = ptm_mgau_frame_start(s, frame);
+    ptm_mgau_vec_active(s, senone_active_vec, new_frame);
+    if (new_frame) {
+        ptm_mgau_codebook_eval(s, featbuf, frame);
+        ptm_mgau_codebook_norm(s, featbuf, frame);
+    }
+    ptm_mgau_senone_eval(s, senone_scores, FALSE);
+
+    return 0;
+}
+
+/**
+ * Compute scores for all senones over several frames.
+ */
+int
+ptm_mgau_frame_eval_batch(ps_mgau_t *ps,
+                          int16 **senscr,
+                          mfcc_t ***feat,
+                          int32 frame,
+                          int32 n_frames)
+{
+    ptm_mgau_t *s = (ptm_mgau_t *)ps;
+    ptm_work_t w;
+    int t;
+
+    /* Codebook pruning depends on the previous frame's scores, so it
+     * has to be done one frame at a time. */
+    if (s->cb_beam) {
+        for (t = 0; t < n_frames; ++t)
+            ptm_mgau_frame_eval(ps, senscr[t], NULL, 0,
+                                feat[t], frame + t, TRUE);
+        return 0;
+    }
+    if (n_frames > s->n_fast_hist - 1) {
+        E_ERROR("Batch of %d frames does not fit in %d frames of history\n",
+                n_frames, s->n_fast_hist);
+        return -1;
+    }
+
+    if (frame == 0)
+        ptm_mgau_report_pruning(s);
+    for (t = 0; t < n_frames; ++t)
+        bitvec_set_all(s->hist[(frame + t) % s->n_fast_hist].mgau_active,
+                       s->g->n_mgau);
+    /* Compute the top-N codewords for all frames at once. */
+    w.s = s;
+    w.feat = feat;
+    w.frame = frame;
+    w.n_frames = n_frames;
+    ps_workpool_run(s->pool, ptm_mgau_codebook_eval_batch_work, &w);
+    /* Now normalize them and compute senone scores for each frame. */
+    for (t = 0; t < n_frames; ++t) {
+        s->f = s->hist + (frame + t) % s->n_fast_hist;
+        ptm_mgau_codebook_norm(s, feat[t], frame + t);
+        ptm_mgau_senone_eval(s, senscr[t], TRUE);
+    }
 
     return 0;
 }
@@ -835,6 +1141,25 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     s->ds_ratio = cmd_ln_int32_r(s->config, "-ds");
     s->max_topn = cmd_ln_int32_r(s->config, "-topn");
     E_INFO("Maximum top-N: %d\n", s->max_topn);
+    if (cmd_ln_float64_r(s->config, "-cb_beam") > 0.0) {
+        s->cb_beam = (int32)logmath_log(s->lmath,
+                                        cmd_ln_float64_r(s->config, "-cb_beam"));
+        E_INFO("Codebook beam: %d\n", s->cb_beam);
+    }
+    s->gmm_dist = gmm_simd_dist_func
+        (gmm_simd_select(cmd_ln_str_r(s->config, "-gmm_simd")));
+    /* Read kd-trees for Gaussian selection, if any. */
+    if (cmd_ln_exists_r(s->config, "_kdtree")
+        && cmd_ln_str_r(s->config, "_kdtree")) {
+        if ((s->kd = kdtree_read(s->config,
+                                 cmd_ln_str_r(s->config, "_kdtree"))) == NULL)
+            goto error_out;
+        if (kdtree_check(s->kd, s->g) < 0) {
+            E_WARN("kd-trees do not match Gaussians, not using them\n");
+            kdtree_free(s->kd);
+            s->kd = NULL;
+        }
+    }
 
     /* Assume mapping of senones to their base phones, though this
      * will become more flexible in the future. */
@@ -842,10 +1167,39 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     for (i = 0; i < s->n_sen; ++i)
         s->sen2cb[i] = bin_mdef_sen2cimap(acmod->mdef, i);
 
+    /* Build the reverse mapping, from codebooks to (sorted) lists of
+     * senones, for codeword-major senone evaluation. */
+    s->cb2sen_idx = ckd_calloc(s->g->n_mgau + 1, sizeof(*s->cb2sen_idx));
+    s->cb2sen = ckd_calloc(s->n_sen, sizeof(*s->cb2sen));
+    s->cb_active = ckd_calloc(s->n_sen, sizeof(*s->cb_active));
+    s->cb_n_active = ckd_calloc(s->g->n_mgau, sizeof(*s->cb_n_active));
+    s->cb_score = ckd_calloc(s->g->n_mgau, sizeof(*s->cb_score));
+
+    /* Start worker threads, with temporary storage for each. */
+    s->pool = ps_workpool_init(cmd_ln_int32_r(s->config, "-nthreads_score"));
+    s->fden = ckd_calloc(ps_workpool_n_threads(s->pool) * s->n_sen,
+                         sizeof(*s->fden));
+    s->thread_best = ckd_calloc(ps_workpool_n_threads(s->pool),
+                                sizeof(*s->thread_best));
+    for (i = 0; i < s->n_sen; ++i)
+        ++s->cb2sen_idx[s->sen2cb[i] + 1];
+    for (i = 0; i < s->g->n_mgau; ++i)
+        s->cb2sen_idx[i + 1] += s->cb2sen_idx[i];
+    for (i = 0; i < s->n_sen; ++i) {
+        int cb = s->sen2cb[i];
+        s->cb2sen[s->cb2sen_idx[cb] + s->cb_n_active[cb]++] = i;
+    }
+
     /* Allocate fast-match history buffers.  We need enough for the
      * phoneme lookahead window, plus the current frame, plus one for
-     * good measure? (FIXME: I don't remember why) */
+     * good measure? (FIXME: I don't remember why), plus the rest of
+     * a batch of frames scored ahead of the search (-score_batch),
+     * plus two more batches in a pipeline (see acmod_score_batch()). */
     s->n_fast_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
+    if (cmd_ln_int32_r(s->config, "-score_batch") > 1)
+        s->n_fast_hist += cmd_ln_int32_r(s->config, "-score_batch") - 1;
+    if (cmd_ln_boolean_r(s->config, "-pipeline"))
+        s->n_fast_hist += 2 * cmd_ln_int32_r(s->config, "-score_batch");
     s->hist = ckd_calloc(s->n_fast_hist, sizeof(*s->hist));
     /* s->f will be a rotating pointer into s->hist. */
     s->f = s->hist;
@@ -883,6 +1237,13 @@ ptm_mgau_mllr_transform(ps_mgau_t *ps,
                             ps_mllr_t *mllr)
 {
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
+
+    /* The boxes in the kd-trees were built around the old means. */
+    if (s->kd) {
+        E_INFO("Disabling kd-trees after MLLR transform\n");
+        kdtree_free(s->kd);
+        s->kd = NULL;
+    }
     return gauden_mllr_transform(s->g, mllr, s->config);
 }
 
@@ -892,6 +1253,8 @@ ptm_mgau_free(ps_mgau_t *ps)
     int i;
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
 
+    if (s->g)
+        ptm_mgau_report_pruning(s);
     logmath_free(s->lmath);
     logmath_free(s->lmath_8b);
     if (s->sendump_mmap) {
@@ -902,6 +1265,14 @@ ptm_mgau_free(ps_mgau_t *ps)
         ckd_free_3d(s->mixw);
     }
     ckd_free(s->sen2cb);
+    ckd_free(s->cb2sen_idx);
+    ckd_free(s->cb2sen);
+    ckd_free(s->cb_active);
+    ckd_free(s->cb_n_active);
+    ckd_free(s->fden);
+    ckd_free(s->cb_score);
+    ckd_free(s->thread_best);
+    ps_workpool_free(s->pool);
     
     for (i = 0; i < s->n_fast_hist; i++) {
 	ckd_free_3d(s->hist[i].topn);
@@ -910,5 +1281,6 @@ ptm_mgau_free(ps_mgau_t *ps)
     ckd_free(s->hist);
     
     gauden_free(s->g);
+    kdtree_free(s->kd);
     ckd_free(s);
 }
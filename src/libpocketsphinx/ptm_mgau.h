@@ -52,6 +52,9 @@
 #include "hmm.h"
 #include "bin_mdef.h"
 #include "ms_gauden.h"
+#include "gmm_simd.h"
+#include "kdtree.h"
+#include "ps_workpool.h"
 
 typedef struct ptm_mgau_s ptm_mgau_t;
 
@@ -71,11 +74,25 @@ struct ptm_mgau_s {
     gauden_t *g;        /**< Set of Gaussians. */
     int32 n_sen;       /**< Number of senones. */
     uint8 *sen2cb;     /**< Senone to codebook mapping. */
+    int32 *cb2sen_idx; /**< Start of each codebook's senones in cb2sen. */
+    int32 *cb2sen;     /**< Senones sorted by codebook (reverse of sen2cb). */
+    int32 *cb_active;  /**< Active senones sorted by codebook (same layout). */
+    int32 *cb_n_active;/**< Number of active senones in each codebook. */
+    int32 *fden;       /**< Temporary feature densities for one codebook (per thread). */
     uint8 ***mixw;     /**< Mixture weight distributions by feature, codeword, senone */
     mmio_file_t *sendump_mmap;/* Memory map for mixw (or NULL if not mmap) */
     uint8 *mixw_cb;    /* Mixture weight codebook, if any (assume it contains 16 values) */
     int16 max_topn;
     int16 ds_ratio;
+    gmm_dist_func_t gmm_dist; /**< Gaussian distance kernel. */
+    kdtree_t *kd;       /**< kd-trees for Gaussian selection (or NULL). */
+    int32 cb_beam;      /**< Codebook pruning beam, or 0 for none. */
+    int32 *cb_score;    /**< Temporary codebook scores for pruning. */
+    int32 n_cb_pruned;  /**< Number of codebooks pruned in last frame. */
+    int32 n_cb_frames;  /**< Number of frames in pruning statistics. */
+    int32 n_cb_pruned_total; /**< Number of codebooks pruned in those frames. */
+    ps_workpool_t *pool; /**< Worker threads for scoring (or NULL). */
+    int32 *thread_best; /**< Best senone score found by each thread. */
 
     ptm_fast_eval_t *hist;   /**< Fast evaluation info for past frames. */
     ptm_fast_eval_t *f;      /**< Fast eval info for current frame. */
@@ -96,6 +113,16 @@ int ptm_mgau_frame_eval(ps_mgau_t *s,
                         mfcc_t **featbuf,
                         int32 frame,
                         int32 compallsen);
+int ptm_mgau_frame_eval_batch(ps_mgau_t *s,
+                              int16 **senscr,
+                              mfcc_t ***feat,
+                              int32 frame,
+                              int32 n_frames);
+int ptm_mgau_frame_eval_active(ps_mgau_t *s,
+                               int16 *senscr,
+                               bitvec_t const *senone_active_vec,
+                               mfcc_t **feat,
+                               int32 frame);
 int ptm_mgau_mllr_transform(ps_mgau_t *s,
                             ps_mllr_t *mllr);
 
@@ -63,6 +63,8 @@
 static ps_mgaufuncs_t s2_semi_mgau_funcs = {
     "s2_semi",
     s2_semi_mgau_frame_eval,      /* frame_eval */
+    s2_semi_mgau_frame_eval_batch,/* frame_eval_batch */
+    NULL,                         /* frame_eval_active */
     s2_semi_mgau_mllr_transform,  /* transform */
     s2_semi_mgau_free             /* free */
 };
@@ -73,12 +75,12 @@ struct vqFeature_s {
 };
 
 static void
-eval_topn(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
+eval_topn(s2_semi_mgau_t *s, vqFeature_t **f, int32 feat, mfcc_t *z)
 {
     int i, ceplen;
     vqFeature_t *topn;
 
-    topn = s->f[feat];
+    topn = f[feat];
     ceplen = s->g->featlen[feat];
 
     for (i = 0; i < s->max_topn; i++) {
@@ -111,32 +113,63 @@ eval_topn(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
     }
 }
 
+/*
+ * Insert a codeword in the top-N, unless it is already there.  The
+ * caller has made sure it is not worse than the worst one.
+ */
+static void
+insert_topn(s2_semi_mgau_t *s, vqFeature_t *topn, int32 cw, int32 d)
+{
+    vqFeature_t *worst, *cur;
+    int32 i;
+
+    for (i = 0; i < s->max_topn; i++) {
+        /* already there, so don't need to insert */
+        if (topn[i].codeword == cw)
+            return;
+    }
+    /* remaining code inserts codeword and dist in correct spot */
+    worst = topn + (s->max_topn - 1);
+    for (cur = worst - 1; cur >= topn && d >= cur->score; --cur)
+        memcpy(cur + 1, cur, sizeof(vqFeature_t));
+    ++cur;
+    cur->codeword = cw;
+    cur->score = d;
+}
+
 static void
-eval_cb(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
+eval_cb(s2_semi_mgau_t *s, vqFeature_t **f, int32 feat, mfcc_t *z)
 {
-    vqFeature_t *worst, *best, *topn;
-    mfcc_t *mean;
-    mfcc_t *var, *det, *detP, *detE;
-    int32 i, ceplen;
+    vqFeature_t *worst, *topn;
+    mfcc_t *mean0, *var0, *det;
+    uint16 const *cand;
+    int32 k, n_cand, ceplen;
 
-    best = topn = s->f[feat];
+    topn = f[feat];
     worst = topn + (s->max_topn - 1);
-    mean = s->g->mean[0][feat][0];
-    var = s->g->var[0][feat][0];
+    mean0 = s->g->mean[0][feat][0];
+    var0 = s->g->var[0][feat][0];
     det = s->g->det[0][feat];
-    detE = det + s->g->n_density;
     ceplen = s->g->featlen[feat];
 
-    for (detP = det; detP < detE; ++detP) {
+    /* With kd-trees, only look at the Gaussians in this observation's bucket. */
+    cand = NULL;
+    if (s->kd)
+        n_cand = kdtree_query(s->kd, 0, feat, z, &cand);
+    else
+        n_cand = s->g->n_density;
+
+    for (k = 0; k < n_cand; ++k) {
         mfcc_t diff, sqdiff, compl; /* diff, diff^2, component likelihood */
         mfcc_t d;
-        mfcc_t *obs;
-        vqFeature_t *cur;
+        mfcc_t *obs, *mean, *var;
         int32 cw, j;
 
-        d = *detP;
+        cw = cand ? cand[k] : k;
+        d = det[cw];
         obs = z;
-        cw = (int)(detP - det);
+        mean = mean0 + cw * ceplen;
+        var = var0 + cw * ceplen;
         for (j = 0; (j < ceplen) && (d >= worst->score); ++j) {
             diff = *obs++ - *mean++;
             sqdiff = MFCCMUL(diff, diff);
@@ -146,56 +179,43 @@ eval_cb(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
         }
         if (j < ceplen) {
             /* terminated early, so not in topn */
-            mean += (ceplen - j);
-            var += (ceplen - j);
             continue;
         }
         if ((int32)d < worst->score)
             continue;
-        for (i = 0; i < s->max_topn; i++) {
-            /* already there, so don't need to insert */
-            if (topn[i].codeword == cw)
-                break;
-        }
-        if (i < s->max_topn)
-            continue;       /* already there.  Don't insert */
-        /* remaining code inserts codeword and dist in correct spot */
-        for (cur = worst - 1; cur >= best && (int32)d >= cur->score; --cur)
-            memcpy(cur + 1, cur, sizeof(vqFeature_t));
-        ++cur;
-        cur->codeword = cw;
-        cur->score = (int32)d;
+        insert_topn(s, topn, cw, (int32)d);
     }
 }
 
 static void
-mgau_dist(s2_semi_mgau_t * s, int32 frame, int32 feat, mfcc_t * z)
+mgau_dist(s2_semi_mgau_t * s, vqFeature_t **f, int32 frame, int32 feat,
+          mfcc_t * z)
 {
-    eval_topn(s, feat, z);
+    eval_topn(s, f, feat, z);
 
     /* If this frame is skipped, do nothing else. */
     if (frame % s->ds_ratio)
         return;
 
     /* Evaluate the rest of the codebook (or subset thereof). */
-    eval_cb(s, feat, z);
+    eval_cb(s, f, feat, z);
 }
 
 static int
-mgau_norm(s2_semi_mgau_t *s, int feat)
+mgau_norm(s2_semi_mgau_t *s, vqFeature_t **f, int feat)
 {
     int32 norm;
     int j;
 
     /* Compute quantized normalizing constant. */
-    norm = s->f[feat][0].score >> SENSCR_SHIFT;
+    norm = f[feat][0].score >> SENSCR_SHIFT;
 
     /* Normalize the scores, negate them, and clamp their dynamic range. */
     for (j = 0; j < s->max_topn; ++j) {
-        s->f[feat][j].score = -((s->f[feat][j].score >> SENSCR_SHIFT) - norm);
-        if (s->f[feat][j].score > MAX_NEG_ASCR)
-            s->f[feat][j].score = MAX_NEG_ASCR;
-        if (s->topn_beam[feat] && s->f[feat][j].score > s->topn_beam[feat])
+        f[feat][j].score = -((f[feat][j].score >> SENSCR_SHIFT) - norm);
+        if (f[feat][j].score > MAX_NEG_ASCR)
+            f[feat][j].score = MAX_NEG_ASCR;
+        if (s->topn_beam[feat] && f[feat][j].score > s->topn_beam[feat])
             break;
     }
     return j;
@@ -204,7 +224,7 @@ mgau_norm(s2_semi_mgau_t *s, int feat)
 static int32
 get_scores_8b_feat_6(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4, *pid_cw5;
@@ -216,7 +236,7 @@ get_scores_8b_feat_6(s2_semi_mgau_t * s, int i,
     pid_cw4 = s->mixw[i][s->f[i][4].codeword];
     pid_cw5 = s->mixw[i][s->f[i][5].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int sen = senone_active[j] + l;
         int32 tmp = pid_cw0[sen] + s->f[i][0].score;
 
@@ -240,7 +260,7 @@ get_scores_8b_feat_6(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_8b_feat_5(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4;
@@ -251,7 +271,7 @@ get_scores_8b_feat_5(s2_semi_mgau_t * s, int i,
     pid_cw3 = s->mixw[i][s->f[i][3].codeword];
     pid_cw4 = s->mixw[i][s->f[i][4].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int sen = senone_active[j] + l;
         int32 tmp = pid_cw0[sen] + s->f[i][0].score;
 
@@ -273,7 +293,7 @@ get_scores_8b_feat_5(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_8b_feat_4(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3;
@@ -283,7 +303,7 @@ get_scores_8b_feat_4(s2_semi_mgau_t * s, int i,
     pid_cw2 = s->mixw[i][s->f[i][2].codeword];
     pid_cw3 = s->mixw[i][s->f[i][3].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int sen = senone_active[j] + l;
         int32 tmp = pid_cw0[sen] + s->f[i][0].score;
 
@@ -303,7 +323,7 @@ get_scores_8b_feat_4(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_8b_feat_3(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2;
@@ -312,7 +332,7 @@ get_scores_8b_feat_3(s2_semi_mgau_t * s, int i,
     pid_cw1 = s->mixw[i][s->f[i][1].codeword];
     pid_cw2 = s->mixw[i][s->f[i][2].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int sen = senone_active[j] + l;
         int32 tmp = pid_cw0[sen] + s->f[i][0].score;
 
@@ -330,7 +350,7 @@ get_scores_8b_feat_3(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_8b_feat_2(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1;
@@ -338,7 +358,7 @@ get_scores_8b_feat_2(s2_semi_mgau_t * s, int i,
     pid_cw0 = s->mixw[i][s->f[i][0].codeword];
     pid_cw1 = s->mixw[i][s->f[i][1].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int sen = senone_active[j] + l;
         int32 tmp = pid_cw0[sen] + s->f[i][0].score;
 
@@ -354,13 +374,13 @@ get_scores_8b_feat_2(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_8b_feat_1(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0;
 
     pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int sen = senone_active[j] + l;
         int32 tmp = pid_cw0[sen] + s->f[i][0].score;
         senone_scores[sen] += tmp;
@@ -372,11 +392,11 @@ get_scores_8b_feat_1(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_8b_feat_any(s2_semi_mgau_t * s, int i, int topn,
                        int16 *senone_scores, uint8 *senone_active,
-                       int32 n_senone_active)
+                       int32 n_senone_active, int32 lastsen)
 {
     int32 j, k, l;
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int sen = senone_active[j] + l;
         uint8 *pid_cw;
         int32 tmp;
@@ -393,41 +413,123 @@ get_scores_8b_feat_any(s2_semi_mgau_t * s, int i, int topn,
     return 0;
 }
 
+/* Largest top-N and number of active senones done at once by
+ * get_scores_feat_simd(). */
+#define SIMD_MAX_TOPN 16
+#define SIMD_BLOCK 64
+
+/*
+ * Compute senone scores for active senones with the vector log-add
+ * kernel.  The densities are gathered for a block of senones at a
+ * time (this is what the unrolled functions above do one senone at a
+ * time), log-added, then added to the scores.
+ */
+static int32
+get_scores_feat_simd(s2_semi_mgau_t * s, int i, int topn,
+                     int16 *senone_scores, uint8 *senone_active,
+                     int32 n_senone_active, int32 lastsen)
+{
+    int16 den[SIMD_MAX_TOPN][SIMD_BLOCK];
+    int16 tmp[SIMD_BLOCK];
+    int32 sen[SIMD_BLOCK];
+    int16 w_den[SIMD_MAX_TOPN][16];
+    uint8 *pid_cw[SIMD_MAX_TOPN];
+    uint8 const *logadd;
+    int32 j, n, l;
+    int b, k;
+
+    logadd = (uint8 const *)LOGMATH_TABLE(s->lmath_8b)->table;
+    for (k = 0; k < topn; ++k) {
+        pid_cw[k] = s->mixw[i][s->f[i][k].codeword];
+        /* Precompute scaled densities (the unrolled functions keep
+         * them in 8 bits, get_scores_4b_feat_any() does not). */
+        if (s->mixw_cb) {
+            for (b = 0; b < 16; ++b) {
+                w_den[k][b] = s->mixw_cb[b] + s->f[i][k].score;
+                if (topn <= 6)
+                    w_den[k][b] = (uint8)w_den[k][b];
+            }
+        }
+    }
+
+    for (l = lastsen, j = 0; j < n_senone_active; j += n) {
+        n = MIN(SIMD_BLOCK, n_senone_active - j);
+        for (b = 0; b < n; ++b) {
+            sen[b] = senone_active[j + b] + l;
+            l = sen[b];
+        }
+        for (k = 0; k < topn; ++k) {
+            if (s->mixw_cb) {
+                for (b = 0; b < n; ++b) {
+                    int cw = pid_cw[k][sen[b]/2];
+                    cw = (sen[b] & 1) ? cw >> 4 : cw & 0x0f;
+                    den[k][b] = w_den[k][cw];
+                }
+            }
+            else {
+                for (b = 0; b < n; ++b)
+                    den[k][b] = pid_cw[k][sen[b]] + s->f[i][k].score;
+            }
+        }
+        (*s->mixw_simd->logadd)(tmp, den[0], SIMD_BLOCK, topn, n, logadd);
+        for (b = 0; b < n; ++b)
+            senone_scores[sen[b]] += tmp[b];
+    }
+    return 0;
+}
+
 static int32
 get_scores_8b_feat(s2_semi_mgau_t * s, int i, int topn,
-                   int16 *senone_scores, uint8 *senone_active, int32 n_senone_active)
+                   int16 *senone_scores, uint8 *senone_active, int32 n_senone_active, int32 lastsen)
 {
+    if (s->mixw_simd && topn > 1)
+        return get_scores_feat_simd(s, i, topn, senone_scores,
+                                    senone_active, n_senone_active, lastsen);
     switch (topn) {
     case 6:
         return get_scores_8b_feat_6(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 5:
         return get_scores_8b_feat_5(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 4:
         return get_scores_8b_feat_4(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 3:
         return get_scores_8b_feat_3(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 2:
         return get_scores_8b_feat_2(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 1:
         return get_scores_8b_feat_1(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     default:
         return get_scores_8b_feat_any(s, i, topn, senone_scores,
-                                      senone_active, n_senone_active);
+                                      senone_active, n_senone_active, lastsen);
     }
 }
 
 static int32
-get_scores_8b_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores)
+get_scores_8b_feat_all(s2_semi_mgau_t * s, int i, int topn,
+                       int16 *senone_scores, int32 start, int32 end)
 {
     int32 j, k;
 
-    for (j = 0; j < s->n_sen; j++) {
+    if (s->mixw_simd) {
+        uint8 const *pid_cw[SIMD_MAX_TOPN];
+        int16 score[SIMD_MAX_TOPN];
+
+        for (k = 0; k < topn; ++k) {
+            pid_cw[k] = s->mixw[i][s->f[i][k].codeword];
+            score[k] = s->f[i][k].score;
+        }
+        (*s->mixw_simd->mixw8)(senone_scores, pid_cw, score, topn, start, end,
+                               LOGMATH_TABLE(s->lmath_8b)->table);
+        return 0;
+    }
+
+    for (j = start; j < end; j++) {
         uint8 *pid_cw;
         int32 tmp;
         pid_cw = s->mixw[i][s->f[i][0].codeword];
@@ -445,7 +547,7 @@ get_scores_8b_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores
 static int32
 get_scores_4b_feat_6(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4, *pid_cw5;
@@ -468,7 +570,7 @@ get_scores_4b_feat_6(s2_semi_mgau_t * s, int i,
     pid_cw4 = s->mixw[i][s->f[i][4].codeword];
     pid_cw5 = s->mixw[i][s->f[i][5].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int n = senone_active[j] + l;
         int tmp, cw;
 
@@ -509,7 +611,7 @@ get_scores_4b_feat_6(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_4b_feat_5(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4;
@@ -530,7 +632,7 @@ get_scores_4b_feat_5(s2_semi_mgau_t * s, int i,
     pid_cw3 = s->mixw[i][s->f[i][3].codeword];
     pid_cw4 = s->mixw[i][s->f[i][4].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int n = senone_active[j] + l;
         int tmp, cw;
 
@@ -567,7 +669,7 @@ get_scores_4b_feat_5(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_4b_feat_4(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3;
@@ -586,7 +688,7 @@ get_scores_4b_feat_4(s2_semi_mgau_t * s, int i,
     pid_cw2 = s->mixw[i][s->f[i][2].codeword];
     pid_cw3 = s->mixw[i][s->f[i][3].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int n = senone_active[j] + l;
         int tmp, cw;
 
@@ -619,7 +721,7 @@ get_scores_4b_feat_4(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_4b_feat_3(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1, *pid_cw2;
@@ -636,7 +738,7 @@ get_scores_4b_feat_3(s2_semi_mgau_t * s, int i,
     pid_cw1 = s->mixw[i][s->f[i][1].codeword];
     pid_cw2 = s->mixw[i][s->f[i][2].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int n = senone_active[j] + l;
         int tmp, cw;
 
@@ -665,7 +767,7 @@ get_scores_4b_feat_3(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_4b_feat_2(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0, *pid_cw1;
@@ -680,7 +782,7 @@ get_scores_4b_feat_2(s2_semi_mgau_t * s, int i,
     pid_cw0 = s->mixw[i][s->f[i][0].codeword];
     pid_cw1 = s->mixw[i][s->f[i][1].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int n = senone_active[j] + l;
         int tmp, cw;
 
@@ -705,7 +807,7 @@ get_scores_4b_feat_2(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_4b_feat_1(s2_semi_mgau_t * s, int i,
                      int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+                     int32 n_senone_active, int32 lastsen)
 {
     int32 j, l;
     uint8 *pid_cw0;
@@ -718,7 +820,7 @@ get_scores_4b_feat_1(s2_semi_mgau_t * s, int i,
 
     pid_cw0 = s->mixw[i][s->f[i][0].codeword];
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int n = senone_active[j] + l;
         int tmp, cw;
 
@@ -739,11 +841,11 @@ get_scores_4b_feat_1(s2_semi_mgau_t * s, int i,
 static int32
 get_scores_4b_feat_any(s2_semi_mgau_t * s, int i, int topn,
                        int16 *senone_scores, uint8 *senone_active,
-                       int32 n_senone_active)
+                       int32 n_senone_active, int32 lastsen)
 {
     int32 j, k, l;
 
-    for (l = j = 0; j < n_senone_active; j++) {
+    for (l = lastsen, j = 0; j < n_senone_active; j++) {
         int n = senone_active[j] + l;
         int tmp, cw;
         uint8 *pid_cw;
@@ -771,42 +873,59 @@ get_scores_4b_feat_any(s2_semi_mgau_t * s, int i, int topn,
 
 static int32
 get_scores_4b_feat(s2_semi_mgau_t * s, int i, int topn,
-                   int16 *senone_scores, uint8 *senone_active, int32 n_senone_active)
+                   int16 *senone_scores, uint8 *senone_active, int32 n_senone_active, int32 lastsen)
 {
+    if (s->mixw_simd && topn > 1)
+        return get_scores_feat_simd(s, i, topn, senone_scores,
+                                    senone_active, n_senone_active, lastsen);
     switch (topn) {
     case 6:
         return get_scores_4b_feat_6(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 5:
         return get_scores_4b_feat_5(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 4:
         return get_scores_4b_feat_4(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 3:
         return get_scores_4b_feat_3(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 2:
         return get_scores_4b_feat_2(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     case 1:
         return get_scores_4b_feat_1(s, i, senone_scores,
-                                    senone_active, n_senone_active);
+                                    senone_active, n_senone_active, lastsen);
     default:
         return get_scores_4b_feat_any(s, i, topn, senone_scores,
-                                      senone_active, n_senone_active);
+                                      senone_active, n_senone_active, lastsen);
     }
 }
 
 static int32
-get_scores_4b_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores)
+get_scores_4b_feat_all(s2_semi_mgau_t * s, int i, int topn,
+                       int16 *senone_scores, int32 start, int32 end)
 {
-    int j, last_sen;
+    int j;
+
+    if (s->mixw_simd) {
+        uint8 const *pid_cw[SIMD_MAX_TOPN];
+        int16 score[SIMD_MAX_TOPN];
+        int k;
+
+        for (k = 0; k < topn; ++k) {
+            pid_cw[k] = s->mixw[i][s->f[i][k].codeword];
+            score[k] = s->f[i][k].score;
+        }
+        (*s->mixw_simd->mixw4)(senone_scores, pid_cw, score, topn, start, end,
+                               s->mixw_cb, LOGMATH_TABLE(s->lmath_8b)->table);
+        return 0;
+    }
 
-    j = 0;
-    /* Number of senones is always even, but don't overrun if it isn't. */
-    last_sen = s->n_sen & ~1;
-    while (j < last_sen) {
+    /* The range always starts and ends on an even senone. */
+    j = start;
+    while (j < end) {
         uint8 *pid_cw;
         int32 tmp0, tmp1;
         int k;
@@ -829,6 +948,237 @@ get_scores_4b_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores
     return 0;
 }
 
+/**
+ * Arguments for work done by the scoring threads.
+ */
+typedef struct s2_work_s {
+    s2_semi_mgau_t *s;
+    int16 *senone_scores;
+    uint8 *senone_active;
+    int32 n_senone_active;
+    mfcc_t **featbuf;
+    int32 frame;
+    int32 compallsen;
+    int topn_idx;
+    mfcc_t ***feat;
+    int32 n_frames;
+    vqFeature_t **f;
+} s2_work_t;
+
+/*
+ * Compute distances to a share of the candidate codewords in every
+ * feature stream, for eval_cb_merge().  As in eval_cb(), this stops
+ * early for codewords which are already worse than the worst of the
+ * top-N, though here that is the top-N before any codewords were
+ * added to it.  Along with the distance, the partial distance before
+ * the last dimension is kept, since that is what eval_cb() compares
+ * against the top-N last.
+ */
+static void
+eval_cb_range_work(void *arg, int idx, int n_threads)
+{
+    s2_work_t *w = (s2_work_t *)arg;
+    s2_semi_mgau_t *s = w->s;
+    int32 feat;
+
+    for (feat = 0; feat < s->g->n_feat; ++feat) {
+        mfcc_t *mean0, *var0, *det, *z;
+        int32 k, start, end, ceplen, thresh;
+
+        mean0 = s->g->mean[0][feat][0];
+        var0 = s->g->var[0][feat][0];
+        det = s->g->det[0][feat];
+        ceplen = s->g->featlen[feat];
+        z = w->featbuf[feat];
+        thresh = w->f[feat][s->max_topn - 1].score;
+        ps_workpool_range(s->n_cw_cand[feat], idx, n_threads, &start, &end);
+        for (k = start; k < end; ++k) {
+            mfcc_t diff, sqdiff, compl; /* diff, diff^2, component likelihood */
+            mfcc_t d, pen;
+            mfcc_t *obs, *mean, *var;
+            int32 cw, j;
+
+            cw = s->cw_cand[feat] ? s->cw_cand[feat][k] : k;
+            d = pen = det[cw];
+            obs = z;
+            mean = mean0 + cw * ceplen;
+            var = var0 + cw * ceplen;
+            for (j = 0; j < ceplen; ++j) {
+                pen = d;
+                if (d < thresh)
+                    break;
+                diff = *obs++ - *mean++;
+                sqdiff = MFCCMUL(diff, diff);
+                compl = MFCCMUL(sqdiff, *var);
+                d = GMMSUB(d, compl);
+                ++var;
+            }
+            s->cw_dist[feat][k] = d;
+            s->cw_pen[feat][k] = pen;
+        }
+    }
+}
+
+/*
+ * Add the codewords whose distances were computed by
+ * eval_cb_range_work() to the top-N, in the same order and with the
+ * same tests as eval_cb(), which gives the same result.
+ */
+static void
+eval_cb_merge(s2_semi_mgau_t *s, vqFeature_t **f, int32 feat)
+{
+    vqFeature_t *worst, *topn;
+    int32 k;
+
+    topn = f[feat];
+    worst = topn + (s->max_topn - 1);
+    for (k = 0; k < s->n_cw_cand[feat]; ++k) {
+        mfcc_t d = s->cw_dist[feat][k];
+        int32 cw = s->cw_cand[feat] ? s->cw_cand[feat][k] : k;
+
+        /* eval_cb() would have stopped early, or it's too far. */
+        if (s->cw_pen[feat][k] < worst->score || (int32)d < worst->score)
+            continue;
+        insert_topn(s, topn, cw, (int32)d);
+    }
+}
+
+/*
+ * Compute top-N densities for one frame, splitting the codewords of
+ * each feature stream between threads.  This is used when there are
+ * more threads than feature streams (as with the usual single-stream
+ * models), where splitting by stream would leave threads idle.
+ */
+static void
+s2_semi_mgau_dist_split(s2_semi_mgau_t *s, vqFeature_t **f,
+                        vqFeature_t **lastf, mfcc_t **z,
+                        int32 frame, int topn_idx)
+{
+    s2_work_t w;
+    int i;
+
+    for (i = 0; i < s->g->n_feat; ++i) {
+        memcpy(f[i], lastf[i], sizeof(vqFeature_t) * s->max_topn);
+        eval_topn(s, f, i, z[i]);
+    }
+    /* If this frame is skipped, do nothing else. */
+    if (frame % s->ds_ratio == 0) {
+        for (i = 0; i < s->g->n_feat; ++i) {
+            s->cw_cand[i] = NULL;
+            if (s->kd)
+                s->n_cw_cand[i] = kdtree_query(s->kd, 0, i, z[i],
+                                               &s->cw_cand[i]);
+            else
+                s->n_cw_cand[i] = s->g->n_density;
+        }
+        w.s = s;
+        w.f = f;
+        w.featbuf = z;
+        ps_workpool_run(s->pool, eval_cb_range_work, &w);
+        for (i = 0; i < s->g->n_feat; ++i)
+            eval_cb_merge(s, f, i);
+    }
+    for (i = 0; i < s->g->n_feat; ++i)
+        s->topn_hist_n[topn_idx][i] = mgau_norm(s, f, i);
+}
+
+/*
+ * Compute top-N densities for a share of the feature streams.
+ */
+static void
+s2_semi_mgau_dist_work(void *arg, int idx, int n_threads)
+{
+    s2_work_t *w = (s2_work_t *)arg;
+    s2_semi_mgau_t *s = w->s;
+    vqFeature_t **lastf;
+    int i, start, end;
+
+    if (w->topn_idx == 0)
+        lastf = s->topn_hist[s->n_topn_hist-1];
+    else
+        lastf = s->topn_hist[w->topn_idx-1];
+    ps_workpool_range(s->g->n_feat, idx, n_threads, &start, &end);
+    for (i = start; i < end; ++i) {
+        memcpy(s->f[i], lastf[i], sizeof(vqFeature_t) * s->max_topn);
+        mgau_dist(s, s->f, w->frame, i, w->featbuf[i]);
+        s->topn_hist_n[w->topn_idx][i] = mgau_norm(s, s->f, i);
+    }
+}
+
+/*
+ * Compute top-N densities for a share of the feature streams over
+ * several frames.
+ */
+static void
+s2_semi_mgau_dist_batch_work(void *arg, int idx, int n_threads)
+{
+    s2_work_t *w = (s2_work_t *)arg;
+    s2_semi_mgau_t *s = w->s;
+    int i, t, start, end;
+
+    ps_workpool_range(s->g->n_feat, idx, n_threads, &start, &end);
+    for (i = start; i < end; ++i) {
+        for (t = 0; t < w->n_frames; ++t) {
+            int frame = w->frame + t;
+            int topn_idx = frame % s->n_topn_hist;
+            vqFeature_t **f = s->topn_hist[topn_idx];
+            vqFeature_t **lastf =
+                s->topn_hist[(topn_idx + s->n_topn_hist - 1)
+                             % s->n_topn_hist];
+
+            memcpy(f[i], lastf[i], sizeof(vqFeature_t) * s->max_topn);
+            mgau_dist(s, f, frame, i, w->feat[t][i]);
+            s->topn_hist_n[topn_idx][i] = mgau_norm(s, f, i);
+        }
+    }
+}
+
+/*
+ * Compute senone scores for a share of the senones.
+ */
+static void
+s2_semi_mgau_senone_work(void *arg, int idx, int n_threads)
+{
+    s2_work_t *w = (s2_work_t *)arg;
+    s2_semi_mgau_t *s = w->s;
+    int i, start, end;
+
+    if (w->compallsen) {
+        /* 4-bit mixture weights are packed in pairs. */
+        if (s->mixw_cb) {
+            ps_workpool_range(s->n_sen / 2, idx, n_threads, &start, &end);
+            start *= 2;
+            end *= 2;
+        }
+        else
+            ps_workpool_range(s->n_sen, idx, n_threads, &start, &end);
+    }
+    else
+        ps_workpool_range(w->n_senone_active, idx, n_threads, &start, &end);
+
+    for (i = 0; i < s->g->n_feat; ++i) {
+        int topn = s->topn_hist_n[w->topn_idx][i];
+        if (s->mixw_cb) {
+            if (w->compallsen)
+                get_scores_4b_feat_all(s, i, topn, w->senone_scores,
+                                       start, end);
+            else
+                get_scores_4b_feat(s, i, topn, w->senone_scores,
+                                   w->senone_active + start, end - start,
+                                   s->thread_lastsen[idx]);
+        }
+        else {
+            if (w->compallsen)
+                get_scores_8b_feat_all(s, i, topn, w->senone_scores,
+                                       start, end);
+            else
+                get_scores_8b_feat(s, i, topn, w->senone_scores,
+                                   w->senone_active + start, end - start,
+                                   s->thread_lastsen[idx]);
+        }
+    }
+}
+
 /*
  * Compute senone scores for the active senones.
  */
@@ -841,42 +1191,95 @@ s2_semi_mgau_frame_eval(ps_mgau_t *ps,
 			int32 compallsen)
 {
     s2_semi_mgau_t *s = (s2_semi_mgau_t *)ps;
-    int i, topn_idx;
-    int n_feat = s->g->n_feat;
+    s2_work_t w;
 
     memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
     /* No bounds checking is done here, which just means you'll get
      * semi-random crap if you request a frame in the future or one
      * that's too far in the past. */
-    topn_idx = frame % s->n_topn_hist;
-    s->f = s->topn_hist[topn_idx];
-    for (i = 0; i < n_feat; ++i) {
-        /* For past frames this will already be computed. */
-        if (frame >= ps_mgau_base(ps)->frame_idx) {
-            vqFeature_t **lastf;
-            if (topn_idx == 0)
-                lastf = s->topn_hist[s->n_topn_hist-1];
-            else
-                lastf = s->topn_hist[topn_idx-1];
-            memcpy(s->f[i], lastf[i], sizeof(vqFeature_t) * s->max_topn);
-            mgau_dist(s, frame, i, featbuf[i]);
-            s->topn_hist_n[topn_idx][i] = mgau_norm(s, i);
-        }
-        if (s->mixw_cb) {
-            if (compallsen)
-                get_scores_4b_feat_all(s, i, s->topn_hist_n[topn_idx][i], senone_scores);
-            else
-                get_scores_4b_feat(s, i, s->topn_hist_n[topn_idx][i], senone_scores,
-                                   senone_active, n_senone_active);
-        }
-        else {
-            if (compallsen)
-                get_scores_8b_feat_all(s, i, s->topn_hist_n[topn_idx][i], senone_scores);
-            else
-                get_scores_8b_feat(s, i, s->topn_hist_n[topn_idx][i], senone_scores,
-                                   senone_active, n_senone_active);
+    w.s = s;
+    w.senone_scores = senone_scores;
+    w.senone_active = senone_active;
+    w.n_senone_active = n_senone_active;
+    w.featbuf = featbuf;
+    w.frame = frame;
+    w.compallsen = compallsen;
+    w.topn_idx = frame % s->n_topn_hist;
+    s->f = s->topn_hist[w.topn_idx];
+    /* For past frames this will already be computed. */
+    if (frame >= ps_mgau_base(ps)->frame_idx) {
+        if (s->split_cw)
+            s2_semi_mgau_dist_split(s, s->f,
+                                    s->topn_hist[(w.topn_idx + s->n_topn_hist - 1)
+                                                 % s->n_topn_hist],
+                                    featbuf, frame, w.topn_idx);
+        else
+            ps_workpool_run(s->pool, s2_semi_mgau_dist_work, &w);
+    }
+
+    /* Find the senone preceding each thread's share of the active
+     * list, since it is delta-encoded. */
+    if (!compallsen)
+        ps_workpool_split_deltas(senone_active, n_senone_active,
+                                 ps_workpool_n_threads(s->pool),
+                                 s->thread_lastsen);
+    /* Senones are independent, so they can be split up between
+     * threads (each one adds up all the features in the same order). */
+    ps_workpool_run(s->pool, s2_semi_mgau_senone_work, &w);
+
+    return 0;
+}
+
+/*
+ * Compute scores for all senones over several frames.
+ */
+int
+s2_semi_mgau_frame_eval_batch(ps_mgau_t *ps,
+                              int16 **senscr,
+                              mfcc_t ***feat,
+                              int32 frame,
+                              int32 n_frames)
+{
+    s2_semi_mgau_t *s = (s2_semi_mgau_t *)ps;
+    s2_work_t w;
+    int t;
+
+    if (n_frames > s->n_topn_hist - 1) {
+        E_ERROR("Batch of %d frames does not fit in %d frames of history\n",
+                n_frames, s->n_topn_hist);
+        return -1;
+    }
+
+    /* Compute the top-N codewords for all frames at once. */
+    w.s = s;
+    w.feat = feat;
+    w.frame = frame;
+    w.n_frames = n_frames;
+    w.senone_active = NULL;
+    w.n_senone_active = 0;
+    w.compallsen = TRUE;
+    if (s->split_cw) {
+        /* Each frame starts from the previous one's top-N, so the
+         * frames have to be done in order. */
+        for (t = 0; t < n_frames; ++t) {
+            int topn_idx = (frame + t) % s->n_topn_hist;
+            s2_semi_mgau_dist_split(s, s->topn_hist[topn_idx],
+                                    s->topn_hist[(topn_idx + s->n_topn_hist - 1)
+                                                 % s->n_topn_hist],
+                                    feat[t], frame + t, topn_idx);
         }
     }
+    else
+        ps_workpool_run(s->pool, s2_semi_mgau_dist_batch_work, &w);
+
+    /* Now compute senone scores for each frame. */
+    for (t = 0; t < n_frames; ++t) {
+        memset(senscr[t], 0, s->n_sen * sizeof(*senscr[t]));
+        w.senone_scores = senscr[t];
+        w.topn_idx = (frame + t) % s->n_topn_hist;
+        s->f = s->topn_hist[w.topn_idx];
+        ps_workpool_run(s->pool, s2_semi_mgau_senone_work, &w);
+    }
 
     return 0;
 }
@@ -1301,8 +1704,51 @@ s2_semi_mgau_init(acmod_t *acmod)
     }
     E_INFOCONT("\n");
 
+    /* Read kd-trees for Gaussian selection, if any. */
+    if (cmd_ln_exists_r(s->config, "_kdtree")
+        && cmd_ln_str_r(s->config, "_kdtree")) {
+        if ((s->kd = kdtree_read(s->config,
+                                 cmd_ln_str_r(s->config, "_kdtree"))) == NULL)
+            goto error_out;
+        if (kdtree_check(s->kd, s->g) < 0) {
+            E_WARN("kd-trees do not match Gaussians, not using them\n");
+            kdtree_free(s->kd);
+            s->kd = NULL;
+        }
+    }
+
+    /* Use vector code for mixture weights if the log-add table
+     * allows it (with -gmm_simd none, this stays NULL). */
+    if (s->max_topn <= SIMD_MAX_TOPN
+        && gmm_simd_logadd_ok(LOGMATH_TABLE(s->lmath_8b)->table,
+                              LOGMATH_TABLE(s->lmath_8b)->table_size))
+        s->mixw_simd = gmm_simd_mixw_funcs
+            (gmm_simd_select(cmd_ln_str_r(s->config, "-gmm_simd")));
+
+    /* Start worker threads. */
+    s->pool = ps_workpool_init(cmd_ln_int32_r(s->config, "-nthreads_score"));
+    s->thread_lastsen = ckd_calloc(ps_workpool_n_threads(s->pool),
+                                   sizeof(*s->thread_lastsen));
+    /* With more threads than feature streams, split up the
+     * codewords instead. */
+    if (ps_workpool_n_threads(s->pool) > n_feat) {
+        s->split_cw = TRUE;
+        s->cw_dist = (mfcc_t **)ckd_calloc_2d(n_feat, s->g->n_density,
+                                              sizeof(**s->cw_dist));
+        s->cw_pen = (mfcc_t **)ckd_calloc_2d(n_feat, s->g->n_density,
+                                             sizeof(**s->cw_pen));
+        s->cw_cand = ckd_calloc(n_feat, sizeof(*s->cw_cand));
+        s->n_cw_cand = ckd_calloc(n_feat, sizeof(*s->n_cw_cand));
+    }
+
     /* Top-N scores from recent frames */
     s->n_topn_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
+    /* Plus frames scored ahead of the search in a batch. */
+    if (cmd_ln_int32_r(s->config, "-score_batch") > 1)
+        s->n_topn_hist += cmd_ln_int32_r(s->config, "-score_batch") - 1;
+    /* And for two more in a pipeline (see acmod_score_batch()). */
+    if (cmd_ln_boolean_r(s->config, "-pipeline"))
+        s->n_topn_hist += 2 * cmd_ln_int32_r(s->config, "-score_batch");
     s->topn_hist = (vqFeature_t ***)
         ckd_calloc_3d(s->n_topn_hist, n_feat, s->max_topn,
                       sizeof(***s->topn_hist));
@@ -1332,6 +1778,13 @@ s2_semi_mgau_mllr_transform(ps_mgau_t *ps,
                             ps_mllr_t *mllr)
 {
     s2_semi_mgau_t *s = (s2_semi_mgau_t *)ps;
+
+    /* The boxes in the kd-trees were built around the old means. */
+    if (s->kd) {
+        E_INFO("Disabling kd-trees after MLLR transform\n");
+        kdtree_free(s->kd);
+        s->kd = NULL;
+    }
     return gauden_mllr_transform(s->g, mllr, s->config);
 }
 
@@ -1352,6 +1805,15 @@ s2_semi_mgau_free(ps_mgau_t *ps)
             ckd_free(s->mixw_cb);
     }
     gauden_free(s->g);
+    kdtree_free(s->kd);
+    ps_workpool_free(s->pool);
+    ckd_free(s->thread_lastsen);
+    if (s->cw_dist)
+        ckd_free_2d(s->cw_dist);
+    if (s->cw_pen)
+        ckd_free_2d(s->cw_pen);
+    ckd_free(s->cw_cand);
+    ckd_free(s->n_cw_cand);
     ckd_free(s->topn_beam);
     ckd_free_2d(s->topn_hist_n);
     ckd_free_3d((void **)s->topn_hist);
@@ -52,6 +52,9 @@
 #include "hmm.h"
 #include "bin_mdef.h"
 #include "ms_gauden.h"
+#include "kdtree.h"
+#include "ps_workpool.h"
+#include "gmm_simd.h"
 
 typedef struct vqFeature_s vqFeature_t;
 
@@ -70,6 +73,15 @@ struct s2_semi_mgau_s {
     uint8 *topn_beam;   /* Beam for determining per-frame top-N densities */
     int16 max_topn;
     int16 ds_ratio;
+    kdtree_t *kd;       /**< kd-trees for Gaussian selection (or NULL). */
+    ps_workpool_t *pool; /**< Worker threads for scoring (or NULL). */
+    int32 *thread_lastsen; /**< Senone preceding each thread's active senones. */
+    int split_cw;       /**< Split codewords rather than streams between threads? */
+    mfcc_t **cw_dist;   /**< Distance to each candidate codeword (if split_cw). */
+    mfcc_t **cw_pen;    /**< Partial distance before last dimension (if split_cw). */
+    uint16 const **cw_cand; /**< Candidate codewords in each stream (or NULL for all). */
+    int32 *n_cw_cand;   /**< Number of candidate codewords in each stream. */
+    gmm_mixw_funcs_t const *mixw_simd; /**< Vectorized mixture weight kernels (or NULL). */
 
     vqFeature_t ***topn_hist; /**< Top-N scores and codewords for past frames. */
     uint8 **topn_hist_n;      /**< Variable top-N for past frames. */
@@ -91,6 +103,11 @@ int s2_semi_mgau_frame_eval(ps_mgau_t *s,
                             mfcc_t **featbuf,
                             int32 frame,
                             int32 compallsen);
+int s2_semi_mgau_frame_eval_batch(ps_mgau_t *s,
+                                  int16 **senscr,
+                                  mfcc_t ***feat,
+                                  int32 frame,
+                                  int32 n_frames);
 int s2_semi_mgau_mllr_transform(ps_mgau_t *s,
                                 ps_mllr_t *mllr);
 
@@ -0,0 +1,503 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file senfile.c Indexed senone score files.
+ */
+
+/* System headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+#include <sphinxbase/bio.h>
+#include <sphinxbase/byteorder.h>
+#include <sphinxbase/strfuncs.h>
+
+/* Local headers. */
+#include "senfile.h"
+#include "acmod.h"
+
+/** Escape in delta-compressed scores for a difference that does not fit. */
+#define SENFILE_DELTA_ESCAPE -128
+
+static const char *senfile_compress_names[] = {
+    "none", "delta", "int8"
+};
+
+int
+senfile_compress_type(char const *name)
+{
+    int i;
+
+    for (i = 0; i < sizeof(senfile_compress_names)
+             / sizeof(senfile_compress_names[0]); ++i)
+        if (0 == strcmp(name, senfile_compress_names[i]))
+            return i;
+    return -1;
+}
+
+int
+senfile_write_header(FILE *fh, int compress, int32 n_sen,
+                     char const *mdef_file, float64 logbase)
+{
+    char nsenstr[64], logbasestr[64];
+
+    if (compress < 0 || compress > SENFILE_COMPRESS_INT8) {
+        E_ERROR("Unknown senone score compression %d\n", compress);
+        return -1;
+    }
+    sprintf(nsenstr, "%d", n_sen);
+    sprintf(logbasestr, "%f", logbase);
+    if (bio_writehdr(fh,
+                     "version", SENFILE_VERSION,
+                     "mdef_file", mdef_file ? mdef_file : "",
+                     "n_sen", nsenstr,
+                     "logbase", logbasestr,
+                     "compress", senfile_compress_names[compress],
+                     NULL) < 0) {
+        E_ERROR_SYSTEM("Failed to write senone score file header");
+        return -1;
+    }
+    return 0;
+}
+
+senfile_writer_t *
+senfile_writer_init(ps_logfile_t *out, int compress, int32 n_sen)
+{
+    senfile_writer_t *w;
+
+    w = ckd_calloc(1, sizeof(*w));
+    w->out = out;
+    w->n_sen = n_sen;
+    w->compress = compress;
+    w->n_frame_alloc = 256;
+    w->index = ckd_calloc(w->n_frame_alloc, sizeof(*w->index));
+    /* Worst case is the delta encoding with every score escaped. */
+    w->buf = ckd_calloc(2 + n_sen + 2 + 3 * n_sen, 1);
+    return w;
+}
+
+int
+senfile_write_frame(senfile_writer_t *w, int n_active,
+                    uint8 const *active, int16 const *senscr)
+{
+    uint8 *ptr = w->buf;
+    uint16 n_active2;
+    int32 i, sen, prev, shift, worst;
+    size_t len;
+
+    n_active2 = n_active;
+    memcpy(ptr, &n_active2, 2);
+    ptr += 2;
+    if (n_active < w->n_sen) {
+        memcpy(ptr, active, n_active);
+        ptr += n_active;
+    }
+    else
+        active = NULL;
+
+    switch (w->compress) {
+    case SENFILE_COMPRESS_NONE:
+        for (i = sen = 0; i < n_active; ++i) {
+            sen = active ? sen + active[i] : i;
+            memcpy(ptr, senscr + sen, 2);
+            ptr += 2;
+        }
+        break;
+    case SENFILE_COMPRESS_DELTA:
+        for (i = sen = prev = 0; i < n_active; ++i) {
+            int32 diff;
+
+            sen = active ? sen + active[i] : i;
+            diff = senscr[sen] - prev;
+            if (i > 0 && diff > SENFILE_DELTA_ESCAPE && diff <= 127)
+                *ptr++ = (uint8)(int8)diff;
+            else {
+                if (i > 0)
+                    *ptr++ = (uint8)(int8)SENFILE_DELTA_ESCAPE;
+                memcpy(ptr, senscr + sen, 2);
+                ptr += 2;
+            }
+            prev = senscr[sen];
+        }
+        break;
+    case SENFILE_COMPRESS_INT8:
+        /* Find the smallest shift that will fit the worst score,
+         * after rounding, into a byte. */
+        for (i = sen = worst = 0; i < n_active; ++i) {
+            sen = active ? sen + active[i] : i;
+            if (senscr[sen] > worst)
+                worst = senscr[sen];
+        }
+        for (shift = 0; shift < 15; ++shift) {
+            int32 half = shift ? 1 << (shift - 1) : 0;
+            if (((worst + half) >> shift) <= 255)
+                break;
+        }
+        if (n_active > 0)
+            *ptr++ = shift;
+        for (i = sen = 0; i < n_active; ++i) {
+            int32 half = shift ? 1 << (shift - 1) : 0;
+            int32 score;
+
+            sen = active ? sen + active[i] : i;
+            score = senscr[sen] < 0 ? 0 : senscr[sen];
+            score = (score + half) >> shift;
+            *ptr++ = score > 255 ? 255 : score;
+        }
+        break;
+    }
+
+    len = ptr - w->buf;
+    if (ps_logfile_write(w->out, w->buf, len) < 0)
+        return -1;
+    if (w->n_frame == w->n_frame_alloc) {
+        w->n_frame_alloc *= 2;
+        w->index = ckd_realloc(w->index,
+                               w->n_frame_alloc * sizeof(*w->index));
+    }
+    w->index[w->n_frame++] = w->pos;
+    w->pos += len;
+    return 0;
+}
+
+int
+senfile_writer_close(senfile_writer_t *w)
+{
+    uint32 trailer[2];
+    int rv = 0;
+
+    if (w == NULL)
+        return 0;
+    trailer[0] = w->n_frame;
+    trailer[1] = SENFILE_INDEX_MAGIC;
+    if (ps_logfile_write(w->out, w->index,
+                         w->n_frame * sizeof(*w->index)) < 0
+        || ps_logfile_write(w->out, trailer, sizeof(trailer)) < 0)
+        rv = -1;
+    ckd_free(w->index);
+    ckd_free(w->buf);
+    ckd_free(w);
+    return rv;
+}
+
+/**
+ * Decode (or just measure, if senscr is NULL) one frame.
+ *
+ * @return Size of the frame in bytes, or <0 if it is corrupt.
+ */
+static int32
+senfile_decode(senfile_t *sf, uint8 const *frame, uint32 avail,
+               int16 *senscr, uint8 *active, int *out_n_active)
+{
+    uint8 const *ptr = frame, *end = frame + avail;
+    uint8 const *deltas;
+    uint16 n_active;
+    int32 i, sen, shift;
+    int16 score;
+
+    if (end - ptr < 2)
+        return -1;
+    memcpy(&n_active, ptr, 2);
+    ptr += 2;
+    if (sf->swap)
+        SWAP_INT16(&n_active);
+    if (n_active > sf->n_sen)
+        return -1;
+    deltas = NULL;
+    if (n_active < sf->n_sen) {
+        if (end - ptr < n_active)
+            return -1;
+        deltas = ptr;
+        ptr += n_active;
+    }
+
+    if (senscr) {
+        if (deltas) {
+            for (i = 0; i < sf->n_sen; ++i)
+                senscr[i] = SENSCR_DUMMY;
+            memcpy(active, deltas, n_active);
+        }
+        else {
+            /* Make the delta list consistent with the scores. */
+            for (i = 0; i < n_active; ++i)
+                active[i] = (i > 0);
+        }
+        *out_n_active = n_active;
+    }
+
+    score = 0;
+    shift = 0;
+    if (sf->compress == SENFILE_COMPRESS_INT8 && n_active > 0) {
+        if (end - ptr < 1 || *ptr > 15)
+            return -1;
+        shift = *ptr++;
+    }
+    for (i = sen = 0; i < n_active; ++i) {
+        if (deltas) {
+            sen += deltas[i];
+            if (sen >= sf->n_sen)
+                return -1;
+        }
+        else
+            sen = i;
+
+        switch (sf->compress) {
+        case SENFILE_COMPRESS_NONE:
+            if (end - ptr < 2)
+                return -1;
+            memcpy(&score, ptr, 2);
+            ptr += 2;
+            if (sf->swap)
+                SWAP_INT16(&score);
+            break;
+        case SENFILE_COMPRESS_DELTA:
+            if (i > 0) {
+                if (end - ptr < 1)
+                    return -1;
+                if ((int8)*ptr != SENFILE_DELTA_ESCAPE) {
+                    score += (int8)*ptr++;
+                    break;
+                }
+                ++ptr;
+            }
+            if (end - ptr < 2)
+                return -1;
+            memcpy(&score, ptr, 2);
+            ptr += 2;
+            if (sf->swap)
+                SWAP_INT16(&score);
+            break;
+        case SENFILE_COMPRESS_INT8: {
+            int32 val;
+            if (end - ptr < 1)
+                return -1;
+            val = (int32)*ptr++ << shift;
+            score = val > 32767 ? 32767 : val;
+            break;
+        }
+        }
+        if (senscr)
+            senscr[sen] = score;
+    }
+
+    return ptr - frame;
+}
+
+int
+senfile_read(cmd_ln_t *config, char const *file, FILE *fh,
+             senfile_t **out_sf)
+{
+    senfile_t *sf;
+    char **name, **val;
+    int32 swap, do_mmap;
+    int32 i, n_sen, compress;
+    float64 logbase;
+    char const *version;
+    uint32 trailer[2];
+    uint8 const *ptr;
+    size_t size;
+    long pos, end;
+
+    *out_sf = NULL;
+    if (bio_readhdr(fh, &name, &val, &swap) < 0) {
+        E_ERROR("Failed to read senone score file header\n");
+        return -1;
+    }
+    version = NULL;
+    n_sen = -1;
+    logbase = 0;
+    compress = SENFILE_COMPRESS_NONE;
+    for (i = 0; name[i] != NULL; ++i) {
+        if (!strcmp(name[i], "version"))
+            version = val[i];
+        else if (!strcmp(name[i], "n_sen"))
+            n_sen = atoi(val[i]);
+        else if (!strcmp(name[i], "logbase"))
+            logbase = atof_c(val[i]);
+        else if (!strcmp(name[i], "compress")) {
+            if ((compress = senfile_compress_type(val[i])) < 0) {
+                E_ERROR("Unknown senone score compression %s\n", val[i]);
+                bio_hdrarg_free(name, val);
+                return -1;
+            }
+        }
+    }
+    if (version == NULL || strcmp(version, SENFILE_VERSION) != 0) {
+        if (version && atof_c(version) > atof_c(SENFILE_VERSION)) {
+            E_ERROR("Senone score file version %s is newer than library\n",
+                    version);
+            bio_hdrarg_free(name, val);
+            return -1;
+        }
+        /* Old-style senone dump, let the caller read it. */
+        bio_hdrarg_free(name, val);
+        fseek(fh, 0, SEEK_SET);
+        return 0;
+    }
+    bio_hdrarg_free(name, val);
+    if (n_sen <= 0) {
+        E_ERROR("Senone score file has no n_sen\n");
+        return -1;
+    }
+
+    sf = ckd_calloc(1, sizeof(*sf));
+    sf->n_sen = n_sen;
+    sf->logbase = logbase;
+    sf->compress = compress;
+    sf->swap = swap;
+    pos = ftell(fh);
+    fseek(fh, 0, SEEK_END);
+    end = ftell(fh);
+    size = end - pos;
+
+    /* Decide whether to read in the whole file or mmap it.  Since
+     * everything is copied out of it, byte order doesn't matter. */
+    do_mmap = config ? cmd_ln_boolean_r(config, "-mmap") : TRUE;
+    if (file == NULL)
+        do_mmap = FALSE;
+    if (do_mmap) {
+        sf->filemap = mmio_file_read(file);
+        if (sf->filemap == NULL)
+            do_mmap = FALSE;
+    }
+    if (do_mmap) {
+        ptr = (uint8 const *)mmio_file_ptr(sf->filemap) + pos;
+    }
+    else {
+        fseek(fh, pos, SEEK_SET);
+        sf->data = ckd_malloc(size ? size : 1);
+        if (fread(sf->data, 1, size, fh) != size) {
+            E_ERROR_SYSTEM("Failed to read %ld bytes from senone score file",
+                           (long)size);
+            goto error_out;
+        }
+        ptr = sf->data;
+    }
+    sf->frames = ptr;
+
+    if (size >= sizeof(trailer))
+        memcpy(trailer, ptr + size - sizeof(trailer), sizeof(trailer));
+    else
+        trailer[0] = trailer[1] = 0;
+    if (swap) {
+        SWAP_INT32(trailer);
+        SWAP_INT32(trailer + 1);
+    }
+    if (trailer[1] == SENFILE_INDEX_MAGIC
+        && trailer[0] <= (size - sizeof(trailer)) / sizeof(*sf->index)) {
+        sf->n_frame = trailer[0];
+        sf->size = size - sizeof(trailer) - sf->n_frame * sizeof(*sf->index);
+        sf->index = ckd_calloc(sf->n_frame + 1, sizeof(*sf->index));
+        memcpy(sf->index, ptr + sf->size, sf->n_frame * sizeof(*sf->index));
+        for (i = 0; i < sf->n_frame; ++i) {
+            if (swap)
+                SWAP_INT32(sf->index + i);
+            if (sf->index[i] >= sf->size) {
+                E_ERROR("Offset of frame %d out of range in senone file\n", i);
+                goto error_out;
+            }
+        }
+    }
+    else {
+        /* The writer never finished (the decoder may have crashed),
+         * so find the frames by reading through them. */
+        int32 n_frame_alloc = 256;
+        uint32 off;
+
+        E_WARN("Senone score file has no frame index, scanning frames\n");
+        sf->size = size;
+        sf->index = ckd_calloc(n_frame_alloc, sizeof(*sf->index));
+        for (off = 0; off < sf->size;) {
+            int32 len;
+            if ((len = senfile_decode(sf, ptr + off, sf->size - off,
+                                      NULL, NULL, NULL)) < 0) {
+                E_WARN("Truncated frame %d in senone score file\n",
+                       sf->n_frame);
+                break;
+            }
+            if (sf->n_frame == n_frame_alloc) {
+                n_frame_alloc *= 2;
+                sf->index = ckd_realloc(sf->index, n_frame_alloc
+                                        * sizeof(*sf->index));
+            }
+            sf->index[sf->n_frame++] = off;
+            off += len;
+        }
+    }
+
+    E_INFO("Senone score file: %d frames, %d senones, %s compression%s\n",
+           sf->n_frame, sf->n_sen, senfile_compress_names[sf->compress],
+           sf->filemap ? " (memory-mapped)" : "");
+    *out_sf = sf;
+    return 0;
+
+error_out:
+    senfile_free(sf);
+    return -1;
+}
+
+int
+senfile_frame(senfile_t *sf, int32 frame, int16 *senscr,
+              uint8 *active, int *out_n_active)
+{
+    uint32 off;
+
+    if (frame < 0 || frame >= sf->n_frame)
+        return -1;
+    off = sf->index[frame];
+    if (senfile_decode(sf, sf->frames + off, sf->size - off,
+                       senscr, active, out_n_active) < 0) {
+        E_ERROR("Frame %d in senone score file is corrupt\n", frame);
+        return -1;
+    }
+    return 0;
+}
+
+void
+senfile_free(senfile_t *sf)
+{
+    if (sf == NULL)
+        return;
+    if (sf->filemap)
+        mmio_file_unmap(sf->filemap);
+    else
+        ckd_free(sf->data);
+    ckd_free(sf->index);
+    ckd_free(sf);
+}
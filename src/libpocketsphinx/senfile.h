@@ -0,0 +1,218 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file senfile.h Indexed senone score files.
+ *
+ * These are an alternative to the original (version 0.1) senone dump
+ * format written by acmod_write_scores(), meant for running the
+ * search many times over the same acoustic scores.  The file starts
+ * with the usual sphinxbase binary header, with "version" set to
+ * SENFILE_VERSION and a "compress" argument giving the encoding of
+ * the scores.  This is followed by the frames and finally by an index
+ * giving the offset of each frame, so that any frame can be found
+ * without reading the ones before it and the whole file can be
+ * memory-mapped:
+ *
+ * (n_frame * 4 bytes) offset of each frame from the end of the header
+ * (4 bytes) n_frame
+ * (4 bytes) SENFILE_INDEX_MAGIC
+ *
+ * Each frame is laid out as:
+ *
+ * (2 bytes) n_active: Number of active senones
+ * If not all senones are active:
+ * (n_active bytes) deltas to active senones
+ * Then the scores of active senones, which are either:
+ *  - SENFILE_COMPRESS_NONE: (n_active * 2 bytes) scores
+ *  - SENFILE_COMPRESS_DELTA: (2 bytes) first score, then for each
+ *    following one a signed byte giving the difference from the
+ *    previous score, or -128 followed by the score in 2 bytes if the
+ *    difference does not fit.  This is lossless.
+ *  - SENFILE_COMPRESS_INT8: (1 byte, unless n_active is 0) shift,
+ *    then (n_active bytes) scores shifted right by that many bits,
+ *    rounded.  The shift is the smallest one that makes the worst
+ *    score in the frame fit.
+ *
+ * Everything is in the byte order of the machine that wrote it.
+ * Nothing is aligned, so all access goes through memcpy().
+ */
+
+#ifndef __SENFILE_H__
+#define __SENFILE_H__
+
+/* System headers. */
+#include <stdio.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/mmio.h>
+
+/* Local headers. */
+#include "ps_logwriter.h"
+
+#define SENFILE_VERSION "1.0"
+/* Little-endian machines will write "SIDX" to disk, big-endian ones "XDIS". */
+#define SENFILE_INDEX_MAGIC 0x58444953 /* 'SIDX' in little-endian order */
+
+/**
+ * Encoding of scores in an indexed senone score file.
+ */
+enum senfile_compress_e {
+    SENFILE_COMPRESS_NONE,  /**< 16-bit scores. */
+    SENFILE_COMPRESS_DELTA, /**< Byte differences between scores. */
+    SENFILE_COMPRESS_INT8   /**< Scores quantized to one byte. */
+};
+
+/**
+ * Writer for an indexed senone score file.
+ */
+typedef struct senfile_writer_s senfile_writer_t;
+struct senfile_writer_s {
+    ps_logfile_t *out; /**< Output file (not owned). */
+    int32 n_sen;       /**< Number of senones. */
+    int32 compress;    /**< Encoding of scores. */
+    uint32 pos;        /**< Offset of next frame from end of header. */
+    uint32 *index;     /**< Offsets of frames written so far. */
+    int32 n_frame;     /**< Number of frames written so far. */
+    int32 n_frame_alloc; /**< Allocated size of index. */
+    uint8 *buf;        /**< Buffer for encoding one frame. */
+};
+
+/**
+ * Indexed senone score file opened for reading.
+ */
+typedef struct senfile_s senfile_t;
+struct senfile_s {
+    int32 n_sen;       /**< Number of senones. */
+    float64 logbase;   /**< Base of logarithm for scores. */
+    int32 compress;    /**< Encoding of scores. */
+    int32 swap;        /**< Whether frames must be byte-swapped. */
+    int32 n_frame;     /**< Number of frames. */
+    uint32 *index;     /**< Offset of each frame in frames. */
+    uint8 const *frames; /**< Start of frame data. */
+    uint32 size;       /**< Size of frame data. */
+
+    mmio_file_t *filemap; /**< Memory map for file (or NULL if not mmap). */
+    void *data;        /**< In-memory copy of file (or NULL if mmap). */
+};
+
+/**
+ * Parse the name of a score encoding.
+ *
+ * @return one of senfile_compress_e, or <0 if unknown.
+ */
+int senfile_compress_type(char const *name);
+
+/**
+ * Write the header of an indexed senone score file.
+ *
+ * @param compress Encoding of scores.
+ * @param mdef_file Name of model definition, for information only.
+ * @return 0 for success, <0 on failure.
+ */
+int senfile_write_header(FILE *fh, int compress, int32 n_sen,
+                         char const *mdef_file, float64 logbase);
+
+/**
+ * Start writing the frames of an indexed senone score file.
+ *
+ * @param out Log file to write to, after the header, which remains
+ *            owned by the caller.
+ * @param compress Encoding of scores, as given to senfile_write_header().
+ * @return newly allocated writer.
+ */
+senfile_writer_t *senfile_writer_init(ps_logfile_t *out, int compress,
+                                      int32 n_sen);
+
+/**
+ * Write one frame of scores.
+ *
+ * @param n_active Number of active senones.
+ * @param active Deltas to active senones, as in acmod_t::senone_active
+ *               (ignored if all senones are active).
+ * @param senscr Scores for all senones.
+ * @return 0 for success, <0 on error.
+ */
+int senfile_write_frame(senfile_writer_t *w, int n_active,
+                        uint8 const *active, int16 const *senscr);
+
+/**
+ * Write the frame index and free a writer.
+ *
+ * The log file itself is not closed.
+ *
+ * @return 0 for success, <0 on error.
+ */
+int senfile_writer_close(senfile_writer_t *w);
+
+/**
+ * Read an indexed senone score file.
+ *
+ * @param config Configuration (used for -mmap), or NULL.
+ * @param file Name of the file, or NULL if it is not known, in which
+ *             case the file is not memory-mapped.
+ * @param fh File handle positioned at start of file.
+ * @param out_sf Output: newly allocated score file, or NULL if this
+ *               is an old-style senone dump, in which case fh is
+ *               positioned at start of file again.
+ * @return 0 for success, <0 on failure.
+ */
+int senfile_read(cmd_ln_t *config, char const *file, FILE *fh,
+                 senfile_t **out_sf);
+
+/**
+ * Get the number of frames in a score file.
+ */
+#define senfile_n_frame(sf) ((sf)->n_frame)
+
+/**
+ * Decode one frame of scores.
+ *
+ * @param senscr Output: scores for all senones, with inactive ones
+ *               set to SENSCR_DUMMY.
+ * @param active Output: deltas to active senones.
+ * @param out_n_active Output: number of active senones.
+ * @return 0 for success, <0 if frame is out of range or corrupt.
+ */
+int senfile_frame(senfile_t *sf, int32 frame, int16 *senscr,
+                  uint8 *active, int *out_n_active);
+
+/**
+ * Release a score file.
+ */
+void senfile_free(senfile_t *sf);
+
+#endif /* __SENFILE_H__ */
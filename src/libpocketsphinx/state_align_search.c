@@ -278,6 +278,7 @@ static ps_searchfuncs_t state_align_search_funcs = {
     /* hyp: */      NULL,
     /* prob: */     NULL,
     /* seg_iter: */ NULL,
+    /* sen_active: */ NULL,
 };
 
 ps_search_t *
@@ -0,0 +1,953 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file wfst_graph.c Precompiled static decoding graphs.
+ */
+
+/* System headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+/* Local headers. */
+#include "wfst_graph.h"
+#include "hmm.h"
+
+/**
+ * Arc of the grammar, waiting to be expanded into phones.
+ */
+typedef struct wfst_word_arc_s {
+    int32 from;          /**< Source grammar state. */
+    int32 to;            /**< Destination grammar state. */
+    int32 wid;           /**< Dictionary word ID, or BAD_S3WID for epsilon. */
+    int32 weight;        /**< Grammar weight. */
+} wfst_word_arc_t;
+
+/**
+ * Decoding graph under construction.
+ *
+ * The grammar is built first, as states and word arcs.  When it is
+ * expanded into phones, each grammar state becomes one context state
+ * for each pair of left context (last phone of the word before it)
+ * and right context (first phone of the word after it) which can
+ * occur there.
+ */
+typedef struct wfst_builder_s {
+    acmod_t *acmod;
+    dict_t *dict;
+    dict2pid_t *d2p;
+
+    int32 wip;           /**< Word insertion penalty. */
+    int32 pip;           /**< Phone insertion penalty. */
+    int32 silpen;        /**< Silence probability. */
+    int32 fillpen;       /**< Filler probability. */
+
+    int32 *final;        /**< Final weight of each state. */
+    int32 n_states;
+    int32 n_states_alloc;
+
+    int32 *arc_from;     /**< Source state of each arc. */
+    wfst_arc_t *arcs;    /**< Arcs, in order of creation. */
+    int32 n_arcs;
+    int32 n_arcs_alloc;
+
+    int32 *gfinal;       /**< Final weight of each grammar state. */
+    int32 n_gstates;
+    int32 n_gstates_alloc;
+
+    wfst_word_arc_t *word_arcs; /**< Grammar arcs not yet expanded. */
+    int32 n_word_arcs;
+    int32 n_word_arcs_alloc;
+
+    int32 **lctx;        /**< Index of each left context at each grammar state, or -1. */
+    int32 **rctx;        /**< Index of each right context at each grammar state, or -1. */
+    int32 *n_rctx;       /**< Number of right contexts at each grammar state. */
+    int32 *ctx_base;     /**< First context state of each grammar state. */
+
+    int32 *lc_entry;     /**< Entry state of a word for each left context. */
+    s3ssid_t *rc_ssid;   /**< Last phone of a word for each right context. */
+    s3ssid_t *hmm_ssid;  /**< Distinct senone sequences of a phone... */
+    int32 *hmm_state;    /**< ...and their entry or exit states. */
+
+    int32 *dict2word;    /**< Output word for each base dictionary word, or -1. */
+    int32 *word_wid;     /**< Base dictionary word for each output word. */
+    int32 n_words;
+} wfst_builder_t;
+
+static wfst_builder_t *
+wfst_builder_init(cmd_ln_t *config, acmod_t *acmod,
+                  dict_t *dict, dict2pid_t *d2p)
+{
+    wfst_builder_t *b;
+    int32 n_ci, i;
+
+    if (bin_mdef_n_emit_state(acmod->mdef) == 0
+        || acmod->tmat->n_state != bin_mdef_n_emit_state(acmod->mdef)) {
+        E_ERROR("Decoding graphs require a fixed HMM topology\n");
+        return NULL;
+    }
+
+    b = ckd_calloc(1, sizeof(*b));
+    b->acmod = acmod;
+    b->dict = dict;
+    b->d2p = d2p;
+    b->wip = logmath_log(acmod->lmath, cmd_ln_float32_r(config, "-wip"))
+        >> SENSCR_SHIFT;
+    b->pip = logmath_log(acmod->lmath, cmd_ln_float32_r(config, "-pip"))
+        >> SENSCR_SHIFT;
+    b->silpen = logmath_log(acmod->lmath, cmd_ln_float32_r(config, "-silprob"))
+        >> SENSCR_SHIFT;
+    b->fillpen = logmath_log(acmod->lmath, cmd_ln_float32_r(config, "-fillprob"))
+        >> SENSCR_SHIFT;
+    b->dict2word = ckd_calloc(dict_size(dict), sizeof(*b->dict2word));
+    b->word_wid = ckd_calloc(dict_size(dict), sizeof(*b->word_wid));
+    for (i = 0; i < dict_size(dict); ++i)
+        b->dict2word[i] = -1;
+    n_ci = bin_mdef_n_ciphone(acmod->mdef);
+    b->lc_entry = ckd_calloc(n_ci, sizeof(*b->lc_entry));
+    b->rc_ssid = ckd_calloc(n_ci, sizeof(*b->rc_ssid));
+    b->hmm_ssid = ckd_calloc(n_ci, sizeof(*b->hmm_ssid));
+    b->hmm_state = ckd_calloc(n_ci, sizeof(*b->hmm_state));
+
+    return b;
+}
+
+static void
+wfst_builder_free(wfst_builder_t *b)
+{
+    if (b == NULL)
+        return;
+    ckd_free(b->final);
+    ckd_free(b->arc_from);
+    ckd_free(b->arcs);
+    ckd_free(b->gfinal);
+    ckd_free(b->word_arcs);
+    if (b->lctx)
+        ckd_free_2d(b->lctx);
+    if (b->rctx)
+        ckd_free_2d(b->rctx);
+    ckd_free(b->n_rctx);
+    ckd_free(b->ctx_base);
+    ckd_free(b->lc_entry);
+    ckd_free(b->rc_ssid);
+    ckd_free(b->hmm_ssid);
+    ckd_free(b->hmm_state);
+    ckd_free(b->dict2word);
+    ckd_free(b->word_wid);
+    ckd_free(b);
+}
+
+static int32
+new_state(wfst_builder_t *b)
+{
+    if (b->n_states == b->n_states_alloc) {
+        b->n_states_alloc = b->n_states_alloc ? b->n_states_alloc * 2 : 256;
+        b->final = ckd_realloc(b->final,
+                               b->n_states_alloc * sizeof(*b->final));
+    }
+    b->final[b->n_states] = WORST_SCORE;
+    return b->n_states++;
+}
+
+static int32
+new_gstate(wfst_builder_t *b)
+{
+    if (b->n_gstates == b->n_gstates_alloc) {
+        b->n_gstates_alloc = b->n_gstates_alloc ? b->n_gstates_alloc * 2 : 256;
+        b->gfinal = ckd_realloc(b->gfinal,
+                                b->n_gstates_alloc * sizeof(*b->gfinal));
+    }
+    b->gfinal[b->n_gstates] = WORST_SCORE;
+    return b->n_gstates++;
+}
+
+static void
+add_arc(wfst_builder_t *b, int32 from, int32 to,
+        int32 ilabel, int32 olabel, int32 weight)
+{
+    wfst_arc_t *arc;
+
+    if (b->n_arcs == b->n_arcs_alloc) {
+        b->n_arcs_alloc = b->n_arcs_alloc ? b->n_arcs_alloc * 2 : 1024;
+        b->arcs = ckd_realloc(b->arcs, b->n_arcs_alloc * sizeof(*b->arcs));
+        b->arc_from = ckd_realloc(b->arc_from,
+                                  b->n_arcs_alloc * sizeof(*b->arc_from));
+    }
+    b->arc_from[b->n_arcs] = from;
+    arc = &b->arcs[b->n_arcs++];
+    arc->ilabel = ilabel;
+    arc->olabel = olabel;
+    arc->weight = weight;
+    arc->next = to;
+}
+
+static void
+add_word_arc(wfst_builder_t *b, int32 from, int32 to,
+             int32 wid, int32 weight)
+{
+    wfst_word_arc_t *warc;
+
+    if (b->n_word_arcs == b->n_word_arcs_alloc) {
+        b->n_word_arcs_alloc = b->n_word_arcs_alloc
+            ? b->n_word_arcs_alloc * 2 : 256;
+        b->word_arcs = ckd_realloc(b->word_arcs, b->n_word_arcs_alloc
+                                   * sizeof(*b->word_arcs));
+    }
+    warc = &b->word_arcs[b->n_word_arcs++];
+    warc->from = from;
+    warc->to = to;
+    warc->wid = wid;
+    warc->weight = weight;
+}
+
+/*
+ * Add a word and all its alternate pronunciations.
+ */
+static void
+add_word_alts(wfst_builder_t *b, int32 from, int32 to,
+              int32 wid, int32 weight)
+{
+    for (wid = dict_basewid(b->dict, wid); wid != BAD_S3WID;
+         wid = dict_nextalt(b->dict, wid))
+        add_word_arc(b, from, to, wid, weight);
+}
+
+/*
+ * Add self-loops for silence and filler words (other than <s> and
+ * </s>) to a grammar state.
+ */
+static void
+add_fillers(wfst_builder_t *b, int32 state)
+{
+    int32 wid;
+
+    for (wid = dict_filler_start(b->dict); wid <= dict_filler_end(b->dict); ++wid) {
+        if (wid == dict_startwid(b->dict) || wid == dict_finishwid(b->dict))
+            continue;
+        if (dict_pronlen(b->dict, wid) == 0)
+            continue;
+        add_word_arc(b, state, state, wid,
+                     wid == dict_silwid(b->dict) ? b->silpen : b->fillpen);
+    }
+}
+
+/*
+ * Phones a word presents as context to the words before and after
+ * it.  Fillers look like silence to their neighbours.
+ */
+static int32
+first_context(wfst_builder_t *b, int32 wid)
+{
+    if (dict_filler_word(b->dict, wid))
+        return bin_mdef_silphone(b->acmod->mdef);
+    return dict_first_phone(b->dict, wid);
+}
+
+static int32
+last_context(wfst_builder_t *b, int32 wid)
+{
+    if (dict_filler_word(b->dict, wid))
+        return bin_mdef_silphone(b->acmod->mdef);
+    return dict_last_phone(b->dict, wid);
+}
+
+/*
+ * Context state for grammar state s with left context lc and right
+ * context rc.
+ */
+static int32
+ctx_state(wfst_builder_t *b, int32 s, int32 lc, int32 rc)
+{
+    return b->ctx_base[s] + b->lctx[s][lc] * b->n_rctx[s] + b->rctx[s][rc];
+}
+
+/*
+ * Find the left and right contexts which can occur at each grammar
+ * state, and create a context state for each pair of them.
+ */
+static void
+build_contexts(wfst_builder_t *b, int32 start)
+{
+    int32 n_ci = bin_mdef_n_ciphone(b->acmod->mdef);
+    int32 sil = bin_mdef_silphone(b->acmod->mdef);
+    int32 i, s, lc, rc, n_lctx, changed;
+
+    b->lctx = ckd_calloc_2d(b->n_gstates, n_ci, sizeof(**b->lctx));
+    b->rctx = ckd_calloc_2d(b->n_gstates, n_ci, sizeof(**b->rctx));
+    b->n_rctx = ckd_calloc(b->n_gstates, sizeof(*b->n_rctx));
+    b->ctx_base = ckd_calloc(b->n_gstates, sizeof(*b->ctx_base));
+
+    /* The utterance begins and ends with silence. */
+    b->lctx[start][sil] = TRUE;
+    for (s = 0; s < b->n_gstates; ++s)
+        if (b->gfinal[s] != WORST_SCORE)
+            b->rctx[s][sil] = TRUE;
+    for (i = 0; i < b->n_word_arcs; ++i) {
+        wfst_word_arc_t *warc = &b->word_arcs[i];
+        if (warc->wid == BAD_S3WID)
+            continue;
+        b->lctx[warc->to][last_context(b, warc->wid)] = TRUE;
+        b->rctx[warc->from][first_context(b, warc->wid)] = TRUE;
+    }
+    /* Contexts are carried across epsilon arcs. */
+    do {
+        changed = FALSE;
+        for (i = 0; i < b->n_word_arcs; ++i) {
+            wfst_word_arc_t *warc = &b->word_arcs[i];
+            if (warc->wid != BAD_S3WID)
+                continue;
+            for (lc = 0; lc < n_ci; ++lc) {
+                if (b->lctx[warc->from][lc] && !b->lctx[warc->to][lc]) {
+                    b->lctx[warc->to][lc] = TRUE;
+                    changed = TRUE;
+                }
+            }
+            for (rc = 0; rc < n_ci; ++rc) {
+                if (b->rctx[warc->to][rc] && !b->rctx[warc->from][rc]) {
+                    b->rctx[warc->from][rc] = TRUE;
+                    changed = TRUE;
+                }
+            }
+        }
+    } while (changed);
+
+    for (s = 0; s < b->n_gstates; ++s) {
+        n_lctx = 0;
+        for (lc = 0; lc < n_ci; ++lc)
+            b->lctx[s][lc] = b->lctx[s][lc] ? n_lctx++ : -1;
+        for (rc = 0; rc < n_ci; ++rc)
+            b->rctx[s][rc] = b->rctx[s][rc] ? b->n_rctx[s]++ : -1;
+        b->ctx_base[s] = b->n_states;
+        for (i = 0; i < n_lctx * b->n_rctx[s]; ++i)
+            new_state(b);
+        if (b->gfinal[s] == WORST_SCORE)
+            continue;
+        for (lc = 0; lc < n_ci; ++lc)
+            if (b->lctx[s][lc] != -1)
+                b->final[ctx_state(b, s, lc, sil)] = b->gfinal[s];
+    }
+}
+
+/*
+ * Add the states and arcs of one HMM from entry to exit, or to a new
+ * state if exit is -1, returning the exit state.
+ */
+static int32
+add_phone(wfst_builder_t *b, int32 entry, int32 exit,
+          int32 ssid, int32 tmatid)
+{
+    bin_mdef_t *mdef = b->acmod->mdef;
+    uint8 **tp = b->acmod->tmat->tp[tmatid];
+    int32 n_emit = bin_mdef_n_emit_state(mdef);
+    int32 first, i, j;
+
+    first = b->n_states;
+    for (i = 0; i < n_emit; ++i)
+        new_state(b);
+    if (exit == -1)
+        exit = new_state(b);
+
+    add_arc(b, entry, first, bin_mdef_sseq2sen(mdef, ssid, 0) + 1, 0, b->pip);
+    for (i = 0; i < n_emit; ++i) {
+        for (j = i; j <= n_emit; ++j) {
+            if (-tp[i][j] <= TMAT_WORST_SCORE)
+                continue;
+            if (j < n_emit)
+                add_arc(b, first + i, first + j,
+                        bin_mdef_sseq2sen(mdef, ssid, j) + 1, 0, -tp[i][j]);
+            else
+                add_arc(b, first + i, exit, 0, 0, -tp[i][j]);
+        }
+    }
+    return exit;
+}
+
+static int32
+output_word(wfst_builder_t *b, int32 wid)
+{
+    wid = dict_basewid(b->dict, wid);
+    if (b->dict2word[wid] == -1) {
+        b->word_wid[b->n_words] = wid;
+        b->dict2word[wid] = b->n_words++;
+    }
+    return b->dict2word[wid];
+}
+
+/*
+ * Add the last phone of a word from state entry, with one HMM for
+ * each distinct senone sequence in rc_ssid over the right contexts of
+ * grammar state to, each of them leading to the context states of to
+ * where that right context follows the word.
+ */
+static void
+add_last_phone(wfst_builder_t *b, int32 entry, int32 tmatid,
+               int32 wid, int32 to)
+{
+    int32 n_ci = bin_mdef_n_ciphone(b->acmod->mdef);
+    int32 lc = last_context(b, wid);
+    int32 olabel = output_word(b, wid) + 1;
+    int32 rc, i, n_hmm;
+
+    n_hmm = 0;
+    for (rc = 0; rc < n_ci; ++rc) {
+        if (b->rctx[to][rc] == -1)
+            continue;
+        for (i = 0; i < n_hmm; ++i)
+            if (b->hmm_ssid[i] == b->rc_ssid[rc])
+                break;
+        if (i == n_hmm) {
+            b->hmm_ssid[i] = b->rc_ssid[rc];
+            b->hmm_state[i] = add_phone(b, entry, -1, b->rc_ssid[rc], tmatid);
+            ++n_hmm;
+        }
+        add_arc(b, b->hmm_state[i], ctx_state(b, to, lc, rc), 0, olabel, 0);
+    }
+}
+
+/*
+ * Expand the arcs for one word going to the same grammar state into
+ * phones.  The first phone is expanded for the left contexts at the
+ * source states and the last one for the right contexts at the
+ * destination.  Fillers are context independent.
+ */
+static void
+expand_word(wfst_builder_t *b, wfst_word_arc_t const *warcs, int32 n_warcs)
+{
+    bin_mdef_t *mdef = b->acmod->mdef;
+    dict_t *dict = b->dict;
+    dict2pid_t *d2p = b->d2p;
+    int32 n_ci = bin_mdef_n_ciphone(mdef);
+    int32 wid = warcs[0].wid, to = warcs[0].to;
+    int32 n = dict_pronlen(dict, wid);
+    int32 first = dict_first_phone(dict, wid);
+    int32 last = dict_last_phone(dict, wid);
+    int32 rc_in = first_context(b, wid);
+    int32 i, lc, rc, pos, state, n_hmm;
+    xwdssid_t *rssid;
+
+    /* Left contexts at any of the source states. */
+    for (lc = 0; lc < n_ci; ++lc) {
+        b->lc_entry[lc] = -1;
+        for (i = 0; i < n_warcs; ++i)
+            if (b->lctx[warcs[i].from][lc] != -1)
+                break;
+        if (i < n_warcs)
+            b->lc_entry[lc] = 0;
+    }
+
+    if (dict_filler_word(dict, wid)) {
+        state = new_state(b);
+        for (lc = 0; lc < n_ci; ++lc)
+            if (b->lc_entry[lc] != -1)
+                b->lc_entry[lc] = state;
+        for (pos = 0; pos < n - 1; ++pos)
+            state = add_phone(b, state, -1,
+                              bin_mdef_pid2ssid(mdef, dict_pron(dict, wid, pos)),
+                              bin_mdef_pid2tmatid(mdef, dict_pron(dict, wid, pos)));
+        for (rc = 0; rc < n_ci; ++rc)
+            b->rc_ssid[rc] = bin_mdef_pid2ssid(mdef, last);
+        add_last_phone(b, state, bin_mdef_pid2tmatid(mdef, last), wid, to);
+    }
+    else if (n == 1) {
+        /* Both contexts apply to the same phone. */
+        for (lc = 0; lc < n_ci; ++lc) {
+            if (b->lc_entry[lc] == -1)
+                continue;
+            b->lc_entry[lc] = new_state(b);
+            for (rc = 0; rc < n_ci; ++rc)
+                if (b->rctx[to][rc] != -1)
+                    b->rc_ssid[rc] = dict2pid_lrdiph_rc(d2p, first, lc, rc);
+            add_last_phone(b, b->lc_entry[lc],
+                           bin_mdef_pid2tmatid(mdef, first), wid, to);
+        }
+    }
+    else {
+        /* One first phone for each distinct senone sequence. */
+        state = new_state(b);
+        n_hmm = 0;
+        for (lc = 0; lc < n_ci; ++lc) {
+            s3ssid_t ssid;
+
+            if (b->lc_entry[lc] == -1)
+                continue;
+            ssid = dict2pid_ldiph_lc(d2p, first,
+                                     dict_second_phone(dict, wid), lc);
+            for (i = 0; i < n_hmm; ++i)
+                if (b->hmm_ssid[i] == ssid)
+                    break;
+            if (i == n_hmm) {
+                b->hmm_ssid[i] = ssid;
+                b->hmm_state[i] = new_state(b);
+                add_phone(b, b->hmm_state[i], state, ssid,
+                          bin_mdef_pid2tmatid(mdef, first));
+                ++n_hmm;
+            }
+            b->lc_entry[lc] = b->hmm_state[i];
+        }
+        for (pos = 1; pos < n - 1; ++pos)
+            state = add_phone(b, state, -1, dict2pid_internal(d2p, wid, pos),
+                              bin_mdef_pid2tmatid(mdef,
+                                                  dict_pron(dict, wid, pos)));
+        rssid = dict2pid_rssid(d2p, last, dict_second_last_phone(dict, wid));
+        for (rc = 0; rc < n_ci; ++rc)
+            if (b->rctx[to][rc] != -1)
+                b->rc_ssid[rc] = rssid->ssid[rssid->cimap[rc]];
+        add_last_phone(b, state, bin_mdef_pid2tmatid(mdef, last), wid, to);
+    }
+
+    /* Enter it from the context states expecting its first phone. */
+    for (i = 0; i < n_warcs; ++i) {
+        for (lc = 0; lc < n_ci; ++lc) {
+            if (b->lctx[warcs[i].from][lc] == -1)
+                continue;
+            add_arc(b, ctx_state(b, warcs[i].from, lc, rc_in),
+                    b->lc_entry[lc], 0, 0, warcs[i].weight);
+        }
+    }
+}
+
+static int
+word_arc_cmp(void const *a, void const *b)
+{
+    wfst_word_arc_t const *wa = a, *wb = b;
+
+    if (wa->wid != wb->wid)
+        return wa->wid < wb->wid ? -1 : 1;
+    if (wa->to != wb->to)
+        return wa->to < wb->to ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Expand the grammar into context states and phones, returning the
+ * start state.  Arcs for the same word going to the same grammar
+ * state share their phones.
+ */
+static int32
+expand_word_arcs(wfst_builder_t *b, int32 gstart)
+{
+    int32 n_ci = bin_mdef_n_ciphone(b->acmod->mdef);
+    int32 sil = bin_mdef_silphone(b->acmod->mdef);
+    int32 i, j, lc, rc, start;
+
+    build_contexts(b, gstart);
+    start = new_state(b);
+    for (rc = 0; rc < n_ci; ++rc)
+        if (b->rctx[gstart][rc] != -1)
+            add_arc(b, start, ctx_state(b, gstart, sil, rc), 0, 0, 0);
+
+    qsort(b->word_arcs, b->n_word_arcs, sizeof(*b->word_arcs), word_arc_cmp);
+    for (i = 0; i < b->n_word_arcs; i = j) {
+        for (j = i; j < b->n_word_arcs
+                 && b->word_arcs[j].wid == b->word_arcs[i].wid
+                 && b->word_arcs[j].to == b->word_arcs[i].to; ++j)
+            ;
+        if (b->word_arcs[i].wid != BAD_S3WID) {
+            expand_word(b, b->word_arcs + i, j - i);
+            continue;
+        }
+        /* Epsilon arcs keep both contexts. */
+        for (; i < j; ++i) {
+            wfst_word_arc_t *warc = &b->word_arcs[i];
+            for (lc = 0; lc < n_ci; ++lc) {
+                if (b->lctx[warc->from][lc] == -1)
+                    continue;
+                for (rc = 0; rc < n_ci; ++rc) {
+                    if (b->rctx[warc->to][rc] == -1)
+                        continue;
+                    add_arc(b, ctx_state(b, warc->from, lc, rc),
+                            ctx_state(b, warc->to, lc, rc),
+                            0, 0, warc->weight);
+                }
+            }
+        }
+    }
+    b->n_word_arcs = 0;
+    return start;
+}
+
+static int
+wfst_builder_write(wfst_builder_t *b, int32 gstart, char const *file)
+{
+    wfst_hdr_t hdr;
+    int32 *arc_idx;
+    wfst_arc_t *arcs;
+    wfst_word_t *words;
+    char *strings;
+    FILE *fh;
+    int32 i, start, strsize;
+    int rv = -1;
+
+    start = expand_word_arcs(b, gstart);
+
+    /* Sort arcs by source state, keeping their order otherwise. */
+    arc_idx = ckd_calloc(b->n_states + 1, sizeof(*arc_idx));
+    for (i = 0; i < b->n_arcs; ++i)
+        ++arc_idx[b->arc_from[i] + 1];
+    for (i = 0; i < b->n_states; ++i)
+        arc_idx[i + 1] += arc_idx[i];
+    arcs = ckd_calloc(b->n_arcs, sizeof(*arcs));
+    for (i = 0; i < b->n_arcs; ++i)
+        arcs[arc_idx[b->arc_from[i]]++] = b->arcs[i];
+    for (i = b->n_states; i > 0; --i)
+        arc_idx[i] = arc_idx[i - 1];
+    arc_idx[0] = 0;
+
+    strsize = 0;
+    words = ckd_calloc(b->n_words, sizeof(*words));
+    for (i = 0; i < b->n_words; ++i) {
+        words[i].str = strsize;
+        words[i].filler = dict_filler_word(b->dict, b->word_wid[i]);
+        strsize += strlen(dict_basestr(b->dict, b->word_wid[i])) + 1;
+    }
+    strsize = (strsize + 3) & ~3;
+    strings = ckd_calloc(strsize ? strsize : 1, 1);
+    for (i = 0; i < b->n_words; ++i)
+        strcpy(strings + words[i].str, dict_basestr(b->dict, b->word_wid[i]));
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = WFST_MAGIC;
+    hdr.version = WFST_VERSION;
+    hdr.logbase = logmath_get_base(b->acmod->lmath);
+    hdr.n_sen = bin_mdef_n_sen(b->acmod->mdef);
+    hdr.n_sseq = bin_mdef_n_sseq(b->acmod->mdef);
+    hdr.n_tmat = b->acmod->tmat->n_tmat;
+    hdr.n_emit_state = bin_mdef_n_emit_state(b->acmod->mdef);
+    hdr.n_states = b->n_states;
+    hdr.n_arcs = b->n_arcs;
+    hdr.n_words = b->n_words;
+    hdr.start = start;
+    hdr.strsize = strsize;
+
+    if ((fh = fopen(file, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s for writing", file);
+        goto error_out;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, fh) != 1
+        || fwrite(arc_idx, sizeof(*arc_idx), b->n_states + 1, fh)
+        != (size_t)b->n_states + 1
+        || fwrite(b->final, sizeof(*b->final), b->n_states, fh)
+        != (size_t)b->n_states
+        || fwrite(arcs, sizeof(*arcs), b->n_arcs, fh) != (size_t)b->n_arcs
+        || fwrite(words, sizeof(*words), b->n_words, fh) != (size_t)b->n_words
+        || fwrite(strings, 1, strsize, fh) != (size_t)strsize) {
+        E_ERROR_SYSTEM("Failed to write decoding graph %s", file);
+        fclose(fh);
+        goto error_out;
+    }
+    if (fclose(fh) < 0) {
+        E_ERROR_SYSTEM("Failed to write decoding graph %s", file);
+        goto error_out;
+    }
+    E_INFO("Wrote decoding graph %s: %d states, %d arcs, %d words\n",
+           file, b->n_states, b->n_arcs, b->n_words);
+    rv = 0;
+
+error_out:
+    ckd_free(arc_idx);
+    ckd_free(arcs);
+    ckd_free(words);
+    ckd_free(strings);
+    return rv;
+}
+
+int
+wfst_graph_build_fsg(cmd_ln_t *config, acmod_t *acmod, dict_t *dict,
+                     dict2pid_t *d2p, fsg_model_t *fsg, char const *file)
+{
+    wfst_builder_t *b;
+    fsg_arciter_t *itor;
+    int32 i, rv = -1;
+
+    if ((b = wfst_builder_init(config, acmod, dict, d2p)) == NULL)
+        return -1;
+
+    /* The grammar states have the same numbers as in the FSG. */
+    for (i = 0; i < fsg_model_n_state(fsg); ++i) {
+        new_gstate(b);
+        add_fillers(b, i);
+    }
+    b->gfinal[fsg_model_final_state(fsg)] = 0;
+
+    for (i = 0; i < fsg_model_n_state(fsg); ++i) {
+        for (itor = fsg_model_arcs(fsg, i); itor;
+             itor = fsg_arciter_next(itor)) {
+            fsg_link_t *link = fsg_arciter_get(itor);
+            int32 weight = fsg_link_logs2prob(link) >> SENSCR_SHIFT;
+            int32 fwid = fsg_link_wid(link);
+            int32 wid;
+
+            if (fwid < 0) {
+                add_word_arc(b, fsg_link_from_state(link),
+                             fsg_link_to_state(link), BAD_S3WID, weight);
+                continue;
+            }
+            /* Fillers are added above and alternates below. */
+            if (fsg_model_is_filler(fsg, fwid) || fsg_model_is_alt(fsg, fwid))
+                continue;
+            wid = dict_wordid(dict, fsg_model_word_str(fsg, fwid));
+            if (wid == BAD_S3WID) {
+                E_ERROR("Word '%s' in FSG is not in the dictionary\n",
+                        fsg_model_word_str(fsg, fwid));
+                fsg_arciter_free(itor);
+                goto error_out;
+            }
+            add_word_alts(b, fsg_link_from_state(link), fsg_link_to_state(link),
+                          wid, weight + b->wip);
+        }
+    }
+
+    rv = wfst_builder_write(b, fsg_model_start_state(fsg), file);
+
+error_out:
+    wfst_builder_free(b);
+    return rv;
+}
+
+int
+wfst_graph_build_lm(cmd_ln_t *config, acmod_t *acmod, dict_t *dict,
+                    dict2pid_t *d2p, ngram_model_t *lm, char const *file)
+{
+    wfst_builder_t *b;
+    ngram_iter_t *itor, *bitor;
+    int32 *lm2dict, *hist;
+    int32 n_lmwords, startwid, finishwid, backoff, final;
+    int32 i, rv = -1;
+
+    if (ngram_wid(lm, S3_FINISH_WORD) == ngram_unknown_wid(lm)) {
+        E_ERROR("Language model does not contain </s>\n");
+        return -1;
+    }
+    if ((b = wfst_builder_init(config, acmod, dict, d2p)) == NULL)
+        return -1;
+
+    /* One grammar state for each history, starting with <s>. */
+    startwid = dict_startwid(dict);
+    finishwid = dict_finishwid(dict);
+    n_lmwords = ngram_model_get_counts(lm)[0];
+    lm2dict = ckd_calloc(n_lmwords, sizeof(*lm2dict));
+    hist = ckd_calloc(dict_size(dict), sizeof(*hist));
+    hist[startwid] = new_gstate(b);
+    for (i = 0; i < n_lmwords; ++i) {
+        int32 wid = dict_wordid(dict, ngram_word(lm, i));
+
+        if (wid != BAD_S3WID && wid != startwid && wid != finishwid) {
+            if (!dict_real_word(dict, wid))
+                wid = BAD_S3WID;
+            else
+                hist[wid] = new_gstate(b);
+        }
+        lm2dict[i] = wid;
+    }
+    backoff = new_gstate(b);
+    final = new_gstate(b);
+    b->gfinal[final] = 0;
+    if (ngram_wid(lm, S3_START_WORD) == ngram_unknown_wid(lm)) {
+        add_word_arc(b, hist[startwid], backoff, BAD_S3WID, 0);
+        add_fillers(b, hist[startwid]);
+    }
+
+    /* Unigrams leave the backoff state, and each one has its bigrams
+     * and backoff weight as a history. */
+    if ((itor = ngram_model_mgrams(lm, 0)) == NULL) {
+        E_ERROR("Failed to iterate over the unigrams of the language model\n");
+        goto error_out;
+    }
+    for (; itor; itor = ngram_iter_next(itor)) {
+        int32 const *wids;
+        int32 u, score, bowt;
+
+        wids = ngram_iter_get(itor, &score, &bowt);
+        if ((u = lm2dict[wids[0]]) == BAD_S3WID)
+            continue;
+        score >>= SENSCR_SHIFT;
+        if (u == finishwid) {
+            add_word_arc(b, backoff, final, BAD_S3WID, score);
+            continue;
+        }
+        if (u != startwid)
+            add_word_alts(b, backoff, hist[u], u, score);
+
+        for (bitor = ngram_iter_successors(itor); bitor;
+             bitor = ngram_iter_next(bitor)) {
+            int32 w, bg_bowt;
+
+            wids = ngram_iter_get(bitor, &score, &bg_bowt);
+            if ((w = lm2dict[wids[1]]) == BAD_S3WID || w == startwid)
+                continue;
+            score >>= SENSCR_SHIFT;
+            if (w == finishwid)
+                add_word_arc(b, hist[u], final, BAD_S3WID, score);
+            else
+                add_word_alts(b, hist[u], hist[w], w, score);
+        }
+        add_word_arc(b, hist[u], backoff, BAD_S3WID, bowt >> SENSCR_SHIFT);
+        add_fillers(b, hist[u]);
+    }
+    E_INFO("Building decoding graph for %d histories\n", b->n_gstates - 2);
+
+    rv = wfst_builder_write(b, hist[startwid], file);
+
+error_out:
+    wfst_builder_free(b);
+    ckd_free(lm2dict);
+    ckd_free(hist);
+    return rv;
+}
+
+static int
+check_graph(wfst_graph_t *g)
+{
+    wfst_hdr_t const *hdr = g->hdr;
+    int32 i;
+
+    if (hdr->start < 0 || hdr->start >= hdr->n_states
+        || g->arc_idx[0] != 0 || g->arc_idx[hdr->n_states] != hdr->n_arcs)
+        return -1;
+    for (i = 0; i < hdr->n_states; ++i)
+        if (g->arc_idx[i + 1] < g->arc_idx[i])
+            return -1;
+    for (i = 0; i < hdr->n_arcs; ++i) {
+        wfst_arc_t const *arc = &g->arcs[i];
+        if (arc->ilabel < 0 || arc->ilabel > hdr->n_sen
+            || arc->olabel < 0 || arc->olabel > hdr->n_words
+            || arc->next < 0 || arc->next >= hdr->n_states)
+            return -1;
+    }
+    if (hdr->n_words > 0 && g->strings[hdr->strsize - 1] != '\0')
+        return -1;
+    for (i = 0; i < hdr->n_words; ++i)
+        if (g->words[i].str < 0 || g->words[i].str >= hdr->strsize)
+            return -1;
+    return 0;
+}
+
+wfst_graph_t *
+wfst_graph_read(cmd_ln_t *config, char const *file, acmod_t *acmod)
+{
+    wfst_graph_t *g;
+    wfst_hdr_t const *hdr;
+    char const *ptr;
+    size_t size;
+    FILE *fh;
+
+    if ((fh = fopen(file, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open decoding graph %s", file);
+        return NULL;
+    }
+    fseek(fh, 0, SEEK_END);
+    size = ftell(fh);
+    if (size < sizeof(*hdr)) {
+        E_ERROR("Decoding graph %s is truncated\n", file);
+        fclose(fh);
+        return NULL;
+    }
+
+    g = ckd_calloc(1, sizeof(*g));
+    if (cmd_ln_boolean_r(config, "-mmap"))
+        g->filemap = mmio_file_read(file);
+    if (g->filemap) {
+        fclose(fh);
+        ptr = mmio_file_ptr(g->filemap);
+    }
+    else {
+        fseek(fh, 0, SEEK_SET);
+        g->data = ckd_malloc(size);
+        if (fread(g->data, 1, size, fh) != size) {
+            E_ERROR_SYSTEM("Failed to read decoding graph %s", file);
+            fclose(fh);
+            goto error_out;
+        }
+        fclose(fh);
+        ptr = g->data;
+    }
+
+    g->hdr = hdr = (wfst_hdr_t const *)ptr;
+    if (hdr->magic != WFST_MAGIC || hdr->version != WFST_VERSION) {
+        E_ERROR("%s is not a decoding graph for this machine\n", file);
+        goto error_out;
+    }
+    if (hdr->logbase != logmath_get_base(acmod->lmath)
+        || hdr->n_sen != bin_mdef_n_sen(acmod->mdef)
+        || hdr->n_sseq != bin_mdef_n_sseq(acmod->mdef)
+        || hdr->n_tmat != acmod->tmat->n_tmat
+        || hdr->n_emit_state != bin_mdef_n_emit_state(acmod->mdef)) {
+        E_ERROR("Decoding graph %s was built for a different acoustic model\n",
+                file);
+        goto error_out;
+    }
+    if (hdr->n_states <= 0 || hdr->n_arcs < 0 || hdr->n_words < 0
+        || hdr->strsize < 0 || (hdr->strsize & 3)
+        || size != sizeof(*hdr)
+        + sizeof(int32) * ((size_t)hdr->n_states * 2 + 1)
+        + sizeof(wfst_arc_t) * (size_t)hdr->n_arcs
+        + sizeof(wfst_word_t) * (size_t)hdr->n_words
+        + hdr->strsize) {
+        E_ERROR("Decoding graph %s is corrupt\n", file);
+        goto error_out;
+    }
+    g->arc_idx = (int32 const *)(ptr + sizeof(*hdr));
+    g->final = g->arc_idx + hdr->n_states + 1;
+    g->arcs = (wfst_arc_t const *)(g->final + hdr->n_states);
+    g->words = (wfst_word_t const *)(g->arcs + hdr->n_arcs);
+    g->strings = (char const *)(g->words + hdr->n_words);
+    if (check_graph(g) < 0) {
+        E_ERROR("Decoding graph %s is corrupt\n", file);
+        goto error_out;
+    }
+
+    E_INFO("Read decoding graph %s: %d states, %d arcs, %d words\n",
+           file, hdr->n_states, hdr->n_arcs, hdr->n_words);
+    return g;
+
+error_out:
+    wfst_graph_free(g);
+    return NULL;
+}
+
+void
+wfst_graph_free(wfst_graph_t *g)
+{
+    if (g == NULL)
+        return;
+    if (g->filemap)
+        mmio_file_unmap(g->filemap);
+    ckd_free(g->data);
+    ckd_free(g);
+}
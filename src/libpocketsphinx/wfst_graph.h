@@ -0,0 +1,195 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file wfst_graph.h Precompiled static decoding graphs.
+ *
+ * A decoding graph is a weighted finite-state transducer from senones
+ * to words, with the grammar or language model, the pronunciations
+ * and the HMM topology all compiled into it, much like the HCLG
+ * graphs of other decoders (though it is neither determinized nor
+ * minimized).  Each arc either consumes one frame, in which case its
+ * input label is the senone scoring that frame, or is an epsilon arc.
+ * An arc may also output a word, which happens when leaving the last
+ * HMM state of the word.  All weights are in the same (negative,
+ * shifted) log scale as acoustic scores, so the search only has to
+ * add them up.
+ *
+ * Triphones are expanded across word boundaries: each state of the
+ * grammar is split by the last phone of the word before it and the
+ * first phone of the word after it.  The first phone of each word is
+ * chosen by the former, and its last phone fans out over the latter.
+ * Filler words are context independent and act as silence to their
+ * neighbours, as do the start and end of the utterance.
+ *
+ * Graphs are built offline from a dictionary and either an FSG or an
+ * N-Gram model, and written to a file which is then memory-mapped by
+ * the search.  The file is a sequence of arrays in the byte order of
+ * the machine that wrote it:
+ *
+ * (sizeof(wfst_hdr_t) bytes) header, as in wfst_hdr_t
+ * (n_states + 1 words) index of the first arc leaving each state
+ * (n_states words) final weight of each state, or WORST_SCORE
+ * (n_arcs * 4 words) arcs sorted by source state, as in wfst_arc_t
+ * (n_words * 2 words) output words, as in wfst_word_t
+ * (strsize bytes) word strings, NUL-terminated
+ */
+
+#ifndef __WFST_GRAPH_H__
+#define __WFST_GRAPH_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/fsg_model.h>
+#include <sphinxbase/ngram_model.h>
+
+/* Local headers. */
+#include "acmod.h"
+#include "dict.h"
+#include "dict2pid.h"
+
+#define WFST_MAGIC 0x54534657 /* 'WFST' in little-endian order */
+#define WFST_VERSION 1
+
+/**
+ * Header of a decoding graph.
+ *
+ * The acoustic model parameters are there to make sure the graph is
+ * used with the model it was built for.
+ */
+typedef struct wfst_hdr_s {
+    uint32 magic;        /**< WFST_MAGIC. */
+    int32 version;       /**< WFST_VERSION. */
+    float64 logbase;     /**< Base of logarithm for weights. */
+    int32 n_sen;         /**< Number of senones in acoustic model. */
+    int32 n_sseq;        /**< Number of senone sequences in acoustic model. */
+    int32 n_tmat;        /**< Number of transition matrices. */
+    int32 n_emit_state;  /**< Number of emitting states per HMM. */
+    int32 n_states;      /**< Number of states. */
+    int32 n_arcs;        /**< Number of arcs. */
+    int32 n_words;       /**< Number of output words. */
+    int32 start;         /**< Start state. */
+    int32 strsize;       /**< Size of word strings (multiple of 4). */
+} wfst_hdr_t;
+
+/**
+ * Arc in a decoding graph.
+ */
+typedef struct wfst_arc_s {
+    int32 ilabel;        /**< Senone ID plus one, or 0 for epsilon. */
+    int32 olabel;        /**< Word index plus one, or 0 for none. */
+    int32 weight;        /**< Log weight. */
+    int32 next;          /**< Destination state. */
+} wfst_arc_t;
+
+/**
+ * Output word in a decoding graph.
+ */
+typedef struct wfst_word_s {
+    int32 str;           /**< Offset of word string. */
+    int32 filler;        /**< Is this a filler word? */
+} wfst_word_t;
+
+/**
+ * Decoding graph opened for searching.
+ */
+typedef struct wfst_graph_s {
+    wfst_hdr_t const *hdr;     /**< Header. */
+    int32 const *arc_idx;      /**< First arc of each state. */
+    int32 const *final;        /**< Final weight of each state. */
+    wfst_arc_t const *arcs;    /**< Arcs. */
+    wfst_word_t const *words;  /**< Output words. */
+    char const *strings;       /**< Word strings. */
+
+    mmio_file_t *filemap;      /**< Memory map for file (or NULL if not mmap). */
+    void *data;                /**< In-memory copy of file (or NULL if mmap). */
+} wfst_graph_t;
+
+#define wfst_graph_n_states(g) ((g)->hdr->n_states)
+#define wfst_graph_n_arcs(g) ((g)->hdr->n_arcs)
+#define wfst_graph_n_words(g) ((g)->hdr->n_words)
+#define wfst_graph_start(g) ((g)->hdr->start)
+#define wfst_graph_final(g,s) ((g)->final[s])
+#define wfst_graph_word_str(g,w) ((g)->strings + (g)->words[w].str)
+#define wfst_graph_is_filler(g,w) ((g)->words[w].filler)
+
+/**
+ * Read a decoding graph.
+ *
+ * @param config Configuration (used for -mmap).
+ * @param acmod Acoustic model the graph must have been built for.
+ * @return newly allocated graph, or NULL on failure.
+ */
+wfst_graph_t *wfst_graph_read(cmd_ln_t *config, char const *file,
+                              acmod_t *acmod);
+
+/**
+ * Release a decoding graph.
+ */
+void wfst_graph_free(wfst_graph_t *g);
+
+/**
+ * Build a decoding graph from a finite-state grammar and write it out.
+ *
+ * Filler words (and silence) may follow any word, with the
+ * probabilities given by -silprob and -fillprob.  Weights of FSG
+ * transitions already include the language weight; -wip and -pip
+ * are applied here.
+ *
+ * @return 0 for success, <0 on failure.
+ */
+int wfst_graph_build_fsg(cmd_ln_t *config, acmod_t *acmod, dict_t *dict,
+                         dict2pid_t *d2p, fsg_model_t *fsg,
+                         char const *file);
+
+/**
+ * Build a decoding graph from an N-Gram model and write it out.
+ *
+ * Only the bigrams of the model are used, with the usual backoff
+ * structure: one state per word, plus one for the unigram
+ * distribution.  The unigrams, with their backoff weights, and the
+ * bigrams following each of them are listed with the iterators of the
+ * model, so it must support them.  Words not in the dictionary are
+ * skipped.  Scores are used as they are, with the language weight and
+ * word insertion penalty the model was read or last weighted with.
+ *
+ * @return 0 for success, <0 on failure.
+ */
+int wfst_graph_build_lm(cmd_ln_t *config, acmod_t *acmod, dict_t *dict,
+                        dict2pid_t *d2p, ngram_model_t *lm,
+                        char const *file);
+
+#endif /* __WFST_GRAPH_H__ */
@@ -0,0 +1,580 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file wfst_search.c Search over a precompiled static decoding graph.
+ */
+
+/* System headers. */
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/err.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/cmd_ln.h>
+
+/* Local headers. */
+#include "wfst_search.h"
+#include "ps_histprune.h"
+#include "hmm.h"
+
+static int wfst_search_start(ps_search_t *search);
+static int wfst_search_step(ps_search_t *search, int frame_idx);
+static int wfst_search_finish(ps_search_t *search);
+static int wfst_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2p);
+static void wfst_search_free(ps_search_t *search);
+static ps_lattice_t *wfst_search_lattice(ps_search_t *search);
+static char const *wfst_search_hyp(ps_search_t *search, int32 *out_score);
+static int32 wfst_search_prob(ps_search_t *search);
+static ps_seg_t *wfst_search_seg_iter(ps_search_t *search);
+static void wfst_search_sen_active(ps_search_t *search, int frame_idx);
+
+static ps_searchfuncs_t wfst_funcs = {
+    /* start: */  wfst_search_start,
+    /* step: */   wfst_search_step,
+    /* finish: */ wfst_search_finish,
+    /* reinit: */ wfst_search_reinit,
+    /* free: */   wfst_search_free,
+    /* lattice: */  wfst_search_lattice,
+    /* hyp: */      wfst_search_hyp,
+    /* prob: */     wfst_search_prob,
+    /* seg_iter: */ wfst_search_seg_iter,
+    /* sen_active: */ wfst_search_sen_active,
+};
+
+ps_search_t *
+wfst_search_init(const char *name,
+                 wfst_graph_t *graph,
+                 cmd_ln_t *config,
+                 acmod_t *acmod,
+                 dict_t *dict,
+                 dict2pid_t *d2p)
+{
+    wfst_search_t *wfs;
+    int32 n_states, i;
+
+    wfs = ckd_calloc(1, sizeof(*wfs));
+    ps_search_init(ps_search_base(wfs), &wfst_funcs, PS_SEARCH_TYPE_WFST,
+                   name, config, acmod, dict, d2p);
+    wfs->graph = graph;
+
+    n_states = wfst_graph_n_states(graph);
+    wfs->score = ckd_calloc(n_states, sizeof(*wfs->score));
+    wfs->hist = ckd_calloc(n_states, sizeof(*wfs->hist));
+    wfs->active = ckd_calloc(n_states, sizeof(*wfs->active));
+    wfs->queue = ckd_calloc(n_states, sizeof(*wfs->queue));
+    wfs->queued = ckd_calloc(n_states, sizeof(*wfs->queued));
+    wfs->tokens = ckd_calloc(n_states, sizeof(*wfs->tokens));
+    for (i = 0; i < n_states; ++i)
+        wfs->score[i] = WORST_SCORE;
+    wfs->frame = -1;
+
+    wfs->beam = logmath_log(acmod->lmath, cmd_ln_float64_r(config, "-beam"))
+        >> SENSCR_SHIFT;
+    wfs->wbeam = logmath_log(acmod->lmath, cmd_ln_float64_r(config, "-wbeam"))
+        >> SENSCR_SHIFT;
+    wfs->maxhmmpf = cmd_ln_int32_r(config, "-maxhmmpf");
+    E_INFO("WFST(beam: %d, wbeam: %d, maxhmmpf: %d)\n",
+           wfs->beam, wfs->wbeam, wfs->maxhmmpf);
+
+    if (wfst_search_reinit(ps_search_base(wfs),
+                           ps_search_dict(wfs),
+                           ps_search_dict2pid(wfs)) < 0) {
+        ps_search_free(ps_search_base(wfs));
+        return NULL;
+    }
+    ptmr_init(&wfs->perf);
+
+    return ps_search_base(wfs);
+}
+
+static void
+wfst_search_free(ps_search_t *search)
+{
+    wfst_search_t *wfs = (wfst_search_t *)search;
+
+    double n_speech = (double)wfs->n_tot_frame
+            / cmd_ln_int32_r(ps_search_config(wfs), "-frate");
+
+    E_INFO("TOTAL wfst %.2f CPU %.3f xRT\n",
+           wfs->perf.t_tot_cpu,
+           wfs->perf.t_tot_cpu / n_speech);
+    E_INFO("TOTAL wfst %.2f wall %.3f xRT\n",
+           wfs->perf.t_tot_elapsed,
+           wfs->perf.t_tot_elapsed / n_speech);
+
+    ps_search_base_free(search);
+    wfst_graph_free(wfs->graph);
+    ckd_free(wfs->score);
+    ckd_free(wfs->hist);
+    ckd_free(wfs->active);
+    ckd_free(wfs->queue);
+    ckd_free(wfs->queued);
+    ckd_free(wfs->tokens);
+    ckd_free(wfs->hist_ent);
+    ckd_free(wfs);
+}
+
+static int
+wfst_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2p)
+{
+    /* Free old dict2pid, dict.  Nothing else depends on them, as the
+     * words are all in the graph. */
+    ps_search_base_reinit(search, dict, d2p);
+    search->n_words = dict_size(dict);
+    return 0;
+}
+
+static void
+wfst_search_sen_active(ps_search_t *search, int frame_idx)
+{
+    wfst_search_t *wfs = (wfst_search_t *)search;
+    wfst_graph_t *g = wfs->graph;
+    acmod_t *acmod = ps_search_acmod(wfs);
+    int32 i, j;
+
+    acmod_clear_active(acmod);
+    for (i = 0; i < wfs->n_active; ++i) {
+        int32 s = wfs->active[i];
+        for (j = g->arc_idx[s]; j < g->arc_idx[s + 1]; ++j)
+            if (g->arcs[j].ilabel)
+                acmod_activate_sen(acmod, g->arcs[j].ilabel - 1);
+    }
+}
+
+static int32
+wfst_search_add_hist(wfst_search_t *wfs, int32 word, int32 score, int32 prev)
+{
+    wfst_hist_t *h;
+
+    if (wfs->n_hist == wfs->n_hist_alloc) {
+        wfs->n_hist_alloc = wfs->n_hist_alloc ? wfs->n_hist_alloc * 2 : 256;
+        wfs->hist_ent = ckd_realloc(wfs->hist_ent, wfs->n_hist_alloc
+                                    * sizeof(*wfs->hist_ent));
+    }
+    h = &wfs->hist_ent[wfs->n_hist];
+    h->word = word;
+    h->ef = wfs->frame;
+    h->score = score;
+    h->prev = prev;
+    return wfs->n_hist++;
+}
+
+/*
+ * Follow epsilon arcs from all active states, until no more scores
+ * can be improved.  Tokens must do better than thresh, and word exits
+ * better than wthresh.
+ */
+static void
+wfst_search_closure(wfst_search_t *wfs, int32 thresh, int32 wthresh)
+{
+    wfst_graph_t *g = wfs->graph;
+    int32 n_states = wfst_graph_n_states(g);
+    int32 head, tail, n_queued, i;
+
+    for (i = 0; i < wfs->n_active; ++i) {
+        wfs->queue[i] = wfs->active[i];
+        wfs->queued[wfs->active[i]] = TRUE;
+    }
+    head = 0;
+    n_queued = wfs->n_active;
+    tail = n_queued % n_states;
+
+    while (n_queued > 0) {
+        int32 s = wfs->queue[head];
+
+        head = (head + 1) % n_states;
+        --n_queued;
+        wfs->queued[s] = FALSE;
+        for (i = g->arc_idx[s]; i < g->arc_idx[s + 1]; ++i) {
+            wfst_arc_t const *arc = &g->arcs[i];
+            int32 score, hist;
+
+            if (arc->ilabel)
+                continue;
+            score = wfs->score[s] + arc->weight;
+            if (!(score BETTER_THAN thresh)
+                || !(score BETTER_THAN wfs->score[arc->next]))
+                continue;
+            hist = wfs->hist[s];
+            if (arc->olabel) {
+                if (!(score BETTER_THAN wthresh))
+                    continue;
+                hist = wfst_search_add_hist(wfs, arc->olabel - 1,
+                                            score, hist);
+            }
+            if (wfs->score[arc->next] == WORST_SCORE)
+                wfs->active[wfs->n_active++] = arc->next;
+            wfs->score[arc->next] = score;
+            wfs->hist[arc->next] = hist;
+            if (score BETTER_THAN wfs->best_score)
+                wfs->best_score = score;
+            if (!wfs->queued[arc->next]) {
+                wfs->queue[tail] = arc->next;
+                tail = (tail + 1) % n_states;
+                wfs->queued[arc->next] = TRUE;
+                ++n_queued;
+            }
+        }
+    }
+}
+
+static void
+wfst_search_clear(wfst_search_t *wfs)
+{
+    int32 i;
+
+    for (i = 0; i < wfs->n_active; ++i)
+        wfs->score[wfs->active[i]] = WORST_SCORE;
+    wfs->n_active = 0;
+    wfs->n_hist = 0;
+}
+
+static int
+wfst_search_start(ps_search_t *search)
+{
+    wfst_search_t *wfs = (wfst_search_t *)search;
+    int32 start = wfst_graph_start(wfs->graph);
+
+    wfst_search_clear(wfs);
+    wfs->final = FALSE;
+    wfs->frame = -1;
+    wfs->best_score = 0;
+    wfs->score[start] = 0;
+    wfs->hist[start] = -1;
+    wfs->active[wfs->n_active++] = start;
+    wfst_search_closure(wfs, wfs->beam, wfs->wbeam);
+    wfs->frame = 0;
+
+    wfs->n_tok = 0;
+    wfs->n_sen_eval = 0;
+
+    ptmr_reset(&wfs->perf);
+    ptmr_start(&wfs->perf);
+
+    return 0;
+}
+
+static int
+wfst_search_step(ps_search_t *search, int frame_idx)
+{
+    wfst_search_t *wfs = (wfst_search_t *)search;
+    wfst_graph_t *g = wfs->graph;
+    acmod_t *acmod = ps_search_acmod(search);
+    int16 const *senscr;
+    int32 n_tok, beam, thresh, i, j;
+
+    /* Activate our senones for the current frame if need be. */
+    if (!acmod->compallsen)
+        wfst_search_sen_active(search, frame_idx);
+    /* Compute GMM scores for the current frame. */
+    senscr = acmod_score(acmod, &frame_idx);
+    wfs->n_sen_eval += acmod->n_senone_active;
+
+    /* Take the tokens out of the graph, then pass them over the
+     * emitting arcs. */
+    n_tok = wfs->n_active;
+    for (i = 0; i < n_tok; ++i) {
+        int32 s = wfs->active[i];
+        wfs->tokens[i].state = s;
+        wfs->tokens[i].score = wfs->score[s];
+        wfs->tokens[i].hist = wfs->hist[s];
+        wfs->score[s] = WORST_SCORE;
+    }
+    wfs->n_active = 0;
+    wfs->best_score = WORST_SCORE;
+    for (i = 0; i < n_tok; ++i) {
+        wfst_token_t const *tok = &wfs->tokens[i];
+
+        for (j = g->arc_idx[tok->state]; j < g->arc_idx[tok->state + 1]; ++j) {
+            wfst_arc_t const *arc = &g->arcs[j];
+            int32 score;
+
+            if (arc->ilabel == 0)
+                continue;
+            score = tok->score + arc->weight + senscr[arc->ilabel - 1];
+            if (!(score BETTER_THAN wfs->score[arc->next]))
+                continue;
+            if (wfs->score[arc->next] == WORST_SCORE)
+                wfs->active[wfs->n_active++] = arc->next;
+            wfs->score[arc->next] = score;
+            wfs->hist[arc->next] = tok->hist;
+            if (score BETTER_THAN wfs->best_score)
+                wfs->best_score = score;
+        }
+    }
+
+    /* Prune, narrowing the beam if there are too many tokens. */
+    beam = wfs->beam;
+    if (wfs->maxhmmpf != -1 && wfs->n_active > wfs->maxhmmpf) {
+        ps_histprune_t hp;
+
+        ps_histprune_reset(&hp, wfs->best_score, wfs->beam);
+        for (i = 0; i < wfs->n_active; ++i)
+            ps_histprune_add(&hp, wfs->score[wfs->active[i]]);
+        beam = ps_histprune_beam(&hp, wfs->maxhmmpf, wfs->beam);
+    }
+    thresh = wfs->best_score + beam;
+    for (i = j = 0; i < wfs->n_active; ++i) {
+        int32 s = wfs->active[i];
+        if (wfs->score[s] BETTER_THAN thresh)
+            wfs->active[j++] = s;
+        else
+            wfs->score[s] = WORST_SCORE;
+    }
+    wfs->n_active = j;
+
+    /* Follow epsilon arcs, emitting words. */
+    wfst_search_closure(wfs, thresh, wfs->best_score + wfs->wbeam);
+    wfs->n_tok += wfs->n_active;
+
+    ++wfs->frame;
+
+    return 1;
+}
+
+/*
+ * Find the best token, in a final state if final is TRUE (returns -1
+ * if there is none).
+ */
+static int32
+wfst_search_find_exit(wfst_search_t *wfs, int final, int32 *out_score)
+{
+    wfst_graph_t *g = wfs->graph;
+    int32 best = -1, best_score = WORST_SCORE;
+    int32 i;
+
+    for (i = 0; i < wfs->n_active; ++i) {
+        int32 s = wfs->active[i];
+        int32 score = wfs->score[s];
+
+        if (final) {
+            if (wfst_graph_final(g, s) == WORST_SCORE)
+                continue;
+            score += wfst_graph_final(g, s);
+        }
+        if (best == -1 || score BETTER_THAN best_score) {
+            best = s;
+            best_score = score;
+        }
+    }
+    if (out_score)
+        *out_score = best_score;
+    return best;
+}
+
+/*
+ * Find the history entry for the best hypothesis, or -1 if no words
+ * have been recognized.
+ */
+static int32
+wfst_search_best_hist(wfst_search_t *wfs, int32 *out_score)
+{
+    int32 s = -1;
+
+    if (wfs->final)
+        s = wfst_search_find_exit(wfs, TRUE, out_score);
+    if (s == -1)
+        s = wfst_search_find_exit(wfs, FALSE, out_score);
+    if (s == -1)
+        return -1;
+    return wfs->hist[s];
+}
+
+static int
+wfst_search_finish(ps_search_t *search)
+{
+    wfst_search_t *wfs = (wfst_search_t *)search;
+    int32 cf, score;
+
+    wfs->final = TRUE;
+    if (wfst_search_find_exit(wfs, TRUE, &score) == -1)
+        E_WARN("No final state reached, using best partial hypothesis\n");
+
+    wfs->n_tot_frame += wfs->frame;
+    E_INFO("%d frames, %d tokens (%d/fr), %d senones (%d/fr), "
+           "%d history entries (%d/fr)\n\n",
+           wfs->frame, wfs->n_tok,
+           (wfs->frame > 0) ? wfs->n_tok / wfs->frame : 0,
+           wfs->n_sen_eval,
+           (wfs->frame > 0) ? wfs->n_sen_eval / wfs->frame : 0,
+           wfs->n_hist, (wfs->frame > 0) ? wfs->n_hist / wfs->frame : 0);
+
+    /* Print out some statistics. */
+    ptmr_stop(&wfs->perf);
+    /* This is the number of frames processed. */
+    cf = ps_search_acmod(wfs)->output_frame;
+    if (cf > 0) {
+        double n_speech = (double) (cf + 1)
+            / cmd_ln_int32_r(ps_search_config(wfs), "-frate");
+        E_INFO("wfst %.2f CPU %.3f xRT\n",
+               wfs->perf.t_cpu, wfs->perf.t_cpu / n_speech);
+        E_INFO("wfst %.2f wall %.3f xRT\n",
+               wfs->perf.t_elapsed, wfs->perf.t_elapsed / n_speech);
+    }
+
+    return 0;
+}
+
+/*
+ * There is no word lattice, as only the best word exit is kept in
+ * each state.
+ */
+static ps_lattice_t *
+wfst_search_lattice(ps_search_t *search)
+{
+    return NULL;
+}
+
+static int32
+wfst_search_prob(ps_search_t *search)
+{
+    return 0;
+}
+
+static char const *
+wfst_search_hyp(ps_search_t *search, int32 *out_score)
+{
+    wfst_search_t *wfs = (wfst_search_t *)search;
+    wfst_graph_t *g = wfs->graph;
+    char *c;
+    size_t len;
+    int32 bp, bpidx;
+
+    bpidx = wfst_search_best_hist(wfs, out_score);
+
+    len = 0;
+    for (bp = bpidx; bp >= 0; bp = wfs->hist_ent[bp].prev) {
+        int32 w = wfs->hist_ent[bp].word;
+        if (wfst_graph_is_filler(g, w))
+            continue;
+        len += strlen(wfst_graph_word_str(g, w)) + 1;
+    }
+
+    ckd_free(search->hyp_str);
+    if (len == 0) {
+        search->hyp_str = NULL;
+        return search->hyp_str;
+    }
+    search->hyp_str = ckd_calloc(1, len);
+
+    c = search->hyp_str + len - 1;
+    for (bp = bpidx; bp >= 0; bp = wfs->hist_ent[bp].prev) {
+        int32 w = wfs->hist_ent[bp].word;
+        if (wfst_graph_is_filler(g, w))
+            continue;
+        len = strlen(wfst_graph_word_str(g, w));
+        c -= len;
+        memcpy(c, wfst_graph_word_str(g, w), len);
+        if (c > search->hyp_str) {
+            --c;
+            *c = ' ';
+        }
+    }
+
+    return search->hyp_str;
+}
+
+static void
+wfst_seg_bp2itor(ps_seg_t *seg, int32 bp)
+{
+    wfst_search_t *wfs = (wfst_search_t *)seg->search;
+    wfst_hist_t const *h = &wfs->hist_ent[bp];
+    wfst_hist_t const *ph = (h->prev >= 0) ? &wfs->hist_ent[h->prev] : NULL;
+
+    seg->word = wfst_graph_word_str(wfs->graph, h->word);
+    seg->ef = h->ef;
+    seg->sf = ph ? ph->ef + 1 : 0;
+    seg->prob = 0; /* Bogus value... */
+    /* The language model score is compiled into the graph. */
+    seg->lback = 1;
+    seg->lscr = 0;
+    seg->ascr = ph ? h->score - ph->score : h->score;
+}
+
+static void
+wfst_seg_free(ps_seg_t *seg)
+{
+    wfst_seg_t *itor = (wfst_seg_t *)seg;
+    ckd_free(itor->hist);
+    ckd_free(itor);
+}
+
+static ps_seg_t *
+wfst_seg_next(ps_seg_t *seg)
+{
+    wfst_seg_t *itor = (wfst_seg_t *)seg;
+
+    if (++itor->cur == itor->n_hist) {
+        wfst_seg_free(seg);
+        return NULL;
+    }
+
+    wfst_seg_bp2itor(seg, itor->hist[itor->cur]);
+    return seg;
+}
+
+static ps_segfuncs_t wfst_segfuncs = {
+    /* seg_next */ wfst_seg_next,
+    /* seg_free */ wfst_seg_free
+};
+
+static ps_seg_t *
+wfst_search_seg_iter(ps_search_t *search)
+{
+    wfst_search_t *wfs = (wfst_search_t *)search;
+    wfst_seg_t *itor;
+    int32 bp, bpidx, cur, out_score;
+
+    bpidx = wfst_search_best_hist(wfs, &out_score);
+    /* No hypothesis (yet). */
+    if (bpidx < 0)
+        return NULL;
+
+    itor = ckd_calloc(1, sizeof(*itor));
+    itor->base.vt = &wfst_segfuncs;
+    itor->base.search = search;
+    itor->base.lwf = 1.0;
+    for (bp = bpidx; bp >= 0; bp = wfs->hist_ent[bp].prev)
+        ++itor->n_hist;
+    itor->hist = ckd_calloc(itor->n_hist, sizeof(*itor->hist));
+    cur = itor->n_hist - 1;
+    for (bp = bpidx; bp >= 0; bp = wfs->hist_ent[bp].prev)
+        itor->hist[cur--] = bp;
+
+    /* Fill in relevant fields for first element. */
+    wfst_seg_bp2itor((ps_seg_t *)itor, itor->hist[0]);
+
+    return (ps_seg_t *)itor;
+}
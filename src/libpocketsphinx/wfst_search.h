@@ -0,0 +1,131 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file wfst_search.h Search over a precompiled static decoding graph.
+ *
+ * Unlike N-Gram and FSG search, which build their search space from
+ * the dictionary and the language model as they go, this search
+ * simply passes tokens over the states of a decoding graph (see
+ * wfst_graph.h), which has everything compiled into it.  There is one
+ * token per state, kept in flat arrays indexed by state.
+ */
+
+#ifndef __WFST_SEARCH_H__
+#define __WFST_SEARCH_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/profile.h>
+
+/* Local headers. */
+#include "pocketsphinx_internal.h"
+#include "wfst_graph.h"
+
+/**
+ * Word exit in the search history.
+ */
+typedef struct wfst_hist_s {
+    int32 word;          /**< Output word in graph. */
+    int32 ef;            /**< Frame in which it ended. */
+    int32 score;         /**< Path score at end of word. */
+    int32 prev;          /**< Previous word exit, or -1. */
+} wfst_hist_t;
+
+/**
+ * Token carried over from the previous frame.
+ */
+typedef struct wfst_token_s {
+    int32 state;         /**< State it was in. */
+    int32 score;         /**< Path score. */
+    int32 hist;          /**< History entry. */
+} wfst_token_t;
+
+/**
+ * Segmentation "iterator" for WFST search history.
+ */
+typedef struct wfst_seg_s {
+    ps_seg_t base;       /**< Base structure. */
+    int32 *hist;         /**< Sequence of history entries. */
+    int32 n_hist;        /**< Number of history entries. */
+    int32 cur;           /**< Current position in hist. */
+} wfst_seg_t;
+
+/**
+ * WFST search structure.
+ */
+typedef struct wfst_search_s {
+    ps_search_t base;       /**< Base search structure. */
+    wfst_graph_t *graph;    /**< Decoding graph. */
+
+    int32 *score;           /**< Score of the token in each state, or WORST_SCORE. */
+    int32 *hist;            /**< History entry of the token in each state. */
+    int32 *active;          /**< States with a token. */
+    int32 n_active;         /**< Number of states with a token. */
+    int32 *queue;           /**< Queue for epsilon arcs (circular). */
+    uint8 *queued;          /**< Is each state in queue? */
+    wfst_token_t *tokens;   /**< Tokens from previous frame. */
+
+    wfst_hist_t *hist_ent;  /**< Word exits. */
+    int32 n_hist;           /**< Number of word exits. */
+    int32 n_hist_alloc;     /**< Allocated number of word exits. */
+
+    int32 beam;             /**< Beam for tokens. */
+    int32 wbeam;            /**< Beam for word exits. */
+    int32 maxhmmpf;         /**< Maximum number of tokens per frame (or -1). */
+
+    int32 frame;            /**< Current frame. */
+    int32 best_score;       /**< Best token score in current frame. */
+    int32 final;            /**< Has the utterance been finished? */
+
+    int32 n_tok;            /**< Total number of tokens in utterance. */
+    int32 n_sen_eval;       /**< Total number of senones evaluated in utterance. */
+    int32 n_tot_frame;      /**< Total number of frames decoded. */
+    ptmr_t perf;            /**< Performance counter. */
+} wfst_search_t;
+
+/**
+ * Create a new WFST search.
+ *
+ * @param graph Decoding graph, ownership of which passes to the search.
+ */
+ps_search_t *wfst_search_init(const char *name,
+                              wfst_graph_t *graph,
+                              cmd_ln_t *config,
+                              acmod_t *acmod,
+                              dict_t *dict,
+                              dict2pid_t *d2p);
+
+#endif /* __WFST_SEARCH_H__ */
@@ -396,7 +396,7 @@ process_ctl_line(ps_decoder_t *ps, cmd_ln_t *config,
 
     if (cmd_ln_boolean_r(config, "-senin")) {
         /* start and end frames not supported. */
-        ps_decode_senscr(ps, infh);
+        ps_decode_senscr_file(ps, infile);
     }
     else if (cmd_ln_boolean_r(config, "-adcin")) {
         
@@ -0,0 +1,120 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2026 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * kdtree_build.c - build kd-trees for Gaussian selection
+ **/
+
+#include <stdio.h>
+
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/err.h>
+#include <sphinxbase/logmath.h>
+
+#include <pocketsphinx.h>
+
+#include "ms_gauden.h"
+#include "kdtree.h"
+
+static const arg_t defn[] = {
+    { "-mean",
+      REQARG_STRING,
+      NULL,
+      "Mixture gaussian means input file" },
+    { "-var",
+      REQARG_STRING,
+      NULL,
+      "Mixture gaussian variances input file" },
+    { "-o",
+      REQARG_STRING,
+      NULL,
+      "Output kd-tree file" },
+    { "-varfloor",
+      ARG_FLOAT32,
+      "0.0001",
+      "Mixture gaussian variance floor (applied to data from -var file)" },
+    { "-logbase",
+      ARG_FLOAT32,
+      "1.0001",
+      "Base in which all log-likelihoods calculated" },
+    { "-threshold",
+      ARG_FLOAT32,
+      "3.0",
+      "Half-width of the box around each Gaussian, in standard deviations" },
+    { "-depth",
+      ARG_INT32,
+      "8",
+      "Maximum depth of each kd-tree" },
+    { "-bucket",
+      ARG_INT32,
+      "8",
+      "Stop splitting nodes with this many Gaussians or fewer" },
+    CMDLN_EMPTY_OPTION
+};
+
+int
+main(int argc, char *argv[])
+{
+    cmd_ln_t *config;
+    logmath_t *lmath;
+    gauden_t *g;
+    kdtree_t *kd;
+    int rv = 1;
+
+    if ((config = cmd_ln_parse_r(NULL, defn, argc, argv, TRUE)) == NULL)
+        return 1;
+    lmath = logmath_init(cmd_ln_float32_r(config, "-logbase"), 0, TRUE);
+    if ((g = gauden_init(cmd_ln_str_r(config, "-mean"),
+                         cmd_ln_str_r(config, "-var"),
+                         cmd_ln_float32_r(config, "-varfloor"),
+                         lmath)) == NULL) {
+        E_ERROR("Failed to read means and variances\n");
+        goto error_out;
+    }
+    if ((kd = kdtree_build(g, cmd_ln_float32_r(config, "-threshold"),
+                           cmd_ln_int32_r(config, "-depth"),
+                           cmd_ln_int32_r(config, "-bucket"))) == NULL) {
+        E_ERROR("Failed to build kd-trees\n");
+        gauden_free(g);
+        goto error_out;
+    }
+    if (kdtree_write(kd, cmd_ln_str_r(config, "-o")) == 0)
+        rv = 0;
+    kdtree_free(kd);
+    gauden_free(g);
+
+error_out:
+    logmath_free(lmath);
+    cmd_ln_free_r(config);
+    return rv;
+}
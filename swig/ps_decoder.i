@@ -235,6 +235,10 @@
         *errcode = ps_set_lm_file($self, name, path);
     }
 
+    void set_wfst_file(const char *name, const char *path, int *errcode) {
+        *errcode = ps_set_wfst_file($self, name, path);
+    }
+
     %newobject get_logmath;
     LogMath * get_logmath() {
         return logmath_retain(ps_get_logmath($self));
@@ -248,6 +252,23 @@
       *errcode = ps_unset_search($self, search_name);
     }
 
+    void activate_search(const char *search_name, int *errcode) {
+      *errcode = ps_activate_search($self, search_name);
+    }
+
+    void deactivate_search(const char *search_name, int *errcode) {
+      *errcode = ps_deactivate_search($self, search_name);
+    }
+
+    Hypothesis * search_hyp(const char *search_name) {
+        char const *hyp;
+        int best_score, prob;
+        hyp = ps_get_search_hyp($self, search_name, &best_score);
+        if (hyp)
+            prob = ps_get_search_prob($self, search_name);
+        return hyp ? new_Hypothesis(hyp, best_score, prob) : NULL;
+    }
+
     const char * get_search() {
         return ps_get_search($self);
     }
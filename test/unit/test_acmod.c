@@ -69,6 +69,7 @@ main(int argc, char *argv[])
     buf = ckd_calloc(nsamps, sizeof(*buf));
     TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
     TEST_EQUAL(0, acmod_start_utt(acmod));
+    TEST_EQUAL(0, acmod_set_rawfh(acmod, fopen("goforward.log.raw", "wb")));
     E_INFO("Incremental(2048):\n");
     while (!feof(rawfh)) {
         nread = fread(buf, sizeof(*buf), nsamps, rawfh);
@@ -113,6 +114,15 @@ main(int argc, char *argv[])
     E_INFO("Whole utterance:\n");
     cmn_live_set(acmod->fcb->cmn_struct, cmninit);
     nsamps = ftell(rawfh) / sizeof(*buf);
+    {
+        /* All of the audio should have been logged. */
+        FILE *logfh;
+        TEST_ASSERT(logfh = fopen("goforward.log.raw", "rb"));
+        fseek(logfh, 0, SEEK_END);
+        TEST_EQUAL(nsamps * sizeof(*buf), ftell(logfh));
+        fclose(logfh);
+    }
+    acmod_set_rawdata_size(acmod, 10000);
     clearerr(rawfh);
     fseek(rawfh, 0, SEEK_SET);
     buf = ckd_realloc(buf, nsamps * sizeof(*buf));
@@ -121,6 +131,16 @@ main(int argc, char *argv[])
     TEST_EQUAL(0, acmod_start_utt(acmod));
     acmod_process_raw(acmod, &bptr, &nsamps, TRUE);
     TEST_EQUAL(0, acmod_end_utt(acmod));
+    {
+        /* The end of the audio should have been kept. */
+        int16 *raw;
+        int32 nraw;
+        size_t total = ftell(rawfh) / sizeof(*buf);
+
+        acmod_get_rawdata(acmod, &raw, &nraw);
+        TEST_EQUAL(10000, nraw);
+        TEST_EQUAL(0, memcmp(raw, buf + total - 10000, nraw * sizeof(*raw)));
+    }
     {
         int16 best_score;
         int frame_idx = -1, best_senid;
@@ -1,15 +1,26 @@
 #include <pocketsphinx.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
+#include <sphinxbase/strfuncs.h>
+
 #include "pocketsphinx_internal.h"
+#include "ngram_search.h"
+#include "ps_histprune.h"
+#include "ngram_search_lextree.h"
 #include "test_macros.h"
 #include "test_ps.c"
 
-int
-main(int argc, char *argv[])
+/*
+ * Configuration for fwdtree search alone, with any other options
+ * given as a NULL-terminated list of names and values.
+ */
+static cmd_ln_t *
+fwdtree_config(char const *name, ...)
 {
     cmd_ln_t *config;
+    va_list args;
 
     TEST_ASSERT(config =
             cmd_ln_init(NULL, ps_args(), TRUE,
@@ -20,5 +31,330 @@ main(int argc, char *argv[])
                 "-fwdflat", "no",
                 "-bestpath", "no",
                 "-samprate", "16000", NULL));
-    return ps_decoder_test(config, "FWDTREE", "go forward ten meters");
+    va_start(args, name);
+    while (name) {
+        char const *value = va_arg(args, char const *);
+        TEST_ASSERT(cmd_ln_init(config, ps_args(), TRUE, name, value, NULL));
+        name = va_arg(args, char const *);
+    }
+    va_end(args);
+    return config;
+}
+
+/* Decode goforward.raw in one go. */
+static ps_decoder_t *
+decode_goforward(cmd_ln_t *config, int32 *out_score)
+{
+    ps_decoder_t *ps;
+    FILE *rawfh;
+
+    TEST_ASSERT(ps = ps_init(config));
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_ASSERT(ps_decode_raw(ps, rawfh, -1) > 0);
+    fclose(rawfh);
+    TEST_EQUAL(0, strcmp(ps_get_hyp(ps, out_score), "go forward ten meters"));
+    return ps;
+}
+
+/* Check that two searches found exactly the same word exits. */
+static void
+compare_bptbl(ngram_search_t *ngs, ngram_search_t *ngs2)
+{
+    int32 i;
+
+    TEST_EQUAL(ngs->bpidx, ngs2->bpidx);
+    for (i = 0; i < ngs->bpidx; ++i) {
+        bptbl_t *be = &ngs->bp_table[i], *be2 = &ngs2->bp_table[i];
+
+        TEST_EQUAL(be->frame, be2->frame);
+        TEST_EQUAL(be->wid, be2->wid);
+        TEST_EQUAL(be->bp, be2->bp);
+        TEST_EQUAL(be->score, be2->score);
+        TEST_EQUAL(be->s_idx, be2->s_idx);
+        TEST_EQUAL(be->real_wid, be2->real_wid);
+        TEST_EQUAL(be->prev_real_wid, be2->prev_real_wid);
+        TEST_EQUAL(be->last_phone, be2->last_phone);
+        TEST_EQUAL(be->last2_phone, be2->last2_phone);
+    }
+    TEST_EQUAL(ngs->bss_head, ngs2->bss_head);
+    TEST_EQUAL(0, memcmp(ngs->bscore_stack, ngs2->bscore_stack,
+                         ngs->bss_head * sizeof(*ngs->bscore_stack)));
+}
+
+/*
+ * Check that no more than maxwpf word exits survived in each frame,
+ * unless they were all too close to the best one to tell apart.
+ */
+static void
+check_maxwpf(ngram_search_t *ngs, int32 maxwpf)
+{
+    int32 bw, start, end, n_pruned;
+
+    bw = -ngs->wbeam / PS_HISTPRUNE_NBINS;
+    n_pruned = 0;
+    for (start = 0; start < ngs->bpidx; start = end) {
+        int32 i, n_valid, best;
+
+        best = WORST_SCORE;
+        n_valid = 0;
+        for (end = start; end < ngs->bpidx
+                 && ngs->bp_table[end].frame == ngs->bp_table[start].frame;
+             ++end) {
+            if (ngs->bp_table[end].score > best)
+                best = ngs->bp_table[end].score;
+            if (ngs->bp_table[end].valid)
+                ++n_valid;
+            else
+                ++n_pruned;
+        }
+        if (n_valid > maxwpf)
+            for (i = start; i < end; ++i)
+                if (ngs->bp_table[i].valid)
+                    TEST_ASSERT(ngs->bp_table[i].score > best - bw);
+    }
+    printf("%d word exits pruned by -maxwpf %d\n", n_pruned, maxwpf);
+    TEST_ASSERT(n_pruned > 0);
+}
+
+/* Append some words to a hypothesis. */
+static char *
+append_hyp(char *hyp, char const *words)
+{
+    char *newhyp;
+
+    if (words == NULL || *words == '\0')
+        return hyp;
+    if (hyp == NULL)
+        return ckd_salloc(words);
+    newhyp = string_join(hyp, " ", words, NULL);
+    ckd_free(hyp);
+    return newhyp;
+}
+
+/*
+ * Decode goforward.raw n_loop times over in a single utterance, a
+ * block at a time, collecting words from ps_get_stable_hyp() as they
+ * become final and tracking the most backpointers and score stack
+ * entries in use.  Returns the final words followed by the rest of
+ * the hypothesis.
+ */
+static char *
+decode_stable(ps_decoder_t *ps, int n_loop,
+              int32 *out_max_bp, int32 *out_max_bss)
+{
+    ngram_search_t *ngs = (ngram_search_t *)ps->search;
+    FILE *rawfh;
+    int16 buf[2048];
+    size_t nread;
+    char *hyp = NULL;
+    int i;
+
+    *out_max_bp = *out_max_bss = 0;
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_EQUAL(0, ps_start_utt(ps));
+    for (i = 0; i < n_loop; ++i) {
+        fseek(rawfh, 0, SEEK_SET);
+        while ((nread = fread(buf, sizeof(*buf), 2048, rawfh)) > 0) {
+            TEST_ASSERT(ps_process_raw(ps, buf, nread, FALSE, FALSE) >= 0);
+            hyp = append_hyp(hyp, ps_get_stable_hyp(ps));
+            if (ngs->bpidx > *out_max_bp)
+                *out_max_bp = ngs->bpidx;
+            if (ngs->bss_head > *out_max_bss)
+                *out_max_bss = ngs->bss_head;
+        }
+    }
+    fclose(rawfh);
+    TEST_EQUAL(0, ps_end_utt(ps));
+    return append_hyp(hyp, ps_get_hyp(ps, NULL));
+}
+
+/* Read a whole file into memory. */
+static char *
+read_file(char const *file, size_t *out_size)
+{
+    FILE *fh;
+    char *data;
+
+    TEST_ASSERT(fh = fopen(file, "rb"));
+    fseek(fh, 0, SEEK_END);
+    *out_size = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    data = ckd_malloc(*out_size);
+    TEST_EQUAL(*out_size, fread(data, 1, *out_size, fh));
+    fclose(fh);
+    return data;
+}
+
+/* Check that two searches have the same lexicon tree. */
+static void
+compare_lextree(ngram_search_t *ngs, ngram_search_t *ngs2)
+{
+    int32 i;
+
+    TEST_EQUAL(ngs->n_root_chan, ngs2->n_root_chan);
+    TEST_EQUAL(ngs->n_nonroot_chan, ngs2->n_nonroot_chan);
+    TEST_EQUAL(ngs->n_1ph_words, ngs2->n_1ph_words);
+    TEST_EQUAL(ngs->n_1ph_LMwords, ngs2->n_1ph_LMwords);
+    for (i = 0; i < ngs->n_root_chan; ++i) {
+        TEST_EQUAL(ngs->root_chan[i].ciphone, ngs2->root_chan[i].ciphone);
+        TEST_EQUAL(ngs->root_chan[i].ci2phone, ngs2->root_chan[i].ci2phone);
+        TEST_EQUAL(ngs->root_chan[i].penult_phn_wid,
+                   ngs2->root_chan[i].penult_phn_wid);
+    }
+}
+
+/*
+ * Damage a lexicon tree image, then check that a decoder using it
+ * rebuilds the tree (and rewrites the image) instead of loading it.
+ */
+static void
+corrupt_lextree_test(ps_decoder_t *ref, char const *image,
+                     size_t size, int32 offset, int32 val)
+{
+    ps_decoder_t *ps;
+    cmd_ln_t *config;
+    char *data;
+    size_t size2;
+    FILE *fh;
+
+    TEST_ASSERT(fh = fopen("test_fwdtree.lextree", "r+b"));
+    fseek(fh, offset, SEEK_SET);
+    TEST_EQUAL(1, fwrite(&val, sizeof(val), 1, fh));
+    fclose(fh);
+    config = fwdtree_config("-lextreeimg", "test_fwdtree.lextree", NULL);
+    TEST_ASSERT(ps = ps_init(config));
+    compare_lextree((ngram_search_t *)ref->search,
+                    (ngram_search_t *)ps->search);
+    data = read_file("test_fwdtree.lextree", &size2);
+    TEST_EQUAL(size, size2);
+    TEST_EQUAL(0, memcmp(image, data, size));
+    ckd_free(data);
+    ps_free(ps);
+    cmd_ln_free_r(config);
+}
+
+int
+main(int argc, char *argv[])
+{
+    ps_decoder_t *ps, *ps2;
+    cmd_ln_t *config;
+    int32 score, score2, max_bp, max_bss, max_bp2, max_bss2;
+    char *hyp, *image, *data;
+    FILE *rawfh;
+    lextree_hdr_t *hdr;
+    lextree_node_t *nodes;
+    size_t image_size, data_size;
+    int32 i;
+
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config(NULL),
+                                  "FWDTREE", "go forward ten meters"));
+
+    /* Same result without the LM score cache. */
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config("-lmcache", "0", NULL),
+                                  "FWDTREE", "go forward ten meters"));
+
+    /* And with LM lookahead in the lexicon tree. */
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config("-lmlookahead", "yes", NULL),
+                                  "FWDTREE", "go forward ten meters"));
+
+    /* And with several threads evaluating the tree, which must find
+     * exactly the same word exits as a single thread. */
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config("-nthreads_search", "4", NULL),
+                                  "FWDTREE", "go forward ten meters"));
+    config = fwdtree_config(NULL);
+    ps = decode_goforward(config, &score);
+    cmd_ln_free_r(config);
+    config = fwdtree_config("-nthreads_search", "4", NULL);
+    ps2 = decode_goforward(config, &score2);
+    cmd_ln_free_r(config);
+    TEST_EQUAL(score, score2);
+    compare_bptbl((ngram_search_t *)ps->search, (ngram_search_t *)ps2->search);
+    ps_free(ps);
+    ps_free(ps2);
+
+    /* And with a limit on word exits per frame, which must actually
+     * limit them. */
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config("-maxwpf", "20", NULL),
+                                  "FWDTREE", "go forward ten meters"));
+    config = fwdtree_config("-maxwpf", "5", NULL);
+    TEST_ASSERT(ps = ps_init(config));
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_ASSERT(ps_decode_raw(ps, rawfh, -1) > 0);
+    fclose(rawfh);
+    check_maxwpf((ngram_search_t *)ps->search, 5);
+    ps_free(ps);
+    cmd_ln_free_r(config);
+
+    /* And with the backpointer table garbage-collected as we go. */
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config("-bptbl_gc", "5", NULL),
+                                  "FWDTREE", "go forward ten meters"));
+    /* The words that become final along the way, followed by the
+     * rest of the hypothesis, must be the same as without it. */
+    config = fwdtree_config("-bptbl_gc", "5", NULL);
+    TEST_ASSERT(ps = ps_init(config));
+    hyp = decode_stable(ps, 1, &max_bp, &max_bss);
+    printf("FWDTREE (stable): %s\n", hyp);
+    TEST_EQUAL(0, strcmp(hyp, "go forward ten meters"));
+    ckd_free(hyp);
+    /* And the backpointer table must not keep growing in a long
+     * utterance, unlike without it. */
+    ckd_free(decode_stable(ps, 10, &max_bp, &max_bss));
+    ps_free(ps);
+    cmd_ln_free_r(config);
+    config = fwdtree_config(NULL);
+    TEST_ASSERT(ps = ps_init(config));
+    ckd_free(decode_stable(ps, 10, &max_bp2, &max_bss2));
+    ps_free(ps);
+    cmd_ln_free_r(config);
+    printf("Most backpointers %d (%d without GC), score stack %d (%d)\n",
+           max_bp, max_bp2, max_bss, max_bss2);
+    TEST_ASSERT(max_bp < max_bp2 / 2);
+    TEST_ASSERT(max_bss < max_bss2 / 2);
+
+    /* And with the lexicon tree written to an image, then loaded from it. */
+    remove("test_fwdtree.lextree");
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config("-lextreeimg",
+                                                 "test_fwdtree.lextree", NULL),
+                                  "FWDTREE", "go forward ten meters"));
+    image = read_file("test_fwdtree.lextree", &image_size);
+    TEST_EQUAL(0, ps_decoder_test(fwdtree_config("-lextreeimg",
+                                                 "test_fwdtree.lextree", NULL),
+                                  "FWDTREE", "go forward ten meters"));
+    /* The loaded tree must be the same as the one built from scratch. */
+    config = fwdtree_config(NULL);
+    TEST_ASSERT(ps = ps_init(config));
+    cmd_ln_free_r(config);
+    config = fwdtree_config("-lextreeimg", "test_fwdtree.lextree", NULL);
+    TEST_ASSERT(ps2 = ps_init(config));
+    cmd_ln_free_r(config);
+    compare_lextree((ngram_search_t *)ps->search,
+                    (ngram_search_t *)ps2->search);
+    ps_free(ps2);
+    /* A damaged image must be rebuilt, whether a senone sequence is
+     * out of range or a channel has two parents. */
+    hdr = (lextree_hdr_t *)image;
+    nodes = (lextree_node_t *)(image + sizeof(*hdr)
+                               + hdr->n_root_chan * sizeof(lextree_root_t));
+    corrupt_lextree_test(ps, image, image_size,
+                         (char *)&nodes[0].ssid - image, 0x7fffffff);
+    for (i = 0; i < hdr->n_nonroot_chan; ++i)
+        if (nodes[i].next != -1)
+            break;
+    TEST_ASSERT(i < hdr->n_nonroot_chan);
+    corrupt_lextree_test(ps, image, image_size,
+                         (char *)&nodes[i].alt - image, nodes[i].next);
+    ps_free(ps);
+    /* Adding a word rebuilds the tree, but leaves the image alone. */
+    config = fwdtree_config("-lextreeimg", "test_fwdtree.lextree", NULL);
+    TEST_ASSERT(ps = ps_init(config));
+    TEST_ASSERT(ps_add_word(ps, "foobie", "F UW B IY", TRUE) >= 0);
+    ps_free(ps);
+    cmd_ln_free_r(config);
+    data = read_file("test_fwdtree.lextree", &data_size);
+    TEST_EQUAL(image_size, data_size);
+    TEST_EQUAL(0, memcmp(image, data, image_size));
+    ckd_free(data);
+    ckd_free(image);
+    remove("test_fwdtree.lextree");
+    return 0;
 }
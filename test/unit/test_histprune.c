@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <pocketsphinx.h>
+
+#include "ps_histprune.h"
+#include "test_macros.h"
+
+/* Count the scores that a beam lets through. */
+static int
+count_survivors(int32 const *scores, int n, int32 best, int32 beam)
+{
+	int i, n_survive;
+
+	for (i = n_survive = 0; i < n; ++i)
+		if (scores[i] > best + beam)
+			++n_survive;
+	return n_survive;
+}
+
+int
+main(int argc, char *argv[])
+{
+	ps_histprune_t hist;
+	int32 scores[400];
+	int32 beam, prune_beam;
+	int i, n, max_n;
+
+	/* With this beam, each bin is 10 wide. */
+	beam = -10 * PS_HISTPRUNE_NBINS;
+
+	/* The best score, then three scores in each bin, and then some
+	 * more beyond the beam. */
+	n = 0;
+	scores[n++] = 0;
+	for (i = 0; i < 100; ++i) {
+		scores[n++] = -10 * i - 1;
+		scores[n++] = -10 * i - 5;
+		scores[n++] = -10 * i - 9;
+	}
+	for (i = 0; i < 20; ++i)
+		scores[n++] = beam * 2 - i;
+	ps_histprune_reset(&hist, 0, beam);
+	for (i = 0; i < n; ++i)
+		ps_histprune_add(&hist, scores[i]);
+	TEST_EQUAL(n, hist.n);
+	TEST_EQUAL(4, hist.bins[0]);
+	TEST_EQUAL(3, hist.bins[1]);
+	TEST_EQUAL(20, hist.bins[PS_HISTPRUNE_NBINS - 1]);
+
+	/* No more than max_n survive, and no fewer than max_n minus a
+	 * bin's worth. */
+	for (max_n = 4; max_n < 300; max_n += 7) {
+		int n_survive;
+
+		prune_beam = ps_histprune_beam(&hist, max_n, beam);
+		n_survive = count_survivors(scores, n, 0, prune_beam);
+		printf("max_n %d beam %d survivors %d\n",
+		       max_n, prune_beam, n_survive);
+		TEST_ASSERT(prune_beam >= beam);
+		TEST_ASSERT(n_survive <= max_n);
+		if (prune_beam > beam)
+			TEST_ASSERT(n_survive > max_n - 3);
+	}
+	/* The empty bins don't count, so everything within the beam
+	 * survives here. */
+	TEST_EQUAL(301, count_survivors(scores, n, 0,
+					ps_histprune_beam(&hist, 310, beam)));
+	/* A beam narrower than the one from the histogram is kept. */
+	TEST_EQUAL(-100, ps_histprune_beam(&hist, 200, -100));
+
+	/* With no more than max_n scores, the original beam is used. */
+	TEST_EQUAL(beam, ps_histprune_beam(&hist, n, beam));
+	TEST_EQUAL(beam, ps_histprune_beam(&hist, n + 1, beam));
+	TEST_EQUAL(beam, ps_histprune_beam(&hist, -1, beam));
+
+	/* The first bin is always kept, even if it has too many. */
+	ps_histprune_reset(&hist, 0, beam);
+	for (i = 0; i < 50; ++i) {
+		scores[i] = -(i % 10);
+		ps_histprune_add(&hist, scores[i]);
+	}
+	for (; i < 60; ++i) {
+		scores[i] = -20 - i;
+		ps_histprune_add(&hist, scores[i]);
+	}
+	prune_beam = ps_histprune_beam(&hist, 10, beam);
+	TEST_EQUAL(-10, prune_beam);
+	TEST_EQUAL(50, count_survivors(scores, 60, 0, prune_beam));
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sphinxbase/ckd_alloc.h>
+
+#include "hmm.h"
+#include "test_macros.h"
+
+#define N_SEN 64
+#define N_TMAT 4
+#define N_HMM 100
+#define N_FRAME 50
+
+static void
+random_tmat(uint8 **tp, int n_emit, int skip)
+{
+    int i, j;
+
+    for (i = 0; i < n_emit; ++i) {
+        for (j = 0; j < n_emit + 1; ++j) {
+            if (j == i || j == i + 1)
+                tp[i][j] = rand() % 100;
+            else if (j == i + 2 && skip)
+                tp[i][j] = rand() % 200;
+            else
+                tp[i][j] = 255;
+        }
+    }
+}
+
+static void
+test_batch(int n_emit)
+{
+    hmm_context_t *ctx;
+    uint8 ***tp;
+    uint16 **sseq;
+    int16 senscr[N_SEN];
+    hmm_t *a, *b;
+    int i, j, f;
+
+    tp = (uint8 ***)ckd_calloc_3d(N_TMAT, n_emit, n_emit + 1, sizeof(uint8));
+    for (i = 0; i < N_TMAT; ++i)
+        random_tmat(tp[i], n_emit, i & 1);
+    sseq = (uint16 **)ckd_calloc_2d(N_HMM, n_emit, sizeof(uint16));
+    for (i = 0; i < N_HMM; ++i)
+        for (j = 0; j < n_emit; ++j)
+            sseq[i][j] = rand() % N_SEN;
+    ctx = hmm_context_init(n_emit, (uint8 ** const *)tp, senscr, sseq);
+
+    a = ckd_calloc(N_HMM, sizeof(*a));
+    b = ckd_calloc(N_HMM, sizeof(*b));
+    for (i = 0; i < N_HMM; ++i) {
+        /* Mix in a few multiplex HMMs, which are not batched. */
+        hmm_init(ctx, &a[i], i % 7 == 0, i, i % N_TMAT);
+        hmm_init(ctx, &b[i], i % 7 == 0, i, i % N_TMAT);
+        hmm_enter(&a[i], -(rand() % 1000), i, 0);
+        hmm_enter(&b[i], hmm_in_score(&a[i]), i, 0);
+    }
+
+    for (f = 0; f < N_FRAME; ++f) {
+        int32 best_a, best_b;
+
+        for (i = 0; i < N_SEN; ++i)
+            senscr[i] = rand() % 2000;
+        best_a = WORST_SCORE;
+        for (i = 0; i < N_HMM; ++i) {
+            int32 score = hmm_vit_eval(&a[i]);
+            if (score BETTER_THAN best_a)
+                best_a = score;
+        }
+        for (i = 0; i < N_HMM; ++i)
+            hmm_batch_add(ctx, &b[i]);
+        best_b = hmm_vit_eval_batch(ctx);
+        TEST_EQUAL(best_a, best_b);
+        TEST_EQUAL(0, ctx->n_batch);
+        for (i = 0; i < N_HMM; ++i) {
+            TEST_EQUAL(0, memcmp(&a[i], &b[i], sizeof(a[i])));
+            /* Re-enter some of them to keep paths alive. */
+            if (rand() % 5 == 0) {
+                hmm_enter(&a[i], best_a - rand() % 500, f * N_HMM + i, f);
+                hmm_enter(&b[i], hmm_in_score(&a[i]), f * N_HMM + i, f);
+            }
+        }
+    }
+
+    ckd_free(a);
+    ckd_free(b);
+    hmm_context_free(ctx);
+    ckd_free_2d(sseq);
+    ckd_free_3d(tp);
+}
+
+static void
+test_compact(int n_emit)
+{
+    hmm_context_t *ctx;
+    uint8 ***tp;
+    uint16 **sseq;
+    int16 senscr[N_SEN];
+    hmm_t *a;
+    hmm_compact_t *c;
+    int32 best_a;
+    int i, j, f;
+
+    TEST_EQUAL(48, sizeof(hmm_compact_t));
+    tp = (uint8 ***)ckd_calloc_3d(N_TMAT, n_emit, n_emit + 1, sizeof(uint8));
+    for (i = 0; i < N_TMAT; ++i)
+        random_tmat(tp[i], n_emit, i & 1);
+    sseq = (uint16 **)ckd_calloc_2d(N_HMM, n_emit, sizeof(uint16));
+    for (i = 0; i < N_HMM; ++i)
+        for (j = 0; j < n_emit; ++j)
+            sseq[i][j] = rand() % N_SEN;
+    ctx = hmm_context_init(n_emit, (uint8 ** const *)tp, senscr, sseq);
+
+    a = ckd_calloc(N_HMM, sizeof(*a));
+    c = ckd_calloc(N_HMM, sizeof(*c));
+    for (i = 0; i < N_HMM; ++i) {
+        hmm_init(ctx, &a[i], FALSE, i, i % N_TMAT);
+        hmm_compact_init(ctx, &c[i], i, i % N_TMAT);
+        hmm_enter(&a[i], -(rand() % 1000), i, 0);
+        hmm_compact_enter(ctx, &c[i], hmm_in_score(&a[i]), i, 0);
+    }
+
+    best_a = 0;
+    for (f = 0; f < N_FRAME; ++f) {
+        int32 best_c;
+
+        for (i = 0; i < N_SEN; ++i)
+            senscr[i] = rand() % 2000;
+        hmm_context_set_base(ctx, best_a);
+        best_a = WORST_SCORE;
+        for (i = 0; i < N_HMM; ++i) {
+            int32 score = hmm_vit_eval(&a[i]);
+            if (score BETTER_THAN best_a)
+                best_a = score;
+        }
+        /* Alternate between batched and single evaluation. */
+        if (f & 1) {
+            for (i = 0; i < N_HMM; ++i)
+                hmm_batch_add(ctx, &c[i]);
+            best_c = hmm_compact_vit_eval_batch(ctx);
+        }
+        else {
+            best_c = WORST_SCORE;
+            for (i = 0; i < N_HMM; ++i) {
+                int32 score = hmm_compact_vit_eval(ctx, &c[i]);
+                if (score BETTER_THAN best_c)
+                    best_c = score;
+            }
+        }
+        TEST_EQUAL(best_a, best_c);
+        for (i = 0; i < N_HMM; ++i) {
+            /* Scores too far below the best are dropped. */
+            for (j = 0; j < n_emit; ++j) {
+                if (hmm_score(&a[i], j) < best_a - 32767)
+                    continue;
+                TEST_EQUAL(hmm_score(&a[i], j),
+                           hmm_compact_score(ctx, &c[i], j));
+                TEST_EQUAL(hmm_history(&a[i], j),
+                           hmm_compact_history(&c[i], j));
+            }
+            TEST_EQUAL(hmm_bestscore(&a[i]),
+                       hmm_compact_bestscore(ctx, &c[i]));
+            if (hmm_out_score(&a[i]) >= best_a - 32767) {
+                TEST_EQUAL(hmm_out_score(&a[i]),
+                           hmm_compact_out_score(ctx, &c[i]));
+                TEST_EQUAL(hmm_out_history(&a[i]),
+                           hmm_compact_out_history(&c[i]));
+            }
+            if (rand() % 5 == 0) {
+                hmm_enter(&a[i], best_a - rand() % 500, f * N_HMM + i, f);
+                hmm_compact_enter(ctx, &c[i], hmm_in_score(&a[i]),
+                                  f * N_HMM + i, f);
+            }
+        }
+    }
+
+    ckd_free(a);
+    ckd_free(c);
+    hmm_context_free(ctx);
+    ckd_free_2d(sseq);
+    ckd_free_3d(tp);
+}
+
+int
+main(int argc, char *argv[])
+{
+    srand(42);
+    test_batch(3);
+    test_batch(5);
+    test_compact(3);
+    test_compact(5);
+    return 0;
+}
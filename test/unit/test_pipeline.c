@@ -0,0 +1,144 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "pocketsphinx_internal.h"
+#include "ps_pipeline.h"
+#include "test_macros.h"
+#include "test_ps.c"
+
+#ifdef HAVE_PTHREAD_H
+typedef struct overlap_s {
+    acmod_t *acmod;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    int in_search;      /**< The first search step has started. */
+    int fe_done;        /**< The front end has run during it. */
+    int overlap;        /**< It did so before the search step ended. */
+    int n_frames;       /**< Frames searched. */
+} overlap_t;
+
+/*
+ * Search step which, the first time, waits for the front end to run
+ * on more audio before it finishes.
+ */
+static int
+overlap_search(void *arg)
+{
+    overlap_t *ov = (overlap_t *)arg;
+    int nfr = 0;
+
+    pthread_mutex_lock(&ov->mtx);
+    if (!ov->in_search) {
+        struct timespec ts;
+
+        ov->in_search = TRUE;
+        pthread_cond_broadcast(&ov->cond);
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 10;
+        while (!ov->fe_done)
+            if (pthread_cond_timedwait(&ov->cond, &ov->mtx, &ts) == ETIMEDOUT)
+                break;
+        ov->overlap = ov->fe_done;
+    }
+    pthread_mutex_unlock(&ov->mtx);
+
+    while (ov->acmod->n_feat_frame > 0) {
+        acmod_advance(ov->acmod);
+        ++nfr;
+    }
+    ov->n_frames += nfr;
+    return nfr;
+}
+
+/*
+ * Check that the front end runs on new audio while the decoding
+ * thread is in the middle of a search step.
+ */
+static void
+test_overlap(void)
+{
+    cmd_ln_t *config;
+    ps_decoder_t *ps;
+    ps_pipeline_t *pl;
+    overlap_t ov;
+    int16 buf[3200];
+    FILE *rawfh;
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/en-us/en-us",
+                "-fsg", DATADIR "/goforward.fsg",
+                "-dict", DATADIR "/turtle.dic",
+                "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    memset(&ov, 0, sizeof(ov));
+    ov.acmod = ps->acmod;
+    pthread_mutex_init(&ov.mtx, NULL);
+    pthread_cond_init(&ov.cond, NULL);
+    TEST_ASSERT(pl = ps_pipeline_init(ps->acmod, overlap_search, &ov));
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_EQUAL(3200, fread(buf, sizeof(*buf), 3200, rawfh));
+    TEST_EQUAL(0, acmod_start_utt(ps->acmod));
+    TEST_ASSERT(ps_pipeline_process_raw(pl, buf, 1600) > 0);
+
+    /* Wait for the search to start on the first block... */
+    pthread_mutex_lock(&ov.mtx);
+    while (!ov.in_search)
+        pthread_cond_wait(&ov.cond, &ov.mtx);
+    pthread_mutex_unlock(&ov.mtx);
+    /* ...and compute features for the second one while it goes on. */
+    TEST_ASSERT(ps_pipeline_process_raw(pl, buf + 1600, 1600) > 0);
+    pthread_mutex_lock(&ov.mtx);
+    ov.fe_done = TRUE;
+    pthread_cond_broadcast(&ov.cond);
+    pthread_mutex_unlock(&ov.mtx);
+
+    TEST_EQUAL(0, ps_pipeline_wait(pl));
+    acmod_end_utt(ps->acmod);
+    TEST_ASSERT(ov.overlap);
+    TEST_ASSERT(ov.n_frames > 0);
+
+    fclose(rawfh);
+    ps_pipeline_free(pl);
+    pthread_cond_destroy(&ov.cond);
+    pthread_mutex_destroy(&ov.mtx);
+    ps_free(ps);
+    cmd_ln_free_r(config);
+}
+#endif /* HAVE_PTHREAD_H */
+
+int
+main(int argc, char *argv[])
+{
+    cmd_ln_t *config;
+
+#ifdef HAVE_PTHREAD_H
+    test_overlap();
+#endif
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/en-us/en-us",
+                "-lm", MODELDIR "/en-us/en-us.lm.bin",
+                "-dict", MODELDIR "/en-us/cmudict-en-us.dict",
+                "-fwdtree", "yes",
+                "-fwdflat", "yes",
+                "-bestpath", "yes",
+                "-compallsen", "yes",
+                "-score_batch", "4",
+                "-pipeline", "yes",
+                "-samprate", "16000", NULL));
+    return ps_decoder_test(config, "PIPELINE", "go forward ten meters");
+}
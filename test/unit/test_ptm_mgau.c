@@ -6,6 +6,7 @@
 #include "pocketsphinx_internal.h"
 #include "ptm_mgau.h"
 #include "ms_mgau.h"
+#include "tied_mgau_common.h"
 #include "test_macros.h"
 
 static const mfcc_t cmninit[13] = {
@@ -78,6 +79,388 @@ run_acmod_test(acmod_t *acmod)
 	fclose(rawfh);
 }
 
+void
+run_gmm_simd_test(ptm_mgau_t *s)
+{
+	gmm_dist_func_t dist;
+	mfcc_t *obs;
+	int level, cw, ceplen;
+
+	/* Score every Gaussian in the first codebook against the mean of
+	 * the first one with each available kernel. */
+	ceplen = s->g->featlen[0];
+	obs = s->g->mean[0][0][0];
+	for (level = GMM_SIMD_NONE; level < GMM_SIMD_AUTO; ++level) {
+		dist = gmm_simd_dist_func(gmm_simd_select(gmm_simd_name(level)));
+		for (cw = 0; cw < s->g->n_density; ++cw) {
+			mfcc_t *mean = s->g->mean[0][0][0] + cw * ceplen;
+			mfcc_t *var = s->g->var[0][0][0] + cw * ceplen;
+			mfcc_t ref, d, thresh;
+
+			ref = gmm_dist_scalar(obs, mean, var, ceplen,
+					      s->g->det[0][0][cw], GMM_NO_THRESH);
+			d = (*dist)(obs, mean, var, ceplen,
+				    s->g->det[0][0][cw], GMM_NO_THRESH);
+			TEST_ASSERT(fabs(MFCC2FLOAT(ref) - MFCC2FLOAT(d))
+				    <= 1e-4 * fabs(MFCC2FLOAT(ref)) + 1);
+			/* Early termination must never let a Gaussian
+			 * through that is worse than the threshold. */
+			thresh = ref + (ref < 0 ? -ref : ref) / 100 + 1;
+			d = (*dist)(obs, mean, var, ceplen,
+				    s->g->det[0][0][cw], thresh);
+			TEST_ASSERT(d < thresh);
+		}
+	}
+}
+
+void
+run_gauden_simd_test(ptm_mgau_t *s)
+{
+	gauden_dist_t **ref, **dist;
+	mfcc_t *obs[4];
+	int level, mgau, f, n_top;
+
+	/* The interleaved Gaussian parameters must give exactly the same
+	 * top-N as the original ones. */
+	n_top = 4;
+	ref = (gauden_dist_t **)ckd_calloc_2d(s->g->n_feat, s->g->n_density,
+					      sizeof(**ref));
+	dist = (gauden_dist_t **)ckd_calloc_2d(s->g->n_feat, s->g->n_density,
+					       sizeof(**dist));
+	for (level = GMM_SIMD_NONE; level < GMM_SIMD_AUTO; ++level) {
+		for (mgau = 0; mgau < s->g->n_mgau; ++mgau) {
+			/* Use one of the means as the observation. */
+			for (f = 0; f < s->g->n_feat; ++f)
+				obs[f] = s->g->mean[(mgau + 1) % s->g->n_mgau][f]
+					[mgau % s->g->n_density];
+			gauden_set_simd(s->g, GMM_SIMD_NONE);
+			gauden_dist(s->g, mgau, n_top, obs, ref);
+			gauden_set_simd(s->g, gmm_simd_select(gmm_simd_name(level)));
+			gauden_dist(s->g, mgau, n_top, obs, dist);
+			for (f = 0; f < s->g->n_feat; ++f)
+				TEST_EQUAL(0, memcmp(ref[f], dist[f],
+						     n_top * sizeof(**ref)));
+			/* And with all of the densities. */
+			gauden_dist(s->g, mgau, s->g->n_density, obs, dist);
+			gauden_set_simd(s->g, GMM_SIMD_NONE);
+			gauden_dist(s->g, mgau, s->g->n_density, obs, ref);
+			for (f = 0; f < s->g->n_feat; ++f)
+				TEST_EQUAL(0, memcmp(ref[f], dist[f],
+						     s->g->n_density * sizeof(**ref)));
+		}
+	}
+	ckd_free_2d(ref);
+	ckd_free_2d(dist);
+}
+
+void
+run_senone_simd_test(ptm_mgau_t *s, logmath_t *lmath)
+{
+	senone_t sen;
+	gauden_dist_t ***dist;
+	mfcc_t *obs[4];
+	int16 *ref, *scores;
+	int32 best, refbest;
+	int level, pass, id, f, c, n_top;
+
+	/* Score the PTM weights and Gaussians as a continuous model with
+	 * fast log-addition, first with a codebook per phone, then
+	 * transposed with a single codebook.  The vector code must give
+	 * exactly the same scores as senone_eval(). */
+	n_top = 4;
+	memset(&sen, 0, sizeof(sen));
+	sen.lmath = logmath_init(logmath_get_base(lmath), SENSCR_SHIFT, TRUE);
+	sen.n_sen = s->n_sen;
+	sen.n_feat = s->g->n_feat;
+	sen.n_cw = s->g->n_density;
+	sen.aw = 1;
+	sen.fastlogadd = TRUE;
+	sen.mgau = ckd_calloc(sen.n_sen, sizeof(*sen.mgau));
+	dist = (gauden_dist_t ***)ckd_calloc_3d(s->g->n_mgau, s->g->n_feat,
+						n_top, sizeof(***dist));
+	for (f = 0; f < s->g->n_feat; ++f)
+		obs[f] = s->g->mean[0][f][0];
+	for (c = 0; c < s->g->n_mgau; ++c)
+		gauden_dist(s->g, c, n_top, obs, dist[c]);
+	ref = ckd_calloc(sen.n_sen, sizeof(*ref));
+	scores = ckd_calloc(sen.n_sen, sizeof(*scores));
+	for (pass = 0; pass < 2; ++pass) {
+		if (pass == 0) {
+			sen.n_gauden = s->g->n_mgau;
+			sen.pdf = (senprob_t ***)ckd_calloc_3d(sen.n_sen, sen.n_feat,
+							       sen.n_cw,
+							       sizeof(senprob_t));
+			for (id = 0; id < sen.n_sen; ++id) {
+				sen.mgau[id] = s->sen2cb[id];
+				for (f = 0; f < sen.n_feat; ++f)
+					for (c = 0; c < sen.n_cw; ++c)
+						sen.pdf[id][f][c] = s->mixw[f][c][id];
+			}
+		}
+		else {
+			ckd_free_3d(sen.pdf);
+			sen.n_gauden = 1;
+			sen.pdf = s->mixw;
+			memset(sen.mgau, 0, sen.n_sen * sizeof(*sen.mgau));
+		}
+		senone_set_simd(&sen, GMM_SIMD_NONE);
+		refbest = senone_eval_all(&sen, dist, n_top, ref, 0, sen.n_sen);
+		for (id = 0; id < sen.n_sen; ++id)
+			TEST_EQUAL(ref[id], senone_eval(&sen, id,
+							dist[sen.mgau[id]], n_top));
+		for (level = GMM_SIMD_NONE; level < GMM_SIMD_AUTO; ++level) {
+			senone_set_simd(&sen, gmm_simd_select(gmm_simd_name(level)));
+			if (sen.mixw_simd == NULL)
+				continue;
+			best = senone_eval_all(&sen, dist, n_top, scores, 0, sen.n_sen);
+			TEST_EQUAL(refbest, best);
+			TEST_EQUAL(0, memcmp(ref, scores, sen.n_sen * sizeof(*ref)));
+		}
+	}
+	ckd_free(ref);
+	ckd_free(scores);
+	ckd_free_3d(dist);
+	ckd_free(sen.mgau);
+	logmath_free(sen.lmath);
+}
+
+void
+run_mixw_simd_test(ptm_mgau_t *s)
+{
+	gmm_mixw_funcs_t const *mf;
+	uint8 const *logadd;
+	uint8 const *rows[4];
+	uint8 mixw_cb[16];
+	int16 score[4], *ref, *scores, *den;
+	int level, j, k, n_sen;
+
+	/* Log-add the mixture weights of the first few codewords with
+	 * each available kernel, which must give exactly the same
+	 * results as fast_logmath_add(). */
+	logadd = LOGMATH_TABLE(s->lmath_8b)->table;
+	TEST_ASSERT(gmm_simd_logadd_ok(logadd,
+				       LOGMATH_TABLE(s->lmath_8b)->table_size));
+	n_sen = s->n_sen & ~1;
+	for (k = 0; k < 4; ++k) {
+		rows[k] = s->mixw[0][k];
+		score[k] = k * 20;
+	}
+	for (j = 0; j < 16; ++j)
+		mixw_cb[j] = j * 10;
+	ref = ckd_calloc(n_sen, sizeof(*ref));
+	scores = ckd_calloc(n_sen, sizeof(*scores));
+	den = ckd_calloc(4 * n_sen, sizeof(*den));
+	for (level = GMM_SIMD_NONE; level < GMM_SIMD_AUTO; ++level) {
+		if ((mf = gmm_simd_mixw_funcs(gmm_simd_select(gmm_simd_name(level))))
+		    == NULL)
+			continue;
+		/* 8-bit weights. */
+		for (j = 0; j < n_sen; ++j) {
+			int32 tmp = rows[0][j] + score[0];
+			for (k = 1; k < 4; ++k)
+				tmp = fast_logmath_add(s->lmath_8b, tmp,
+						       rows[k][j] + score[k]);
+			ref[j] = tmp;
+		}
+		memset(scores, 0, n_sen * sizeof(*scores));
+		(*mf->mixw8)(scores, rows, score, 4, 0, n_sen, logadd);
+		TEST_EQUAL(0, memcmp(ref, scores, n_sen * sizeof(*ref)));
+		/* Already gathered densities. */
+		for (k = 0; k < 4; ++k)
+			for (j = 0; j < n_sen; ++j)
+				den[k * n_sen + j] = rows[k][j] + score[k];
+		(*mf->logadd)(scores, den, n_sen, 4, n_sen, logadd);
+		TEST_EQUAL(0, memcmp(ref, scores, n_sen * sizeof(*ref)));
+		/* 4-bit weights (just reusing the same rows). */
+		for (j = 0; j < n_sen; ++j) {
+			int32 tmp;
+			int cw;
+
+			cw = (j & 1) ? rows[0][j/2] >> 4 : rows[0][j/2] & 0x0f;
+			tmp = mixw_cb[cw] + score[0];
+			for (k = 1; k < 4; ++k) {
+				cw = (j & 1) ? rows[k][j/2] >> 4 : rows[k][j/2] & 0x0f;
+				tmp = fast_logmath_add(s->lmath_8b, tmp,
+						       mixw_cb[cw] + score[k]);
+			}
+			ref[j] = tmp;
+		}
+		memset(scores, 0, n_sen * sizeof(*scores));
+		(*mf->mixw4)(scores, rows, score, 4, 0, n_sen, mixw_cb, logadd);
+		TEST_EQUAL(0, memcmp(ref, scores, n_sen * sizeof(*ref)));
+	}
+	ckd_free(ref);
+	ckd_free(scores);
+	ckd_free(den);
+}
+
+void
+run_kdtree_test(ptm_mgau_t *s, cmd_ln_t *config)
+{
+	kdtree_t *kd, *kd2;
+	int m, f, cw, k;
+
+	TEST_ASSERT((kd = kdtree_build(s->g, 3.0, 8, 8)));
+	TEST_EQUAL(0, kdtree_check(kd, s->g));
+	TEST_EQUAL(0, kdtree_write(kd, "kdtrees.out"));
+	TEST_ASSERT((kd2 = kdtree_read(config, "kdtrees.out")));
+	TEST_EQUAL(0, kdtree_check(kd2, s->g));
+	TEST_EQUAL(kd->n_node, kd2->n_node);
+	TEST_EQUAL(kd->n_cw, kd2->n_cw);
+	TEST_EQUAL(0, memcmp(kd->node, kd2->node,
+			     kd->n_node * sizeof(*kd->node)));
+	TEST_EQUAL(0, memcmp(kd->bucket, kd2->bucket,
+			     kd->n_cw * sizeof(*kd->bucket)));
+	/* Every Gaussian's box contains its own mean, so it must always
+	 * be in the bucket for that mean. */
+	for (m = 0; m < s->g->n_mgau; ++m) {
+		for (f = 0; f < s->g->n_feat; ++f) {
+			for (cw = 0; cw < s->g->n_density; ++cw) {
+				uint16 const *cand;
+				int32 n_cand;
+
+				n_cand = kdtree_query(kd2, m, f,
+						      s->g->mean[m][f][cw], &cand);
+				TEST_ASSERT(n_cand > 0);
+				TEST_ASSERT(n_cand <= s->g->n_density);
+				for (k = 0; k < n_cand; ++k)
+					if (cand[k] == cw)
+						break;
+				TEST_ASSERT(k < n_cand);
+			}
+		}
+	}
+	kdtree_free(kd);
+	kdtree_free(kd2);
+}
+
+void
+run_compare_test(cmd_ln_t *config, logmath_t *lmath, acmod_t *acmod,
+		 char const *name, int value, int compallsen)
+{
+	acmod_t *acmod2;
+	FILE *rawfh;
+	int16 *buf;
+	int16 const *bptr;
+	size_t nread, nread2;
+	int n_sen, old_value, old_compallsen;
+
+	/* Scores must be the same whatever the value of this option. */
+	old_value = cmd_ln_int32_r(config, name);
+	cmd_ln_set_int32_r(config, name, value);
+	TEST_ASSERT((acmod2 = acmod_init(config, lmath, NULL, NULL)));
+	cmd_ln_set_int32_r(config, name, old_value);
+	old_compallsen = acmod->compallsen;
+	acmod->compallsen = acmod2->compallsen = compallsen;
+	cmn_live_set(acmod->fcb->cmn_struct, cmninit);
+	cmn_live_set(acmod2->fcb->cmn_struct, cmninit);
+	n_sen = bin_mdef_n_sen(acmod->mdef);
+	buf = ckd_calloc(2048, sizeof(*buf));
+	TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+	TEST_EQUAL(0, acmod_start_utt(acmod));
+	TEST_EQUAL(0, acmod_start_utt(acmod2));
+	while ((nread = fread(buf, sizeof(*buf), 2048, rawfh)) > 0) {
+		nread2 = nread;
+		bptr = buf;
+		while (acmod_process_raw(acmod, &bptr, &nread, FALSE) > 0)
+			;
+		bptr = buf;
+		while (acmod_process_raw(acmod2, &bptr, &nread2, FALSE) > 0)
+			;
+		while (acmod->n_feat_frame > 0) {
+			int16 const *scores, *scores2;
+			int frame_idx = -1, frame_idx2 = -1;
+
+			TEST_ASSERT(acmod2->n_feat_frame > 0);
+			scores = acmod_score(acmod, &frame_idx);
+			scores2 = acmod_score(acmod2, &frame_idx2);
+			TEST_EQUAL(frame_idx, frame_idx2);
+			TEST_EQUAL(0, memcmp(scores, scores2,
+					     n_sen * sizeof(*scores)));
+			acmod_advance(acmod);
+			acmod_advance(acmod2);
+		}
+	}
+	TEST_EQUAL(0, acmod_end_utt(acmod));
+	TEST_EQUAL(0, acmod_end_utt(acmod2));
+	fclose(rawfh);
+	ckd_free(buf);
+	acmod_free(acmod2);
+	acmod->compallsen = old_compallsen;
+}
+
+void
+run_active_vec_test(cmd_ln_t *config, logmath_t *lmath, acmod_t *acmod)
+{
+	acmod_t *acmod2;
+	ps_mgaufuncs_t listvt;
+	FILE *rawfh;
+	int16 *buf;
+	int16 const *bptr;
+	size_t nread, nread2;
+	int n_sen, old_compallsen;
+
+	/* Scoring straight from the active senone bitvector must give the
+	 * same scores as going through the delta list. */
+	TEST_ASSERT((acmod2 = acmod_init(config, lmath, NULL, NULL)));
+	TEST_ASSERT(acmod->mgau->vt->frame_eval_active != NULL);
+	listvt = *acmod2->mgau->vt;
+	listvt.frame_eval_active = NULL;
+	acmod2->mgau->vt = &listvt;
+	old_compallsen = acmod->compallsen;
+	acmod->compallsen = acmod2->compallsen = FALSE;
+	cmn_live_set(acmod->fcb->cmn_struct, cmninit);
+	cmn_live_set(acmod2->fcb->cmn_struct, cmninit);
+	n_sen = bin_mdef_n_sen(acmod->mdef);
+	buf = ckd_calloc(2048, sizeof(*buf));
+	TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+	TEST_EQUAL(0, acmod_start_utt(acmod));
+	TEST_EQUAL(0, acmod_start_utt(acmod2));
+	while ((nread = fread(buf, sizeof(*buf), 2048, rawfh)) > 0) {
+		nread2 = nread;
+		bptr = buf;
+		while (acmod_process_raw(acmod, &bptr, &nread, FALSE) > 0)
+			;
+		bptr = buf;
+		while (acmod_process_raw(acmod2, &bptr, &nread2, FALSE) > 0)
+			;
+		while (acmod->n_feat_frame > 0) {
+			int16 const *scores, *scores2;
+			int frame_idx = -1, frame_idx2 = -1;
+			int sen, n_active;
+
+			TEST_ASSERT(acmod2->n_feat_frame > 0);
+			/* Gaps are kept under 255 senones so that the
+			 * delta list has no extra entries. */
+			acmod_clear_active(acmod);
+			acmod_clear_active(acmod2);
+			n_active = 0;
+			for (sen = acmod->output_frame % 7; sen < n_sen;
+			     sen += 1 + (sen * 31 + acmod->output_frame) % 200) {
+				acmod_activate_sen(acmod, sen);
+				acmod_activate_sen(acmod2, sen);
+				++n_active;
+			}
+			scores = acmod_score(acmod, &frame_idx);
+			scores2 = acmod_score(acmod2, &frame_idx2);
+			TEST_EQUAL(frame_idx, frame_idx2);
+			TEST_EQUAL(n_active, acmod->n_senone_active);
+			TEST_EQUAL(n_active, acmod2->n_senone_active);
+			for (sen = 0; sen < n_sen; ++sen)
+				if (bitvec_is_set(acmod->senone_active_vec, sen))
+					TEST_EQUAL(scores[sen], scores2[sen]);
+			acmod_advance(acmod);
+			acmod_advance(acmod2);
+		}
+	}
+	TEST_EQUAL(0, acmod_end_utt(acmod));
+	TEST_EQUAL(0, acmod_end_utt(acmod2));
+	fclose(rawfh);
+	ckd_free(buf);
+	acmod_free(acmod2);
+	acmod->compallsen = old_compallsen;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -121,7 +504,28 @@ main(int argc, char *argv[])
 		}
 	}
 	E_INFOCONT("-%d\n", i-1);
+	run_gmm_simd_test(s);
+	run_mixw_simd_test(s);
+	run_gauden_simd_test(s);
+	run_senone_simd_test(s, lmath);
+	run_kdtree_test(s, config);
+	/* Multi-threaded and batched scoring must give the same scores. */
+	run_compare_test(config, lmath, acmod, "-nthreads_score", 3, TRUE);
+	run_compare_test(config, lmath, acmod, "-score_batch", 4, TRUE);
+	run_compare_test(config, lmath, acmod, "-score_batch", 4, FALSE);
+	run_active_vec_test(config, lmath, acmod);
+	run_acmod_test(acmod);
+	/* Nothing is pruned with the codebook beam off. */
+	TEST_EQUAL(0, s->n_cb_frames);
+	TEST_EQUAL(0, s->n_cb_pruned_total);
+
+	/* Now do it again with codebook pruning, which must actually
+	 * prune some codebooks, but never all of them. */
+	s->cb_beam = logmath_log(lmath, 1e-10);
 	run_acmod_test(acmod);
+	TEST_ASSERT(s->n_cb_frames > 0);
+	TEST_ASSERT(s->n_cb_pruned_total > 0);
+	TEST_ASSERT(s->n_cb_pruned_total < s->n_cb_frames * s->g->n_mgau);
 
 #if 0
 	/* Replace it with ms_mgau. */
@@ -0,0 +1,107 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pocketsphinx_internal.h"
+#include "s2_semi_mgau.h"
+#include "test_macros.h"
+
+void
+run_compare_test(cmd_ln_t *config, logmath_t *lmath, acmod_t *acmod,
+		 char const *name, int value)
+{
+	acmod_t *acmod2;
+	FILE *rawfh;
+	int16 *buf;
+	int16 const *bptr;
+	size_t nread, nread2;
+	int n_sen, n_frames, old_value;
+
+	/* Scores must be the same whatever the value of this option. */
+	old_value = cmd_ln_int32_r(config, name);
+	cmd_ln_set_int32_r(config, name, value);
+	TEST_ASSERT((acmod2 = acmod_init(config, lmath, NULL, NULL)));
+	cmd_ln_set_int32_r(config, name, old_value);
+	n_sen = bin_mdef_n_sen(acmod->mdef);
+	n_frames = 0;
+	buf = ckd_calloc(2048, sizeof(*buf));
+	TEST_ASSERT(rawfh = fopen(DATADIR "/tidigits/dhd.2934z.raw", "rb"));
+	TEST_EQUAL(0, acmod_start_utt(acmod));
+	TEST_EQUAL(0, acmod_start_utt(acmod2));
+	while ((nread = fread(buf, sizeof(*buf), 2048, rawfh)) > 0) {
+		nread2 = nread;
+		bptr = buf;
+		while (acmod_process_raw(acmod, &bptr, &nread, FALSE) > 0)
+			;
+		bptr = buf;
+		while (acmod_process_raw(acmod2, &bptr, &nread2, FALSE) > 0)
+			;
+		while (acmod->n_feat_frame > 0) {
+			int16 const *scores, *scores2;
+			int frame_idx = -1, frame_idx2 = -1;
+
+			TEST_ASSERT(acmod2->n_feat_frame > 0);
+			scores = acmod_score(acmod, &frame_idx);
+			scores2 = acmod_score(acmod2, &frame_idx2);
+			TEST_EQUAL(frame_idx, frame_idx2);
+			TEST_EQUAL(0, memcmp(scores, scores2,
+					     n_sen * sizeof(*scores)));
+			acmod_advance(acmod);
+			acmod_advance(acmod2);
+			++n_frames;
+		}
+	}
+	TEST_ASSERT(n_frames > 0);
+	TEST_EQUAL(0, acmod_end_utt(acmod));
+	TEST_EQUAL(0, acmod_end_utt(acmod2));
+	fclose(rawfh);
+	ckd_free(buf);
+	acmod_free(acmod2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	logmath_t *lmath;
+	cmd_ln_t *config;
+	acmod_t *acmod;
+	s2_semi_mgau_t *s;
+
+	lmath = logmath_init(1.0001, 0, 0);
+	config = cmd_ln_init(NULL, ps_args(), TRUE,
+			     "-compallsen", "yes",
+			     "-samprate", "8000",
+			     NULL);
+	cmd_ln_parse_file_r(config, ps_args(),
+			    DATADIR "/tidigits/hmm/feat.params", FALSE);
+	cmd_ln_set_str_extra_r(config, "_mdef", DATADIR "/tidigits/hmm/mdef");
+	cmd_ln_set_str_extra_r(config, "_mean", DATADIR "/tidigits/hmm/means");
+	cmd_ln_set_str_extra_r(config, "_var", DATADIR "/tidigits/hmm/variances");
+	cmd_ln_set_str_extra_r(config, "_tmat", DATADIR "/tidigits/hmm/transition_matrices");
+	cmd_ln_set_str_extra_r(config, "_sendump", DATADIR "/tidigits/hmm/sendump");
+	cmd_ln_set_str_extra_r(config, "_mixw", NULL);
+	cmd_ln_set_str_extra_r(config, "_lda", NULL);
+	cmd_ln_set_str_extra_r(config, "_senmgau", NULL);
+
+	TEST_ASSERT((acmod = acmod_init(config, lmath, NULL, NULL)));
+	TEST_EQUAL(0, strcmp(acmod->mgau->vt->name, "s2_semi"));
+	s = (s2_semi_mgau_t *)acmod->mgau;
+	TEST_EQUAL(4, s->g->n_feat);
+	TEST_ASSERT(!s->split_cw);
+
+	/* With fewer threads than streams the work is split by stream,
+	 * with more, the codewords of each stream are split.  Both must
+	 * give the same scores as a single thread. */
+	run_compare_test(config, lmath, acmod, "-nthreads_score", 3);
+	run_compare_test(config, lmath, acmod, "-nthreads_score", 6);
+	/* Also when the top-N is only updated every other frame. */
+	cmd_ln_set_int32_r(config, "-ds", 2);
+	acmod_free(acmod);
+	TEST_ASSERT((acmod = acmod_init(config, lmath, NULL, NULL)));
+	run_compare_test(config, lmath, acmod, "-nthreads_score", 6);
+
+	acmod_free(acmod);
+	logmath_free(lmath);
+	cmd_ln_free_r(config);
+	return 0;
+}
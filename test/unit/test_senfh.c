@@ -83,6 +83,71 @@ main(int argc, char *argv[])
                              ngram_search_find_exit(ngs, -1, NULL))));
         fclose(senfh);
     }
+    /* Now do it again with the indexed formats, memory-mapped. */
+    {
+        static char const *fmts[] = { "indexed", "delta", "int8" };
+        int i;
+
+        for (i = 0; i < 3; ++i) {
+            FILE *rawfh, *senfh;
+            int16 buf[2048];
+            size_t nread;
+            int16 const *bptr;
+            int nfr, n_written, n_read;
+
+            printf("Format %s\n", fmts[i]);
+            cmd_ln_set_str_r(config, "-senlogfmt", fmts[i]);
+            TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+            TEST_EQUAL(0, acmod_start_utt(acmod));
+            TEST_ASSERT(senfh = fopen("goforward.sen", "wb"));
+            TEST_EQUAL(0, acmod_set_senfh(acmod, senfh));
+            TEST_ASSERT(acmod->senwriter != NULL);
+            ngram_fwdtree_start(ngs);
+            n_written = 0;
+            while (!feof(rawfh)) {
+                nread = fread(buf, sizeof(*buf), 2048, rawfh);
+                bptr = buf;
+                while ((nfr = acmod_process_raw(acmod, &bptr, &nread, FALSE)) > 0) {
+                    while (acmod->n_feat_frame > 0) {
+                        ngram_fwdtree_search(ngs, acmod->output_frame);
+                        acmod_advance(acmod);
+                        ++n_written;
+                    }
+                }
+            }
+            ngram_fwdtree_finish(ngs);
+            TEST_ASSERT(acmod_end_utt(acmod) >= 0);
+            fclose(rawfh);
+
+            TEST_EQUAL(0, acmod_start_utt(acmod));
+            TEST_ASSERT(senfh = fopen("goforward.sen", "rb"));
+            TEST_EQUAL(0, acmod_set_insenfile(acmod, senfh, "goforward.sen"));
+            TEST_ASSERT(acmod->insenfile != NULL);
+            TEST_EQUAL(n_written, senfile_n_frame(acmod->insenfile));
+            ngram_fwdtree_start(ngs);
+            n_read = 0;
+            while ((nfr = acmod_read_scores(acmod)) > 0) {
+                while (acmod->n_feat_frame > 0) {
+                    ngram_fwdtree_search(ngs, acmod->output_frame);
+                    acmod_advance(acmod);
+                    ++n_read;
+                }
+            }
+            ngram_fwdtree_finish(ngs);
+            printf("%s\n",
+                   ngram_search_bp_hyp(ngs, ngram_search_find_exit(ngs, -1, NULL)));
+            TEST_ASSERT(acmod_end_utt(acmod) >= 0);
+            TEST_EQUAL(n_written, n_read);
+            /* Only the quantized scores may change the result. */
+            if (i < 2) {
+                TEST_EQUAL(0, strcmp("go forward ten meters",
+                                     ngram_search_bp_hyp(ngs,
+                                             ngram_search_find_exit(ngs, -1, NULL))));
+            }
+            TEST_EQUAL(0, acmod_set_insenfh(acmod, NULL));
+            fclose(senfh);
+        }
+    }
     ps_free(ps);
     cmd_ln_free_r(config);
 
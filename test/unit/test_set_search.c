@@ -145,6 +145,77 @@ test_check_mode()
     cmd_ln_free_r(config);
 }
 
+static void
+test_activate_search()
+{
+    cmd_ln_t *config = default_config();
+    ps_decoder_t *ps;
+    FILE *rawfh;
+    char const *hyp;
+    int32 score;
+
+    cmd_ln_set_str_r(config, "-lm", MODELDIR "/en-us/en-us.lm.bin");
+    ps = ps_init(config);
+    TEST_ASSERT(!ps_set_jsgf_file(ps, "goforward", DATADIR "/goforward.gram"));
+    TEST_ASSERT(!ps_set_search(ps, PS_DEFAULT_SEARCH));
+    TEST_EQUAL(-1, ps_activate_search(ps, "nosuchsearch"));
+    TEST_EQUAL(-1, ps_deactivate_search(ps, "goforward"));
+    TEST_ASSERT(!ps_activate_search(ps, "goforward"));
+    /* Activating twice is harmless. */
+    TEST_ASSERT(!ps_activate_search(ps, "goforward"));
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    ps_decode_raw(ps, rawfh, -1);
+    fclose(rawfh);
+    hyp = ps_get_hyp(ps, &score);
+    printf("%s: %s (%d)\n", PS_DEFAULT_SEARCH, hyp, score);
+    TEST_EQUAL(0, strcmp(hyp, "go forward ten meters"));
+    hyp = ps_get_search_hyp(ps, "goforward", &score);
+    printf("goforward: %s (%d)\n", hyp, score);
+    TEST_EQUAL(0, strcmp(hyp, "go forward ten meters"));
+    TEST_EQUAL(NULL, ps_get_search_hyp(ps, "nosuchsearch", &score));
+
+    ps_start_utt(ps);
+    TEST_EQUAL(-1, ps_activate_search(ps, "goforward"));
+    ps_end_utt(ps);
+    TEST_ASSERT(!ps_deactivate_search(ps, "goforward"));
+
+    ps_free(ps);
+    cmd_ln_free_r(config);
+}
+
+static void
+test_decode_multi()
+{
+    cmd_ln_t *config = default_config();
+    ps_decoder_t *ps = ps_init(config);
+    char const *names[] = { "digits", "goforward" };
+    char const *hyps[2];
+    int32 scores[2];
+    FILE *rawfh;
+
+    TEST_ASSERT(!ps_set_jsgf_file(ps, "goforward", DATADIR "/goforward.gram"));
+    TEST_ASSERT(!ps_set_jsgf_string(ps, "digits",
+                                    "#JSGF V1.0;\n"
+                                    "grammar digits;\n"
+                                    "public <digits> = (one | two | three)+;\n"));
+    TEST_ASSERT(!ps_set_search(ps, "digits"));
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_EQUAL(1, ps_decode_multi(ps, rawfh, names, 2, hyps, scores));
+    fclose(rawfh);
+    printf("goforward: %s (%d)\n", hyps[1], scores[1]);
+    printf("digits: %s (%d)\n", hyps[0] ? hyps[0] : "(null)", scores[0]);
+    TEST_EQUAL(0, strcmp(hyps[1], "go forward ten meters"));
+    TEST_EQUAL(0, strcmp(ps_get_search(ps), "digits"));
+
+    names[1] = "nosuchsearch";
+    TEST_EQUAL(-1, ps_decode_multi(ps, NULL, names, 2, hyps, scores));
+
+    ps_free(ps);
+    cmd_ln_free_r(config);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -155,6 +226,8 @@ main(int argc, char* argv[])
     test_default_lmctl();
     test_set_search();
     test_check_mode();
+    test_activate_search();
+    test_decode_multi();
 
     return 0;
 }
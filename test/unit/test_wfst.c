@@ -0,0 +1,114 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pocketsphinx_internal.h"
+#include "wfst_graph.h"
+#include "test_macros.h"
+
+static void
+decode_goforward(ps_decoder_t *ps, char const *expected)
+{
+    const char *hyp;
+    ps_seg_t *seg;
+    int32 score;
+    FILE *rawfh;
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    ps_decode_raw(ps, rawfh, -1);
+    fclose(rawfh);
+    hyp = ps_get_hyp(ps, &score);
+    printf("%s (%d)\n", hyp, score);
+    TEST_ASSERT(hyp);
+    if (expected)
+        TEST_EQUAL(0, strcmp(expected, hyp));
+
+    for (seg = ps_seg_iter(ps); seg;
+         seg = ps_seg_next(seg)) {
+        char const *word;
+        int sf, ef;
+        int32 lscr, ascr, lback;
+
+        word = ps_seg_word(seg);
+        ps_seg_frames(seg, &sf, &ef);
+        ps_seg_prob(seg, &ascr, &lscr, &lback);
+        printf("%s (%d:%d) ascr = %d\n", word, sf, ef, ascr);
+        TEST_ASSERT(sf <= ef);
+    }
+}
+
+/*
+ * Load a copy of a graph with some changes to its header.
+ */
+static int
+load_modified(ps_decoder_t *ps, char const *file, int32 n_sen_delta,
+              float64 logbase)
+{
+    wfst_hdr_t hdr;
+    FILE *infh, *outfh;
+    char buf[4096];
+    size_t nread;
+    int rv;
+
+    TEST_ASSERT(infh = fopen(file, "rb"));
+    TEST_ASSERT(outfh = fopen("test_wfst_mod.fst", "wb"));
+    TEST_EQUAL(1, fread(&hdr, sizeof(hdr), 1, infh));
+    hdr.n_sen += n_sen_delta;
+    if (logbase != 0)
+        hdr.logbase = logbase;
+    TEST_EQUAL(1, fwrite(&hdr, sizeof(hdr), 1, outfh));
+    while ((nread = fread(buf, 1, sizeof(buf), infh)) > 0)
+        TEST_EQUAL(nread, fwrite(buf, 1, nread, outfh));
+    fclose(infh);
+    fclose(outfh);
+    rv = ps_set_wfst_file(ps, "modified", "test_wfst_mod.fst");
+    remove("test_wfst_mod.fst");
+    return rv;
+}
+
+int
+main(int argc, char *argv[])
+{
+    ps_decoder_t *ps;
+    cmd_ln_t *config;
+    ngram_model_t *lm;
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/en-us/en-us",
+                "-fsg", DATADIR "/goforward.fsg",
+                "-dict", DATADIR "/turtle.dic",
+                "-bestpath", "no",
+                "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+
+    /* Build a graph from the grammar and decode with it. */
+    TEST_EQUAL(0, ps_build_wfst_fsg(ps, ps_get_fsg(ps, PS_DEFAULT_SEARCH),
+                                    "test_wfst_fsg.fst"));
+    TEST_EQUAL(0, ps_set_wfst_file(ps, "wfst_fsg", "test_wfst_fsg.fst"));
+    TEST_EQUAL(0, ps_set_search(ps, "wfst_fsg"));
+    decode_goforward(ps, "go forward ten meters");
+
+    /* Now one from a language model. */
+    TEST_ASSERT(lm = ngram_model_read(config, DATADIR "/turtle.lm.bin",
+                                      NGRAM_AUTO, ps_get_logmath(ps)));
+    TEST_EQUAL(0, ps_build_wfst_lm(ps, lm, "test_wfst_lm.fst"));
+    ngram_model_free(lm);
+    TEST_EQUAL(0, ps_set_wfst_file(ps, "wfst_lm", "test_wfst_lm.fst"));
+    TEST_EQUAL(0, ps_set_search(ps, "wfst_lm"));
+    decode_goforward(ps, "go forward ten meters");
+
+    /* A graph is not usable with another acoustic model or log base,
+     * and something else entirely is not a graph. */
+    TEST_EQUAL(0, load_modified(ps, "test_wfst_fsg.fst", 0, 0));
+    TEST_ASSERT(load_modified(ps, "test_wfst_fsg.fst", 1, 0) < 0);
+    TEST_ASSERT(load_modified(ps, "test_wfst_lm.fst", 0, 1.0002) < 0);
+    TEST_ASSERT(ps_set_wfst_file(ps, "bogus", DATADIR "/goforward.fsg") < 0);
+    remove("test_wfst_fsg.fst");
+    remove("test_wfst_lm.fst");
+
+    ps_free(ps);
+    cmd_ln_free_r(config);
+
+    return 0;
+}